@@ -3,6 +3,13 @@ plugins {
     alias(libs.plugins.kotlin.android)
 }
 
+val offlineMipmaps = providers.gradleProperty("nativeguitest.offlineMipmaps")
+    .map { it.toBoolean() }.getOrElse(false)
+val mipmappedAssetsDir = layout.buildDirectory.dir("generated/mipmappedAssets")
+val assetPack = providers.gradleProperty("nativeguitest.assetPack")
+    .map { it.toBoolean() }.getOrElse(false)
+val packedAssetsDir = layout.buildDirectory.dir("generated/packedAssets")
+
 android {
     namespace = "com.omsi.nativeguitest"
     compileSdk = 36
@@ -42,6 +49,128 @@ android {
             version = "3.22.1"
         }
     }
+    androidResources {
+        // Texture containers are read in place with AAsset_getBuffer, which needs them stored
+        noCompress += "mtex"
+        noCompress += "ktx2"
+        // The asset pack is mapped whole and served from the mapping
+        noCompress += "mpak"
+    }
+    if (assetPack) {
+        // Everything, mip chains included, goes in through the pack instead
+        sourceSets["main"].assets.setSrcDirs(listOf(packedAssetsDir))
+    } else if (offlineMipmaps) {
+        sourceSets["main"].assets.srcDir(mipmappedAssetsDir)
+    }
+}
+
+// With nativeguitest.offlineMipmaps=true in gradle.properties, mip chains for every PNG asset are
+// built on the host by tools/texturetool and packaged next to the PNGs, so nothing is generated on
+// the GPU at load time. Off by default, since it needs host tools and libpng and the chains are
+// stored uncompressed; textures then fall back to glGenerateMipmap.
+val textureToolBuildDir = layout.buildDirectory.dir("texturetool")
+val textureTool = textureToolBuildDir.map { it.file("texture_tool") }
+val packTool = textureToolBuildDir.map { it.file("pack_tool") }
+
+val configureTextureTool by tasks.registering(Exec::class) {
+    commandLine(
+        "cmake",
+        "-S", rootProject.file("tools").path,
+        "-B", textureToolBuildDir.get().asFile.path,
+        "-DCMAKE_BUILD_TYPE=Release"
+    )
+}
+
+val buildTextureTool by tasks.registering(Exec::class) {
+    dependsOn(configureTextureTool)
+    commandLine(
+        "cmake",
+        "--build", textureToolBuildDir.get().asFile.path,
+        "--target", "texture_tool"
+    )
+}
+
+val generateMipmappedTextures by tasks.registering {
+    dependsOn(buildTextureTool)
+    val assetsDir = file("src/main/assets")
+    inputs.files(fileTree(assetsDir) { include("**/*.png") })
+    inputs.files(rootProject.fileTree("tools/texturetool"))
+    outputs.dir(mipmappedAssetsDir)
+    doLast {
+        fileTree(assetsDir) { include("**/*.png") }.forEach { png ->
+            val container = mipmappedAssetsDir.get()
+                .file(png.relativeTo(assetsDir).path.removeSuffix(".png") + ".mtex").asFile
+            container.parentFile.mkdirs()
+            project.exec {
+                commandLine(textureTool.get().asFile.path, png.path, container.path)
+            }
+        }
+    }
+}
+
+if (offlineMipmaps) {
+    tasks.named("preBuild") { dependsOn(generateMipmappedTextures) }
+}
+
+// With nativeguitest.assetPack=true every asset is packed on the host by tools/packtool into one
+// assets.mpak, which the app maps once and reads every asset out of, instead of opening each
+// through the AssetManager.
+//
+// Every run the app saves the order startup first read its assets in. Pulled into the project
+// with
+//   adb exec-out run-as com.omsi.nativeguitest cat files/asset_access_order.txt \
+//       > app/asset_access_order.txt
+// the next pack lays those assets out first, in that order, so the app reads them ahead in one
+// sequential read at startup. The layout it got is written to build/packedAssetsPrefetch.txt.
+val assetAccessOrder = file("asset_access_order.txt")
+val buildPackTool by tasks.registering(Exec::class) {
+    dependsOn(configureTextureTool)
+    commandLine(
+        "cmake",
+        "--build", textureToolBuildDir.get().asFile.path,
+        "--target", "pack_tool"
+    )
+}
+
+val packAssets by tasks.registering {
+    dependsOn(buildPackTool)
+    if (offlineMipmaps) {
+        dependsOn(generateMipmappedTextures)
+    }
+    val assetsDir = file("src/main/assets")
+    inputs.dir(assetsDir)
+    if (offlineMipmaps) {
+        inputs.dir(mipmappedAssetsDir)
+    }
+    if (assetAccessOrder.exists()) {
+        inputs.file(assetAccessOrder)
+    }
+    outputs.dir(packedAssetsDir)
+    doLast {
+        val pack = packedAssetsDir.get().file("assets.mpak").asFile
+        pack.parentFile.mkdirs()
+        val inputDirs = listOf(assetsDir.path) +
+                if (offlineMipmaps) listOf(mipmappedAssetsDir.get().asFile.path) else listOf()
+        val order = if (assetAccessOrder.exists()) {
+            listOf(
+                "--order", assetAccessOrder.path,
+                "--prefetch-list",
+                layout.buildDirectory.file("packedAssetsPrefetch.txt").get().asFile.path
+            )
+        } else {
+            listOf()
+        }
+        project.exec {
+            commandLine(
+                listOf(packTool.get().asFile.path, "--align", "4096") + order +
+                        listOf(pack.path) + inputDirs
+            )
+        }
+    }
+}
+
+if (assetPack) {
+    tasks.named("preBuild") { dependsOn(packAssets) }
 }
 
 dependencies {
@@ -0,0 +1,54 @@
+#include "AndroidAssetFileSource.h"
+
+#include <algorithm>
+
+/*!
+ * An open AAsset
+ */
+class AndroidAssetFile : public File {
+public:
+    explicit AndroidAssetFile(AAsset *pAsset)
+            : File(int64_t(AAsset_getLength64(pAsset))), pAsset_(pAsset) {}
+
+    ~AndroidAssetFile() override { AAsset_close(pAsset_); }
+
+    const uint8_t *getBuffer() override {
+        return static_cast<const uint8_t *>(AAsset_getBuffer(pAsset_));
+    }
+
+    int64_t read(void *buffer, size_t size) override {
+        return int64_t(AAsset_read(pAsset_, buffer, size));
+    }
+
+    bool seek(int64_t offset) override {
+        return offset >= 0 && offset <= getLength()
+               && AAsset_seek64(pAsset_, off64_t(offset), SEEK_SET) >= 0;
+    }
+
+    void prefetch(int64_t offset, int64_t size) override {
+        if (offset < 0 || size <= 0 || offset >= getLength()) {
+            return;
+        }
+        // Only an asset stored uncompressed is mapped straight out of the APK. A compressed one
+        // is inflated whole into memory by getBuffer, so there's nothing left to read ahead.
+        if (AAsset_isAllocated(pAsset_)) {
+            return;
+        }
+        auto buffer = static_cast<const uint8_t *>(AAsset_getBuffer(pAsset_));
+        if (buffer) {
+            adviseWillNeed(buffer + offset, size_t(std::min(size, getLength() - offset)));
+        }
+    }
+
+private:
+    AAsset *pAsset_;
+};
+
+std::unique_ptr<File> AndroidAssetFileSource::open(const std::string &path, FileAccess access) {
+    auto mode = access == FileAccess::Buffer ? AASSET_MODE_BUFFER : AASSET_MODE_STREAMING;
+    auto pAsset = AAssetManager_open(assetManager_, path.c_str(), mode);
+    if (!pAsset) {
+        return nullptr;
+    }
+    return std::make_unique<AndroidAssetFile>(pAsset);
+}
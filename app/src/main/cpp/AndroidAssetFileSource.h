@@ -0,0 +1,28 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ANDROIDASSETFILESOURCE_H
+#define ANDROIDGLINVESTIGATIONS_ANDROIDASSETFILESOURCE_H
+
+#include <memory>
+#include <string>
+#include <android/asset_manager.h>
+
+#include "FileSystem.h"
+
+/*!
+ * The assets/ directory of the APK, through AAssetManager. Assets stored uncompressed are mapped
+ * straight out of the APK when their buffer is asked for, compressed ones are inflated into
+ * memory first.
+ */
+class AndroidAssetFileSource : public FileSource {
+public:
+    /*!
+     * @param assetManager the asset manager, which has to outlive the source and its files
+     */
+    explicit AndroidAssetFileSource(AAssetManager *assetManager) : assetManager_(assetManager) {}
+
+    std::unique_ptr<File> open(const std::string &path, FileAccess access) override;
+
+private:
+    AAssetManager *assetManager_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ANDROIDASSETFILESOURCE_H
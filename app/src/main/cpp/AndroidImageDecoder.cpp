@@ -0,0 +1,62 @@
+#include "AndroidImageDecoder.h"
+
+#include <cstring>
+
+std::unique_ptr<ImageDecoder> AndroidImageDecoder::create(const uint8_t *data, size_t size) {
+    AImageDecoder *pDecoder = nullptr;
+    if (AImageDecoder_createFromBuffer(data, size, &pDecoder) != ANDROID_IMAGE_DECODER_SUCCESS) {
+        return nullptr;
+    }
+
+    // make sure we get 8 bits per channel out. RGBA order.
+    // AImageDecoder premultiplies by default. Ask for straight alpha so every decoder hands back
+    // the same thing, premultiplying is done by PixelConvert when the load options ask for it.
+    if (AImageDecoder_setAndroidBitmapFormat(pDecoder, ANDROID_BITMAP_FORMAT_RGBA_8888)
+        != ANDROID_IMAGE_DECODER_SUCCESS
+        || AImageDecoder_setUnpremultipliedRequired(pDecoder, true)
+           != ANDROID_IMAGE_DECODER_SUCCESS) {
+        AImageDecoder_delete(pDecoder);
+        return nullptr;
+    }
+
+    auto pHeader = AImageDecoder_getHeaderInfo(pDecoder);
+    return std::unique_ptr<ImageDecoder>(new AndroidImageDecoder(
+            pDecoder,
+            AImageDecoderHeaderInfo_getWidth(pHeader),
+            AImageDecoderHeaderInfo_getHeight(pHeader)));
+}
+
+AndroidImageDecoder::~AndroidImageDecoder() {
+    AImageDecoder_delete(pDecoder_);
+}
+
+bool AndroidImageDecoder::setNativeTargetSize(int32_t width, int32_t height) {
+    if (AImageDecoder_setTargetSize(pDecoder_, width, height) != ANDROID_IMAGE_DECODER_SUCCESS) {
+        return false;
+    }
+    decodedHeight_ = height;
+    return true;
+}
+
+bool AndroidImageDecoder::readRows(uint8_t *pixels, size_t stride, int32_t rowCount) {
+    if (buffered_.empty() && rowCount == decodedHeight_) {
+        // Everything at once, straight into the caller's memory
+        return AImageDecoder_decodeImage(pDecoder_, pixels, stride, stride * rowCount)
+               == ANDROID_IMAGE_DECODER_SUCCESS;
+    }
+
+    if (buffered_.empty()) {
+        bufferedStride_ = AImageDecoder_getMinimumStride(pDecoder_);
+        buffered_.resize(bufferedStride_ * decodedHeight_);
+        if (AImageDecoder_decodeImage(pDecoder_, buffered_.data(), bufferedStride_,
+                                      buffered_.size()) != ANDROID_IMAGE_DECODER_SUCCESS) {
+            return false;
+        }
+    }
+    for (int32_t row = 0; row < rowCount; row++, nextBufferedRow_++) {
+        memcpy(pixels + size_t(row) * stride,
+               buffered_.data() + size_t(nextBufferedRow_) * bufferedStride_,
+               bufferedStride_);
+    }
+    return true;
+}
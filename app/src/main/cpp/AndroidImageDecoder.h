@@ -0,0 +1,51 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ANDROIDIMAGEDECODER_H
+#define ANDROIDGLINVESTIGATIONS_ANDROIDIMAGEDECODER_H
+
+#include <memory>
+#include <vector>
+#include <android/imagedecoder.h>
+
+#include "ImageDecoder.h"
+
+/*!
+ * An @a ImageDecoder on top of the platform's AImageDecoder, which handles every format the
+ * platform does and decodes straight at a smaller size.
+ *
+ * AImageDecoder only decodes whole images. Asking for everything at once decodes straight into
+ * the caller's memory; asking for fewer rows decodes the image once into a buffer kept here and
+ * hands the rows out from that.
+ */
+class AndroidImageDecoder : public ImageDecoder {
+public:
+    /*!
+     * @param data the encoded image, which must outlive the decoder
+     * @param size the size of @a data in bytes
+     * @return the decoder, or null if the data isn't an image the platform can decode
+     */
+    static std::unique_ptr<ImageDecoder> create(const uint8_t *data, size_t size);
+
+    ~AndroidImageDecoder() override;
+
+protected:
+    bool setNativeTargetSize(int32_t width, int32_t height) override;
+
+    bool readRows(uint8_t *pixels, size_t stride, int32_t rowCount) override;
+
+private:
+    AndroidImageDecoder(AImageDecoder *pDecoder, int32_t width, int32_t height)
+            : ImageDecoder(width, height),
+              pDecoder_(pDecoder),
+              decodedHeight_(height),
+              bufferedStride_(0),
+              nextBufferedRow_(0) {}
+
+    AImageDecoder *pDecoder_;
+    // the height the platform decodes at, the source height unless it's scaling
+    int32_t decodedHeight_;
+    // the whole image, only decoded when rows are asked for a few at a time
+    std::vector<uint8_t> buffered_;
+    size_t bufferedStride_;
+    int32_t nextBufferedRow_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ANDROIDIMAGEDECODER_H
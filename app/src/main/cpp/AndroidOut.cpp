@@ -1,4 +1,4 @@
 #include "AndroidOut.h"
 
-AndroidOut androidOut("AO");
-std::ostream aout(&androidOut);
\ No newline at end of file
+thread_local AndroidOut androidOut("AO");
+thread_local std::ostream aout(&androidOut);
\ No newline at end of file
@@ -9,8 +9,10 @@
  *
  * ex:
  *  aout << "Hello World" << std::endl;
+ *
+ * Every thread has its own, so lines logged from worker threads don't interleave.
  */
-extern std::ostream aout;
+extern thread_local std::ostream aout;
 
 /*!
  * Use this class to create an output stream that writes to logcat. By default, a global one is
@@ -0,0 +1,321 @@
+#include "AssetPack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
+#include "Hash.h"
+#include "Lz4.h"
+
+/*!
+ * Compressed entries have to come out at least this much smaller, 1/8 of the original, to be
+ * worth decompressing
+ */
+static constexpr size_t kMinCompressionSavingsShift = 3;
+
+static inline size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static inline bool isPowerOfTwo(uint64_t value) {
+    return value && (value & (value - 1)) == 0;
+}
+
+/*!
+ * A stored entry, read straight out of the pack's buffer
+ */
+class StoredEntryFile : public File {
+public:
+    StoredEntryFile(std::shared_ptr<const AssetPack> spPack, const uint8_t *data, int64_t length)
+            : File(length), spPack_(std::move(spPack)), data_(data), position_(0) {}
+
+    const uint8_t *getBuffer() override { return data_; }
+
+    int64_t read(void *buffer, size_t size) override {
+        auto bytesRead = std::min(size, size_t(getLength()) - position_);
+        memcpy(buffer, data_ + position_, bytesRead);
+        position_ += bytesRead;
+        return int64_t(bytesRead);
+    }
+
+    bool seek(int64_t offset) override {
+        if (offset < 0 || offset > getLength()) {
+            return false;
+        }
+        position_ = size_t(offset);
+        return true;
+    }
+
+private:
+    std::shared_ptr<const AssetPack> spPack_;
+    const uint8_t *data_;
+    size_t position_;
+};
+
+/*!
+ * A compressed entry, decompressed whole the first time any of it is read
+ */
+class CompressedEntryFile : public File {
+public:
+    CompressedEntryFile(
+            std::shared_ptr<const AssetPack> spPack,
+            const uint8_t *stored,
+            size_t storedSize,
+            int64_t length)
+            : File(length),
+              spPack_(std::move(spPack)),
+              stored_(stored),
+              storedSize_(storedSize),
+              decompressed_(false),
+              failed_(false),
+              position_(0) {}
+
+    const uint8_t *getBuffer() override {
+        if (!decompressed_ && !failed_) {
+            data_.resize(size_t(getLength()));
+            decompressed_ = Lz4::decompress(stored_, storedSize_, data_.data(), data_.size());
+            failed_ = !decompressed_;
+            if (failed_) {
+                data_ = {};
+            }
+        }
+        return decompressed_ ? data_.data() : nullptr;
+    }
+
+    int64_t read(void *buffer, size_t size) override {
+        if (!getBuffer()) {
+            return -1;
+        }
+        auto bytesRead = std::min(size, data_.size() - position_);
+        memcpy(buffer, data_.data() + position_, bytesRead);
+        position_ += bytesRead;
+        return int64_t(bytesRead);
+    }
+
+    bool seek(int64_t offset) override {
+        if (offset < 0 || offset > getLength()) {
+            return false;
+        }
+        position_ = size_t(offset);
+        return true;
+    }
+
+private:
+    std::shared_ptr<const AssetPack> spPack_;
+    const uint8_t *stored_;
+    size_t storedSize_;
+    bool decompressed_;
+    bool failed_;
+    std::vector<uint8_t> data_;
+    size_t position_;
+};
+
+std::vector<uint8_t> AssetPack::write(
+        const std::vector<Input> &inputs,
+        uint32_t alignment,
+        uint32_t prefetchCount) {
+    if (!isPowerOfTwo(alignment) || alignment < kCompressedAlignment
+        || prefetchCount > inputs.size()) {
+        return {};
+    }
+
+    // Twice as many slots as entries keeps the probes short
+    uint32_t slotCount = 1;
+    while (slotCount < inputs.size() * 2) {
+        slotCount *= 2;
+    }
+
+    Header header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.alignment = alignment;
+    header.entryCount = uint32_t(inputs.size());
+    header.slotCount = slotCount;
+    header.prefetchCount = prefetchCount;
+
+    std::vector<Entry> entries(inputs.size());
+    std::vector<uint32_t> slots(slotCount, 0);
+    std::string paths;
+    std::vector<std::vector<uint8_t>> compressed(inputs.size());
+    std::unordered_set<std::string> seenPaths;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const auto &input = inputs[i];
+        if (!seenPaths.insert(input.path).second) {
+            return {};
+        }
+        auto &entry = entries[i];
+        entry.pathHash = Hash::xxh64(input.path.data(), input.path.size());
+        entry.pathOffset = uint32_t(paths.size());
+        entry.pathLength = uint32_t(input.path.size());
+        entry.size = input.data.size();
+        entry.storedSize = input.data.size();
+        entry.compression = kCompressionNone;
+        paths += input.path;
+
+        auto slot = entry.pathHash & (slotCount - 1);
+        while (slots[slot] != 0) {
+            slot = (slot + 1) & (slotCount - 1);
+        }
+        slots[slot] = uint32_t(i + 1);
+
+        if (input.compress) {
+            auto packed = Lz4::compress(input.data.data(), input.data.size());
+            auto savings = input.data.size() >> kMinCompressionSavingsShift;
+            if (packed.size() + savings <= input.data.size() && savings > 0) {
+                entry.storedSize = packed.size();
+                entry.compression = kCompressionLz4;
+                compressed[i] = std::move(packed);
+            }
+        }
+    }
+    header.pathsSize = paths.size();
+
+    // Lay out the data after the table of contents
+    auto tableSize = entries.size() * sizeof(Entry) + slots.size() * sizeof(uint32_t)
+                     + paths.size();
+    size_t offset = alignUp(sizeof(Header) + tableSize, alignment);
+    for (auto &entry: entries) {
+        offset = alignUp(
+                offset,
+                entry.compression == kCompressionNone ? alignment : kCompressedAlignment);
+        entry.offset = offset;
+        offset += entry.storedSize;
+    }
+
+    std::vector<uint8_t> pack(alignUp(offset, alignment), 0);
+    auto table = pack.data() + sizeof(Header);
+    memcpy(table, entries.data(), entries.size() * sizeof(Entry));
+    table += entries.size() * sizeof(Entry);
+    memcpy(table, slots.data(), slots.size() * sizeof(uint32_t));
+    table += slots.size() * sizeof(uint32_t);
+    memcpy(table, paths.data(), paths.size());
+    header.tableHash = Hash::xxh64(pack.data() + sizeof(Header), tableSize);
+    memcpy(pack.data(), &header, sizeof(Header));
+
+    for (size_t i = 0; i < inputs.size(); i++) {
+        const auto &stored = entries[i].compression == kCompressionNone
+                             ? inputs[i].data
+                             : compressed[i];
+        memcpy(pack.data() + entries[i].offset, stored.data(), stored.size());
+    }
+    return pack;
+}
+
+std::shared_ptr<AssetPack> AssetPack::create(std::unique_ptr<File> pFile) {
+    auto data = pFile ? pFile->getBuffer() : nullptr;
+    if (!data || size_t(pFile->getLength()) < sizeof(Header)) {
+        return nullptr;
+    }
+    auto size = size_t(pFile->getLength());
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+        return nullptr;
+    }
+    if (!isPowerOfTwo(header.alignment) || !isPowerOfTwo(header.slotCount)
+        || header.slotCount < header.entryCount || header.prefetchCount > header.entryCount) {
+        return nullptr;
+    }
+
+    // Every size is checked against what's left before it's multiplied out
+    auto remaining = size - sizeof(Header);
+    if (header.entryCount > remaining / sizeof(Entry)) {
+        return nullptr;
+    }
+    remaining -= size_t(header.entryCount) * sizeof(Entry);
+    if (header.slotCount > remaining / sizeof(uint32_t)) {
+        return nullptr;
+    }
+    remaining -= size_t(header.slotCount) * sizeof(uint32_t);
+    if (header.pathsSize > remaining) {
+        return nullptr;
+    }
+    auto tableSize = size - sizeof(Header) - remaining + size_t(header.pathsSize);
+    if (Hash::xxh64(data + sizeof(Header), tableSize) != header.tableHash) {
+        return nullptr;
+    }
+
+    auto spPack = std::shared_ptr<AssetPack>(new AssetPack(std::move(pFile), data));
+    spPack->header_ = header;
+    spPack->entries_.resize(header.entryCount);
+    spPack->slots_.resize(header.slotCount);
+    auto table = data + sizeof(Header);
+    memcpy(spPack->entries_.data(), table, spPack->entries_.size() * sizeof(Entry));
+    table += spPack->entries_.size() * sizeof(Entry);
+    memcpy(spPack->slots_.data(), table, spPack->slots_.size() * sizeof(uint32_t));
+    table += spPack->slots_.size() * sizeof(uint32_t);
+    spPack->paths_ = reinterpret_cast<const char *>(table);
+
+    for (const auto &entry: spPack->entries_) {
+        bool valid = entry.offset <= size && entry.storedSize <= size - entry.offset
+                     && entry.pathOffset <= header.pathsSize
+                     && entry.pathLength <= header.pathsSize - entry.pathOffset;
+        if (entry.compression == kCompressionNone) {
+            valid = valid && entry.storedSize == entry.size;
+        } else {
+            valid = valid && entry.compression == kCompressionLz4;
+        }
+        if (!valid) {
+            return nullptr;
+        }
+    }
+    for (auto slot: spPack->slots_) {
+        if (slot > header.entryCount) {
+            return nullptr;
+        }
+    }
+    return spPack;
+}
+
+size_t AssetPack::getPrefetchSize() const {
+    if (header_.prefetchCount == 0) {
+        return 0;
+    }
+    const auto &last = entries_[header_.prefetchCount - 1];
+    return size_t(last.offset + last.storedSize);
+}
+
+void AssetPack::prefetch() {
+    auto size = getPrefetchSize();
+    if (size > 0) {
+        pFile_->prefetch(0, int64_t(size));
+    }
+}
+
+std::string AssetPack::getPath(size_t entry) const {
+    return std::string(paths_ + entries_[entry].pathOffset, entries_[entry].pathLength);
+}
+
+int64_t AssetPack::findEntry(const std::string &path) const {
+    auto pathHash = Hash::xxh64(path.data(), path.size());
+    auto mask = slots_.size() - 1;
+    for (size_t probe = 0, slot = pathHash & mask; probe < slots_.size(); probe++) {
+        auto index = slots_[slot];
+        if (index == 0) {
+            break;
+        }
+        const auto &entry = entries_[index - 1];
+        if (entry.pathHash == pathHash && entry.pathLength == path.size()
+            && memcmp(paths_ + entry.pathOffset, path.data(), path.size()) == 0) {
+            return int64_t(index - 1);
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+std::unique_ptr<File> AssetPack::open(const std::string &path, FileAccess /* access */) {
+    auto index = findEntry(path);
+    if (index < 0) {
+        return nullptr;
+    }
+    const auto &entry = entries_[size_t(index)];
+    if (entry.compression == kCompressionNone) {
+        return std::make_unique<StoredEntryFile>(
+                shared_from_this(), data_ + entry.offset, int64_t(entry.size));
+    }
+    return std::make_unique<CompressedEntryFile>(
+            shared_from_this(), data_ + entry.offset, size_t(entry.storedSize),
+            int64_t(entry.size));
+}
@@ -0,0 +1,170 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ASSETPACK_H
+#define ANDROIDGLINVESTIGATIONS_ASSETPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FileSystem.h"
+
+/*!
+ * Many assets in one file, built on the host by tools/packtool and mounted into a @a FileSystem
+ * at runtime. The pack is opened once and mapped, and every asset in it is served straight out of
+ * the mapping, so loading one costs page faults rather than an open, read syscalls and a copy.
+ * All values are little endian.
+ *
+ * Layout:
+ *  - @a AssetPack::Header
+ *  - entryCount x @a AssetPack::Entry
+ *  - slotCount x uint32_t, a hash table over the entries by path: the index of an entry plus 1,
+ *    0 for an empty slot, probed linearly from the path's hash
+ *  - the paths, packed together without terminators
+ *  - the data, in entry order. Stored entries each start on an alignment boundary, so they can
+ *    be mapped and uploaded in place. Compressed entries are only decompressed when asked for, so
+ *    they're packed kCompressedAlignment apart.
+ *
+ * The alignment holds from the start of the pack. A pack on disk is mapped from a page boundary,
+ * so with 4096 or 16384 its entries start on pages. Inside the APK the pack starts wherever the
+ * zip put it.
+ */
+class AssetPack : public FileSource, public std::enable_shared_from_this<AssetPack> {
+public:
+    static constexpr char kMagic[4] = {'M', 'P', 'A', 'K'};
+    static constexpr uint32_t kVersion = 2;
+    static constexpr size_t kCompressedAlignment = 16;
+
+    /*!
+     * The extension packs are given
+     */
+    static constexpr const char *kExtension = ".mpak";
+
+    enum Compression : uint32_t {
+        kCompressionNone = 0,
+        kCompressionLz4 = 1,
+    };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        // what stored entries are aligned to, a power of two
+        uint32_t alignment;
+        uint32_t entryCount;
+        // a power of two, at least entryCount
+        uint32_t slotCount;
+        // how many entries, from the first, are read at startup. They're laid out first in the
+        // order they're read, so they can be read ahead in one go.
+        uint32_t prefetchCount;
+        uint64_t pathsSize;
+        // XXH64 of everything from the end of the header to the end of the paths, checked when
+        // the pack is opened
+        uint64_t tableHash;
+    };
+
+    struct Entry {
+        // XXH64 of the path
+        uint64_t pathHash;
+        // from the start of the pack
+        uint64_t offset;
+        // the bytes the entry takes in the pack
+        uint64_t storedSize;
+        // the bytes it takes once decompressed
+        uint64_t size;
+        // into the paths
+        uint32_t pathOffset;
+        uint32_t pathLength;
+        // a Compression value
+        uint32_t compression;
+        uint32_t reserved;
+    };
+
+    /*!
+     * A file to put in a pack
+     */
+    struct Input {
+        // the path it's opened by, '/' separated
+        std::string path;
+        std::vector<uint8_t> data;
+        // try compressing it, for data that's rarely loaded. It's only kept compressed when that
+        // saves enough to be worth decompressing.
+        bool compress;
+    };
+
+    /*!
+     * Serializes a pack
+     * @param inputs the files, in the order they're laid out
+     * @param alignment what stored entries are aligned to, a power of two of at least
+     *     kCompressedAlignment
+     * @param prefetchCount how many of the inputs, from the first, are read at startup
+     * @return the contents of the pack, empty if a path is there twice, the alignment is wrong or
+     *     there are fewer inputs than @a prefetchCount
+     */
+    static std::vector<uint8_t> write(
+            const std::vector<Input> &inputs,
+            uint32_t alignment,
+            uint32_t prefetchCount = 0);
+
+    /*!
+     * Opens a pack and checks its table of contents. Entries are only checked as they're opened.
+     * @param pFile the pack, kept open for as long as the pack or any file opened from it is
+     * @return the pack, or null if the file isn't a valid pack
+     */
+    static std::shared_ptr<AssetPack> create(std::unique_ptr<File> pFile);
+
+    /*!
+     * Opens an entry. Stored entries point into the pack's buffer. Compressed ones decompress the
+     * first time they're read.
+     */
+    std::unique_ptr<File> open(const std::string &path, FileAccess access) override;
+
+    inline size_t getEntryCount() const { return entries_.size(); }
+
+    inline uint32_t getAlignment() const { return header_.alignment; }
+
+    inline uint32_t getPrefetchCount() const { return header_.prefetchCount; }
+
+    /*!
+     * @return the bytes from the start of the pack to the end of the last entry read at startup
+     */
+    size_t getPrefetchSize() const;
+
+    /*!
+     * Starts reading the table of contents and the entries read at startup in the background, as
+     * one sequential read, so they're resident before they're asked for one at a time
+     */
+    void prefetch();
+
+    /*!
+     * @return the path of an entry
+     */
+    std::string getPath(size_t entry) const;
+
+    inline const Entry &getEntry(size_t entry) const { return entries_[entry]; }
+
+    /*!
+     * @return where an entry's stored bytes are in the pack's buffer
+     */
+    inline const uint8_t *getStoredData(size_t entry) const {
+        return data_ + entries_[entry].offset;
+    }
+
+private:
+    AssetPack(std::unique_ptr<File> pFile, const uint8_t *data)
+            : pFile_(std::move(pFile)), data_(data), header_{}, paths_(nullptr) {}
+
+    /*!
+     * @return the index of the entry at @a path, or -1 if there isn't one
+     */
+    int64_t findEntry(const std::string &path) const;
+
+    std::unique_ptr<File> pFile_;
+    // the pack's buffer
+    const uint8_t *data_;
+    Header header_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> slots_;
+    const char *paths_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ASSETPACK_H
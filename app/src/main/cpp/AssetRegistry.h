@@ -0,0 +1,288 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ASSETREGISTRY_H
+#define ANDROIDGLINVESTIGATIONS_ASSETREGISTRY_H
+
+#include <algorithm>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*!
+ * Where an asset in an @a AssetRegistry is
+ */
+enum class AssetState : uint8_t {
+    // somebody is loading it, anyone else asking waits for them
+    Pending,
+    // loaded and ready to use
+    Resident,
+    // the load failed, asking again gives null without trying again
+    Failed,
+};
+
+/*!
+ * Assets by name, safe to look up and load from any thread, with each asset loaded only once.
+ *
+ * The names are spread over shards, each with its own lock, so threads asking for different
+ * assets rarely wait on each other and no lock is held for longer than a hash map lookup.
+ *
+ * Loads are single flight. The first thread to @a acquire a name that isn't there gets to load
+ * it, and must @a resolve or @a abandon it. Everyone who asks in the meantime is queued, and
+ * handed the result when it lands, on whichever thread resolved it. Coroutines do the same with
+ * @a lookup.
+ *
+ * Nothing here depends on Android, so contention can be benchmarked on a desktop build.
+ *
+ * @tparam T the asset type, held by shared pointer
+ */
+template<typename T>
+class AssetRegistry {
+public:
+    /*!
+     * Called with the asset once it's loaded, null if it failed or was abandoned
+     */
+    using Waiter = std::function<void(const std::shared_ptr<T> &)>;
+
+    /*!
+     * What @a acquire found
+     */
+    enum class AcquireResult : uint8_t {
+        // the asset is resident, or failed, and the result is there already
+        Ready,
+        // nobody had asked for it yet, the caller has to load it
+        Load,
+        // somebody else is loading it, the waiter is called when they're done
+        Waiting,
+    };
+
+    /*!
+     * @param shardCount how many locks to spread the names over, at least 1
+     */
+    explicit AssetRegistry(size_t shardCount = 16)
+            : shards_(std::max(shardCount, size_t(1))) {}
+
+    AssetRegistry(const AssetRegistry &) = delete;
+    AssetRegistry &operator=(const AssetRegistry &) = delete;
+
+    /*!
+     * @return the asset if it's resident, otherwise null
+     */
+    std::shared_ptr<T> find(const std::string &name) const {
+        auto &shard = getShard(name);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(name);
+        if (it == shard.entries.end() || it->second.state != AssetState::Resident) {
+            return nullptr;
+        }
+        return it->second.value;
+    }
+
+    /*!
+     * @param outState receives the state of the asset
+     * @return false if nobody has asked for the asset
+     */
+    bool getState(const std::string &name, AssetState &outState) const {
+        auto &shard = getShard(name);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(name);
+        if (it == shard.entries.end()) {
+            return false;
+        }
+        outState = it->second.state;
+        return true;
+    }
+
+    /*!
+     * Gets an asset, or the right to load it
+     * @param name the asset
+     * @param waiter called with the result if somebody else is loading it, not called otherwise
+     * @param outValue receives the asset when it's Ready, null if it failed
+     * @return what was found. After Load the caller has to @a resolve or @a abandon the name.
+     */
+    AcquireResult acquire(const std::string &name, Waiter waiter, std::shared_ptr<T> &outValue) {
+        auto &shard = getShard(name);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto [it, inserted] = shard.entries.try_emplace(name);
+        auto &entry = it->second;
+        if (inserted) {
+            entry.state = AssetState::Pending;
+            return AcquireResult::Load;
+        }
+        if (entry.state == AssetState::Pending) {
+            entry.waiters.push_back(std::move(waiter));
+            return AcquireResult::Waiting;
+        }
+        outValue = entry.value;
+        return AcquireResult::Ready;
+    }
+
+    /*!
+     * Stores the result of a load and hands it to everyone waiting. Also registers assets that
+     * weren't acquired, an already loaded one under a second name say.
+     * @param name the asset
+     * @param value the asset, null if the load failed
+     * @return what's registered under the name now. An asset that was already resident is kept,
+     *     and returned instead of @a value.
+     */
+    std::shared_ptr<T> resolve(const std::string &name, std::shared_ptr<T> value) {
+        std::vector<Waiter> waiters;
+        std::shared_ptr<T> registered;
+        {
+            auto &shard = getShard(name);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto &entry = shard.entries[name];
+            if (entry.state != AssetState::Resident) {
+                entry.state = value ? AssetState::Resident : AssetState::Failed;
+                entry.value = std::move(value);
+            }
+            registered = entry.value;
+            waiters.swap(entry.waiters);
+        }
+
+        // Waiters often go on to ask for more, so they run without the lock
+        for (auto &waiter: waiters) {
+            waiter(registered);
+        }
+        return registered;
+    }
+
+    /*!
+     * Gives up a load without recording a failure, so the next @a acquire loads it again. Anyone
+     * waiting is handed null.
+     */
+    void abandon(const std::string &name) {
+        std::vector<Waiter> waiters;
+        {
+            auto &shard = getShard(name);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.entries.find(name);
+            if (it == shard.entries.end() || it->second.state != AssetState::Pending) {
+                return;
+            }
+            waiters.swap(it->second.waiters);
+            shard.entries.erase(it);
+        }
+        for (auto &waiter: waiters) {
+            waiter(nullptr);
+        }
+    }
+
+    /*!
+     * Calls @a function with the name and value of every resident asset. It runs under a shard's
+     * lock, so it mustn't use the registry.
+     */
+    template<typename Function>
+    void forEachResident(Function &&function) const {
+        for (auto &shard: shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (const auto &[name, entry]: shard.entries) {
+                if (entry.state == AssetState::Resident) {
+                    function(name, entry.value);
+                }
+            }
+        }
+    }
+
+    /*!
+     * Forgets resident and failed assets @a predicate picks. It runs under a shard's lock, so it
+     * mustn't use the registry. Pending loads are never removed.
+     * @param predicate called with the name and value, null for failed assets, returns true to
+     *     remove
+     * @return how many were removed
+     */
+    template<typename Predicate>
+    size_t eraseIf(Predicate &&predicate) {
+        size_t erased = 0;
+        for (auto &shard: shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+                if (it->second.state != AssetState::Pending
+                    && predicate(it->first, it->second.value)) {
+                    it = shard.entries.erase(it);
+                    erased++;
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return erased;
+    }
+
+    /*!
+     * What a coroutine gets from @a lookup
+     */
+    struct LookupResult {
+        // the asset, null if it failed or this coroutine has to load it
+        std::shared_ptr<T> value;
+        // true if this coroutine has to load the asset and @a resolve or @a abandon it
+        bool mustLoad;
+    };
+
+    /*!
+     * @a acquire for coroutines. When somebody else is loading the asset, the coroutine is
+     * suspended and carries on on the thread that resolves it.
+     */
+    class LookupAwaiter {
+    public:
+        LookupAwaiter(AssetRegistry &registry, std::string name)
+                : registry_(registry), name_(std::move(name)), result_{nullptr, false} {}
+
+        inline bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            auto acquired = registry_.acquire(
+                    name_,
+                    [this, handle](const std::shared_ptr<T> &value) {
+                        result_.value = value;
+                        handle.resume();
+                    },
+                    result_.value);
+            // Once waiting, the waiter may already be running on another thread, so nothing
+            // here can be touched any more
+            if (acquired == AcquireResult::Waiting) {
+                return true;
+            }
+            result_.mustLoad = acquired == AcquireResult::Load;
+            return false;
+        }
+
+        inline LookupResult await_resume() { return std::move(result_); }
+
+    private:
+        AssetRegistry &registry_;
+        std::string name_;
+        LookupResult result_;
+    };
+
+    /*!
+     * @return what to co_await for the asset, or the right to load it
+     */
+    inline LookupAwaiter lookup(std::string name) { return LookupAwaiter(*this, std::move(name)); }
+
+private:
+    struct Entry {
+        AssetState state = AssetState::Pending;
+        std::shared_ptr<T> value;
+        std::vector<Waiter> waiters;
+    };
+
+    // A cache line each, so threads locking neighboring shards don't slow each other down
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    inline Shard &getShard(const std::string &name) const {
+        return shards_[std::hash<std::string>()(name) % shards_.size()];
+    }
+
+    // mutable so lookups from const methods can lock
+    mutable std::vector<Shard> shards_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ASSETREGISTRY_H
@@ -0,0 +1,93 @@
+#include "CompletionQueue.h"
+
+#include <algorithm>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+CompletionQueue::CompletionQueue()
+        : fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+          nextTimerSequence_(0),
+          signalled_(false) {}
+
+CompletionQueue::~CompletionQueue() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+void CompletionQueue::post(Completion completion) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    completions_.push_back(std::move(completion));
+    if (!signalled_) {
+        signalled_ = true;
+        signal();
+    }
+}
+
+void CompletionQueue::postAt(Clock::time_point time, Completion completion) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool first = timers_.empty() || time < timers_.front().time;
+    timers_.push_back(Timer{time, nextTimerSequence_++, std::move(completion)});
+    std::push_heap(timers_.begin(), timers_.end(), LaterTimer());
+
+    // The loop may be blocked with a timeout for a later timer, it has to start over
+    if (first && !signalled_) {
+        signalled_ = true;
+        signal();
+    }
+}
+
+void CompletionQueue::wake() {
+    signal();
+}
+
+void CompletionQueue::signal() const {
+    if (fd_ >= 0) {
+        uint64_t one = 1;
+        // Only fails when the counter would overflow, and then the loop is awake anyway
+        (void) write(fd_, &one, sizeof(one));
+    }
+}
+
+size_t CompletionQueue::runPending() {
+    std::vector<Completion> completions;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (fd_ >= 0) {
+            // Resets the counter, so the fd stops being readable until the next post
+            uint64_t count;
+            (void) read(fd_, &count, sizeof(count));
+        }
+        signalled_ = false;
+        completions.swap(completions_);
+
+        auto now = Clock::now();
+        while (!timers_.empty() && timers_.front().time <= now) {
+            std::pop_heap(timers_.begin(), timers_.end(), LaterTimer());
+            completions.push_back(std::move(timers_.back().completion));
+            timers_.pop_back();
+        }
+    }
+
+    // Run without the lock, completions often post more work
+    for (auto &completion: completions) {
+        completion();
+    }
+    return completions.size();
+}
+
+int CompletionQueue::getTimeoutMillis() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!completions_.empty()) {
+        return 0;
+    }
+    if (timers_.empty()) {
+        return -1;
+    }
+    auto remaining = timers_.front().time - Clock::now();
+    if (remaining <= Clock::duration::zero()) {
+        return 0;
+    }
+    // Rounded up, waking a little early would just mean blocking again for the remainder
+    return int(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+}
@@ -0,0 +1,104 @@
+#ifndef ANDROIDGLINVESTIGATIONS_COMPLETIONQUEUE_H
+#define ANDROIDGLINVESTIGATIONS_COMPLETIONQUEUE_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/*!
+ * Hands work from any thread back to the thread that owns an event loop, and wakes that loop only
+ * when there's something to do.
+ *
+ * Completions are posted from any thread with @a post, or for a later time with @a postAt. The
+ * queue signals an eventfd when it goes from empty to not, so the owning thread can block in its
+ * loop, ALooper or epoll, with the fd registered for input and @a getTimeoutMillis as the timeout,
+ * and call @a runPending when either fires. Posting again before that doesn't touch the fd.
+ *
+ * Nothing here depends on Android, so it can be driven by a plain epoll loop on a desktop build.
+ */
+class CompletionQueue {
+public:
+    using Completion = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+
+    CompletionQueue();
+
+    /*!
+     * Closes the fd. Completions that haven't run are dropped.
+     */
+    ~CompletionQueue();
+
+    CompletionQueue(const CompletionQueue &) = delete;
+    CompletionQueue &operator=(const CompletionQueue &) = delete;
+
+    /*!
+     * @return the fd to wait on for input, or -1 if it couldn't be created. Without one nothing
+     *     wakes the loop, it has to poll @a runPending.
+     */
+    constexpr int getFd() const { return fd_; }
+
+    /*!
+     * Queues a completion to run on the owning thread. Safe from any thread.
+     */
+    void post(Completion completion);
+
+    /*!
+     * Queues a completion to run on the owning thread once @a time has passed. Safe from any
+     * thread.
+     */
+    void postAt(Clock::time_point time, Completion completion);
+
+    /*!
+     * Wakes the loop without queueing anything, for work that's queued somewhere else. Safe from
+     * any thread and from signal handlers.
+     */
+    void wake();
+
+    /*!
+     * Runs the completions posted so far and the timers that are due, in the order they were
+     * posted and then by time. Completions these post wait for the next call. Call on the owning
+     * thread when the fd is readable or the timeout has passed.
+     * @return how many ran
+     */
+    size_t runPending();
+
+    /*!
+     * @return how long the loop can block before @a runPending has something to do: 0 if
+     *     completions are waiting, the time to the next timer, or -1 for no limit
+     */
+    int getTimeoutMillis() const;
+
+private:
+    struct Timer {
+        Clock::time_point time;
+        // breaks ties between timers due at the same time, in the order they were posted
+        uint64_t sequence;
+        Completion completion;
+    };
+
+    struct LaterTimer {
+        inline bool operator()(const Timer &a, const Timer &b) const {
+            return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+        }
+    };
+
+    /*!
+     * Writes to the fd, waking whoever waits on it
+     */
+    void signal() const;
+
+    int fd_;
+
+    mutable std::mutex mutex_;
+    std::vector<Completion> completions_;
+    // a heap ordered by LaterTimer, the next one due at the front
+    std::vector<Timer> timers_;
+    uint64_t nextTimerSequence_;
+    // true from the write that woke the loop until the loop drains the fd, later posts skip it
+    bool signalled_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_COMPLETIONQUEUE_H
@@ -0,0 +1,152 @@
+#include "DecodePool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+
+/*!
+ * A scratch buffer bigger than this is freed after its job instead of going back in the pool, so
+ * one huge image doesn't pin its decode buffer for the rest of the run
+ */
+static constexpr size_t kMaxPooledScratchBytes = 32 * 1024 * 1024;
+
+/*!
+ * @return the highest frequency a core can run at, in kHz, or 0 if it can't be read
+ */
+static long readMaxFrequency(int cpu) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+    auto pFile = fopen(path, "r");
+    if (!pFile) {
+        return 0;
+    }
+    long frequency = 0;
+    if (fscanf(pFile, "%ld", &frequency) != 1) {
+        frequency = 0;
+    }
+    fclose(pFile);
+    return frequency;
+}
+
+int DecodePool::getBigCoreCount() {
+    int coreCount = std::max(int(sysconf(_SC_NPROCESSORS_CONF)), 1);
+    std::vector<long> frequencies;
+    for (int cpu = 0; cpu < coreCount; cpu++) {
+        auto frequency = readMaxFrequency(cpu);
+        if (frequency <= 0) {
+            // Offline cores and locked down sysfs look the same, assume a uniform CPU
+            return coreCount;
+        }
+        frequencies.push_back(frequency);
+    }
+
+    auto slowest = *std::min_element(frequencies.begin(), frequencies.end());
+    auto bigCount = std::count_if(frequencies.begin(), frequencies.end(), [slowest](long f) {
+        return f > slowest;
+    });
+    return bigCount > 0 ? int(bigCount) : coreCount;
+}
+
+DecodePool::DecodePool(int threadCount)
+        : outstanding_(0),
+          nextSequence_(0),
+          stopping_(false) {
+    for (int i = 0; i < std::max(threadCount, 1); i++) {
+        threads_.emplace_back(&DecodePool::workerMain, this);
+    }
+}
+
+DecodePool::~DecodePool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    jobReady_.notify_all();
+    for (auto &thread: threads_) {
+        thread.join();
+    }
+}
+
+void DecodePool::submit(int priority, Job job, Completion completion) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push(Task{priority, nextSequence_++, std::move(job), std::move(completion)});
+        outstanding_++;
+    }
+    jobReady_.notify_one();
+}
+
+void DecodePool::workerMain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        jobReady_.wait(lock, [this]() { return stopping_ || !pending_.empty(); });
+        if (stopping_) {
+            return;
+        }
+
+        // priority_queue only hands out const references, the task is moved out before popping
+        auto task = std::move(const_cast<Task &>(pending_.top()));
+        pending_.pop();
+        std::vector<uint8_t> scratch;
+        if (!scratch_.empty()) {
+            scratch = std::move(scratch_.back());
+            scratch_.pop_back();
+        }
+        lock.unlock();
+
+        task.job(scratch);
+        task.job = nullptr;
+
+        lock.lock();
+        if (scratch.capacity() <= kMaxPooledScratchBytes) {
+            scratch_.push_back(std::move(scratch));
+        }
+        completed_.push(std::move(task));
+        jobDone_.notify_all();
+    }
+}
+
+bool DecodePool::runNextCompletion(bool wait) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (wait) {
+        jobDone_.wait(lock, [this]() { return !completed_.empty() || outstanding_ == 0; });
+    }
+    if (completed_.empty()) {
+        return false;
+    }
+    auto task = std::move(const_cast<Task &>(completed_.top()));
+    completed_.pop();
+    outstanding_--;
+    lock.unlock();
+
+    if (task.completion) {
+        task.completion();
+    }
+    return true;
+}
+
+size_t DecodePool::runCompletions() {
+    size_t count = 0;
+    while (runNextCompletion(false)) {
+        count++;
+    }
+    return count;
+}
+
+size_t DecodePool::finish() {
+    size_t count = 0;
+    while (runNextCompletion(true)) {
+        count++;
+    }
+    return count;
+}
+
+size_t DecodePool::trimScratch() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t freedBytes = 0;
+    for (const auto &buffer: scratch_) {
+        freedBytes += buffer.capacity();
+    }
+    scratch_.clear();
+    return freedBytes;
+}
@@ -0,0 +1,129 @@
+#ifndef ANDROIDGLINVESTIGATIONS_DECODEPOOL_H
+#define ANDROIDGLINVESTIGATIONS_DECODEPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*!
+ * Runs image decodes on worker threads and hands the results back to the GL thread.
+ *
+ * Jobs start highest priority first. Each one borrows a scratch buffer from the pool for its
+ * decoded pixels, so a batch of loads reuses a handful of large allocations instead of making one
+ * per image. When a job finishes its completion is queued, and the GL thread runs the queued
+ * completions, again highest priority first, from @a runCompletions or @a finish. Completions are
+ * where GL work belongs, jobs must not touch GL state.
+ *
+ * Nothing here depends on Android, so the pool can be benchmarked on a desktop build.
+ */
+class DecodePool {
+public:
+    /*!
+     * Runs on a worker thread
+     * @param scratch a buffer to decode into, it keeps its capacity between jobs and its contents
+     *     are undefined on entry
+     */
+    using Job = std::function<void(std::vector<uint8_t> &scratch)>;
+
+    /*!
+     * Runs on the thread that drains the pool, after the job it belongs to
+     */
+    using Completion = std::function<void()>;
+
+    /*!
+     * Counts the cores worth decoding on. On big.LITTLE designs those are the cores faster than
+     * the slowest cluster, the little cores would only hold a batch up. When every core is the
+     * same, or the frequencies can't be read, that's every core.
+     * @return how many threads to decode with, at least 1
+     */
+    static int getBigCoreCount();
+
+    /*!
+     * @param threadCount how many worker threads to start, at least 1
+     */
+    explicit DecodePool(int threadCount);
+
+    /*!
+     * Waits for running jobs to finish. Queued jobs and completions that haven't run are dropped.
+     */
+    ~DecodePool();
+
+    DecodePool(const DecodePool &) = delete;
+    DecodePool &operator=(const DecodePool &) = delete;
+
+    inline int getThreadCount() const { return int(threads_.size()); }
+
+    /*!
+     * Queues a job
+     * @param priority jobs with a higher priority start first and complete first, equal ones go in
+     *     the order they were submitted
+     * @param job the work to run on a worker thread
+     * @param completion what to run on the draining thread once @a job is done, may be empty
+     */
+    void submit(int priority, Job job, Completion completion);
+
+    /*!
+     * Runs the completions of every job that has finished, without waiting for the rest
+     * @return how many completions ran
+     */
+    size_t runCompletions();
+
+    /*!
+     * Waits for every submitted job, running each completion as soon as it's ready, highest
+     * priority first among those that are
+     * @return how many completions ran
+     */
+    size_t finish();
+
+    /*!
+     * Frees the scratch buffers no job is using
+     * @return the bytes freed
+     */
+    size_t trimScratch();
+
+private:
+    struct Task {
+        int priority;
+        // breaks priority ties in submission order
+        uint64_t sequence;
+        Job job;
+        Completion completion;
+    };
+
+    struct TaskOrder {
+        inline bool operator()(const Task &a, const Task &b) const {
+            return a.priority != b.priority ? a.priority < b.priority : a.sequence > b.sequence;
+        }
+    };
+
+    void workerMain();
+
+    /*!
+     * Runs one completion if there's a finished job
+     * @param wait block until a job finishes, unless nothing is outstanding
+     * @return false if no completion ran
+     */
+    bool runNextCompletion(bool wait);
+
+    std::mutex mutex_;
+    // wakes workers when a job is queued or the pool is stopping
+    std::condition_variable jobReady_;
+    // wakes the draining thread when a job finishes
+    std::condition_variable jobDone_;
+    std::priority_queue<Task, std::vector<Task>, TaskOrder> pending_;
+    std::priority_queue<Task, std::vector<Task>, TaskOrder> completed_;
+    // submitted jobs whose completion hasn't been taken yet
+    size_t outstanding_;
+    uint64_t nextSequence_;
+    bool stopping_;
+    // scratch buffers no job is using
+    std::vector<std::vector<uint8_t>> scratch_;
+    std::vector<std::thread> threads_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_DECODEPOOL_H
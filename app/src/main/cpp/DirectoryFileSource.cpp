@@ -0,0 +1,87 @@
+#include "DirectoryFileSource.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*!
+ * A file descriptor, mapped the first time the whole file is asked for
+ */
+class DirectoryFile : public File {
+public:
+    DirectoryFile(int fd, int64_t length)
+            : File(length), fd_(fd), pMapping_(MAP_FAILED) {}
+
+    ~DirectoryFile() override {
+        if (pMapping_ != MAP_FAILED) {
+            munmap(pMapping_, size_t(getLength()));
+        }
+        close(fd_);
+    }
+
+    const uint8_t *getBuffer() override {
+        // mmap can't map nothing, but an empty file still has a buffer
+        static const uint8_t kEmpty = 0;
+        if (getLength() == 0) {
+            return &kEmpty;
+        }
+        if (pMapping_ == MAP_FAILED) {
+            pMapping_ = mmap(nullptr, size_t(getLength()), PROT_READ, MAP_PRIVATE, fd_, 0);
+            if (pMapping_ == MAP_FAILED) {
+                return nullptr;
+            }
+        }
+        return static_cast<const uint8_t *>(pMapping_);
+    }
+
+    int64_t read(void *buffer, size_t size) override {
+        ssize_t bytesRead;
+        do {
+            bytesRead = ::read(fd_, buffer, size);
+        } while (bytesRead < 0 && errno == EINTR);
+        return bytesRead < 0 ? -1 : int64_t(bytesRead);
+    }
+
+    bool seek(int64_t offset) override {
+        return offset >= 0 && offset <= getLength() && lseek(fd_, off_t(offset), SEEK_SET) >= 0;
+    }
+
+    void prefetch(int64_t offset, int64_t size) override {
+        if (offset < 0 || size <= 0 || offset >= getLength()) {
+            return;
+        }
+        size = std::min(size, getLength() - offset);
+        // A mapped file pages in through the mapping, otherwise the page cache is read ahead
+        if (pMapping_ != MAP_FAILED) {
+            adviseWillNeed(static_cast<const uint8_t *>(pMapping_) + offset, size_t(size));
+        } else {
+            posix_fadvise(fd_, off_t(offset), off_t(size), POSIX_FADV_WILLNEED);
+        }
+    }
+
+private:
+    int fd_;
+    void *pMapping_;
+};
+
+std::unique_ptr<File> DirectoryFileSource::open(const std::string &path, FileAccess access) {
+    auto fullPath = directory_ + "/" + path;
+    int fd = ::open(fullPath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat status{};
+    if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+
+    // Streamed files are read once front to back, so the kernel can read well ahead
+    if (access == FileAccess::Streaming) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    return std::make_unique<DirectoryFile>(fd, int64_t(status.st_size));
+}
@@ -0,0 +1,26 @@
+#ifndef ANDROIDGLINVESTIGATIONS_DIRECTORYFILESOURCE_H
+#define ANDROIDGLINVESTIGATIONS_DIRECTORYFILESOURCE_H
+
+#include <memory>
+#include <string>
+
+#include "FileSystem.h"
+
+/*!
+ * Files under a directory on a Linux file system, the app's files directory on a device or an
+ * asset directory on a host. Buffers are mapped with mmap rather than read.
+ */
+class DirectoryFileSource : public FileSource {
+public:
+    /*!
+     * @param directory the directory paths are relative to, without a trailing '/'
+     */
+    explicit DirectoryFileSource(std::string directory) : directory_(std::move(directory)) {}
+
+    std::unique_ptr<File> open(const std::string &path, FileAccess access) override;
+
+private:
+    std::string directory_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_DIRECTORYFILESOURCE_H
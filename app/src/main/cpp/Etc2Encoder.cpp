@@ -0,0 +1,316 @@
+#include "Etc2Encoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr uint32_t kBlockDimension = 4;
+static constexpr uint32_t kBlockPixels = kBlockDimension * kBlockDimension;
+static constexpr size_t kColorBlockSize = 8;
+static constexpr size_t kAlphaBlockSize = 8;
+
+/*!
+ * The modifiers of ETC1's intensity tables, the small one then the large one. A selector adds or
+ * subtracts one of them from every channel of the sub-block's base color.
+ */
+static constexpr int kIntensityTables[8][2] = {
+        {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+/*!
+ * The modifier each 2 bit selector picks, as {sign, which of the pair}
+ */
+static constexpr int kSelectorModifiers[4][2] = {{1, 0}, {1, 1}, {-1, 0}, {-1, 1}};
+
+/*!
+ * EAC's alpha modifier tables. A selector picks one, scaled by the block's multiplier and added to
+ * its base alpha.
+ */
+static constexpr int kAlphaTables[16][8] = {
+        {-3, -6, -9, -15, 2, 5, 8, 14},
+        {-3, -7, -10, -13, 2, 6, 9, 12},
+        {-2, -5, -8, -13, 1, 4, 7, 12},
+        {-2, -4, -6, -13, 1, 3, 5, 12},
+        {-3, -6, -8, -12, 2, 5, 7, 11},
+        {-3, -7, -9, -11, 2, 6, 8, 10},
+        {-4, -7, -8, -11, 3, 6, 7, 10},
+        {-3, -5, -8, -11, 2, 4, 7, 10},
+        {-2, -6, -8, -10, 1, 5, 7, 9},
+        {-2, -5, -8, -10, 1, 4, 7, 9},
+        {-2, -4, -8, -10, 1, 3, 7, 9},
+        {-2, -5, -7, -10, 1, 4, 6, 9},
+        {-3, -4, -7, -10, 2, 3, 6, 9},
+        {-1, -2, -3, -10, 0, 1, 2, 9},
+        {-4, -6, -8, -9, 3, 5, 7, 8},
+        {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+/*!
+ * The table with a 0 modifier, used for blocks of a single alpha
+ */
+static constexpr int kFlatAlphaTable = 13;
+
+static inline int clamp255(int value) {
+    return std::clamp(value, 0, 255);
+}
+
+/*!
+ * ETC stores a block's pixels column by column
+ */
+static inline uint32_t etcPixelIndex(uint32_t x, uint32_t y) {
+    return x * kBlockDimension + y;
+}
+
+/*!
+ * Copies a block out of the image, repeating the last column and row past the edges
+ * @param pixels receives 16 RGBA8 pixels in rows
+ */
+static void loadBlock(
+        const uint8_t *rgba,
+        uint32_t width,
+        uint32_t height,
+        uint32_t blockX,
+        uint32_t blockY,
+        uint8_t *pixels) {
+    for (uint32_t y = 0; y < kBlockDimension; y++) {
+        auto sourceY = std::min(blockY * kBlockDimension + y, height - 1);
+        for (uint32_t x = 0; x < kBlockDimension; x++) {
+            auto sourceX = std::min(blockX * kBlockDimension + x, width - 1);
+            memcpy(pixels + (y * kBlockDimension + x) * 4,
+                   rgba + (size_t(sourceY) * width + sourceX) * 4,
+                   4);
+        }
+    }
+}
+
+static inline void storeBigEndian(uint64_t bits, uint8_t *out) {
+    for (int i = 0; i < 8; i++) {
+        out[i] = uint8_t(bits >> (56 - i * 8));
+    }
+}
+
+/*!
+ * The best intensity table and selectors for one sub-block around a base color
+ */
+struct SubBlockFit {
+    uint32_t error;
+    uint32_t table;
+    // by ETC pixel index, only the sub-block's pixels are set
+    uint8_t selectors[kBlockPixels];
+};
+
+/*!
+ * Tries every intensity table on a sub-block
+ * @param pixels the block's pixels in rows
+ * @param members the row order indices of the sub-block's 8 pixels
+ * @param base the sub-block's base color expanded to 8 bits
+ */
+static SubBlockFit fitSubBlock(const uint8_t *pixels, const uint8_t *members, const int *base) {
+    SubBlockFit best{UINT32_MAX, 0, {}};
+    for (uint32_t table = 0; table < 8; table++) {
+        SubBlockFit fit{0, table, {}};
+        for (uint32_t i = 0; i < 8 && fit.error < best.error; i++) {
+            const auto *pPixel = pixels + members[i] * 4;
+            uint32_t bestError = UINT32_MAX;
+            uint8_t bestSelector = 0;
+            for (uint8_t selector = 0; selector < 4; selector++) {
+                auto modifier = kSelectorModifiers[selector][0]
+                                * kIntensityTables[table][kSelectorModifiers[selector][1]];
+                uint32_t error = 0;
+                for (int channel = 0; channel < 3; channel++) {
+                    auto delta = clamp255(base[channel] + modifier) - pPixel[channel];
+                    error += uint32_t(delta * delta);
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    bestSelector = selector;
+                }
+            }
+            fit.error += bestError;
+            auto x = members[i] % kBlockDimension;
+            auto y = members[i] / kBlockDimension;
+            fit.selectors[etcPixelIndex(x, y)] = bestSelector;
+        }
+        if (fit.error < best.error) {
+            best = fit;
+        }
+    }
+    return best;
+}
+
+/*!
+ * Encodes the RGB of a block with the ETC1 modes
+ * @param pixels 16 RGBA8 pixels in rows
+ */
+static uint64_t encodeColorBlock(const uint8_t *pixels) {
+    uint64_t bestBits = 0;
+    uint32_t bestError = UINT32_MAX;
+    for (uint32_t flip = 0; flip < 2; flip++) {
+        // Without flip the sub-blocks are the left and right halves, with it the top and bottom
+        uint8_t members[2][8];
+        uint32_t counts[2] = {};
+        uint32_t sums[2][3] = {};
+        for (uint32_t y = 0; y < kBlockDimension; y++) {
+            for (uint32_t x = 0; x < kBlockDimension; x++) {
+                uint32_t subBlock = flip ? y / 2 : x / 2;
+                auto index = y * kBlockDimension + x;
+                members[subBlock][counts[subBlock]++] = uint8_t(index);
+                for (int channel = 0; channel < 3; channel++) {
+                    sums[subBlock][channel] += pixels[index * 4 + channel];
+                }
+            }
+        }
+
+        // The sub-blocks' average colors rounded to 4 bits each, or to 5 bits with the second
+        // stored as a 3 bit difference from the first when it's close enough
+        int individual[2][3];
+        int differential[2][3];
+        bool canDiffer = true;
+        for (int subBlock = 0; subBlock < 2; subBlock++) {
+            for (int channel = 0; channel < 3; channel++) {
+                auto sum = sums[subBlock][channel];
+                individual[subBlock][channel] = int((sum * 15 + 1020) / 2040);
+                differential[subBlock][channel] = int((sum * 31 + 1020) / 2040);
+            }
+        }
+        for (int channel = 0; channel < 3; channel++) {
+            auto delta = differential[1][channel] - differential[0][channel];
+            canDiffer = canDiffer && delta >= -4 && delta <= 3;
+        }
+
+        for (int differ = 0; differ < 2; differ++) {
+            if (differ && !canDiffer) {
+                continue;
+            }
+            const auto &quantized = differ ? differential : individual;
+            SubBlockFit fits[2];
+            for (int subBlock = 0; subBlock < 2; subBlock++) {
+                int base[3];
+                for (int channel = 0; channel < 3; channel++) {
+                    auto value = quantized[subBlock][channel];
+                    base[channel] = differ ? (value << 3) | (value >> 2) : (value << 4) | value;
+                }
+                fits[subBlock] = fitSubBlock(pixels, members[subBlock], base);
+            }
+            auto error = fits[0].error + fits[1].error;
+            if (error >= bestError) {
+                continue;
+            }
+
+            bestError = error;
+            uint64_t bits = 0;
+            for (int channel = 0; channel < 3; channel++) {
+                auto shift = 59 - channel * 8;
+                if (differ) {
+                    auto delta = quantized[1][channel] - quantized[0][channel];
+                    bits |= uint64_t(quantized[0][channel]) << shift;
+                    bits |= uint64_t(delta & 7) << (shift - 3);
+                } else {
+                    bits |= uint64_t(quantized[0][channel]) << (shift + 1);
+                    bits |= uint64_t(quantized[1][channel]) << (shift - 3);
+                }
+            }
+            bits |= uint64_t(fits[0].table) << 37;
+            bits |= uint64_t(fits[1].table) << 34;
+            bits |= uint64_t(differ) << 33;
+            bits |= uint64_t(flip) << 32;
+            for (uint32_t subBlock = 0; subBlock < 2; subBlock++) {
+                for (uint32_t i = 0; i < 8; i++) {
+                    auto x = members[subBlock][i] % kBlockDimension;
+                    auto y = members[subBlock][i] / kBlockDimension;
+                    auto index = etcPixelIndex(x, y);
+                    auto selector = fits[subBlock].selectors[index];
+                    bits |= uint64_t(selector >> 1) << (16 + index);
+                    bits |= uint64_t(selector & 1) << index;
+                }
+            }
+            bestBits = bits;
+        }
+    }
+    return bestBits;
+}
+
+/*!
+ * Encodes the alpha of a block as EAC
+ * @param pixels 16 RGBA8 pixels in rows
+ */
+static uint64_t encodeAlphaBlock(const uint8_t *pixels) {
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    for (uint32_t i = 0; i < kBlockPixels; i++) {
+        minAlpha = std::min(minAlpha, int(pixels[i * 4 + 3]));
+        maxAlpha = std::max(maxAlpha, int(pixels[i * 4 + 3]));
+    }
+
+    uint64_t bestBits = 0;
+    uint32_t bestError = UINT32_MAX;
+    auto tryFit = [&](int base, int multiplier, int table) {
+        uint64_t bits = (uint64_t(base) << 56) | (uint64_t(multiplier) << 52)
+                        | (uint64_t(table) << 48);
+        uint32_t error = 0;
+        for (uint32_t i = 0; i < kBlockPixels && error < bestError; i++) {
+            int alpha = pixels[i * 4 + 3];
+            uint32_t pixelError = UINT32_MAX;
+            uint32_t pixelSelector = 0;
+            for (uint32_t selector = 0; selector < 8; selector++) {
+                auto delta = clamp255(base + kAlphaTables[table][selector] * multiplier) - alpha;
+                if (uint32_t(delta * delta) < pixelError) {
+                    pixelError = uint32_t(delta * delta);
+                    pixelSelector = selector;
+                }
+            }
+            error += pixelError;
+            auto index = etcPixelIndex(i % kBlockDimension, i / kBlockDimension);
+            bits |= uint64_t(pixelSelector) << (45 - index * 3);
+        }
+        if (error < bestError) {
+            bestError = error;
+            bestBits = bits;
+        }
+    };
+
+    if (minAlpha == maxAlpha) {
+        tryFit(minAlpha, 1, kFlatAlphaTable);
+        return bestBits;
+    }
+
+    // Each table spans the block's range at about one multiplier, with the base in the middle
+    for (int table = 0; table < 16 && bestError > 0; table++) {
+        int low = kAlphaTables[table][3];
+        int high = kAlphaTables[table][7];
+        int spread = high - low;
+        int multiplier = (maxAlpha - minAlpha + spread / 2) / spread;
+        for (int candidate = multiplier - 1; candidate <= multiplier + 1; candidate++) {
+            if (candidate < 1 || candidate > 15) {
+                continue;
+            }
+            auto doubledBase = minAlpha + maxAlpha - (low + high) * candidate;
+            tryFit(clamp255((doubledBase + 1) / 2), candidate, table);
+        }
+    }
+    return bestBits;
+}
+
+void Etc2Encoder::encodeRgb8(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *out) {
+    uint32_t blocksX = (width + kBlockDimension - 1) / kBlockDimension;
+    uint32_t blocksY = (height + kBlockDimension - 1) / kBlockDimension;
+    uint8_t pixels[kBlockPixels * 4];
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            loadBlock(rgba, width, height, blockX, blockY, pixels);
+            storeBigEndian(encodeColorBlock(pixels), out);
+            out += kColorBlockSize;
+        }
+    }
+}
+
+void Etc2Encoder::encodeRgba8(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *out) {
+    uint32_t blocksX = (width + kBlockDimension - 1) / kBlockDimension;
+    uint32_t blocksY = (height + kBlockDimension - 1) / kBlockDimension;
+    uint8_t pixels[kBlockPixels * 4];
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            loadBlock(rgba, width, height, blockX, blockY, pixels);
+            storeBigEndian(encodeAlphaBlock(pixels), out);
+            storeBigEndian(encodeColorBlock(pixels), out + kAlphaBlockSize);
+            out += kAlphaBlockSize + kColorBlockSize;
+        }
+    }
+}
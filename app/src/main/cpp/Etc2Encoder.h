@@ -0,0 +1,38 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ETC2ENCODER_H
+#define ANDROIDGLINVESTIGATIONS_ETC2ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * Encodes RGBA8 pixels as ETC2, which every GLES 3.0 device can sample. It's what transcoded
+ * textures fall back to on devices without ASTC, so it's built to run at load time on the
+ * loaders' worker threads rather than for the best quality: color blocks only use the ETC1
+ * modes, searched over both sub-block orientations, both base color encodings and every
+ * intensity table, and alpha blocks search EAC's tables around the block's alpha range.
+ *
+ * Blocks are 4x4 pixels, written in rows from the top left. Blocks hanging over the right or
+ * bottom edge repeat the last column or row.
+ */
+class Etc2Encoder {
+public:
+    /*!
+     * Encodes opaque pixels as ETC2 RGB8, 8 bytes per block. Alpha is ignored.
+     * @param rgba tightly packed RGBA8 pixels
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param out receives the blocks
+     */
+    static void encodeRgb8(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *out);
+
+    /*!
+     * Encodes pixels as ETC2 RGBA8, 16 bytes per block: the EAC alpha block, then the color block
+     * @param rgba tightly packed RGBA8 pixels
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param out receives the blocks
+     */
+    static void encodeRgba8(const uint8_t *rgba, uint32_t width, uint32_t height, uint8_t *out);
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ETC2ENCODER_H
@@ -0,0 +1,167 @@
+#include "FileSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+void File::adviseWillNeed(const uint8_t *data, size_t size) {
+    if (!data || size == 0) {
+        return;
+    }
+    // madvise wants a page aligned start, so the range grows back to the page it starts in
+    static const auto kPageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+    auto start = reinterpret_cast<uintptr_t>(data) & ~(kPageSize - 1);
+    auto end = reinterpret_cast<uintptr_t>(data) + size;
+    madvise(reinterpret_cast<void *>(start), end - start, MADV_WILLNEED);
+}
+
+/*!
+ * Forwards to the backend's file and records how long it takes
+ */
+class FileSystem::TimedFile : public File {
+public:
+    TimedFile(
+            std::unique_ptr<File> pFile,
+            std::string path,
+            std::shared_ptr<IoStatsTable> spIoStats)
+            : File(pFile->getLength()),
+              pFile_(std::move(pFile)),
+              path_(std::move(path)),
+              spIoStats_(std::move(spIoStats)),
+              buffer_(nullptr) {}
+
+    const uint8_t *getBuffer() override {
+        // Only the first call does any work, the rest would skew the stats
+        if (buffer_) {
+            return buffer_;
+        }
+        auto start = std::chrono::steady_clock::now();
+        buffer_ = pFile_->getBuffer();
+        if (buffer_) {
+            recordRead(uint64_t(getLength()), start);
+        }
+        return buffer_;
+    }
+
+    int64_t read(void *buffer, size_t size) override {
+        auto start = std::chrono::steady_clock::now();
+        auto bytesRead = pFile_->read(buffer, size);
+        if (bytesRead > 0) {
+            recordRead(uint64_t(bytesRead), start);
+        }
+        return bytesRead;
+    }
+
+    bool seek(int64_t offset) override { return pFile_->seek(offset); }
+
+    void prefetch(int64_t offset, int64_t size) override { pFile_->prefetch(offset, size); }
+
+private:
+    void recordRead(uint64_t bytes, std::chrono::steady_clock::time_point start) {
+        FileIoStats stats{};
+        stats.bytesRead = bytes;
+        stats.readMilliseconds = Milliseconds(std::chrono::steady_clock::now() - start).count();
+        spIoStats_->record(path_, stats);
+    }
+
+    std::unique_ptr<File> pFile_;
+    std::string path_;
+    std::shared_ptr<IoStatsTable> spIoStats_;
+    const uint8_t *buffer_;
+};
+
+FileSystem::IoStatsTable::IoStatsTable() : start_(std::chrono::steady_clock::now()) {}
+
+void FileSystem::IoStatsTable::record(const std::string &path, const FileIoStats &stats) {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto [it, inserted] = stats_.try_emplace(path, FileIoStats{});
+    auto &total = it->second;
+    if (inserted) {
+        total.firstOpenMilliseconds = Milliseconds(now - start_).count();
+    }
+    total.openCount += stats.openCount;
+    total.bytesRead += stats.bytesRead;
+    total.openMilliseconds += stats.openMilliseconds;
+    total.readMilliseconds += stats.readMilliseconds;
+}
+
+std::vector<std::pair<std::string, FileIoStats>> FileSystem::IoStatsTable::get() const {
+    std::vector<std::pair<std::string, FileIoStats>> stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats.assign(stats_.begin(), stats_.end());
+    }
+    std::sort(stats.begin(), stats.end(), [](const auto &a, const auto &b) {
+        return a.second.openMilliseconds + a.second.readMilliseconds
+               > b.second.openMilliseconds + b.second.readMilliseconds;
+    });
+    return stats;
+}
+
+void FileSystem::IoStatsTable::reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.clear();
+    start_ = std::chrono::steady_clock::now();
+}
+
+FileSystem::FileSystem() : spIoStats_(std::make_shared<IoStatsTable>()) {}
+
+void FileSystem::mount(std::string prefix, std::shared_ptr<FileSource> spSource) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    mounts_.push_back(Mount{std::move(prefix), std::move(spSource)});
+}
+
+std::unique_ptr<File> FileSystem::open(const std::string &path, FileAccess access) {
+    auto start = std::chrono::steady_clock::now();
+
+    // Sources open files without the lock held, a slow one mustn't hold up mounting
+    std::vector<Mount> mounts;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mounts = mounts_;
+    }
+    std::unique_ptr<File> pFile;
+    for (auto it = mounts.rbegin(); it != mounts.rend() && !pFile; ++it) {
+        if (path.compare(0, it->prefix.size(), it->prefix) == 0) {
+            pFile = it->spSource->open(path.substr(it->prefix.size()), access);
+        }
+    }
+
+    FileIoStats stats{};
+    stats.openCount = 1;
+    stats.openMilliseconds = Milliseconds(std::chrono::steady_clock::now() - start).count();
+    spIoStats_->record(path, stats);
+    if (!pFile) {
+        return nullptr;
+    }
+    return std::unique_ptr<File>(new TimedFile(std::move(pFile), path, spIoStats_));
+}
+
+std::vector<std::pair<std::string, FileIoStats>> FileSystem::getIoStats() const {
+    return spIoStats_->get();
+}
+
+std::vector<std::pair<std::string, FileIoStats>> FileSystem::getAccessOrder() const {
+    auto stats = spIoStats_->get();
+    std::sort(stats.begin(), stats.end(), [](const auto &a, const auto &b) {
+        return a.second.firstOpenMilliseconds < b.second.firstOpenMilliseconds;
+    });
+    return stats;
+}
+
+bool FileSystem::saveAccessOrder(const std::string &path) const {
+    std::ofstream file(path, std::ios::trunc);
+    for (const auto &[filePath, stats]: getAccessOrder()) {
+        file << stats.firstOpenMilliseconds << '\t' << filePath << '\n';
+    }
+    return bool(file);
+}
+
+void FileSystem::resetIoStats() {
+    spIoStats_->reset();
+}
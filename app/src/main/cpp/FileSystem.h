@@ -0,0 +1,201 @@
+#ifndef ANDROIDGLINVESTIGATIONS_FILESYSTEM_H
+#define ANDROIDGLINVESTIGATIONS_FILESYSTEM_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/*!
+ * How a file is going to be read, so the backend can pick the cheapest way to get at it
+ */
+enum class FileAccess : uint8_t {
+    // all at once with getBuffer, mapped rather than copied where the backend can
+    Buffer,
+    // front to back in pieces with read
+    Streaming,
+};
+
+/*!
+ * A file opened from a @a FileSystem. It's closed when it's destroyed. A file is used from one
+ * thread at a time, but can be handed between threads.
+ */
+class File {
+public:
+    virtual ~File() = default;
+
+    File(const File &) = delete;
+    File &operator=(const File &) = delete;
+
+    /*!
+     * @return the size of the file in bytes
+     */
+    inline int64_t getLength() const { return length_; }
+
+    /*!
+     * @return the whole file, mapped where the backend can so nothing is copied. It stays valid
+     *     until the file is closed. Null if the file can't be read.
+     */
+    virtual const uint8_t *getBuffer() = 0;
+
+    /*!
+     * Reads from the current position and moves past what was read
+     * @param buffer receives the bytes
+     * @param size how many bytes to read at most
+     * @return how many bytes were read, 0 at the end of the file, -1 if it can't be read
+     */
+    virtual int64_t read(void *buffer, size_t size) = 0;
+
+    /*!
+     * Moves the position @a read carries on from
+     * @param offset from the start of the file, at most its length
+     * @return false if the position can't be moved there
+     */
+    virtual bool seek(int64_t offset) = 0;
+
+    /*!
+     * Asks the backend to start reading part of the file in the background, so it's resident by
+     * the time it's used. Backends that can't do that ignore it.
+     * @param offset from the start of the file
+     * @param size how many bytes from there
+     */
+    virtual void prefetch(int64_t /* offset */, int64_t /* size */) {}
+
+protected:
+    explicit File(int64_t length) : length_(length) {}
+
+    /*!
+     * madvise(MADV_WILLNEED) over the pages of mapped memory, for backends that have the file
+     * mapped
+     */
+    static void adviseWillNeed(const uint8_t *data, size_t size);
+
+private:
+    int64_t length_;
+};
+
+/*!
+ * Somewhere files come from: the APK's assets, a directory, a pack in memory. Mounted into a
+ * @a FileSystem. Opening has to be safe from any thread.
+ */
+class FileSource {
+public:
+    virtual ~FileSource() = default;
+
+    /*!
+     * @param path the path of the file relative to the source, '/' separated
+     * @param access how the file is going to be read
+     * @return the open file, or null if there isn't one at @a path
+     */
+    virtual std::unique_ptr<File> open(const std::string &path, FileAccess access) = 0;
+};
+
+/*!
+ * Time spent getting at one file, across every time it was opened
+ */
+struct FileIoStats {
+    // how many times it was asked for, found or not, since probing for missing files costs too
+    uint32_t openCount;
+    uint64_t bytesRead;
+    // opening, including looking through every mount that didn't have it
+    double openMilliseconds;
+    // in getBuffer and read. Mapped files fault their pages in as they're touched, so that time
+    // lands on whoever reads them, not here.
+    double readMilliseconds;
+    // when it was first asked for, from when the stats were last reset
+    double firstOpenMilliseconds;
+};
+
+/*!
+ * Where loaders get their files from, so they don't care whether a file is in the APK, on disk
+ * or in memory, and run the same in host tools and benchmarks as on a device.
+ *
+ * Sources are mounted under a path prefix. Later mounts cover earlier ones, so a path is opened
+ * from the most recent mount whose prefix it starts with and that has the file. How long each
+ * file takes to open and read is recorded by path.
+ */
+class FileSystem {
+public:
+    FileSystem();
+
+    FileSystem(const FileSystem &) = delete;
+    FileSystem &operator=(const FileSystem &) = delete;
+
+    /*!
+     * Makes a source's files visible under @a prefix. Safe from any thread, files already open
+     * aren't affected.
+     * @param prefix prepended to the source's paths, empty or ending in '/'
+     * @param spSource the source
+     */
+    void mount(std::string prefix, std::shared_ptr<FileSource> spSource);
+
+    /*!
+     * Opens a file from the most recent mount that has it. Safe from any thread.
+     * @param path the path of the file, '/' separated
+     * @param access how the file is going to be read
+     * @return the open file, or null if no mount has it
+     */
+    std::unique_ptr<File> open(const std::string &path, FileAccess access = FileAccess::Buffer);
+
+    /*!
+     * @return the I/O stats of every file opened so far, the most time spent first
+     */
+    std::vector<std::pair<std::string, FileIoStats>> getIoStats() const;
+
+    /*!
+     * @return the I/O stats of every file opened so far, in the order they were first asked for
+     */
+    std::vector<std::pair<std::string, FileIoStats>> getAccessOrder() const;
+
+    /*!
+     * Writes the order files were first asked for, one "milliseconds<TAB>path" line each, for
+     * tools/packtool --order to lay a pack out by
+     * @param path where to write it
+     * @return false if it couldn't be written
+     */
+    bool saveAccessOrder(const std::string &path) const;
+
+    void resetIoStats();
+
+private:
+    struct Mount {
+        std::string prefix;
+        std::shared_ptr<FileSource> spSource;
+    };
+
+    /*!
+     * The stats table, shared with every open file so they can outlive the file system
+     */
+    class IoStatsTable {
+    public:
+        IoStatsTable();
+
+        /*!
+         * Adds to a file's stats. Its firstOpenMilliseconds is taken from the first open
+         * recorded, @a stats' is ignored.
+         */
+        void record(const std::string &path, const FileIoStats &stats);
+
+        std::vector<std::pair<std::string, FileIoStats>> get() const;
+
+        void reset();
+
+    private:
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, FileIoStats> stats_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    class TimedFile;
+
+    mutable std::mutex mutex_;
+    std::vector<Mount> mounts_;
+    std::shared_ptr<IoStatsTable> spIoStats_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_FILESYSTEM_H
@@ -0,0 +1,167 @@
+#include "GpuDeletionQueue.h"
+
+#include <chrono>
+
+/*!
+ * How many objects are deleted between checks of the clock
+ */
+static constexpr size_t kDeletionsPerBudgetCheck = 16;
+
+/*!
+ * The queue released objects go to, and the lock that keeps it alive while they're queued
+ */
+static std::mutex sCurrentMutex;
+static GpuDeletionQueue *pCurrentQueue = nullptr;
+
+GpuDeletionQueue::GpuDeletionQueue(float budgetMilliseconds)
+        : budgetMilliseconds_(budgetMilliseconds), frame_(0), completedFrame_(-1) {
+    std::lock_guard<std::mutex> lock(sCurrentMutex);
+    pCurrentQueue = this;
+}
+
+GpuDeletionQueue::~GpuDeletionQueue() {
+    {
+        std::lock_guard<std::mutex> lock(sCurrentMutex);
+        if (pCurrentQueue == this) {
+            pCurrentQueue = nullptr;
+        }
+    }
+    // Whatever is still queued goes with the context
+}
+
+void GpuDeletionQueue::release(GpuResourceType type, GLuint name) {
+    if (name == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(sCurrentMutex);
+    if (!pCurrentQueue) {
+        return;
+    }
+    std::lock_guard<std::mutex> queueLock(pCurrentQueue->mutex_);
+    pCurrentQueue->releases_.push_back(Release{type, name, pCurrentQueue->frame_});
+}
+
+void GpuDeletionQueue::runWhenDone(std::function<void()> function) {
+    std::lock_guard<std::mutex> lock(sCurrentMutex);
+    if (!pCurrentQueue) {
+        return;
+    }
+    std::lock_guard<std::mutex> queueLock(pCurrentQueue->mutex_);
+    pCurrentQueue->deferred_.push_back(Deferred{std::move(function), pCurrentQueue->frame_});
+}
+
+void GpuDeletionQueue::endFrame() {
+    int64_t frame;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        frame = frame_++;
+    }
+    // Without a fence the frame counts as done once the next process call runs. That can only
+    // happen when GL is out of memory, and deleting is the best thing to do then anyway.
+    fences_.push_back(FrameFence{frame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+}
+
+size_t GpuDeletionQueue::process() {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    auto start = std::chrono::steady_clock::now();
+
+    // Fences signal in order, so stop at the first that hasn't
+    while (!fences_.empty()) {
+        auto fence = fences_.front().fence;
+        if (fence) {
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+                break;
+            }
+            glDeleteSync(fence);
+        }
+        completedFrame_ = fences_.front().frame;
+        fences_.pop_front();
+    }
+
+    // These only hand storage back, so they all run whatever the budget
+    std::deque<Deferred> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!deferred_.empty() && deferred_.front().frame <= completedFrame_) {
+            ready.push_back(std::move(deferred_.front()));
+            deferred_.pop_front();
+        }
+    }
+    for (auto &deferred: ready) {
+        deferred.function();
+    }
+
+    size_t deleted = 0;
+    while (true) {
+        Release release;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (releases_.empty() || releases_.front().frame > completedFrame_) {
+                break;
+            }
+            release = releases_.front();
+            releases_.pop_front();
+        }
+        deleteObject(release);
+        deleted++;
+
+        if (deleted % kDeletionsPerBudgetCheck == 0
+            && Milliseconds(std::chrono::steady_clock::now() - start).count()
+               >= budgetMilliseconds_) {
+            break;
+        }
+    }
+    return deleted;
+}
+
+void GpuDeletionQueue::flush() {
+    glFinish();
+    for (auto &frameFence: fences_) {
+        if (frameFence.fence) {
+            glDeleteSync(frameFence.fence);
+        }
+    }
+    fences_.clear();
+
+    // First, in case they release objects of their own
+    std::deque<Deferred> deferred;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        deferred.swap(deferred_);
+    }
+    for (auto &entry: deferred) {
+        entry.function();
+    }
+
+    std::deque<Release> releases;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        releases.swap(releases_);
+        completedFrame_ = frame_ - 1;
+    }
+    for (const auto &release: releases) {
+        deleteObject(release);
+    }
+}
+
+size_t GpuDeletionQueue::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return releases_.size() + deferred_.size();
+}
+
+void GpuDeletionQueue::deleteObject(const Release &release) {
+    switch (release.type) {
+        case GpuResourceType::Texture:
+            glDeleteTextures(1, &release.name);
+            break;
+        case GpuResourceType::Buffer:
+            glDeleteBuffers(1, &release.name);
+            break;
+        case GpuResourceType::Program:
+            glDeleteProgram(release.name);
+            break;
+        case GpuResourceType::Sampler:
+            glDeleteSamplers(1, &release.name);
+            break;
+    }
+}
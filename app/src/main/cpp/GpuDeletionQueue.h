@@ -0,0 +1,132 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GPUDELETIONQUEUE_H
+#define ANDROIDGLINVESTIGATIONS_GPUDELETIONQUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <GLES3/gl3.h>
+
+/*!
+ * The kinds of GL object a @a GpuDeletionQueue can delete
+ */
+enum class GpuResourceType : uint8_t {
+    Texture,
+    Buffer,
+    Program,
+    Sampler,
+};
+
+/*!
+ * Deletes GL objects once the GPU has finished with them, on the GL thread, a little each frame.
+ *
+ * Objects are handed over with @a release from any thread, typically from the destructor of
+ * whatever owned them, which can run wherever the last reference is dropped. Each is tagged with
+ * the frame it was released in. @a endFrame puts a fence after each frame's commands, and
+ * @a process deletes the objects of frames whose fence has signalled, so nothing is deleted while
+ * a draw that's still in flight uses it, and the driver never has to stall for it. @a process
+ * stops once its time budget is spent, leaving the rest for later frames.
+ *
+ * One queue is current at a time, the one for the context on the GL thread. Objects released
+ * while no queue is current are dropped: their context is gone and took them with it.
+ */
+class GpuDeletionQueue {
+public:
+    /*!
+     * Makes this the current queue. GL objects are only made once frames end, so this can be
+     * made before there's a context.
+     * @param budgetMilliseconds how much time @a process may spend each frame
+     */
+    explicit GpuDeletionQueue(float budgetMilliseconds = 0.5f);
+
+    /*!
+     * Stops being the current queue. Whatever is still queued is dropped without deleting it, so
+     * call @a flush first while the context is still current.
+     */
+    ~GpuDeletionQueue();
+
+    GpuDeletionQueue(const GpuDeletionQueue &) = delete;
+    GpuDeletionQueue &operator=(const GpuDeletionQueue &) = delete;
+
+    /*!
+     * Queues a GL object for deletion on the current queue. Safe from any thread.
+     * @param type what kind of object @a name is
+     * @param name the object, 0 is ignored
+     */
+    static void release(GpuResourceType type, GLuint name);
+
+    /*!
+     * Queues a function to run on the GL thread once the GPU has finished the frame it's queued
+     * in, for storage that's reused rather than deleted, like a layer of a texture array. Safe
+     * from any thread. Dropped if no queue is current.
+     * @param function what to run, from @a process or @a flush
+     */
+    static void runWhenDone(std::function<void()> function);
+
+    /*!
+     * Marks the end of a frame's GL commands with a fence. Call on the GL thread once per frame,
+     * after the last draw.
+     */
+    void endFrame();
+
+    /*!
+     * Deletes the objects the GPU is done with until the budget runs out. Call on the GL thread
+     * once per frame.
+     * @return how many were deleted
+     */
+    size_t process();
+
+    /*!
+     * Waits for the GPU and deletes everything queued. Call on the GL thread before the context
+     * is destroyed.
+     */
+    void flush();
+
+    /*!
+     * @return how many objects are waiting to be deleted, and functions waiting to run
+     */
+    size_t getPendingCount() const;
+
+    inline void setBudget(float budgetMilliseconds) { budgetMilliseconds_ = budgetMilliseconds; }
+
+private:
+    struct Release {
+        GpuResourceType type;
+        GLuint name;
+        // the frame the object was released in, it's safe to delete once that frame's fence
+        // signals
+        int64_t frame;
+    };
+
+    struct Deferred {
+        std::function<void()> function;
+        // the frame it was queued in, it runs once that frame's fence signals
+        int64_t frame;
+    };
+
+    struct FrameFence {
+        int64_t frame;
+        GLsync fence;
+    };
+
+    static void deleteObject(const Release &release);
+
+    float budgetMilliseconds_;
+
+    // guards releases_, deferred_ and frame_
+    mutable std::mutex mutex_;
+    // in the order they were released, so frames only go up
+    std::deque<Release> releases_;
+    // in the order they were queued, likewise
+    std::deque<Deferred> deferred_;
+    // the frame being recorded, not fenced yet
+    int64_t frame_;
+
+    // GL thread only
+    std::deque<FrameFence> fences_;
+    // the newest frame the GPU is known to have finished, -1 for none
+    int64_t completedFrame_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_GPUDELETIONQUEUE_H
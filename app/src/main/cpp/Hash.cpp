@@ -0,0 +1,91 @@
+#include "Hash.h"
+
+#include <cstring>
+
+static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Unaligned little endian reads, the compiler turns these into single loads
+static inline uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t accumulate(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * kPrime1;
+}
+
+static inline uint64_t mergeRound(uint64_t hash, uint64_t accumulator) {
+    hash ^= accumulate(0, accumulator);
+    return hash * kPrime1 + kPrime4;
+}
+
+uint64_t Hash::xxh64(const void *data, size_t size, uint64_t seed) {
+    auto p = static_cast<const uint8_t *>(data);
+    auto end = p + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        // Four independent lanes over 32 byte stripes
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+        auto limit = end - 32;
+        do {
+            v1 = accumulate(v1, read64(p));
+            v2 = accumulate(v2, read64(p + 8));
+            v3 = accumulate(v3, read64(p + 16));
+            v4 = accumulate(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+    hash += uint64_t(size);
+
+    // The tail, 8 then 4 then 1 bytes at a time
+    for (; p + 8 <= end; p += 8) {
+        hash ^= accumulate(0, read64(p));
+        hash = rotateLeft(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= uint64_t(read32(p)) * kPrime1;
+        hash = rotateLeft(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash ^= uint64_t(*p) * kPrime5;
+        hash = rotateLeft(hash, 11) * kPrime1;
+    }
+
+    // Avalanche
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
@@ -0,0 +1,31 @@
+#ifndef ANDROIDGLINVESTIGATIONS_HASH_H
+#define ANDROIDGLINVESTIGATIONS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * Fast non cryptographic hashing for content keys and corruption checks
+ */
+class Hash {
+public:
+    /*!
+     * XXH64, bit for bit compatible with the reference implementation so hashes can be checked
+     * with the xxhsum tool
+     * @param data the bytes to hash
+     * @param size how many bytes there are
+     * @param seed starts a different hash sequence for the same bytes
+     * @return the 64 bit hash
+     */
+    static uint64_t xxh64(const void *data, size_t size, uint64_t seed = 0);
+
+    /*!
+     * Mixes @a value into @a seed, for building one key out of several hashes
+     * @return the combined hash
+     */
+    static inline uint64_t combine(uint64_t seed, uint64_t value) {
+        return xxh64(&value, sizeof(value), seed);
+    }
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_HASH_H
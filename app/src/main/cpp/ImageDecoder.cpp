@@ -0,0 +1,80 @@
+#include "ImageDecoder.h"
+
+#include <algorithm>
+#include <cstring>
+
+bool ImageDecoder::setTargetSize(int32_t width, int32_t height) {
+    if (nextRow_ > 0 || width <= 0 || height <= 0
+        || width > sourceWidth_ || height > sourceHeight_) {
+        return false;
+    }
+
+    width_ = width;
+    height_ = height;
+    scaling_ = !setNativeTargetSize(width, height)
+               && (width != sourceWidth_ || height != sourceHeight_);
+    if (scaling_) {
+        // Every destination pixel covers a whole number of source pixels, the edges of the boxes
+        // are spread as evenly as integers allow
+        columnStarts_.resize(size_t(width) + 1);
+        for (int32_t x = 0; x <= width; x++) {
+            columnStarts_[x] = int32_t(int64_t(x) * sourceWidth_ / width);
+        }
+        sourceRow_.resize(size_t(sourceWidth_) * 4);
+        sums_.resize(size_t(width) * 4);
+    }
+    return true;
+}
+
+bool ImageDecoder::decodeRows(uint8_t *pixels, size_t stride, int32_t rowCount) {
+    if (failed_ || rowCount < 0 || rowCount > height_ - nextRow_
+        || stride < getMinimumStride()) {
+        return false;
+    }
+    bool decoded = scaling_ ? scaleRows(pixels, stride, rowCount)
+                            : readRows(pixels, stride, rowCount);
+    if (!decoded) {
+        failed_ = true;
+        return false;
+    }
+    nextRow_ += rowCount;
+    return true;
+}
+
+bool ImageDecoder::scaleRows(uint8_t *pixels, size_t stride, int32_t rowCount) {
+    for (int32_t row = 0; row < rowCount; row++) {
+        auto y = nextRow_ + row;
+        auto sourceEnd = int32_t(int64_t(y + 1) * sourceHeight_ / height_);
+        auto boxHeight = sourceEnd - nextSourceRow_;
+
+        // Weight color by alpha, so transparent pixels don't bleed their color into the edges
+        std::fill(sums_.begin(), sums_.end(), 0);
+        for (; nextSourceRow_ < sourceEnd; nextSourceRow_++) {
+            if (!readRows(sourceRow_.data(), sourceRow_.size(), 1)) {
+                return false;
+            }
+            for (int32_t x = 0; x < width_; x++) {
+                auto *sum = &sums_[size_t(x) * 4];
+                for (auto sourceX = columnStarts_[x]; sourceX < columnStarts_[x + 1]; sourceX++) {
+                    const auto *pixel = &sourceRow_[size_t(sourceX) * 4];
+                    uint32_t alpha = pixel[3];
+                    sum[0] += pixel[0] * alpha;
+                    sum[1] += pixel[1] * alpha;
+                    sum[2] += pixel[2] * alpha;
+                    sum[3] += alpha;
+                }
+            }
+        }
+
+        auto *out = pixels + size_t(row) * stride;
+        for (int32_t x = 0; x < width_; x++) {
+            const auto *sum = &sums_[size_t(x) * 4];
+            auto area = uint64_t(columnStarts_[x + 1] - columnStarts_[x]) * boxHeight;
+            for (int channel = 0; channel < 3; channel++) {
+                out[x * 4 + channel] = sum[3] ? uint8_t((sum[channel] + sum[3] / 2) / sum[3]) : 0;
+            }
+            out[x * 4 + 3] = uint8_t((sum[3] + area / 2) / area);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,118 @@
+#ifndef ANDROIDGLINVESTIGATIONS_IMAGEDECODER_H
+#define ANDROIDGLINVESTIGATIONS_IMAGEDECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Decodes an encoded image into tightly packed RGBA8 pixels with straight alpha, a few rows at a
+ * time if the caller wants, into memory the caller owns.
+ *
+ * Backends only have to read rows at the size they were opened at. Any target size they can't
+ * decode at directly is box filtered here from the rows they produce, so only one band of source
+ * rows is ever held at once.
+ */
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() = default;
+
+    /*!
+     * @return the width of the decoded image, after @a setTargetSize
+     */
+    inline int32_t getWidth() const { return width_; }
+
+    /*!
+     * @return the height of the decoded image, after @a setTargetSize
+     */
+    inline int32_t getHeight() const { return height_; }
+
+    inline int32_t getSourceWidth() const { return sourceWidth_; }
+
+    inline int32_t getSourceHeight() const { return sourceHeight_; }
+
+    /*!
+     * @return the smallest stride that fits a row of the decoded image
+     */
+    inline size_t getMinimumStride() const { return size_t(width_) * 4; }
+
+    /*!
+     * @return how many rows have been decoded so far
+     */
+    inline int32_t getDecodedRowCount() const { return nextRow_; }
+
+    /*!
+     * Decodes at a smaller size. Call before the first row is decoded.
+     * @param width the width to decode at, no bigger than the source
+     * @param height the height to decode at, no bigger than the source
+     * @return false if the size can't be used, the decoder keeps its current size
+     */
+    bool setTargetSize(int32_t width, int32_t height);
+
+    /*!
+     * Decodes the next rows of the image
+     * @param pixels receives the rows
+     * @param stride the bytes from one row to the next in @a pixels
+     * @param rowCount how many rows to decode, at most what's left
+     * @return false if the image is corrupt or the arguments don't fit, the decoder can't be used
+     *     after that
+     */
+    bool decodeRows(uint8_t *pixels, size_t stride, int32_t rowCount);
+
+    /*!
+     * Decodes everything that hasn't been decoded yet
+     * @param pixels receives the rows
+     * @param stride the bytes from one row to the next in @a pixels
+     * @return false if the image is corrupt
+     */
+    inline bool decode(uint8_t *pixels, size_t stride) {
+        return decodeRows(pixels, stride, height_ - nextRow_);
+    }
+
+protected:
+    ImageDecoder(int32_t width, int32_t height)
+            : sourceWidth_(width),
+              sourceHeight_(height),
+              width_(width),
+              height_(height),
+              nextRow_(0),
+              failed_(false),
+              scaling_(false),
+              nextSourceRow_(0) {}
+
+    /*!
+     * Lets a backend decode straight at a smaller size
+     * @return true if it will, @a readRows then produces rows at that size
+     */
+    virtual bool setNativeTargetSize(int32_t /* width */, int32_t /* height */) { return false; }
+
+    /*!
+     * Reads the next rows at the size the backend decodes at
+     * @return false if the image is corrupt
+     */
+    virtual bool readRows(uint8_t *pixels, size_t stride, int32_t rowCount) = 0;
+
+private:
+    /*!
+     * Box filters the source rows under @a rowCount destination rows
+     */
+    bool scaleRows(uint8_t *pixels, size_t stride, int32_t rowCount);
+
+    int32_t sourceWidth_;
+    int32_t sourceHeight_;
+    int32_t width_;
+    int32_t height_;
+    int32_t nextRow_;
+    bool failed_;
+
+    // set up when the backend can't decode at the target size itself
+    bool scaling_;
+    int32_t nextSourceRow_;
+    // the first source column of each destination column, and one past the last
+    std::vector<int32_t> columnStarts_;
+    std::vector<uint8_t> sourceRow_;
+    // alpha weighted color and alpha per destination pixel of the row being built
+    std::vector<uint64_t> sums_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_IMAGEDECODER_H
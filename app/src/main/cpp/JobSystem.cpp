@@ -0,0 +1,340 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+/*!
+ * How many jobs each thread's deque holds. A thread that fills its deque runs the next job it
+ * queues straight away instead.
+ */
+static constexpr size_t kDequeCapacity = 4096;
+
+/*!
+ * How many chunks per thread @a JobSystem::parallelFor aims for when it picks the grain itself.
+ * More than one so a thread that's slowed down doesn't hold up the rest.
+ */
+static constexpr size_t kChunksPerThread = 8;
+
+/*!
+ * How many rounds an idle worker looks for work before going to sleep
+ */
+static constexpr int kIdleSpins = 64;
+
+/*!
+ * The system the calling thread belongs to, and its deque in it
+ */
+static thread_local const JobSystem *tlsJobSystem = nullptr;
+static thread_local size_t tlsDequeIndex = 0;
+
+JobSystem::JobSystem(int workerCount)
+        : mainThreadId_(std::this_thread::get_id()),
+          queuedJobs_(0),
+          sleepingWorkers_(0),
+          stopping_(false) {
+    workerCount = std::max(workerCount, 0);
+    for (int i = 0; i <= workerCount; i++) {
+        deques_.push_back(std::make_unique<WorkStealingDeque<Job>>(kDequeCapacity));
+    }
+    tlsJobSystem = this;
+    tlsDequeIndex = 0;
+    for (int i = 1; i <= workerCount; i++) {
+        workers_.emplace_back(&JobSystem::workerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wakeWorkers_.notify_all();
+    for (auto &worker: workers_) {
+        worker.join();
+    }
+
+    // Nothing is running any more, so the deques can be emptied from here
+    for (auto &spDeque: deques_) {
+        while (auto pJob = spDeque->steal()) {
+            delete pJob;
+        }
+    }
+    for (auto pJob: sharedJobs_) {
+        delete pJob;
+    }
+    for (auto pJob: mainThreadJobs_) {
+        delete pJob;
+    }
+    if (tlsJobSystem == this) {
+        tlsJobSystem = nullptr;
+    }
+}
+
+bool JobSystem::isMainThread() const {
+    return std::this_thread::get_id() == mainThreadId_;
+}
+
+WorkStealingDeque<Job> *JobSystem::getLocalDeque() const {
+    return tlsJobSystem == this ? deques_[tlsDequeIndex].get() : nullptr;
+}
+
+void JobSystem::run(std::function<void()> function, JobCounter *counter, JobAffinity affinity) {
+    if (counter) {
+        addWork(*counter);
+    }
+    schedule(new Job{std::move(function), counter, affinity});
+}
+
+void JobSystem::runAfter(
+        JobCounter &dependency,
+        std::function<void()> function,
+        JobCounter *counter,
+        JobAffinity affinity) {
+    if (counter) {
+        addWork(*counter);
+    }
+    auto pJob = new Job{std::move(function), counter, affinity};
+    {
+        // The job that takes the count to 0 locks this before releasing the dependents, so the
+        // job either goes on the list in time or sees the count already at 0
+        std::lock_guard<std::mutex> lock(dependency.mutex_);
+        if (dependency.count_.load(std::memory_order_acquire) > 0) {
+            dependency.dependents_.push_back(pJob);
+            return;
+        }
+    }
+    schedule(pJob);
+}
+
+void JobSystem::schedule(Job *pJob) {
+    if (pJob->affinity == JobAffinity::MainThread) {
+        {
+            std::lock_guard<std::mutex> lock(mainThreadMutex_);
+            mainThreadJobs_.push_back(pJob);
+        }
+        if (mainThreadWakeup_) {
+            mainThreadWakeup_();
+        }
+        return;
+    }
+
+    auto pDeque = getLocalDeque();
+    if (pDeque && !pDeque->push(pJob)) {
+        // Full, the job runs now rather than waiting behind thousands of others
+        execute(pJob);
+        return;
+    }
+    if (!pDeque) {
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        sharedJobs_.push_back(pJob);
+    }
+
+    // Paired with the sleeping count going up before a worker checks for jobs, so either the
+    // worker sees this job or this sees the worker
+    queuedJobs_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepingWorkers_.load(std::memory_order_seq_cst) > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        wakeWorkers_.notify_one();
+    }
+
+    // Without workers only the main thread can run it
+    if (workers_.empty() && mainThreadWakeup_ && !isMainThread()) {
+        mainThreadWakeup_();
+    }
+}
+
+void JobSystem::execute(Job *pJob) {
+    pJob->function();
+    auto pCounter = pJob->counter;
+    delete pJob;
+    if (pCounter) {
+        finishWork(*pCounter);
+    }
+}
+
+void JobSystem::addWork(JobCounter &counter) {
+    counter.count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JobSystem::finishWork(JobCounter &counter) {
+    std::vector<Job *> dependents;
+    {
+        // Counted down under the lock, so a waiter that sees 0 can't free the counter until this
+        // is done with it
+        std::lock_guard<std::mutex> lock(counter.mutex_);
+        if (counter.count_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            dependents.swap(counter.dependents_);
+        }
+    }
+    for (auto pDependent: dependents) {
+        schedule(pDependent);
+    }
+}
+
+Job *JobSystem::findJob() {
+    Job *pJob = nullptr;
+    auto pLocal = getLocalDeque();
+    if (pLocal) {
+        pJob = pLocal->pop();
+    }
+    if (!pJob) {
+        std::lock_guard<std::mutex> lock(sharedMutex_);
+        if (!sharedJobs_.empty()) {
+            pJob = sharedJobs_.front();
+            sharedJobs_.pop_front();
+        }
+    }
+
+    // Start each search at a different deque so thieves spread out
+    auto start = pLocal ? tlsDequeIndex + 1 : 0;
+    for (size_t i = 0; !pJob && i < deques_.size(); i++) {
+        auto &spVictim = deques_[(start + i) % deques_.size()];
+        if (spVictim.get() != pLocal) {
+            pJob = spVictim->steal();
+        }
+    }
+    if (pJob) {
+        queuedJobs_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return pJob;
+}
+
+Job *JobSystem::takeMainThreadJob() {
+    std::lock_guard<std::mutex> lock(mainThreadMutex_);
+    if (mainThreadJobs_.empty()) {
+        return nullptr;
+    }
+    auto pJob = mainThreadJobs_.front();
+    mainThreadJobs_.pop_front();
+    return pJob;
+}
+
+void JobSystem::wait(JobCounter &counter) {
+    bool mainThread = isMainThread();
+    while (!counter.isDone()) {
+        Job *pJob = mainThread ? takeMainThreadJob() : nullptr;
+        if (!pJob) {
+            pJob = findJob();
+        }
+        if (pJob) {
+            execute(pJob);
+        } else {
+            // What's left is running on other threads
+            std::this_thread::yield();
+        }
+    }
+
+    // The last job may still be releasing the counter's dependents
+    std::lock_guard<std::mutex> lock(counter.mutex_);
+}
+
+size_t JobSystem::runMainThreadJobs() {
+    // Only what's queued now, jobs these queue wait for the next frame
+    std::deque<Job *> jobs;
+    {
+        std::lock_guard<std::mutex> lock(mainThreadMutex_);
+        jobs.swap(mainThreadJobs_);
+    }
+    for (auto pJob: jobs) {
+        execute(pJob);
+    }
+    size_t count = jobs.size();
+
+    // Nothing else would ever run them. Again only what's queued now, jobs these queue wait.
+    if (workers_.empty()) {
+        for (auto queued = queuedJobs_.load(std::memory_order_relaxed); queued > 0; queued--) {
+            auto pJob = findJob();
+            if (!pJob) {
+                break;
+            }
+            execute(pJob);
+            count++;
+        }
+    }
+    return count;
+}
+
+bool JobSystem::hasMainThreadJobs() {
+    if (workers_.empty() && queuedJobs_.load(std::memory_order_relaxed) > 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mainThreadMutex_);
+    return !mainThreadJobs_.empty();
+}
+
+void JobSystem::setMainThreadWakeup(std::function<void()> wakeup) {
+    mainThreadWakeup_ = std::move(wakeup);
+}
+
+void JobSystem::parallelFor(
+        size_t begin,
+        size_t end,
+        size_t grain,
+        const RangeFunction &function) {
+    if (begin >= end) {
+        return;
+    }
+    if (grain == 0) {
+        auto chunkCount = deques_.size() * kChunksPerThread;
+        grain = std::max((end - begin + chunkCount - 1) / chunkCount, size_t(1));
+    }
+
+    JobCounter counter;
+    if (getLocalDeque()) {
+        runRange(begin, end, grain, function, counter);
+    } else {
+        // Threads outside the system have no deque to split onto, so a worker starts the range
+        run([this, begin, end, grain, &function, &counter]() {
+            runRange(begin, end, grain, function, counter);
+        }, &counter);
+    }
+    wait(counter);
+}
+
+void JobSystem::runRange(
+        size_t begin,
+        size_t end,
+        size_t grain,
+        const RangeFunction &function,
+        JobCounter &counter) {
+    auto pLocal = getLocalDeque();
+    while (begin < end) {
+        // An empty deque means idle threads have nothing to steal from here, so give them half.
+        // Threads outside the system split all the way, their halves go on the shared queue.
+        while (end - begin > grain && (!pLocal || pLocal->size() == 0)) {
+            auto middle = begin + (end - begin) / 2;
+            run([this, middle, end, grain, &function, &counter]() {
+                runRange(middle, end, grain, function, counter);
+            }, &counter);
+            end = middle;
+        }
+        auto chunkEnd = std::min(begin + grain, end);
+        function(begin, chunkEnd);
+        begin = chunkEnd;
+    }
+}
+
+void JobSystem::workerMain(int index) {
+    tlsJobSystem = this;
+    tlsDequeIndex = size_t(index);
+
+    int idleRounds = 0;
+    while (!stopping_.load(std::memory_order_relaxed)) {
+        if (auto pJob = findJob()) {
+            execute(pJob);
+            idleRounds = 0;
+            continue;
+        }
+        if (++idleRounds < kIdleSpins) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        sleepingWorkers_.fetch_add(1, std::memory_order_seq_cst);
+        wakeWorkers_.wait(lock, [this]() {
+            return stopping_.load(std::memory_order_relaxed)
+                   || queuedJobs_.load(std::memory_order_seq_cst) > 0;
+        });
+        sleepingWorkers_.fetch_sub(1, std::memory_order_relaxed);
+        idleRounds = 0;
+    }
+}
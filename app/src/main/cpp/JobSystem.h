@@ -0,0 +1,250 @@
+#ifndef ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
+#define ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "WorkStealingDeque.h"
+
+class JobSystem;
+struct Job;
+
+/*!
+ * Where a job may run
+ */
+enum class JobAffinity : uint8_t {
+    // any worker, or the main thread while it waits
+    Any,
+    // only the main thread, for GL calls and anything else tied to the thread that owns the context
+    MainThread,
+};
+
+/*!
+ * Counts the unfinished jobs of a group. Jobs are added to it when they're run and taken off when
+ * they finish, so @a JobSystem::wait on it waits for the whole group, and @a JobSystem::runAfter
+ * can start more work once the group is done.
+ *
+ * A counter has to outlive every job counted on it and every job waiting on it. Free it only after
+ * @a JobSystem::wait on it has returned, the last job may still be using it when @a isDone first
+ * turns true.
+ */
+class JobCounter {
+public:
+    inline JobCounter() : count_(0) {}
+
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    /*!
+     * @return true if no job counted on this is still queued or running
+     */
+    inline bool isDone() const { return count_.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> count_;
+    // guards dependents_, and orders adding one against the count reaching 0
+    std::mutex mutex_;
+    // jobs held back until the count reaches 0
+    std::vector<Job *> dependents_;
+};
+
+/*!
+ * A unit of work queued on a @a JobSystem
+ */
+struct Job {
+    std::function<void()> function;
+    // taken off when the job finishes, may be null
+    JobCounter *counter;
+    JobAffinity affinity;
+};
+
+/*!
+ * Runs small jobs across a fixed set of worker threads with work stealing.
+ *
+ * Every worker, and the main thread, has its own @a WorkStealingDeque. Jobs run from one of those
+ * threads go on its own deque, and a thread that runs out of work steals from the others, so load
+ * balances itself without a shared queue to fight over. Jobs run from any other thread go through
+ * a small locked queue. Jobs with @a JobAffinity::MainThread only ever run on the main thread, in
+ * @a runMainThreadJobs or while it waits.
+ *
+ * The main thread is the one that creates the system. It has no thread of its own in the pool,
+ * instead it runs jobs whenever it waits, so size the pool one smaller than the cores to use.
+ *
+ * Nothing here depends on Android, so it can be benchmarked on a desktop build.
+ */
+class JobSystem {
+public:
+    using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+    /*!
+     * @param workerCount how many worker threads to start, 0 runs everything on the main thread,
+     *     while it waits or in @a runMainThreadJobs
+     */
+    explicit JobSystem(int workerCount);
+
+    /*!
+     * Stops the workers. Jobs that haven't started are dropped, wait on them first.
+     */
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+
+    inline int getWorkerCount() const { return int(workers_.size()); }
+
+    /*!
+     * @return true on the thread that created the system
+     */
+    bool isMainThread() const;
+
+    /*!
+     * Queues a job
+     * @param function the work
+     * @param counter counts the job until it finishes, may be null
+     * @param affinity where the job may run
+     */
+    void run(
+            std::function<void()> function,
+            JobCounter *counter = nullptr,
+            JobAffinity affinity = JobAffinity::Any);
+
+    /*!
+     * Queues a job once every job counted on @a dependency so far has finished, straight away if
+     * they already have
+     * @param dependency the group to wait for
+     * @param function the work
+     * @param counter counts the job from now until it finishes, may be null
+     * @param affinity where the job may run
+     */
+    void runAfter(
+            JobCounter &dependency,
+            std::function<void()> function,
+            JobCounter *counter = nullptr,
+            JobAffinity affinity = JobAffinity::Any);
+
+    /*!
+     * Counts work that isn't a job on @a counter, a coroutine say, until @a finishWork is called
+     * for it. Waiting on the counter and jobs run after it treat it like a job.
+     */
+    void addWork(JobCounter &counter);
+
+    /*!
+     * Takes work counted with @a addWork off @a counter
+     */
+    void finishWork(JobCounter &counter);
+
+    /*!
+     * Runs other jobs until every job counted on @a counter has finished. On the main thread that
+     * includes main thread jobs, so waiting on one from there can't deadlock.
+     */
+    void wait(JobCounter &counter);
+
+    /*!
+     * Calls @a function over [begin, end) in chunks spread across the threads and waits for all
+     * of them.
+     *
+     * Chunking adapts to how busy the threads are. A thread running part of the range splits off
+     * the top half as a new job whenever its deque is empty, since that means there's nothing
+     * queued for idle threads to steal. While every thread has work it just runs its part in
+     * chunks of @a grain, so the range is only split as finely as stealing calls for.
+     * @param begin the first index
+     * @param end one past the last index
+     * @param grain the smallest chunk worth its own job, 0 picks one from the range and the
+     *     thread count
+     * @param function called with each chunk, from any thread, never with an empty one
+     */
+    void parallelFor(size_t begin, size_t end, size_t grain, const RangeFunction &function);
+
+    /*!
+     * Runs the main thread jobs queued so far. Call once per frame from the main thread. Without
+     * workers the main thread is the only one that runs anything, so the other jobs queued so far
+     * run here too.
+     * @return how many ran
+     */
+    size_t runMainThreadJobs();
+
+    /*!
+     * @return true if jobs are queued for the next @a runMainThreadJobs
+     */
+    bool hasMainThreadJobs();
+
+    /*!
+     * Sets what's called, from the thread queueing it, whenever a job for the next
+     * @a runMainThreadJobs is queued, so a main thread that sleeps between frames can be woken
+     * for it. Set it before other threads start running jobs.
+     * @param wakeup called with no locks held, may be null
+     */
+    void setMainThreadWakeup(std::function<void()> wakeup);
+
+private:
+    /*!
+     * Puts a job where a thread that may run it will find it
+     */
+    void schedule(Job *pJob);
+
+    /*!
+     * Runs a job and signals its counter
+     */
+    void execute(Job *pJob);
+
+    /*!
+     * Finds a job for the calling thread: its own newest job, then the shared queue, then the
+     * oldest job of another thread
+     * @return the job, or null if there was nothing to take
+     */
+    Job *findJob();
+
+    /*!
+     * @return the main thread job that has waited longest, or null if there's none
+     */
+    Job *takeMainThreadJob();
+
+    /*!
+     * Runs part of a @a parallelFor range, splitting it up while other threads could take a share
+     */
+    void runRange(
+            size_t begin,
+            size_t end,
+            size_t grain,
+            const RangeFunction &function,
+            JobCounter &counter);
+
+    void workerMain(int index);
+
+    /*!
+     * @return the deque of the calling thread, or null if it isn't part of this system
+     */
+    WorkStealingDeque<Job> *getLocalDeque() const;
+
+    std::thread::id mainThreadId_;
+    // the main thread's deque first, then one per worker
+    std::vector<std::unique_ptr<WorkStealingDeque<Job>>> deques_;
+    std::vector<std::thread> workers_;
+
+    // jobs run from threads outside the system
+    std::mutex sharedMutex_;
+    std::deque<Job *> sharedJobs_;
+
+    std::mutex mainThreadMutex_;
+    std::deque<Job *> mainThreadJobs_;
+    std::function<void()> mainThreadWakeup_;
+
+    // jobs any worker could take, a hint for idle workers deciding whether to sleep
+    std::atomic<int> queuedJobs_;
+    std::atomic<int> sleepingWorkers_;
+    std::mutex sleepMutex_;
+    std::condition_variable wakeWorkers_;
+    std::atomic<bool> stopping_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
@@ -0,0 +1,122 @@
+#include "Ktx2File.h"
+
+#include <cstring>
+
+/*!
+ * The VkFormat values of the formats that can be uploaded without transcoding
+ */
+static constexpr uint32_t kVkFormatR8G8B8A8Unorm = 37;
+static constexpr uint32_t kVkFormatEtc2R8G8B8UnormBlock = 147;
+static constexpr uint32_t kVkFormatEtc2R8G8B8A8UnormBlock = 151;
+static constexpr uint32_t kVkFormatAstc4x4UnormBlock = 157;
+
+/*!
+ * Data format descriptor color models that mean Basis Universal data
+ */
+static constexpr uint8_t kColorModelEtc1s = 163;
+static constexpr uint8_t kColorModelUastc = 166;
+
+/*!
+ * KHR_DF_FLAG_ALPHA_PREMULTIPLIED from the data format descriptor's basic block
+ */
+static constexpr uint8_t kDfdFlagAlphaPremultiplied = 1u << 0;
+
+/*!
+ * Where the fields used here sit in the data format descriptor: the total size, then the basic
+ * block's vendor/type, version and size words, then its color model and flags bytes
+ */
+static constexpr size_t kDfdColorModelOffset = 12;
+static constexpr size_t kDfdFlagsOffset = 15;
+
+bool Ktx2File::parse(const uint8_t *data, size_t size, Ktx2File &outFile) {
+    size_t headerEnd = sizeof(kIdentifier) + sizeof(Header) + sizeof(Index);
+    if (!data || size < headerEnd || memcmp(data, kIdentifier, sizeof(kIdentifier)) != 0) {
+        return false;
+    }
+
+    Header header;
+    Index index;
+    memcpy(&header, data + sizeof(kIdentifier), sizeof(Header));
+    memcpy(&index, data + sizeof(kIdentifier) + sizeof(Header), sizeof(Index));
+
+    // Plain 2D textures only
+    if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0
+        || header.layerCount != 0 || header.faceCount != 1 || header.levelCount > 32) {
+        return false;
+    }
+
+    // Everything parsed here needs the descriptor's basic block
+    if (index.dfdByteOffset > size || index.dfdByteLength > size - index.dfdByteOffset
+        || index.dfdByteLength <= kDfdFlagsOffset) {
+        return false;
+    }
+
+    auto levelCount = header.levelCount ? header.levelCount : 1;
+    size_t tableEnd = headerEnd + size_t(levelCount) * sizeof(LevelEntry);
+    if (size < tableEnd) {
+        return false;
+    }
+
+    std::vector<Level> levels;
+    levels.reserve(levelCount);
+    for (uint32_t i = 0; i < levelCount; i++) {
+        LevelEntry entry;
+        memcpy(&entry, data + headerEnd + i * sizeof(LevelEntry), sizeof(LevelEntry));
+        if (entry.byteOffset < tableEnd || entry.byteOffset > size
+            || entry.byteLength > size - entry.byteOffset) {
+            return false;
+        }
+        uint32_t levelWidth = header.pixelWidth >> i ? header.pixelWidth >> i : 1;
+        uint32_t levelHeight = header.pixelHeight >> i ? header.pixelHeight >> i : 1;
+        auto uncompressedSize = header.supercompressionScheme == kSupercompressionNone
+                                ? entry.byteLength : entry.uncompressedByteLength;
+        levels.push_back({levelWidth, levelHeight, data + entry.byteOffset,
+                          size_t(entry.byteLength), size_t(uncompressedSize)});
+    }
+
+    const uint8_t *pDfd = data + index.dfdByteOffset;
+    outFile.header_ = header;
+    outFile.colorModel_ = pDfd[kDfdColorModelOffset];
+    outFile.premultipliedAlpha_ = pDfd[kDfdFlagsOffset] & kDfdFlagAlphaPremultiplied;
+    outFile.levels_ = std::move(levels);
+    return true;
+}
+
+std::string Ktx2File::pathFor(const std::string &assetPath) {
+    auto extension = assetPath.find_last_of('.');
+    auto directory = assetPath.find_last_of('/');
+    if (extension == std::string::npos
+        || (directory != std::string::npos && extension < directory)) {
+        return assetPath + kExtension;
+    }
+    return assetPath.substr(0, extension) + kExtension;
+}
+
+bool Ktx2File::getTextureFormat(TextureFormat &outFormat) const {
+    switch (header_.vkFormat) {
+        case kVkFormatR8G8B8A8Unorm:
+            outFormat = TextureFormat::RGBA8;
+            return true;
+        case kVkFormatEtc2R8G8B8UnormBlock:
+            outFormat = TextureFormat::ETC2_RGB8;
+            return true;
+        case kVkFormatEtc2R8G8B8A8UnormBlock:
+            outFormat = TextureFormat::ETC2_RGBA8;
+            return true;
+        case kVkFormatAstc4x4UnormBlock:
+            outFormat = TextureFormat::ASTC_4x4;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Ktx2File::isBasisUniversal() const {
+    return header_.supercompressionScheme == kSupercompressionBasisLZ
+           || colorModel_ == kColorModelEtc1s
+           || colorModel_ == kColorModelUastc;
+}
+
+bool Ktx2File::isUastc() const {
+    return colorModel_ == kColorModelUastc;
+}
@@ -0,0 +1,137 @@
+#ifndef ANDROIDGLINVESTIGATIONS_KTX2FILE_H
+#define ANDROIDGLINVESTIGATIONS_KTX2FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "TextureFormat.h"
+
+/*!
+ * A Khronos KTX2 texture file, read in place. Only 2D textures are accepted, no arrays, cube maps
+ * or 3D textures. All values are little endian.
+ *
+ * Layout:
+ *  - the 12 byte identifier
+ *  - @a Ktx2File::Header
+ *  - @a Ktx2File::Index, locating the data format descriptor and the metadata
+ *  - levelCount x @a Ktx2File::LevelEntry, largest level first
+ *  - the data format descriptor, metadata, supercompression data and level data
+ */
+class Ktx2File {
+public:
+    static constexpr uint8_t kIdentifier[12] = {
+            0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    /*!
+     * The extension KTX2 files use. One next to a source image replaces it at load time.
+     */
+    static constexpr const char *kExtension = ".ktx2";
+
+    enum SupercompressionScheme : uint32_t {
+        kSupercompressionNone = 0,
+        kSupercompressionBasisLZ = 1,
+        kSupercompressionZstd = 2,
+        kSupercompressionZlib = 3,
+    };
+
+    struct Header {
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        // 0 asks for the chain to be generated at load time, there's still one level stored
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+    };
+
+    struct Index {
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct LevelEntry {
+        // from the start of the file
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    /*!
+     * One mip level as a view into the file's memory
+     */
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        const uint8_t *data;
+        size_t size;
+        // the size once the supercompression is undone, the same as @a size without it
+        size_t uncompressedSize;
+    };
+
+    /*!
+     * Reads a file from memory without copying. @a data must outlive the result.
+     * @param data the contents of the file
+     * @param size the size of the file
+     * @param outFile receives the parsed file
+     * @return false if the data isn't a valid 2D KTX2 file
+     */
+    static bool parse(const uint8_t *data, size_t size, Ktx2File &outFile);
+
+    /*!
+     * @param assetPath the path of a source image, ex: "android_robot.png"
+     * @return where a KTX2 version of it would be, ex: "android_robot.ktx2"
+     */
+    static std::string pathFor(const std::string &assetPath);
+
+    /*!
+     * Maps the Vulkan format of the levels to the format they're uploaded in
+     * @param outFormat receives the format
+     * @return false if the levels aren't in a format that can be uploaded as is
+     */
+    bool getTextureFormat(TextureFormat &outFormat) const;
+
+    /*!
+     * @return true if the levels are Basis Universal data, ETC1S or UASTC, that has to be
+     *     transcoded to a GPU format before it can be uploaded
+     */
+    bool isBasisUniversal() const;
+
+    /*!
+     * @return true if the levels are UASTC blocks, which UastcTranscoder transcodes once any
+     *     Zstandard supercompression is undone
+     */
+    bool isUastc() const;
+
+    /*!
+     * @return true if the data format descriptor says the color is multiplied by alpha
+     */
+    inline bool isPremultipliedAlpha() const { return premultipliedAlpha_; }
+
+    inline uint32_t getWidth() const { return header_.pixelWidth; }
+
+    inline uint32_t getHeight() const { return header_.pixelHeight; }
+
+    inline uint32_t getSupercompressionScheme() const { return header_.supercompressionScheme; }
+
+    inline size_t getLevelCount() const { return levels_.size(); }
+
+    inline const Level &getLevel(size_t level) const { return levels_[level]; }
+
+private:
+    Header header_;
+    // the color model from the data format descriptor's basic block
+    uint8_t colorModel_;
+    bool premultipliedAlpha_;
+    std::vector<Level> levels_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_KTX2FILE_H
@@ -0,0 +1,210 @@
+#include "Lz4.h"
+
+#include <cstring>
+
+/*!
+ * The shortest match the format can describe
+ */
+static constexpr size_t kMinMatch = 4;
+
+/*!
+ * The block always ends with at least this many literals
+ */
+static constexpr size_t kLastLiterals = 5;
+
+/*!
+ * No match may start within this many bytes of the end of the block
+ */
+static constexpr size_t kMatchStartLimit = 12;
+
+/*!
+ * How far back a match can reach, offsets are 16 bit
+ */
+static constexpr size_t kMaxOffset = 65535;
+
+static constexpr int kHashBits = 16;
+
+/*!
+ * After this many positions in a row without a match, the search starts skipping ahead, so
+ * incompressible data goes by quickly
+ */
+static constexpr int kSkipTrigger = 6;
+
+/*!
+ * Short copies are done as one fixed size copy of this many bytes when both buffers have room
+ * past the end, which is much cheaper than a copy of variable length
+ */
+static constexpr size_t kFastCopySize = 16;
+
+static inline uint32_t read32(const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hashSequence(uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+/*!
+ * Appends a length that didn't fit in its 4 bits of the token
+ */
+static void writeLengthTail(std::vector<uint8_t> &out, size_t length) {
+    for (; length >= 255; length -= 255) {
+        out.push_back(255);
+    }
+    out.push_back(uint8_t(length));
+}
+
+/*!
+ * Appends a sequence: literals, then a match unless @a matchLength is 0
+ */
+static void writeSequence(
+        std::vector<uint8_t> &out,
+        const uint8_t *literals,
+        size_t literalLength,
+        size_t offset,
+        size_t matchLength) {
+    auto matchCode = matchLength ? matchLength - kMinMatch : 0;
+    out.push_back(uint8_t((literalLength < 15 ? literalLength : 15) << 4
+                          | (matchCode < 15 ? matchCode : 15)));
+    if (literalLength >= 15) {
+        writeLengthTail(out, literalLength - 15);
+    }
+    out.insert(out.end(), literals, literals + literalLength);
+    if (matchLength == 0) {
+        return;
+    }
+    out.push_back(uint8_t(offset));
+    out.push_back(uint8_t(offset >> 8));
+    if (matchCode >= 15) {
+        writeLengthTail(out, matchCode - 15);
+    }
+}
+
+std::vector<uint8_t> Lz4::compress(const uint8_t *data, size_t size) {
+    std::vector<uint8_t> out;
+    out.reserve(getMaxCompressedSize(size));
+
+    size_t anchor = 0;
+    if (size > kMatchStartLimit) {
+        // The most recent position of each hashed 4 byte sequence, plus 1 so 0 means none
+        std::vector<uint32_t> table(size_t(1) << kHashBits, 0);
+        auto matchStartLimit = size - kMatchStartLimit;
+        auto matchEndLimit = size - kLastLiterals;
+        size_t position = 0;
+        size_t misses = 0;
+        while (position < matchStartLimit) {
+            auto sequence = read32(data + position);
+            auto &slot = table[hashSequence(sequence)];
+            size_t candidate = slot;
+            slot = uint32_t(position + 1);
+            if (candidate == 0 || position - (candidate - 1) > kMaxOffset
+                || read32(data + candidate - 1) != sequence) {
+                position += 1 + (misses++ >> kSkipTrigger);
+                continue;
+            }
+            misses = 0;
+
+            auto match = candidate - 1;
+            auto length = kMinMatch;
+            while (position + length < matchEndLimit
+                   && data[match + length] == data[position + length]) {
+                length++;
+            }
+            // The bytes just before often match too, they'd otherwise go out as literals
+            while (position > anchor && match > 0 && data[position - 1] == data[match - 1]) {
+                position--;
+                match--;
+                length++;
+            }
+
+            writeSequence(out, data + anchor, position - anchor, position - match, length);
+            position += length;
+            anchor = position;
+        }
+    }
+    writeSequence(out, data + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+/*!
+ * Reads the rest of a length that filled its 4 bits of the token
+ * @return false if the block ends first
+ */
+static bool readLengthTail(const uint8_t *&in, const uint8_t *end, size_t &length) {
+    uint8_t byte;
+    do {
+        if (in >= end) {
+            return false;
+        }
+        byte = *in++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool Lz4::decompress(const uint8_t *data, size_t size, uint8_t *out, size_t outSize) {
+    auto in = data;
+    auto inEnd = data + size;
+    auto outPosition = out;
+    auto outEnd = out + outSize;
+    while (in < inEnd) {
+        auto token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLengthTail(in, inEnd, literalLength)) {
+            return false;
+        }
+        if (literalLength > size_t(inEnd - in) || literalLength > size_t(outEnd - outPosition)) {
+            return false;
+        }
+        if (literalLength <= kFastCopySize && size_t(inEnd - in) >= kFastCopySize
+            && size_t(outEnd - outPosition) >= kFastCopySize) {
+            memcpy(outPosition, in, kFastCopySize);
+        } else if (literalLength > 0) {
+            memcpy(outPosition, in, literalLength);
+        }
+        in += literalLength;
+        outPosition += literalLength;
+
+        // The last sequence is only literals
+        if (in == inEnd) {
+            break;
+        }
+
+        if (inEnd - in < 2) {
+            return false;
+        }
+        size_t offset = size_t(in[0]) | size_t(in[1]) << 8;
+        in += 2;
+        if (offset == 0 || offset > size_t(outPosition - out)) {
+            return false;
+        }
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLengthTail(in, inEnd, matchLength)) {
+            return false;
+        }
+        matchLength += kMinMatch;
+        if (matchLength > size_t(outEnd - outPosition)) {
+            return false;
+        }
+
+        // A match can overlap what it's writing, repeating a short run, which has to go a byte
+        // at a time
+        auto match = outPosition - offset;
+        if (offset >= kFastCopySize && matchLength <= kFastCopySize
+            && size_t(outEnd - outPosition) >= kFastCopySize) {
+            memcpy(outPosition, match, kFastCopySize);
+            outPosition += matchLength;
+        } else if (offset >= matchLength) {
+            memcpy(outPosition, match, matchLength);
+            outPosition += matchLength;
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                *outPosition++ = *match++;
+            }
+        }
+    }
+    return outPosition == outEnd;
+}
@@ -0,0 +1,39 @@
+#ifndef ANDROIDGLINVESTIGATIONS_LZ4_H
+#define ANDROIDGLINVESTIGATIONS_LZ4_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * LZ4 block compression, compatible with the reference block format so data can be checked with
+ * the lz4 tools. Decompression is fast enough to run at load time, and checks every length and
+ * offset against the buffers so corrupt data can't read or write out of bounds.
+ */
+class Lz4 {
+public:
+    /*!
+     * @return the most a block of @a size bytes can take once compressed
+     */
+    static inline size_t getMaxCompressedSize(size_t size) { return size + size / 255 + 16; }
+
+    /*!
+     * Compresses a block with a greedy single pass match finder
+     * @param data the bytes to compress
+     * @param size how many bytes there are
+     * @return the compressed block
+     */
+    static std::vector<uint8_t> compress(const uint8_t *data, size_t size);
+
+    /*!
+     * Decompresses a block
+     * @param data the compressed block
+     * @param size the size of the compressed block
+     * @param out receives the decompressed bytes
+     * @param outSize the exact size of the decompressed block
+     * @return false if the block is corrupt or doesn't decompress to exactly @a outSize bytes
+     */
+    static bool decompress(const uint8_t *data, size_t size, uint8_t *out, size_t outSize);
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_LZ4_H
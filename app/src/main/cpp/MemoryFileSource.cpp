@@ -0,0 +1,54 @@
+#include "MemoryFileSource.h"
+
+#include <algorithm>
+#include <cstring>
+
+/*!
+ * A file in memory, read straight from the shared contents
+ */
+class MemoryFile : public File {
+public:
+    explicit MemoryFile(std::shared_ptr<const std::vector<uint8_t>> spData)
+            : File(int64_t(spData->size())), spData_(std::move(spData)), position_(0) {}
+
+    const uint8_t *getBuffer() override { return spData_->data(); }
+
+    int64_t read(void *buffer, size_t size) override {
+        auto bytesRead = std::min(size, spData_->size() - position_);
+        memcpy(buffer, spData_->data() + position_, bytesRead);
+        position_ += bytesRead;
+        return int64_t(bytesRead);
+    }
+
+    bool seek(int64_t offset) override {
+        if (offset < 0 || offset > getLength()) {
+            return false;
+        }
+        position_ = size_t(offset);
+        return true;
+    }
+
+private:
+    std::shared_ptr<const std::vector<uint8_t>> spData_;
+    size_t position_;
+};
+
+void MemoryFileSource::add(const std::string &path, std::vector<uint8_t> data) {
+    auto spData = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_[path] = std::move(spData);
+}
+
+void MemoryFileSource::remove(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.erase(path);
+}
+
+std::unique_ptr<File> MemoryFileSource::open(const std::string &path, FileAccess /* access */) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = files_.find(path);
+    if (it == files_.end()) {
+        return nullptr;
+    }
+    return std::make_unique<MemoryFile>(it->second);
+}
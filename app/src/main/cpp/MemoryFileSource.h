@@ -0,0 +1,38 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MEMORYFILESOURCE_H
+#define ANDROIDGLINVESTIGATIONS_MEMORYFILESOURCE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FileSystem.h"
+
+/*!
+ * Files held in memory, for packs that have been read in whole, generated content, and tests.
+ * Buffers point straight at the data, which open files keep alive even after it's replaced.
+ */
+class MemoryFileSource : public FileSource {
+public:
+    /*!
+     * Adds a file, replacing any already at @a path. Safe from any thread.
+     * @param path the path of the file, '/' separated
+     * @param data the contents
+     */
+    void add(const std::string &path, std::vector<uint8_t> data);
+
+    /*!
+     * Removes a file. Files already open keep their contents.
+     */
+    void remove(const std::string &path);
+
+    std::unique_ptr<File> open(const std::string &path, FileAccess access) override;
+
+private:
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const std::vector<uint8_t>>> files_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_MEMORYFILESOURCE_H
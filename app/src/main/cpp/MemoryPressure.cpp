@@ -0,0 +1,128 @@
+#include "MemoryPressure.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unistd.h>
+
+/*!
+ * The trim levels from android.content.ComponentCallbacks2
+ */
+static constexpr int kTrimMemoryRunningModerate = 5;
+static constexpr int kTrimMemoryRunningLow = 10;
+static constexpr int kTrimMemoryRunningCritical = 15;
+static constexpr int kTrimMemoryUiHidden = 20;
+static constexpr int kTrimMemoryBackground = 40;
+static constexpr int kTrimMemoryModerate = 60;
+
+std::atomic<int> MemoryPressure::pendingTier_{-1};
+std::atomic<int> MemoryPressure::wakeFd_{-1};
+
+static void handleSimulationSignal(int) {
+    MemoryPressure::post(TrimTier::Pools);
+}
+
+bool MemoryPressure::tierForTrimLevel(int trimLevel, TrimTier &outTier) {
+    // The background levels sit above the running ones but aren't all more severe, so each range
+    // is checked from the top
+    if (trimLevel >= kTrimMemoryModerate) {
+        // next in line to be killed, give back everything possible
+        outTier = TrimTier::Pools;
+    } else if (trimLevel >= kTrimMemoryBackground) {
+        outTier = TrimTier::UnusedTextures;
+    } else if (trimLevel >= kTrimMemoryUiHidden) {
+        // nothing is on screen, so lower resolution isn't visible
+        outTier = TrimTier::MipLevels;
+    } else if (trimLevel >= kTrimMemoryRunningCritical) {
+        outTier = TrimTier::UnusedTextures;
+    } else if (trimLevel >= kTrimMemoryRunningLow) {
+        outTier = TrimTier::MipLevels;
+    } else if (trimLevel >= kTrimMemoryRunningModerate) {
+        outTier = TrimTier::ScratchBuffers;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void MemoryPressure::post(TrimTier tier) {
+    int pending = pendingTier_.load(std::memory_order_relaxed);
+    while (pending < int(tier)
+           && !pendingTier_.compare_exchange_weak(pending, int(tier), std::memory_order_relaxed)) {
+    }
+
+    // write is safe in a signal handler, unlike waking a condition variable
+    int fd = wakeFd_.load(std::memory_order_relaxed);
+    if (fd >= 0) {
+        uint64_t one = 1;
+        (void) write(fd, &one, sizeof(one));
+    }
+}
+
+void MemoryPressure::postTrimLevel(int trimLevel) {
+    TrimTier tier;
+    if (tierForTrimLevel(trimLevel, tier)) {
+        post(tier);
+    }
+}
+
+bool MemoryPressure::installSimulationSignal(int signalNumber) {
+    struct sigaction action = {};
+    action.sa_handler = handleSimulationSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    return sigaction(signalNumber, &action, nullptr) == 0;
+}
+
+const char *MemoryPressure::getTierName(TrimTier tier) {
+    switch (tier) {
+        case TrimTier::ScratchBuffers:
+            return "scratch buffers";
+        case TrimTier::MipLevels:
+            return "mip levels";
+        case TrimTier::UnusedTextures:
+            return "unused textures";
+        case TrimTier::Pools:
+            return "pools";
+    }
+    return "unknown";
+}
+
+void MemoryPressure::addTrimmer(
+        TrimTier tier,
+        std::string name,
+        Trimmer trimmer,
+        bool deferred) {
+    trimmers_.push_back({tier, std::move(name), std::move(trimmer), deferred});
+
+    // keep the cheapest tiers first, in the order they were added within a tier
+    std::stable_sort(trimmers_.begin(), trimmers_.end(), [](const Entry &a, const Entry &b) {
+        return a.tier < b.tier;
+    });
+}
+
+std::vector<TrimResult> MemoryPressure::trim(TrimTier tier) {
+    std::vector<TrimResult> results;
+    for (auto &entry: trimmers_) {
+        if (entry.tier > tier) {
+            break;
+        }
+        results.push_back({entry.tier, entry.name, entry.trimmer(), entry.deferred});
+    }
+    return results;
+}
+
+void MemoryPressure::setWakeFd(int fd) {
+    wakeFd_.store(fd, std::memory_order_relaxed);
+}
+
+bool MemoryPressure::hasPending() {
+    return pendingTier_.load(std::memory_order_relaxed) >= 0;
+}
+
+std::vector<TrimResult> MemoryPressure::handlePending() {
+    auto pending = pendingTier_.exchange(-1, std::memory_order_relaxed);
+    if (pending < 0) {
+        return {};
+    }
+    return trim(TrimTier(pending));
+}
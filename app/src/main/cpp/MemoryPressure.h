@@ -0,0 +1,138 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MEMORYPRESSURE_H
+#define ANDROIDGLINVESTIGATIONS_MEMORYPRESSURE_H
+
+#include <atomic>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*!
+ * How much to give back when memory runs low, cheapest to recover from first. Trimming at a tier
+ * runs every tier before it too.
+ */
+enum class TrimTier : uint8_t {
+    // CPU side scratch, staging and decode buffers, rebuilt on demand
+    ScratchBuffers,
+    // the top mip levels of streamed textures that aren't being drawn
+    MipLevels,
+    // textures nothing is drawing with any more
+    UnusedTextures,
+    // empty texture arrays and other pooled storage
+    Pools,
+};
+
+/*!
+ * What one trimmer gave back
+ */
+struct TrimResult {
+    TrimTier tier;
+    std::string name;
+    // what the trimmer freed, or for a deferred one what it expects to free over the next frames
+    size_t bytesReclaimed;
+    // true if the memory is only freed later, so @a bytesReclaimed is a target
+    bool deferred;
+};
+
+/*!
+ * Turns platform memory warnings into tiered trimming.
+ *
+ * Whatever owns memory registers a trimmer per tier with @a addTrimmer. Warnings are posted from
+ * any thread with @a post, @a postTrimLevel or a POSIX signal, and the GL thread runs the trimmers
+ * for the highest tier posted when it calls @a handlePending. Posting only touches a lock free
+ * atomic and writes to the wake fd, so it's safe from JNI callbacks and signal handlers alike.
+ * Nothing here depends on Android, so pressure can be simulated on a desktop build with @a post
+ * or the signal.
+ */
+class MemoryPressure {
+public:
+    /*!
+     * Returns the amount of memory freed, in bytes
+     */
+    using Trimmer = std::function<size_t()>;
+
+    /*!
+     * Maps an android.content.ComponentCallbacks2 trim level to a tier
+     * @param trimLevel the level passed to onTrimMemory
+     * @param outTier receives the tier to trim at
+     * @return false if the level doesn't call for trimming
+     */
+    static bool tierForTrimLevel(int trimLevel, TrimTier &outTier);
+
+    /*!
+     * Asks for a trim at @a tier on the next @a handlePending. Safe from any thread and from
+     * signal handlers. Lower tiers posted before the trim runs are folded into the highest one.
+     */
+    static void post(TrimTier tier);
+
+    /*!
+     * @a post for an android.content.ComponentCallbacks2 trim level, ignoring levels that don't
+     * call for trimming
+     */
+    static void postTrimLevel(int trimLevel);
+
+    /*!
+     * Makes a signal post a full trim, so pressure can be simulated from outside the process, ex:
+     * "kill -USR1 <pid>"
+     * @param signalNumber the signal to handle
+     * @return false if the handler couldn't be installed
+     */
+    static bool installSimulationSignal(int signalNumber = SIGUSR1);
+
+    /*!
+     * Makes every post write to an eventfd, so a GL thread sleeping on it wakes up to trim
+     * @param fd the eventfd, -1 for none
+     */
+    static void setWakeFd(int fd);
+
+    /*!
+     * @return true if a trim was posted and @a handlePending hasn't run it yet
+     */
+    static bool hasPending();
+
+    /*!
+     * @return a readable name for logs
+     */
+    static const char *getTierName(TrimTier tier);
+
+    /*!
+     * @param tier the tier the trimmer runs at
+     * @param name used to report what was reclaimed
+     * @param trimmer frees memory and returns how much
+     * @param deferred true if @a trimmer only arranges for memory to be freed over the next frames
+     *     and returns how much it will be
+     */
+    void addTrimmer(TrimTier tier, std::string name, Trimmer trimmer, bool deferred = false);
+
+    /*!
+     * Runs every trimmer at or below @a tier, cheapest tier first
+     * @return what each trimmer reclaimed
+     */
+    std::vector<TrimResult> trim(TrimTier tier);
+
+    /*!
+     * Trims for whatever was posted since the last call. Call on the thread that owns the memory.
+     * @return what each trimmer reclaimed, empty if nothing was posted
+     */
+    std::vector<TrimResult> handlePending();
+
+private:
+    struct Entry {
+        TrimTier tier;
+        std::string name;
+        Trimmer trimmer;
+        bool deferred;
+    };
+
+    std::vector<Entry> trimmers_;
+
+    // the highest tier posted and not yet handled, -1 for none. Shared by the whole process since
+    // the platform callbacks are.
+    static std::atomic<int> pendingTier_;
+    // written to by every post, -1 for none
+    static std::atomic<int> wakeFd_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_MEMORYPRESSURE_H
@@ -23,10 +23,14 @@ union Vector2 {
 
 struct Vertex {
     constexpr Vertex(const Vector3 &inPosition, const Vector2 &inUV) : position(inPosition),
-                                                                       uv(inUV) {}
+                                                                       uv(inUV),
+                                                                       layer(0.f) {}
 
     Vector3 position;
     Vector2 uv;
+    // the texture array layer to sample from, filled in by Model from its texture and refreshed
+    // by SpriteBatcher when drawing
+    float layer;
 };
 
 typedef uint16_t Index;
@@ -36,15 +40,28 @@ public:
     inline Model(
             std::vector<Vertex> vertices,
             std::vector<Index> indices,
-            std::shared_ptr<TextureAsset> spTexture)
+            std::shared_ptr<TextureAsset> spTexture,
+            GLuint sampler = 0)
             : vertices_(std::move(vertices)),
               indices_(std::move(indices)),
-              spTexture_(std::move(spTexture)) {}
+              spTexture_(std::move(spTexture)),
+              sampler_(sampler) {
+        // Every vertex carries its layer so models sharing a texture array can be drawn together
+        if (spTexture_) {
+            for (auto &vertex: vertices_) {
+                vertex.layer = float(spTexture_->getLayer());
+            }
+        }
+    }
 
     inline const Vertex *getVertexData() const {
         return vertices_.data();
     }
 
+    inline size_t getVertexCount() const {
+        return vertices_.size();
+    }
+
     inline const size_t getIndexCount() const {
         return indices_.size();
     }
@@ -57,10 +74,25 @@ public:
         return *spTexture_;
     }
 
+    /*!
+     * @return the texture of this model, or null if it doesn't have one
+     */
+    inline const TextureAsset *getTexturePointer() const {
+        return spTexture_.get();
+    }
+
+    /*!
+     * @return the sampler object to sample the texture with, 0 to use the texture's own state
+     */
+    inline GLuint getSampler() const {
+        return sampler_;
+    }
+
 private:
     std::vector<Vertex> vertices_;
     std::vector<Index> indices_;
     std::shared_ptr<TextureAsset> spTexture_;
+    GLuint sampler_;
 };
 
 #endif //ANDROIDGLINVESTIGATIONS_MODEL_H
\ No newline at end of file
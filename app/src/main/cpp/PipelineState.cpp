@@ -0,0 +1,177 @@
+#include "PipelineState.h"
+
+#include <functional>
+
+#include "Shader.h"
+
+/*!
+ * Mixes @a value into @a seed, the same way boost::hash_combine does
+ */
+template<typename T>
+static void hashCombine(size_t &seed, const T &value) {
+    seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+static void setEnabled(GLenum capability, bool enabled) {
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+}
+
+bool BlendState::operator==(const BlendState &other) const {
+    return enabled == other.enabled
+           && sourceFactor == other.sourceFactor
+           && destinationFactor == other.destinationFactor;
+}
+
+bool DepthState::operator==(const DepthState &other) const {
+    return testEnabled == other.testEnabled
+           && compareFunction == other.compareFunction
+           && writeEnabled == other.writeEnabled;
+}
+
+bool CullState::operator==(const CullState &other) const {
+    return enabled == other.enabled
+           && cullFace == other.cullFace
+           && frontFace == other.frontFace;
+}
+
+bool ColorMask::operator==(const ColorMask &other) const {
+    return red == other.red
+           && green == other.green
+           && blue == other.blue
+           && alpha == other.alpha;
+}
+
+bool PipelineDescription::operator==(const PipelineDescription &other) const {
+    return shader == other.shader
+           && vertexLayout == other.vertexLayout
+           && blend == other.blend
+           && depth == other.depth
+           && cull == other.cull
+           && colorMask == other.colorMask;
+}
+
+size_t PipelineDescription::hash() const {
+    size_t seed = 0;
+    hashCombine(seed, shader);
+    hashCombine(seed, static_cast<uint8_t>(vertexLayout));
+    hashCombine(seed, blend.enabled);
+    hashCombine(seed, blend.sourceFactor);
+    hashCombine(seed, blend.destinationFactor);
+    hashCombine(seed, depth.testEnabled);
+    hashCombine(seed, depth.compareFunction);
+    hashCombine(seed, depth.writeEnabled);
+    hashCombine(seed, cull.enabled);
+    hashCombine(seed, cull.cullFace);
+    hashCombine(seed, cull.frontFace);
+    hashCombine(seed, colorMask.red);
+    hashCombine(seed, colorMask.green);
+    hashCombine(seed, colorMask.blue);
+    hashCombine(seed, colorMask.alpha);
+    return seed;
+}
+
+PipelineDescription PipelineDescription::defaults(const Shader *shader) {
+    return PipelineDescription{
+            shader,
+            VertexLayout::PositionUV,
+            BlendState{false, GL_ONE, GL_ZERO},
+            DepthState{true, GL_LESS, true},
+            CullState{false, GL_BACK, GL_CCW},
+            ColorMask{true, true, true, true}
+    };
+}
+
+const PipelineState *PipelineCache::getOrCreate(const PipelineDescription &description) {
+    auto hash = description.hash();
+    auto range = pipelinesByHash_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second->getDescription() == description) {
+            return it->second;
+        }
+    }
+
+    auto id = static_cast<uint32_t>(pipelines_.size());
+    pipelines_.emplace_back(new PipelineState(id, description));
+    auto *pipeline = pipelines_.back().get();
+    pipelinesByHash_.emplace(hash, pipeline);
+    return pipeline;
+}
+
+void PipelineBinder::bind(const PipelineState &pipeline) {
+    if (stateKnown_ && current_ == &pipeline) {
+        return;
+    }
+
+    const auto &next = pipeline.getDescription();
+    bool all = !stateKnown_;
+
+    if (all || next.shader != state_.shader) {
+        next.shader->activate();
+    }
+
+    if (all || next.blend.enabled != state_.blend.enabled) {
+        setEnabled(GL_BLEND, next.blend.enabled);
+    }
+    if (all
+        || next.blend.sourceFactor != state_.blend.sourceFactor
+        || next.blend.destinationFactor != state_.blend.destinationFactor) {
+        glBlendFunc(next.blend.sourceFactor, next.blend.destinationFactor);
+    }
+
+    if (all || next.depth.testEnabled != state_.depth.testEnabled) {
+        setEnabled(GL_DEPTH_TEST, next.depth.testEnabled);
+    }
+    if (all || next.depth.compareFunction != state_.depth.compareFunction) {
+        glDepthFunc(next.depth.compareFunction);
+    }
+    if (all || next.depth.writeEnabled != state_.depth.writeEnabled) {
+        glDepthMask(next.depth.writeEnabled ? GL_TRUE : GL_FALSE);
+    }
+
+    if (all || next.cull.enabled != state_.cull.enabled) {
+        setEnabled(GL_CULL_FACE, next.cull.enabled);
+    }
+    if (all || next.cull.cullFace != state_.cull.cullFace) {
+        glCullFace(next.cull.cullFace);
+    }
+    if (all || next.cull.frontFace != state_.cull.frontFace) {
+        glFrontFace(next.cull.frontFace);
+    }
+
+    if (all || !(next.colorMask == state_.colorMask)) {
+        glColorMask(
+                next.colorMask.red ? GL_TRUE : GL_FALSE,
+                next.colorMask.green ? GL_TRUE : GL_FALSE,
+                next.colorMask.blue ? GL_TRUE : GL_FALSE,
+                next.colorMask.alpha ? GL_TRUE : GL_FALSE);
+    }
+
+    state_ = next;
+    current_ = &pipeline;
+    stateKnown_ = true;
+}
+
+void PipelineBinder::invalidate() {
+    current_ = nullptr;
+    stateKnown_ = false;
+}
+
+void PipelineBinder::prepareForClear() {
+    if (!stateKnown_ || !state_.depth.writeEnabled) {
+        glDepthMask(GL_TRUE);
+    }
+    ColorMask all{true, true, true, true};
+    if (!stateKnown_ || !(state_.colorMask == all)) {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    }
+    if (stateKnown_) {
+        state_.depth.writeEnabled = true;
+        state_.colorMask = all;
+        // The masks no longer match the bound pipeline, so rebinding it has to do some work
+        current_ = nullptr;
+    }
+}
@@ -0,0 +1,169 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PIPELINESTATE_H
+#define ANDROIDGLINVESTIGATIONS_PIPELINESTATE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <GLES3/gl3.h>
+
+class Shader;
+
+/*!
+ * The vertex layouts a pipeline can be drawn with. They all read from @a Vertex, but differ in which
+ * of its attributes the shader consumes.
+ */
+enum class VertexLayout : uint8_t {
+    PositionUV,
+    PositionUVLayer
+};
+
+struct BlendState {
+    bool enabled;
+    GLenum sourceFactor;
+    GLenum destinationFactor;
+
+    bool operator==(const BlendState &other) const;
+};
+
+struct DepthState {
+    bool testEnabled;
+    GLenum compareFunction;
+    bool writeEnabled;
+
+    bool operator==(const DepthState &other) const;
+};
+
+struct CullState {
+    bool enabled;
+    GLenum cullFace;
+    GLenum frontFace;
+
+    bool operator==(const CullState &other) const;
+};
+
+struct ColorMask {
+    bool red;
+    bool green;
+    bool blue;
+    bool alpha;
+
+    bool operator==(const ColorMask &other) const;
+};
+
+/*!
+ * Everything needed to describe a @a PipelineState. Fill one of these out and hand it to
+ * @a PipelineCache::getOrCreate.
+ */
+struct PipelineDescription {
+    const Shader *shader;
+    VertexLayout vertexLayout;
+    BlendState blend;
+    DepthState depth;
+    CullState cull;
+    ColorMask colorMask;
+
+    bool operator==(const PipelineDescription &other) const;
+
+    /*!
+     * @return a hash of every field in the description
+     */
+    size_t hash() const;
+
+    /*!
+     * @return a description with no blending, depth testing with GL_LESS, no culling and all color
+     *     channels written. Change whatever fields you need from here.
+     */
+    static PipelineDescription defaults(const Shader *shader);
+};
+
+/*!
+ * An immutable bundle of a shader program, vertex layout and the fixed function state it is drawn
+ * with. Pipelines are created up front through a @a PipelineCache, so two pipelines with the same
+ * description are the same object and can be compared or sorted by @a getId alone.
+ */
+class PipelineState {
+public:
+    /*!
+     * @return a small id unique within the owning cache, usable as a sort key
+     */
+    constexpr uint32_t getId() const { return id_; }
+
+    constexpr const PipelineDescription &getDescription() const { return description_; }
+
+    constexpr size_t getHash() const { return hash_; }
+
+private:
+    friend class PipelineCache;
+
+    PipelineState(uint32_t id, const PipelineDescription &description)
+            : id_(id),
+              description_(description),
+              hash_(description.hash()) {}
+
+    uint32_t id_;
+    PipelineDescription description_;
+    size_t hash_;
+};
+
+/*!
+ * Owns every @a PipelineState the renderer uses and hands out the same instance for equal
+ * descriptions. Pointers stay valid for the lifetime of the cache.
+ */
+class PipelineCache {
+public:
+    /*!
+     * @param description the state to look up
+     * @return the pipeline for @a description, creating it on first use
+     */
+    const PipelineState *getOrCreate(const PipelineDescription &description);
+
+    inline size_t size() const { return pipelines_.size(); }
+
+private:
+    std::vector<std::unique_ptr<PipelineState>> pipelines_;
+    std::unordered_multimap<size_t, const PipelineState *> pipelinesByHash_;
+};
+
+/*!
+ * Applies pipelines to the GL context, touching only the state that differs from the pipeline that
+ * was bound before it. If anything outside of the binder changes GL state, call @a invalidate so
+ * the next bind applies everything.
+ */
+class PipelineBinder {
+public:
+    inline PipelineBinder()
+            : current_(nullptr),
+              stateKnown_(false),
+              state_(PipelineDescription::defaults(nullptr)) {}
+
+    /*!
+     * Makes @a pipeline current, including activating its shader
+     * @param pipeline the pipeline to bind
+     */
+    void bind(const PipelineState &pipeline);
+
+    /*!
+     * Forgets the tracked state, forcing the next @a bind to set everything
+     */
+    void invalidate();
+
+    /*!
+     * glClear honours the depth and color masks, so make sure they're fully enabled before
+     * clearing. The tracked state is updated to match.
+     */
+    void prepareForClear();
+
+    /*!
+     * @return the pipeline that was last bound, or null
+     */
+    constexpr const PipelineState *getCurrent() const { return current_; }
+
+private:
+    const PipelineState *current_;
+    bool stateKnown_;
+    PipelineDescription state_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PIPELINESTATE_H
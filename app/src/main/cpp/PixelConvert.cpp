@@ -0,0 +1,360 @@
+#include "PixelConvert.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON)
+
+/*!
+ * Divides each lane by 255 with rounding, the vector form of @a PixelConvert::divideBy255
+ */
+static inline uint16x8_t divideLanesBy255(uint16x8_t value) {
+    return vrshrq_n_u16(vaddq_u16(value, vrshrq_n_u16(value, 8)), 8);
+}
+
+/*!
+ * Quantizes each lane of an 8 bit channel widened to 16 bits
+ */
+static inline uint16x8_t quantizeLanes(uint16x8_t channel, uint16_t maxValue) {
+    return divideLanesBy255(vmulq_n_u16(channel, maxValue));
+}
+
+#elif defined(__SSE2__)
+
+/*!
+ * Quantizes 8 bit channel values held in the low half of each 32 bit lane. The high halves stay
+ * zero throughout, so 16 bit arithmetic is safe to use on the 32 bit lanes.
+ */
+static inline __m128i quantizeLanes(__m128i channel, int maxValue) {
+    __m128i value = _mm_add_epi32(
+            _mm_mullo_epi16(channel, _mm_set1_epi32(maxValue)),
+            _mm_set1_epi32(128));
+    return _mm_srli_epi32(_mm_add_epi32(value, _mm_srli_epi32(value, 8)), 8);
+}
+
+/*!
+ * Narrows two vectors of 32 bit lanes holding values up to 0xFFFF into one vector of 16 bit lanes.
+ * SSE2 only has a signed pack, so the values are biased into signed range and back.
+ */
+static inline __m128i packUnsigned32To16(__m128i low, __m128i high) {
+    const __m128i bias32 = _mm_set1_epi32(0x8000);
+    const __m128i bias16 = _mm_set1_epi16(short(0x8000));
+    return _mm_xor_si128(
+            _mm_packs_epi32(_mm_sub_epi32(low, bias32), _mm_sub_epi32(high, bias32)),
+            bias16);
+}
+
+/*!
+ * Splits 4 RGBA8 pixels into one vector per channel, each value in the low byte of a 32 bit lane
+ */
+static inline void splitChannels(__m128i pixels, __m128i &r, __m128i &g, __m128i &b, __m128i &a) {
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    r = _mm_and_si128(pixels, byteMask);
+    g = _mm_and_si128(_mm_srli_epi32(pixels, 8), byteMask);
+    b = _mm_and_si128(_mm_srli_epi32(pixels, 16), byteMask);
+    a = _mm_srli_epi32(pixels, 24);
+}
+
+#endif
+
+void PixelConvert::premultiplyAlpha(uint8_t *rgba, size_t pixelCount) {
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= pixelCount; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(rgba + i * 4);
+        for (int channel = 0; channel < 3; channel++) {
+            uint16x8_t low = vmull_u8(
+                    vget_low_u8(pixels.val[channel]), vget_low_u8(pixels.val[3]));
+            uint16x8_t high = vmull_u8(
+                    vget_high_u8(pixels.val[channel]), vget_high_u8(pixels.val[3]));
+            pixels.val[channel] = vcombine_u8(
+                    vmovn_u16(divideLanesBy255(low)),
+                    vmovn_u16(divideLanesBy255(high)));
+        }
+        vst4q_u8(rgba + i * 4, pixels);
+    }
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(128);
+    // multiply color by alpha, and alpha by 255 so it comes back unchanged
+    const __m128i alphaLanes = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+    const __m128i alphaFactor = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    for (; i + 4 <= pixelCount; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + i * 4));
+        __m128i halves[2] = {_mm_unpacklo_epi8(pixels, zero), _mm_unpackhi_epi8(pixels, zero)};
+        for (auto &half: halves) {
+            __m128i alpha = _mm_shufflehi_epi16(
+                    _mm_shufflelo_epi16(half, _MM_SHUFFLE(3, 3, 3, 3)),
+                    _MM_SHUFFLE(3, 3, 3, 3));
+            alpha = _mm_or_si128(_mm_andnot_si128(alphaLanes, alpha), alphaFactor);
+            __m128i value = _mm_add_epi16(_mm_mullo_epi16(half, alpha), rounding);
+            half = _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+        }
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(rgba + i * 4),
+                _mm_packus_epi16(halves[0], halves[1]));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        uint8_t *pixel = rgba + i * 4;
+        uint8_t alpha = pixel[3];
+        pixel[0] = divideBy255(pixel[0] * alpha);
+        pixel[1] = divideBy255(pixel[1] * alpha);
+        pixel[2] = divideBy255(pixel[2] * alpha);
+    }
+}
+
+void PixelConvert::packRGB565(const uint8_t *rgba, uint16_t *out, size_t pixelCount) {
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= pixelCount; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(rgba + i * 4);
+        for (int half = 0; half < 2; half++) {
+            auto widen = [half](uint8x16_t channel) {
+                return vmovl_u8(half ? vget_high_u8(channel) : vget_low_u8(channel));
+            };
+            uint16x8_t r = quantizeLanes(widen(pixels.val[0]), 31);
+            uint16x8_t g = quantizeLanes(widen(pixels.val[1]), 63);
+            uint16x8_t b = quantizeLanes(widen(pixels.val[2]), 31);
+            uint16x8_t packed = vorrq_u16(
+                    vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), b);
+            vst1q_u16(out + i + half * 8, packed);
+        }
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= pixelCount; i += 8) {
+        __m128i packed[2];
+        for (int half = 0; half < 2; half++) {
+            __m128i r, g, b, a;
+            splitChannels(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + (i + half * 4) * 4)),
+                    r, g, b, a);
+            packed[half] = _mm_or_si128(
+                    _mm_or_si128(_mm_slli_epi32(quantizeLanes(r, 31), 11),
+                                 _mm_slli_epi32(quantizeLanes(g, 63), 5)),
+                    quantizeLanes(b, 31));
+        }
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(out + i),
+                packUnsigned32To16(packed[0], packed[1]));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        const uint8_t *pixel = rgba + i * 4;
+        out[i] = uint16_t(quantize(pixel[0], 5) << 11
+                          | quantize(pixel[1], 6) << 5
+                          | quantize(pixel[2], 5));
+    }
+}
+
+void PixelConvert::packRGBA4444(const uint8_t *rgba, uint16_t *out, size_t pixelCount) {
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= pixelCount; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(rgba + i * 4);
+        for (int half = 0; half < 2; half++) {
+            auto widen = [half](uint8x16_t channel) {
+                return vmovl_u8(half ? vget_high_u8(channel) : vget_low_u8(channel));
+            };
+            uint16x8_t r = quantizeLanes(widen(pixels.val[0]), 15);
+            uint16x8_t g = quantizeLanes(widen(pixels.val[1]), 15);
+            uint16x8_t b = quantizeLanes(widen(pixels.val[2]), 15);
+            uint16x8_t a = quantizeLanes(widen(pixels.val[3]), 15);
+            uint16x8_t packed = vorrq_u16(
+                    vorrq_u16(vshlq_n_u16(r, 12), vshlq_n_u16(g, 8)),
+                    vorrq_u16(vshlq_n_u16(b, 4), a));
+            vst1q_u16(out + i + half * 8, packed);
+        }
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= pixelCount; i += 8) {
+        __m128i packed[2];
+        for (int half = 0; half < 2; half++) {
+            __m128i r, g, b, a;
+            splitChannels(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + (i + half * 4) * 4)),
+                    r, g, b, a);
+            packed[half] = _mm_or_si128(
+                    _mm_or_si128(_mm_slli_epi32(quantizeLanes(r, 15), 12),
+                                 _mm_slli_epi32(quantizeLanes(g, 15), 8)),
+                    _mm_or_si128(_mm_slli_epi32(quantizeLanes(b, 15), 4),
+                                 quantizeLanes(a, 15)));
+        }
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(out + i),
+                packUnsigned32To16(packed[0], packed[1]));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        const uint8_t *pixel = rgba + i * 4;
+        out[i] = uint16_t(quantize(pixel[0], 4) << 12
+                          | quantize(pixel[1], 4) << 8
+                          | quantize(pixel[2], 4) << 4
+                          | quantize(pixel[3], 4));
+    }
+}
+
+void PixelConvert::packRGB5A1(const uint8_t *rgba, uint16_t *out, size_t pixelCount) {
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= pixelCount; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(rgba + i * 4);
+        for (int half = 0; half < 2; half++) {
+            auto widen = [half](uint8x16_t channel) {
+                return vmovl_u8(half ? vget_high_u8(channel) : vget_low_u8(channel));
+            };
+            uint16x8_t r = quantizeLanes(widen(pixels.val[0]), 31);
+            uint16x8_t g = quantizeLanes(widen(pixels.val[1]), 31);
+            uint16x8_t b = quantizeLanes(widen(pixels.val[2]), 31);
+            uint16x8_t a = vshrq_n_u16(widen(pixels.val[3]), 7);
+            uint16x8_t packed = vorrq_u16(
+                    vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 6)),
+                    vorrq_u16(vshlq_n_u16(b, 1), a));
+            vst1q_u16(out + i + half * 8, packed);
+        }
+    }
+#elif defined(__SSE2__)
+    for (; i + 8 <= pixelCount; i += 8) {
+        __m128i packed[2];
+        for (int half = 0; half < 2; half++) {
+            __m128i r, g, b, a;
+            splitChannels(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + (i + half * 4) * 4)),
+                    r, g, b, a);
+            packed[half] = _mm_or_si128(
+                    _mm_or_si128(_mm_slli_epi32(quantizeLanes(r, 31), 11),
+                                 _mm_slli_epi32(quantizeLanes(g, 31), 6)),
+                    _mm_or_si128(_mm_slli_epi32(quantizeLanes(b, 31), 1),
+                                 _mm_srli_epi32(a, 7)));
+        }
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(out + i),
+                packUnsigned32To16(packed[0], packed[1]));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        const uint8_t *pixel = rgba + i * 4;
+        out[i] = uint16_t(quantize(pixel[0], 5) << 11
+                          | quantize(pixel[1], 5) << 6
+                          | quantize(pixel[2], 5) << 1
+                          | (pixel[3] >> 7));
+    }
+}
+
+void PixelConvert::swizzle4(
+        const uint8_t *in,
+        uint8_t *out,
+        size_t pixelCount,
+        const uint8_t order[4]) {
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= pixelCount; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(in + i * 4);
+        uint8x16x4_t swizzled;
+        swizzled.val[0] = pixels.val[order[0]];
+        swizzled.val[1] = pixels.val[order[1]];
+        swizzled.val[2] = pixels.val[order[2]];
+        swizzled.val[3] = pixels.val[order[3]];
+        vst4q_u8(out + i * 4, swizzled);
+    }
+#elif defined(__SSSE3__)
+    alignas(16) uint8_t shuffleBytes[16];
+    for (int pixel = 0; pixel < 4; pixel++) {
+        for (int channel = 0; channel < 4; channel++) {
+            shuffleBytes[pixel * 4 + channel] = uint8_t(pixel * 4 + order[channel]);
+        }
+    }
+    const __m128i shuffle = _mm_load_si128(reinterpret_cast<const __m128i *>(shuffleBytes));
+    for (; i + 4 <= pixelCount; i += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 4));
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(out + i * 4),
+                _mm_shuffle_epi8(pixels, shuffle));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        uint8_t pixel[4] = {in[i * 4], in[i * 4 + 1], in[i * 4 + 2], in[i * 4 + 3]};
+        out[i * 4] = pixel[order[0]];
+        out[i * 4 + 1] = pixel[order[1]];
+        out[i * 4 + 2] = pixel[order[2]];
+        out[i * 4 + 3] = pixel[order[3]];
+    }
+}
+
+void PixelConvert::extractR8(const uint8_t *rgba, uint8_t *out, size_t pixelCount) {
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= pixelCount; i += 16) {
+        vst1q_u8(out + i, vld4q_u8(rgba + i * 4).val[0]);
+    }
+#elif defined(__SSE2__)
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    for (; i + 16 <= pixelCount; i += 16) {
+        __m128i words[4];
+        for (int quarter = 0; quarter < 4; quarter++) {
+            words[quarter] = _mm_and_si128(
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(rgba + (i + quarter * 4) * 4)),
+                    byteMask);
+        }
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(out + i),
+                _mm_packus_epi16(
+                        _mm_packs_epi32(words[0], words[1]),
+                        _mm_packs_epi32(words[2], words[3])));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        out[i] = rgba[i * 4];
+    }
+}
+
+void PixelConvert::extractRA8(const uint8_t *rgba, uint8_t *out, size_t pixelCount) {
+    size_t i = 0;
+#if defined(__ARM_NEON)
+    for (; i + 16 <= pixelCount; i += 16) {
+        uint8x16x4_t pixels = vld4q_u8(rgba + i * 4);
+        uint8x16x2_t redAlpha;
+        redAlpha.val[0] = pixels.val[0];
+        redAlpha.val[1] = pixels.val[3];
+        vst2q_u8(out + i * 2, redAlpha);
+    }
+#elif defined(__SSE2__)
+    const __m128i redMask = _mm_set1_epi32(0xFF);
+    const __m128i alphaMask = _mm_set1_epi32(0xFF00);
+    for (; i + 8 <= pixelCount; i += 8) {
+        __m128i words[2];
+        for (int half = 0; half < 2; half++) {
+            __m128i pixels = _mm_loadu_si128(
+                    reinterpret_cast<const __m128i *>(rgba + (i + half * 4) * 4));
+            words[half] = _mm_or_si128(
+                    _mm_and_si128(pixels, redMask),
+                    _mm_and_si128(_mm_srli_epi32(pixels, 16), alphaMask));
+        }
+        _mm_storeu_si128(
+                reinterpret_cast<__m128i *>(out + i * 2),
+                packUnsigned32To16(words[0], words[1]));
+    }
+#endif
+    for (; i < pixelCount; i++) {
+        out[i * 2] = rgba[i * 4];
+        out[i * 2 + 1] = rgba[i * 4 + 3];
+    }
+}
+
+const char *PixelConvert::getImplementationName() {
+#if defined(__ARM_NEON)
+    return "NEON";
+#elif defined(__SSSE3__)
+    return "SSSE3";
+#elif defined(__SSE2__)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
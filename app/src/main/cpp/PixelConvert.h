@@ -0,0 +1,77 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PIXELCONVERT_H
+#define ANDROIDGLINVESTIGATIONS_PIXELCONVERT_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * Pixel processing kernels that sit between the image decoder and the GL upload. Each kernel has a
+ * NEON version for arm devices, an SSE2 version for x86 emulators and hosts, and a scalar fallback.
+ * All versions produce exactly the same output.
+ *
+ * Channel values are rounded, not truncated, when narrowed. Packed 16 bit formats are written in
+ * native endianness, which is what GL expects for the GL_UNSIGNED_SHORT_* types.
+ */
+class PixelConvert {
+public:
+    /*!
+     * Multiplies the color channels of straight alpha RGBA8 pixels by their alpha, in place
+     * @param rgba the pixels to premultiply
+     * @param pixelCount how many pixels @a rgba holds
+     */
+    static void premultiplyAlpha(uint8_t *rgba, size_t pixelCount);
+
+    /*!
+     * Packs RGBA8 pixels to RGB565, dropping alpha
+     */
+    static void packRGB565(const uint8_t *rgba, uint16_t *out, size_t pixelCount);
+
+    /*!
+     * Packs RGBA8 pixels to RGBA4444
+     */
+    static void packRGBA4444(const uint8_t *rgba, uint16_t *out, size_t pixelCount);
+
+    /*!
+     * Packs RGBA8 pixels to RGB5_A1. Alpha becomes 1 when it's at least 128.
+     */
+    static void packRGB5A1(const uint8_t *rgba, uint16_t *out, size_t pixelCount);
+
+    /*!
+     * Reorders the channels of 4 channel pixels, ex: {2, 1, 0, 3} turns BGRA into RGBA. @a in and
+     * @a out may be the same buffer.
+     * @param order for each output channel, the input channel to take it from
+     */
+    static void swizzle4(const uint8_t *in, uint8_t *out, size_t pixelCount, const uint8_t order[4]);
+
+    /*!
+     * Copies the red channel of RGBA8 pixels, for R8 textures
+     */
+    static void extractR8(const uint8_t *rgba, uint8_t *out, size_t pixelCount);
+
+    /*!
+     * Copies the red and alpha channels of RGBA8 pixels, for grayscale + alpha RG8 textures
+     */
+    static void extractRA8(const uint8_t *rgba, uint8_t *out, size_t pixelCount);
+
+    /*!
+     * Rounds an 8 bit channel to @a bits bits, the same way the packing kernels do
+     */
+    static inline uint8_t quantize(uint8_t value, int bits) {
+        return divideBy255(value * ((1 << bits) - 1));
+    }
+
+    /*!
+     * @return @a value / 255 rounded to the nearest integer, exact for any product of two bytes
+     */
+    static inline uint8_t divideBy255(uint32_t value) {
+        value += 128;
+        return uint8_t((value + (value >> 8)) >> 8);
+    }
+
+    /*!
+     * @return the name of the kernels compiled in, for logging and benchmarks
+     */
+    static const char *getImplementationName();
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_PIXELCONVERT_H
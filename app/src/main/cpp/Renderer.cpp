@@ -2,12 +2,21 @@
 
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 #include <GLES3/gl3.h>
+#include <algorithm>
+#include <cstring>
 #include <memory>
 #include <vector>
 #include <android/imagedecoder.h>
+#include <android/looper.h>
 
+#include "AndroidAssetFileSource.h"
 #include "AndroidOut.h"
+#include "AssetPack.h"
+#include "DirectoryFileSource.h"
+#include "Hash.h"
 #include "Shader.h"
+#include "ShaderWarmup.h"
+#include "TextureArray.h"
 #include "Utility.h"
 #include "TextureAsset.h"
 
@@ -43,29 +52,35 @@ aout << std::endl;\
 static const char *vertex = R"vertex(#version 300 es
 in vec3 inPosition;
 in vec2 inUV;
+in float inLayer;
 
 out vec2 fragUV;
+flat out float fragLayer;
 
 uniform mat4 uProjection;
 
 void main() {
     fragUV = inUV;
+    fragLayer = inLayer;
     gl_Position = uProjection * vec4(inPosition, 1.0);
 }
 )vertex";
 
-// Fragment shader, you'd typically load this from assets
+// Fragment shader, you'd typically load this from assets. Sprites live in texture arrays so that
+// different images of the same size can be drawn in one draw call.
 static const char *fragment = R"fragment(#version 300 es
 precision mediump float;
+precision mediump sampler2DArray;
 
 in vec2 fragUV;
+flat in float fragLayer;
 
-uniform sampler2D uTexture;
+uniform sampler2DArray uTexture;
 
 out vec4 outColor;
 
 void main() {
-    outColor = texture(uTexture, fragUV);
+    outColor = texture(uTexture, vec3(fragUV, fragLayer));
 }
 )fragment";
 
@@ -112,7 +127,74 @@ static constexpr float kProjectionNearPlane = -1.f;
  */
 static constexpr float kProjectionFarPlane = 1.f;
 
+/*!
+ * The largest size, in world units, a robot is ever drawn at. The one from createModels covers
+ * the full 2x2 square. Robot textures never need more pixels than this covers on screen.
+ */
+static constexpr float kRobotMaxWorldSize = 2.f;
+
+/*!
+ * How long each frame may spend streaming texture data to the GPU, in milliseconds. Loading new
+ * art spreads over more frames instead of making one frame late.
+ */
+static constexpr float kTextureUploadBudgetMilliseconds = 2.f;
+
+/*!
+ * How long to go without a memory warning before streamed textures get their dropped mip levels
+ * back
+ */
+static constexpr std::chrono::seconds kMipTrimRecoveryTime{30};
+
+/*!
+ * How many frames a streamed texture has to go undrawn before a memory warning may drop its mip
+ * levels
+ */
+static constexpr uint64_t kMipTrimIdleFrames = 120;
+
+/*!
+ * How much disk the packed texture cache may use, the least recently used entries go first
+ */
+static constexpr size_t kTextureDiskCacheMaxBytes = 64 * 1024 * 1024;
+
+/*!
+ * How many of the slowest files to log once the scene has loaded
+ */
+static constexpr size_t kLoggedFileIoStats = 5;
+
+/*!
+ * The asset pack tools/packtool builds, mounted over the loose assets when it's in the APK
+ */
+static constexpr const char *kAssetPackPath = "assets.mpak";
+
 Renderer::~Renderer() {
+    // Loads still in flight finish early, and run their last steps here while everything they
+    // touch is still alive
+    textureLoadCancellation_.cancel();
+    jobSystem_.wait(pendingTextureLoads_);
+
+    // Free what the scene holds while the context is still current, the context takes whatever
+    // is left with it
+    if (context_ != EGL_NO_CONTEXT) {
+        models_.clear();
+        modelsRed_.clear();
+        shader_.reset();
+        shaderRed_.reset();
+        textureCache_.eraseIf([](const std::string &, const std::shared_ptr<TextureAsset> &) {
+            return true;
+        });
+        textureContentIndex_.clear();
+        textureUploadQueue_.releaseGlObjects();
+        // Released layers go back to their arrays once the GPU is done, then the empty arrays go
+        gpuDeletionQueue_.flush();
+        textureArrayPool_.trim();
+        gpuDeletionQueue_.flush();
+    }
+
+    if (completionQueue_.getFd() >= 0) {
+        MemoryPressure::setWakeFd(-1);
+        ALooper_removeFd(ALooper_forThread(), completionQueue_.getFd());
+    }
+
     if (display_ != EGL_NO_DISPLAY) {
         eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
         if (context_ != EGL_NO_CONTEXT) {
@@ -128,7 +210,18 @@ Renderer::~Renderer() {
     }
 }
 
+int Renderer::getDecodeThreadCount() {
+    return std::max(DecodePool::getBigCoreCount() / 2, 1);
+}
+
+int Renderer::getJobWorkerCount() {
+    // The render thread runs jobs too, while it waits and in runMainThreadJobs
+    return std::max(DecodePool::getBigCoreCount() - getDecodeThreadCount() - 1, 0);
+}
+
 void Renderer::render() {
+    redrawRequested_ = false;
+
     // Check to see if the surface has changed size. This is _necessary_ to do every frame when
     // using immersive mode as you'll get no other notification that your renderable area has
     // changed.
@@ -159,28 +252,44 @@ void Renderer::render() {
         shaderRed_->setProjectionMatrix(projectionMatrix);
         shaderRed_->deactivate();
 
+        // The program was changed behind the binder's back
+        pipelineBinder_.invalidate();
+
         // make sure the matrix isn't generated every frame
         shaderNeedsNewProjectionMatrix_ = false;
     }
 
+    handleMemoryPressure();
+
+    // GL work handed back by jobs since the last frame
+    jobSystem_.runMainThreadJobs();
+
+    // Stream in a slice of any textures that are still loading
+    textureStreamer_.update();
+    textureUploadQueue_.process();
+
+    // Delete what the GPU finished with a few frames ago
+    gpuDeletionQueue_.process();
+
     // clear the color buffer
+    pipelineBinder_.prepareForClear();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     if(!modelsRed_.empty()) {
-        shaderRed_->activate();
+        pipelineBinder_.bind(*backgroundPipeline_);
         for (const auto &model: modelsRed_) {
             shaderRed_->drawModel(model);
         }
-        shaderRed_->deactivate();
     }
     //order is critical for alpha blending
     if (!models_.empty()) {
-        shader_->activate();
-        for (const auto &model: models_) {
-            shader_->drawModel(model);
-        }
-        shader_->deactivate();
+        pipelineBinder_.bind(*spritePipeline_);
+        spriteBatcher_.draw(*shader_, models_, frameCount_);
     }
+    frameCount_++;
+
+    // Anything released from here on waits for this frame's draws
+    gpuDeletionQueue_.endFrame();
 
     // Present the rendered image. This is an implicit glFlush.
     auto swapResult = eglSwapBuffers(display_, surface_);
@@ -251,41 +360,157 @@ void Renderer::initRenderer() {
     surface_ = surface;
     context_ = context;
 
-    // make width and height invalid so it gets updated the first frame in @a updateRenderArea()
+    // make width and height invalid so they get updated by @a updateRenderArea(). It's called right
+    // away since texture loading needs to know how big the surface is.
     width_ = -1;
     height_ = -1;
+    updateRenderArea();
 
     PRINT_GL_STRING(GL_VENDOR);
     PRINT_GL_STRING(GL_RENDERER);
     PRINT_GL_STRING(GL_VERSION);
     PRINT_GL_STRING_AS_LIST(GL_EXTENSIONS);
 
-    shader_ = std::unique_ptr<Shader>(
-            Shader::loadShader(vertex, fragment, "inPosition", "inUV", "uProjection"));
-    assert(shader_);
-
-    shaderRed_ = std::unique_ptr<Shader>(
-            Shader::loadShader(vertexRed, fragmentSolidRed, "inPosition", "", "uProjection"));
-    assert(shaderRed_);
+    // Submit every program up front. Nothing here waits on the driver, so the compiles overlap
+    // with the texture loading in createModels below.
+    Shader::enableParallelCompile();
+    auto pendingShader = Shader::loadShaderAsync(
+            vertex, fragment, "inPosition", "inUV", "uProjection", "inLayer");
+    assert(pendingShader);
 
+    auto pendingShaderRed = Shader::loadShaderAsync(
+            vertexRed, fragmentSolidRed, "inPosition", "", "uProjection");
+    assert(pendingShaderRed);
 
     // setup any other gl related global states
     glClearColor(255.f, 255.f, 255.f, 0.f);
 
-    // enable alpha globally for now, you probably don't want to do this in a game
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    // every sprite is sampled the same way for now
+    spriteSampler_ = samplerCache_.get(SamplerDescription::trilinearClamp());
+    textureUploadQueue_.setBudget(kTextureUploadBudgetMilliseconds);
+    registerMemoryTrimmers();
 
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glDepthMask(GL_TRUE);
-    aout << "Depth testing enabled." << std::endl;
+    mountFileSystem();
+
+    // formats chosen for textures on earlier runs, so they don't have to be analyzed again
+    auto textureMetadataPath = getTextureMetadataPath();
+    if (!textureMetadataPath.empty()) {
+        textureMetadata_.load(textureMetadataPath);
+    }
+
+    // packed textures from earlier runs. Entries are tied to this GPU and driver, since an update
+    // can change which formats work.
+    auto textureCacheDirectory = getTextureCacheDirectory();
+    if (!textureCacheDirectory.empty()) {
+        std::string deviceSignature;
+        for (auto name: {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+            deviceSignature += reinterpret_cast<const char *>(glGetString(name));
+            deviceSignature += '\n';
+        }
+        textureDiskCache_ = TextureDiskCache::create(textureCacheDirectory, deviceSignature);
+        if (textureDiskCache_) {
+            textureDiskCache_->prune(kTextureDiskCacheMaxBytes);
+        }
+    }
 
     // get some demo models into memory
     counter=0.0001f;
     createModels();
     createBackground();
     counter += 0.00001f;
+
+    if (!textureMetadataPath.empty()) {
+        textureMetadata_.save(textureMetadataPath);
+    }
+
+    // what startup read and in which order, for the next asset pack to be laid out by
+    auto assetAccessOrderPath = getAssetAccessOrderPath();
+    if (!assetAccessOrderPath.empty() && !fileSystem_.saveAccessOrder(assetAccessOrderPath)) {
+        aout << "Failed to save the asset access order to " << assetAccessOrderPath << std::endl;
+    }
+
+    // The textures are loaded, now wait for whatever shader work the driver has left
+    shader_ = pendingShader->take();
+    assert(shader_);
+
+    shaderRed_ = pendingShaderRed->take();
+    assert(shaderRed_);
+
+    // Build every pipeline up front. The background is opaque so it doesn't need blending, the
+    // sprites are alpha blended. Sprite textures are premultiplied when they're loaded, so they
+    // blend with GL_ONE. Both depth test with GL_LESS.
+    auto backgroundDescription = PipelineDescription::defaults(shaderRed_.get());
+    backgroundPipeline_ = pipelineCache_.getOrCreate(backgroundDescription);
+
+    auto spriteDescription = PipelineDescription::defaults(shader_.get());
+    spriteDescription.vertexLayout = VertexLayout::PositionUVLayer;
+    spriteDescription.blend = BlendState{true, GL_ONE, GL_ONE_MINUS_SRC_ALPHA};
+    spritePipeline_ = pipelineCache_.getOrCreate(spriteDescription);
+    aout << "Created " << pipelineCache_.size() << " pipelines" << std::endl;
+
+    // Draw every pipeline once offscreen so the first real draw that uses it doesn't hitch
+    ShaderWarmup warmup;
+    warmup.add("red background", backgroundPipeline_, nullptr, 0);
+    // Without its texture the sprite pipeline waits for the first real draw
+    auto spWarmupTexture = getOrLoadTexture("android_robot.png", kRobotMaxWorldSize);
+    if (spWarmupTexture) {
+        warmup.add("textured robot", spritePipeline_, spWarmupTexture, spriteSampler_);
+    } else {
+        aout << "Error: Could not get android_robot.png texture for shader warm-up" << std::endl;
+    }
+    warmup.run(pipelineBinder_);
+    double warmupMilliseconds = 0;
+    for (const auto &timing: warmup.getTimings()) {
+        warmupMilliseconds += timing.milliseconds;
+    }
+    aout << "Warmed up " << warmup.getTimings().size() << " pipelines in " << warmupMilliseconds
+         << "ms" << std::endl;
+    for (const auto &timing: warmup.getTimings()) {
+        aout << "  " << timing.name << ": " << timing.milliseconds << "ms" << std::endl;
+    }
+
+    // Work finished off the render thread wakes the looper, so the loop can sleep while idle
+    if (completionQueue_.getFd() >= 0) {
+        ALooper_addFd(
+                ALooper_forThread(),
+                completionQueue_.getFd(),
+                LOOPER_ID_USER,
+                ALOOPER_EVENT_INPUT,
+                handleCompletions,
+                this);
+        MemoryPressure::setWakeFd(completionQueue_.getFd());
+    } else {
+        aout << "Couldn't create the completion queue's eventfd, polling instead" << std::endl;
+    }
+    jobSystem_.setMainThreadWakeup([this]() { completionQueue_.wake(); });
+}
+
+int Renderer::handleCompletions(int, int, void *pData) {
+    static_cast<Renderer *>(pData)->runCompletions();
+    return 1;
+}
+
+void Renderer::runCompletions() {
+    if (completionQueue_.runPending() > 0) {
+        redrawRequested_ = true;
+    }
+}
+
+bool Renderer::needsFrame() {
+    return redrawRequested_
+           || shaderNeedsNewProjectionMatrix_
+           || MemoryPressure::hasPending()
+           || jobSystem_.hasMainThreadJobs()
+           || textureUploadQueue_.getPendingCount() > 0
+           || gpuDeletionQueue_.getPendingCount() > 0
+           || !textureStreamer_.isSettled();
+}
+
+int Renderer::getPollTimeout() {
+    if (completionQueue_.getFd() < 0 || needsFrame()) {
+        return 0;
+    }
+    return completionQueue_.getTimeoutMillis();
 }
 
 void Renderer::updateRenderArea() {
@@ -302,33 +527,350 @@ void Renderer::updateRenderArea() {
 
         // make sure that we lazily recreate the projection matrix before we render
         shaderNeedsNewProjectionMatrix_ = true;
+
+        updateTextureDisplaySizes();
     }
 }
 
-std::shared_ptr<TextureAsset> Renderer::getOrLoadTexture(const std::string& assetPath) {
-    // Check if the texture is already in the cache
-    auto it = textureCache_.find(assetPath);
-    if (it != textureCache_.end()) {
-        aout << "Reusing texture from cache: " << assetPath << std::endl;
-        return it->second; // Return the existing shared_ptr
+void Renderer::registerMemoryTrimmers() {
+    memoryPressure_.addTrimmer(TrimTier::ScratchBuffers, "sprite batch buffers", [this]() {
+        return spriteBatcher_.releaseScratch();
+    });
+    memoryPressure_.addTrimmer(TrimTier::ScratchBuffers, "texture staging buffers", [this]() {
+        return textureUploadQueue_.releaseStagingBuffers();
+    });
+    memoryPressure_.addTrimmer(TrimTier::ScratchBuffers, "image decode buffers", [this]() {
+        return decodePool_.trimScratch();
+    });
+    // The levels are only freed as the textures stream down over the next frames
+    memoryPressure_.addTrimmer(TrimTier::MipLevels, "streamed mip levels", [this]() {
+        lastMipTrim_ = std::chrono::steady_clock::now();
+        completionQueue_.postAt(lastMipTrim_ + kMipTrimRecoveryTime, [this]() {
+            // A later trim moved the deadline, its own timer brings the levels back
+            if (textureStreamer_.hasDroppedLevels()
+                && std::chrono::steady_clock::now() - lastMipTrim_ >= kMipTrimRecoveryTime) {
+                aout << "Restoring dropped mip levels" << std::endl;
+                textureStreamer_.restoreDroppedLevels();
+            }
+        });
+        return textureStreamer_.dropIdleLevels(1, frameCount_, kMipTrimIdleFrames);
+    }, true);
+    memoryPressure_.addTrimmer(TrimTier::UnusedTextures, "unused textures", [this]() {
+        // A texture only the cache holds isn't being drawn with. Deduplicated textures are in
+        // the cache once per path, so those references are counted first.
+        std::map<const TextureAsset *, long> cacheReferences;
+        textureCache_.forEachResident(
+                [&](const std::string &, const std::shared_ptr<TextureAsset> &spTexture) {
+                    cacheReferences[spTexture.get()]++;
+                });
+        size_t bytes = 0;
+        textureCache_.eraseIf(
+                [&](const std::string &assetPath, const std::shared_ptr<TextureAsset> &spTexture) {
+                    // Failed loads go too, they're tried again next time
+                    if (!spTexture) {
+                        return true;
+                    }
+                    auto &references = cacheReferences[spTexture.get()];
+                    if (spTexture.use_count() != references) {
+                        return false;
+                    }
+                    // counted once, when the last path holding it goes
+                    if (--references == 0) {
+                        bytes += spTexture->getMemorySize();
+                    }
+                    textureMaxWorldSizes_.erase(assetPath);
+                    return true;
+                });
+        for (auto it = textureContentIndex_.begin(); it != textureContentIndex_.end();) {
+            it = it->second.expired() ? textureContentIndex_.erase(it) : std::next(it);
+        }
+        return bytes;
+    });
+    memoryPressure_.addTrimmer(TrimTier::Pools, "empty texture arrays", [this]() {
+        return textureArrayPool_.trim();
+    });
+}
+
+void Renderer::handleMemoryPressure() {
+    auto results = memoryPressure_.handlePending();
+    if (!results.empty()) {
+        size_t total = 0;
+        size_t deferredTotal = 0;
+        for (const auto &result: results) {
+            aout << "Trimmed " << result.name << " (" << MemoryPressure::getTierName(result.tier)
+                 << "): " << result.bytesReclaimed
+                 << (result.deferred ? " bytes to be freed over the next frames" : " bytes")
+                 << std::endl;
+            (result.deferred ? deferredTotal : total) += result.bytesReclaimed;
+        }
+        aout << "Memory trim reclaimed " << total << " bytes, " << deferredTotal
+             << " more to be freed" << std::endl;
     }
+}
 
-    // Texture not in cache, load it
-    aout << "Loading texture into cache: " << assetPath << std::endl;
-    if (!app_ || !app_->activity || !app_->activity->assetManager) {
-        aout << "Error: AssetManager not available in getOrLoadTexture." << std::endl;
-        return nullptr;
+void Renderer::updateTextureDisplaySizes() {
+    textureCache_.forEachResident(
+            [this](const std::string &assetPath, const std::shared_ptr<TextureAsset> &spTexture) {
+                auto maxDisplaySize = TextureLoadOptions::computeMaxDisplaySize(
+                        width_, height_, kProjectionHalfHeight, textureMaxWorldSizes_[assetPath]);
+                textureStreamer_.setDisplaySize(*spTexture, maxDisplaySize, maxDisplaySize);
+            });
+}
+
+std::string Renderer::getTextureMetadataPath() const {
+    if (!app_ || !app_->activity || !app_->activity->internalDataPath) {
+        return "";
     }
-    auto assetManager = app_->activity->assetManager;
-    std::shared_ptr<TextureAsset> newTexture = TextureAsset::loadAsset(assetManager, assetPath);
+    return std::string(app_->activity->internalDataPath) + "/texture_metadata.txt";
+}
 
-    if (newTexture) {
-        // Store the newly loaded texture in the cache
-        textureCache_[assetPath] = newTexture;
+std::string Renderer::getAssetAccessOrderPath() const {
+    if (!app_ || !app_->activity || !app_->activity->internalDataPath) {
+        return "";
+    }
+    return std::string(app_->activity->internalDataPath) + "/asset_access_order.txt";
+}
+
+std::string Renderer::getTextureCacheDirectory() const {
+    if (!app_ || !app_->activity || !app_->activity->internalDataPath) {
+        return "";
+    }
+    // internalDataPath is the app's files directory, its cache directory sits next to it. The
+    // system may clear that when storage runs low, which is fine for a cache.
+    std::string filesPath = app_->activity->internalDataPath;
+    auto slash = filesPath.find_last_of('/');
+    if (slash == std::string::npos || slash == 0) {
+        return "";
+    }
+    return filesPath.substr(0, slash) + "/cache/textures";
+}
+
+void Renderer::mountFileSystem() {
+    if (!app_ || !app_->activity) {
+        return;
+    }
+    if (app_->activity->assetManager) {
+        fileSystem_.mount(
+                "", std::make_shared<AndroidAssetFileSource>(app_->activity->assetManager));
+        // the packed assets, when the build made a pack, cover the loose ones. What startup
+        // reads is read ahead now, while the caches open and the shaders finish compiling.
+        if (auto spPack = AssetPack::create(fileSystem_.open(kAssetPackPath))) {
+            spPack->prefetch();
+            aout << "Mounted " << kAssetPackPath << ", " << spPack->getEntryCount()
+                 << " assets, reading ahead " << spPack->getPrefetchCount() << " in "
+                 << spPack->getPrefetchSize() << " bytes" << std::endl;
+            fileSystem_.mount("", spPack);
+        }
     } else {
-        aout << "Failed to load texture: " << assetPath << std::endl;
+        aout << "Error: AssetManager not available, no assets can be loaded." << std::endl;
+    }
+    if (app_->activity->internalDataPath) {
+        fileSystem_.mount(
+                "files/",
+                std::make_shared<DirectoryFileSource>(app_->activity->internalDataPath));
+    }
+}
+
+void Renderer::logFileIoStats(size_t count) {
+    auto stats = fileSystem_.getIoStats();
+    for (size_t i = 0; i < std::min(count, stats.size()); i++) {
+        const auto &[path, fileStats] = stats[i];
+        aout << "  " << path << ": " << fileStats.openCount << " opens in "
+             << fileStats.openMilliseconds << "ms, " << fileStats.bytesRead << " bytes in "
+             << fileStats.readMilliseconds << "ms" << std::endl;
+    }
+}
+
+bool Renderer::hashTextureAsset(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        uint64_t &outHash) {
+    auto pFile = fileSystem.open(assetPath);
+    auto pData = pFile ? pFile->getBuffer() : nullptr;
+    if (!pData) {
+        return false;
     }
-    return newTexture;
+    outHash = Hash::xxh64(pData, size_t(pFile->getLength()));
+    return true;
+}
+
+std::shared_ptr<TextureAsset>
+Renderer::getOrLoadTexture(const std::string& assetPath, float maxWorldSize) {
+    return getOrLoadTextures({{assetPath, maxWorldSize}})[0];
+}
+
+std::vector<std::shared_ptr<TextureAsset>>
+Renderer::getOrLoadTextures(const std::vector<TextureRequest> &requests) {
+    std::vector<std::shared_ptr<TextureAsset>> textures(requests.size());
+
+    // What's left to load, and for each the request it came from
+    std::vector<TextureLoadRequest> loadRequests;
+    std::vector<size_t> loadIndices;
+    // The load for each content key in this batch, and the requests waiting to share one
+    std::unordered_map<uint64_t, size_t> loadsByContent;
+    std::vector<std::pair<size_t, size_t>> sharedLoads;
+
+    for (size_t i = 0; i < requests.size(); i++) {
+        const auto &request = requests[i];
+
+        // Check if the texture is already in the cache
+        if (auto spCached = textureCache_.find(request.assetPath)) {
+            aout << "Reusing texture from cache: " << request.assetPath << std::endl;
+            textures[i] = spCached;
+            continue;
+        }
+
+        // The same image is often shipped under more than one name. Those share one texture, as
+        // long as they're drawn at the same size.
+        uint64_t contentKey = 0;
+        if (hashTextureAsset(fileSystem_, request.assetPath, contentKey)) {
+            contentKey = makeTextureContentKey(contentKey, request.maxWorldSize);
+            if (auto spDuplicate = textureContentIndex_[contentKey].lock()) {
+                shareTexture(request, spDuplicate);
+                textures[i] = spDuplicate;
+                continue;
+            }
+            auto loading = loadsByContent.find(contentKey);
+            if (loading != loadsByContent.end()) {
+                sharedLoads.emplace_back(i, loading->second);
+                continue;
+            }
+            loadsByContent[contentKey] = loadRequests.size();
+        }
+
+        // Texture not in cache, load it. Earlier requests are decoded and uploaded first.
+        aout << "Loading texture into cache: " << request.assetPath << std::endl;
+        loadRequests.push_back({
+                request.assetPath,
+                makeTextureLoadOptions(request.maxWorldSize),
+                int(requests.size() - i)});
+        loadIndices.push_back(i);
+    }
+    if (loadRequests.empty()) {
+        return textures;
+    }
+
+    auto loadStart = std::chrono::steady_clock::now();
+    auto loaded = textureStreamer_.loadBatch(fileSystem_, loadRequests, decodePool_);
+    auto loadTime = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - loadStart);
+    aout << "Loaded " << loadRequests.size() << " textures in " << loadTime.count() << "ms with "
+         << decodePool_.getThreadCount() << " decode threads" << std::endl;
+
+    for (size_t i = 0; i < loaded.size(); i++) {
+        const auto &request = requests[loadIndices[i]];
+        if (loaded[i]) {
+            // Store the newly loaded texture in the cache. A coroutine may have loaded the same
+            // path meanwhile, and then its texture is kept.
+            loaded[i] = textureCache_.resolve(request.assetPath, loaded[i]);
+            textureMaxWorldSizes_[request.assetPath] = request.maxWorldSize;
+        } else {
+            aout << "Failed to load texture: " << request.assetPath << std::endl;
+        }
+        textures[loadIndices[i]] = loaded[i];
+    }
+    for (const auto &[contentKey, load]: loadsByContent) {
+        if (loaded[load]) {
+            textureContentIndex_[contentKey] = loaded[load];
+        }
+    }
+    for (const auto &[index, load]: sharedLoads) {
+        if (loaded[load]) {
+            shareTexture(requests[index], loaded[load]);
+        }
+        textures[index] = loaded[load];
+    }
+    return textures;
+}
+
+TextureLoadOptions Renderer::makeTextureLoadOptions(float maxWorldSize) {
+    TextureLoadOptions options = TextureLoadOptions::defaults();
+    options.metadataStore = &textureMetadata_;
+    options.uploadQueue = &textureUploadQueue_;
+    options.diskCache = textureDiskCache_.get();
+    if (width_ > 0 && height_ > 0) {
+        auto maxDisplaySize = TextureLoadOptions::computeMaxDisplaySize(
+                width_, height_, kProjectionHalfHeight, maxWorldSize);
+        options.maxDisplayWidth = maxDisplaySize;
+        options.maxDisplayHeight = maxDisplaySize;
+    }
+    return options;
+}
+
+uint64_t Renderer::makeTextureContentKey(uint64_t contentHash, float maxWorldSize) {
+    uint32_t maxWorldSizeBits;
+    memcpy(&maxWorldSizeBits, &maxWorldSize, sizeof(maxWorldSizeBits));
+    return Hash::combine(contentHash, maxWorldSizeBits);
+}
+
+Task<std::shared_ptr<TextureAsset>>
+Renderer::loadTexture(std::string assetPath, float maxWorldSize) {
+    // The content index and draw sizes are only touched from the render thread
+    co_await resumeOn(jobSystem_, JobAffinity::MainThread);
+
+    // Only the first to ask loads it, anyone asking meanwhile carries on once it has landed
+    auto lookup = co_await textureCache_.lookup(assetPath);
+    if (!lookup.mustLoad) {
+        if (lookup.value) {
+            aout << "Reusing texture from cache: " << assetPath << std::endl;
+        }
+        co_return lookup.value;
+    }
+    auto cancellation = textureLoadCancellation_.getToken();
+
+    // Hashing reads the whole asset, so it's done on a worker like the decode
+    co_await resumeOn(jobSystem_, JobAffinity::Any);
+    uint64_t contentHash = 0;
+    bool hashed = hashTextureAsset(fileSystem_, assetPath, contentHash);
+    co_await resumeOn(jobSystem_, JobAffinity::MainThread);
+    if (cancellation.isCancelled()) {
+        textureCache_.abandon(assetPath);
+        co_return nullptr;
+    }
+
+    uint64_t contentKey = 0;
+    if (hashed) {
+        contentKey = makeTextureContentKey(contentHash, maxWorldSize);
+        if (auto spDuplicate = textureContentIndex_[contentKey].lock()) {
+            shareTexture({assetPath, maxWorldSize}, spDuplicate);
+            co_return spDuplicate;
+        }
+    }
+
+    aout << "Loading texture into cache: " << assetPath << std::endl;
+    auto spTexture = co_await textureStreamer_.loadAsync(
+            fileSystem_,
+            assetPath,
+            makeTextureLoadOptions(maxWorldSize),
+            jobSystem_,
+            cancellation);
+    if (!spTexture) {
+        if (cancellation.isCancelled()) {
+            textureCache_.abandon(assetPath);
+        } else {
+            aout << "Failed to load texture: " << assetPath << std::endl;
+            textureCache_.resolve(assetPath, nullptr);
+        }
+        co_return nullptr;
+    }
+
+    // A batch load of the same path may have got there first, then that texture is kept
+    spTexture = textureCache_.resolve(assetPath, spTexture);
+    textureMaxWorldSizes_[assetPath] = maxWorldSize;
+    if (hashed) {
+        textureContentIndex_[contentKey] = spTexture;
+    }
+    co_return spTexture;
+}
+
+void Renderer::shareTexture(
+        const TextureRequest &request,
+        const std::shared_ptr<TextureAsset> &spTexture) {
+    textureDedupSavedBytes_ += spTexture->getMemorySize();
+    aout << request.assetPath << " is identical to a loaded texture, sharing it. Deduplication "
+         << "has saved " << textureDedupSavedBytes_ << " bytes" << std::endl;
+    textureCache_.resolve(request.assetPath, spTexture);
+    textureMaxWorldSizes_[request.assetPath] = request.maxWorldSize;
 }
 
 
@@ -354,17 +896,26 @@ void Renderer::createModels() {
             0, 1, 2, 0, 2, 3
     };
 
-    // Use the helper function to load/get the texture
-    std::shared_ptr<TextureAsset> spAndroidRobotTexture = getOrLoadTexture("android_robot.png");
+    // Everything the scene starts with loads together, so the images decode in parallel
+    std::vector<Task<std::shared_ptr<TextureAsset>>> loads;
+    loads.push_back(loadTexture("android_robot.png", kRobotMaxWorldSize));
+    auto loadStart = std::chrono::steady_clock::now();
+    auto textures = syncWait(jobSystem_, whenAll(std::move(loads)));
+    auto loadTime = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - loadStart);
+    aout << "Loaded " << textures.size() << " scene textures in " << loadTime.count() << "ms with "
+         << jobSystem_.getWorkerCount() << " workers" << std::endl;
+    logFileIoStats(kLoggedFileIoStats);
+    std::shared_ptr<TextureAsset> spAndroidRobotTexture = textures[0];
 
     if (spAndroidRobotTexture) {
         // Create a model and put it in the back of the render list.
-        models_.emplace_back(vertices, indices, spAndroidRobotTexture);
+        models_.emplace_back(vertices, indices, spAndroidRobotTexture, spriteSampler_);
     } else {
         aout << "Error: Could not get android_robot.png texture for model." << std::endl;
     }
     // Create a model and put it in the back of the render list.
-    models_.emplace_back(vertices, indices, spAndroidRobotTexture);
+    models_.emplace_back(vertices, indices, spAndroidRobotTexture, spriteSampler_);
 }
 
 
@@ -402,6 +953,12 @@ void Renderer::createBackground() {
 
 void Renderer::drawRobotInPosition(float x, float y, float z) {
     aout << "Drawing robot at " << x << ", " << y << std::endl;
+    // Usually the texture is cached and the robot is added right here, otherwise it appears once
+    // the texture has loaded
+    spawn(jobSystem_, addRobot(x, y, z), &pendingTextureLoads_);
+}
+
+Task<void> Renderer::addRobot(float x, float y, float z) {
     std::vector<Vertex> vertices = {
             Vertex(Vector3{x+0.1f, y+0.1f, z}, Vector2{0, 0}), // 0
             Vertex(Vector3{x-0.1f, y+0.1f, z}, Vector2{1, 0}), // 1
@@ -412,11 +969,15 @@ void Renderer::drawRobotInPosition(float x, float y, float z) {
             0, 1, 2, 0, 2, 3
     };
 
-    std::shared_ptr<TextureAsset> spAndroidRobotTexture = getOrLoadTexture("android_robot.png");
+    std::shared_ptr<TextureAsset> spAndroidRobotTexture =
+            co_await loadTexture("android_robot.png", kRobotMaxWorldSize);
+    if (textureLoadCancellation_.isCancelled()) {
+        co_return;
+    }
 
     if (spAndroidRobotTexture) {
         // Create a model and put it in the back of the render list.
-        models_.emplace_back(vertices, indices, spAndroidRobotTexture);
+        models_.emplace_back(vertices, indices, spAndroidRobotTexture, spriteSampler_);
     } else {
         aout << "Error: Could not get android_robot.png texture for model." << std::endl;
     }
@@ -429,6 +990,9 @@ void Renderer::handleInput() {
         // no inputs yet.
         return;
     }
+    if (inputBuffer->motionEventsCount > 0 || inputBuffer->keyEventsCount > 0) {
+        redrawRequested_ = true;
+    }
 
     // handle motion events (motionEventsCounts can be 0).
     for (auto i = 0; i < inputBuffer->motionEventsCount; i++) {
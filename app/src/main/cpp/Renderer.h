@@ -2,12 +2,29 @@
 #define ANDROIDGLINVESTIGATIONS_RENDERER_H
 
 #include <EGL/egl.h>
+#include <chrono>
 #include <memory>
 
+#include "AssetRegistry.h"
+#include "CompletionQueue.h"
+#include "DecodePool.h"
+#include "FileSystem.h"
+#include "GpuDeletionQueue.h"
+#include "JobSystem.h"
+#include "MemoryPressure.h"
 #include "Model.h"
+#include "PipelineState.h"
+#include "SamplerCache.h"
 #include "Shader.h"
+#include "SpriteBatcher.h"
+#include "Task.h"
+#include "TextureArray.h"
+#include "TextureDiskCache.h"
+#include "TextureStreamer.h"
+#include "TextureUploadQueue.h"
 #include <map>
 #include <string>
+#include <unordered_map>
 
 struct android_app;
 
@@ -23,7 +40,16 @@ public:
             context_(EGL_NO_CONTEXT),
             width_(0),
             height_(0),
-            shaderNeedsNewProjectionMatrix_(true) {
+            shaderNeedsNewProjectionMatrix_(true),
+            redrawRequested_(true),
+            backgroundPipeline_(nullptr),
+            spritePipeline_(nullptr),
+            spriteSampler_(0),
+            frameCount_(0),
+            textureStreamer_(textureArrayPool_, textureUploadQueue_),
+            decodePool_(getDecodeThreadCount()),
+            jobSystem_(getJobWorkerCount()),
+            textureDedupSavedBytes_(0) {
         initRenderer();
     }
 
@@ -41,6 +67,32 @@ public:
      */
     void render();
 
+    /*!
+     * @return true if something changed since the last frame, textures are still streaming in, or
+     *     GL objects are waiting to be deleted, so @a render has to be called again
+     */
+    bool needsFrame();
+
+    /*!
+     * @return how long the main loop can sleep in ALooper_pollOnce before there's work: 0 when
+     *     a frame is needed, the time to the next timer on the completion queue, or -1 to wait for
+     *     an event
+     */
+    int getPollTimeout();
+
+    /*!
+     * Runs the completions handed back to the render thread and the timers that are due, and asks
+     * for a frame if any ran. The looper calls this when the completion queue's fd is readable,
+     * the main loop when a poll times out, since timers don't write to the fd.
+     */
+    void runCompletions();
+
+    /*!
+     * Makes the next loop iteration draw a frame, for changes the renderer can't see itself like
+     * the window being resized or needing a redraw
+     */
+    inline void requestRedraw() { redrawRequested_ = true; }
+
 private:
     /*!
      * Performs necessary OpenGL initialization. Customize this if you want to change your EGL
@@ -69,20 +121,225 @@ private:
 
     bool shaderNeedsNewProjectionMatrix_;
 
+    // Set by anything that changes what's on screen, cleared once a frame is drawn
+    bool redrawRequested_;
+
+    // Deletes GL objects once the GPU is done with them. Declared before everything that owns GL
+    // objects so it's destroyed last, and whatever they release on the way out is still queued.
+    GpuDeletionQueue gpuDeletionQueue_;
+
     std::unique_ptr<Shader> shader_;
     std::unique_ptr<Shader> shaderRed_;
     std::vector<Model> models_;
     std::vector<Model> modelsRed_;
 
+    PipelineCache pipelineCache_;
+    PipelineBinder pipelineBinder_;
+    const PipelineState *backgroundPipeline_;
+    const PipelineState *spritePipeline_;
+    SpriteBatcher spriteBatcher_;
+    SamplerCache samplerCache_;
+    GLuint spriteSampler_;
+    // frames rendered so far, what textures record when they're drawn
+    uint64_t frameCount_;
+
     void drawRobotInPosition(float x, float y, float z);
 
     void createBackground();
 
-    // Texture Cache: Maps asset path to loaded TextureAsset
-    std::map<std::string, std::shared_ptr<TextureAsset>> textureCache_;
+    // Where assets are read from: the APK's assets at the root and the app's files directory
+    // under files/
+    FileSystem fileSystem_;
+
+    /*!
+     * Mounts the asset sources the activity provides
+     */
+    void mountFileSystem();
+
+    /*!
+     * Logs the files that took the longest to open and read
+     * @param count how many to log
+     */
+    void logFileIoStats(size_t count);
+
+    /*!
+     * @return where the order startup first read each asset in is saved, for tools/packtool
+     *     --order, or an empty string if there's nowhere to save it
+     */
+    std::string getAssetAccessOrderPath() const;
+
+    // Texture arrays that sprites are loaded into, one per image size
+    TextureArrayPool textureArrayPool_;
+
+    // Streams texture data to the GPU under a per frame time budget
+    TextureUploadQueue textureUploadQueue_;
+
+    // Loads sprite textures low resolution first and streams in the rest
+    TextureStreamer textureStreamer_;
+
+    // Results handed back to the render thread. Its eventfd is registered with the looper, so
+    // the render thread sleeps until there's something to do.
+    CompletionQueue completionQueue_;
+
+    /*!
+     * ALooper callback for the completion queue's fd
+     * @return 1 to stay registered
+     */
+    static int handleCompletions(int fd, int events, void *pData);
+
+    /*!
+     * The decode pool and the job system share the big cores. The decode pool gets half of them,
+     * since batch decodes and jobs often run at the same time.
+     * @return how many threads the decode pool starts, at least 1
+     */
+    static int getDecodeThreadCount();
+
+    /*!
+     * @return how many workers the job system starts: the big cores the decode pool and the
+     *     render thread leave over, which may be none
+     */
+    static int getJobWorkerCount();
+
+    // Decodes batches of textures on the big cores
+    DecodePool decodePool_;
+
+    // Runs engine work across the big cores. The render thread is its main thread, so jobs that
+    // need GL run there each frame.
+    JobSystem jobSystem_;
+
+    // Cancelled when the window goes, so texture loads still in flight stop early
+    CancellationSource textureLoadCancellation_;
+
+    // Coroutines spawned to load textures, waited for before anything they use is torn down
+    JobCounter pendingTextureLoads_;
+
+    // Gives memory back when the platform runs low
+    MemoryPressure memoryPressure_;
+
+    // When mip levels were last dropped for memory, they come back once things have been quiet
+    std::chrono::steady_clock::time_point lastMipTrim_;
+
+    /*!
+     * Registers what can be freed at each memory pressure tier
+     */
+    void registerMemoryTrimmers();
+
+    /*!
+     * Runs any memory trim that was asked for, and restores dropped mip levels once memory has
+     * stopped being tight
+     */
+    void handleMemoryPressure();
+
+    // The storage format picked for each texture, saved between runs
+    TextureMetadataStore textureMetadata_;
+
+    /*!
+     * @return where @a textureMetadata_ is saved, or an empty string if there's nowhere to save it
+     */
+    std::string getTextureMetadataPath() const;
+
+    // Packed textures kept between runs, null if there's nowhere to keep them
+    std::unique_ptr<TextureDiskCache> textureDiskCache_;
+
+    /*!
+     * @return the directory @a textureDiskCache_ lives in, or an empty string if there isn't one
+     */
+    std::string getTextureCacheDirectory() const;
 
-    // Helper function to get or load a texture
-    std::shared_ptr<TextureAsset> getOrLoadTexture(const std::string& assetPath);
+    // Texture Cache: Maps asset path to loaded TextureAsset. Loads in flight are tracked too, so
+    // everyone asking for a texture while it loads shares the one load.
+    AssetRegistry<TextureAsset> textureCache_;
+
+    // Loaded textures by a hash of their encoded asset and draw size, so identical images under
+    // different paths share a texture
+    std::unordered_map<uint64_t, std::weak_ptr<TextureAsset>> textureContentIndex_;
+
+    // The texture memory that sharing identical images has saved
+    size_t textureDedupSavedBytes_;
+
+    /*!
+     * Hashes the encoded contents of an asset
+     * @param fileSystem where the asset is read from
+     * @param assetPath the path to the asset
+     * @param outHash receives the hash
+     * @return false if the asset couldn't be read
+     */
+    static bool hashTextureAsset(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            uint64_t &outHash);
+
+    // The largest size in world units each cached texture is drawn at
+    std::map<std::string, float> textureMaxWorldSizes_;
+
+    /*!
+     * Tells the streamer how large each cached texture now appears, after the surface resized
+     */
+    void updateTextureDisplaySizes();
+
+    /*!
+     * A texture to get or load
+     */
+    struct TextureRequest {
+        // the path to the asset
+        std::string assetPath;
+        // the largest size in world units the texture is drawn at
+        float maxWorldSize;
+    };
+
+    /*!
+     * Gets or loads a batch of textures into texture arrays. The ones that need decoding are
+     * decoded in parallel, and uploaded in the order they're asked for.
+     * @param requests the textures to get, the ones needed soonest first
+     * @return a texture for each request in the same order, null where one couldn't be loaded
+     */
+    std::vector<std::shared_ptr<TextureAsset>>
+    getOrLoadTextures(const std::vector<TextureRequest> &requests);
+
+    /*!
+     * @param maxWorldSize the largest size in world units the texture is drawn at
+     * @return the options every texture the renderer loads is stored with
+     */
+    TextureLoadOptions makeTextureLoadOptions(float maxWorldSize);
+
+    /*!
+     * @param contentHash the hash of the encoded asset
+     * @param maxWorldSize the largest size in world units the texture is drawn at
+     * @return the key of the texture in @a textureContentIndex_
+     */
+    static uint64_t makeTextureContentKey(uint64_t contentHash, float maxWorldSize);
+
+    /*!
+     * Gets or loads a texture into a texture array, as a coroutine. The asset is hashed and
+     * decoded on workers, so loads awaited together with @a whenAll run in parallel.
+     * @param assetPath the path to the asset
+     * @param maxWorldSize the largest size in world units the texture is drawn at
+     * @return a task for the texture, null if it couldn't be loaded or the renderer is going
+     *     away. The awaiting coroutine carries on on the render thread.
+     */
+    Task<std::shared_ptr<TextureAsset>> loadTexture(std::string assetPath, float maxWorldSize);
+
+    /*!
+     * Adds a robot model at a position once its texture has loaded
+     */
+    Task<void> addRobot(float x, float y, float z);
+
+    /*!
+     * Caches an already loaded texture under the path of a request for an identical image
+     */
+    void shareTexture(
+            const TextureRequest &request,
+            const std::shared_ptr<TextureAsset> &spTexture);
+
+    /*!
+     * Helper function to get or load a texture into a texture array
+     * @param assetPath the path to the asset
+     * @param maxWorldSize the largest size in world units the texture is drawn at. Streamed
+     *     textures stop at the levels this needs, others are decoded at a lower resolution when
+     *     they're oversized.
+     */
+    std::shared_ptr<TextureAsset>
+    getOrLoadTexture(const std::string& assetPath, float maxWorldSize);
 
     float counter;
 };
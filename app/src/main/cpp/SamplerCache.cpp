@@ -0,0 +1,99 @@
+#include "SamplerCache.h"
+
+#include <algorithm>
+#include <functional>
+#include <GLES2/gl2ext.h>
+
+#include "AndroidOut.h"
+#include "GpuDeletionQueue.h"
+#include "Utility.h"
+
+/*!
+ * Mixes @a value into @a seed, the same way boost::hash_combine does
+ */
+template<typename T>
+static void hashCombine(size_t &seed, const T &value) {
+    seed ^= std::hash<T>{}(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+bool SamplerDescription::operator==(const SamplerDescription &other) const {
+    return minFilter == other.minFilter
+           && magFilter == other.magFilter
+           && wrapS == other.wrapS
+           && wrapT == other.wrapT
+           && maxAnisotropy == other.maxAnisotropy
+           && minLod == other.minLod
+           && maxLod == other.maxLod;
+}
+
+size_t SamplerDescription::hash() const {
+    size_t seed = 0;
+    hashCombine(seed, minFilter);
+    hashCombine(seed, magFilter);
+    hashCombine(seed, wrapS);
+    hashCombine(seed, wrapT);
+    hashCombine(seed, maxAnisotropy);
+    hashCombine(seed, minLod);
+    hashCombine(seed, maxLod);
+    return seed;
+}
+
+SamplerDescription SamplerDescription::trilinearClamp() {
+    return SamplerDescription{
+            GL_LINEAR_MIPMAP_LINEAR,
+            GL_LINEAR,
+            GL_CLAMP_TO_EDGE,
+            GL_CLAMP_TO_EDGE,
+            1.f,
+            -1000.f, // the GL defaults, so every level is used
+            1000.f
+    };
+}
+
+SamplerCache::~SamplerCache() {
+    for (auto &[description, sampler]: samplers_) {
+        GpuDeletionQueue::release(GpuResourceType::Sampler, sampler);
+    }
+    samplers_.clear();
+}
+
+GLuint SamplerCache::get(const SamplerDescription &description) {
+    auto it = samplers_.find(description);
+    if (it != samplers_.end()) {
+        return it->second;
+    }
+
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, description.minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, description.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, description.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, description.wrapT);
+    glSamplerParameterf(sampler, GL_TEXTURE_MIN_LOD, description.minLod);
+    glSamplerParameterf(sampler, GL_TEXTURE_MAX_LOD, description.maxLod);
+
+    if (description.maxAnisotropy > 1.f) {
+        auto deviceMaxAnisotropy = getDeviceMaxAnisotropy();
+        if (deviceMaxAnisotropy > 1.f) {
+            glSamplerParameterf(
+                    sampler,
+                    GL_TEXTURE_MAX_ANISOTROPY_EXT,
+                    std::min(description.maxAnisotropy, deviceMaxAnisotropy));
+        }
+    }
+    Utility::assertGlError();
+
+    samplers_.emplace(description, sampler);
+    aout << "Created sampler " << sampler << ", " << samplers_.size() << " cached" << std::endl;
+    return sampler;
+}
+
+float SamplerCache::getDeviceMaxAnisotropy() {
+    if (maxAnisotropy_ < 0.f) {
+        maxAnisotropy_ = 1.f;
+        if (Utility::hasGlExtension("GL_EXT_texture_filter_anisotropic")) {
+            glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy_);
+        }
+    }
+    return maxAnisotropy_;
+}
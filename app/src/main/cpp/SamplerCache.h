@@ -0,0 +1,70 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SAMPLERCACHE_H
+#define ANDROIDGLINVESTIGATIONS_SAMPLERCACHE_H
+
+#include <unordered_map>
+#include <GLES3/gl3.h>
+
+/*!
+ * Describes how a texture is sampled. Equal descriptions share one GL sampler object.
+ */
+struct SamplerDescription {
+    GLenum minFilter;
+    GLenum magFilter;
+    GLenum wrapS;
+    GLenum wrapT;
+    // 1 disables anisotropic filtering, values above the device limit are clamped
+    float maxAnisotropy;
+    float minLod;
+    float maxLod;
+
+    bool operator==(const SamplerDescription &other) const;
+
+    /*!
+     * @return a hash of every field in the description
+     */
+    size_t hash() const;
+
+    /*!
+     * @return trilinear filtering clamped to the edge, what sprites want. Clamping avoids odd
+     *     results at the edges when alpha blending.
+     */
+    static SamplerDescription trilinearClamp();
+};
+
+/*!
+ * Creates GL sampler objects on demand and keeps them for reuse. Sampling state lives in the
+ * sampler instead of the texture, so the same texture can be sampled differently per draw just by
+ * binding a different sampler to its texture unit.
+ */
+class SamplerCache {
+public:
+    inline SamplerCache() : maxAnisotropy_(-1.f) {}
+
+    ~SamplerCache();
+
+    /*!
+     * @param description how the texture should be sampled
+     * @return a sampler object for @a description, creating it on first use. The sampler is
+     *     owned by the cache and lives as long as it does.
+     */
+    GLuint get(const SamplerDescription &description);
+
+    inline size_t size() const { return samplers_.size(); }
+
+private:
+    struct DescriptionHash {
+        size_t operator()(const SamplerDescription &description) const {
+            return description.hash();
+        }
+    };
+
+    /*!
+     * @return the largest anisotropy the device supports, or 1 if it doesn't support any
+     */
+    float getDeviceMaxAnisotropy();
+
+    std::unordered_map<SamplerDescription, GLuint, DescriptionHash> samplers_;
+    float maxAnisotropy_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SAMPLERCACHE_H
@@ -1,5 +1,8 @@
 #include "Shader.h"
 
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
 #include "AndroidOut.h"
 #include "Model.h"
 #include "Utility.h"
@@ -9,15 +12,34 @@ Shader *Shader::loadShader(
         const std::string &fragmentSource,
         const std::string &positionAttributeName,
         const std::string &uvAttributeName,
-        const std::string &projectionMatrixUniformName) {
-    Shader *shader = nullptr;
+        const std::string &projectionMatrixUniformName,
+        const std::string &layerAttributeName) {
+    auto pendingShader = loadShaderAsync(
+            vertexSource,
+            fragmentSource,
+            positionAttributeName,
+            uvAttributeName,
+            projectionMatrixUniformName,
+            layerAttributeName);
+    if (!pendingShader) {
+        return nullptr;
+    }
+    return pendingShader->take().release();
+}
 
-    GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexSource);
+std::shared_ptr<PendingShader> Shader::loadShaderAsync(
+        const std::string &vertexSource,
+        const std::string &fragmentSource,
+        const std::string &positionAttributeName,
+        const std::string &uvAttributeName,
+        const std::string &projectionMatrixUniformName,
+        const std::string &layerAttributeName) {
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource);
     if (!vertexShader) {
         return nullptr;
     }
 
-    GLuint fragmentShader = loadShader(GL_FRAGMENT_SHADER, fragmentSource);
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
     if (!fragmentShader) {
         aout << "Failed to load fragment shader" << std::endl;
         glDeleteShader(vertexShader);
@@ -25,77 +47,45 @@ Shader *Shader::loadShader(
     }
 
     GLuint program = glCreateProgram();
-    if (program) {
-        glAttachShader(program, vertexShader);
-        glAttachShader(program, fragmentShader);
-
-        glLinkProgram(program);
-        GLint linkStatus = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-        if (linkStatus != GL_TRUE) {
-            GLint logLength = 0;
-            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-
-            // If we fail to link the shader program, log the result for debugging
-            if (logLength) {
-                GLchar *log = new GLchar[logLength];
-                glGetProgramInfoLog(program, logLength, nullptr, log);
-                aout << "Failed to link program with:\n" << log << std::endl;
-                delete[] log;
-            }
+    if (!program) {
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return nullptr;
+    }
 
-            glDeleteProgram(program);
-        } else {
-            // Get the attribute and uniform locations by name. You may also choose to hardcode
-            // indices with layout= in your shader, but it is not done in this sample
-            // ... after linking ...
-            GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
-            if (positionAttribute == -1) {
-                aout << "Failed to find required attribute: " << positionAttributeName << std::endl;
-                glDeleteProgram(program);
-                return nullptr; // Position is likely always required
-            }
+    // Kick off the link without asking for the result. The shaders stay attached until the
+    // program is resolved so their info logs are still around if something went wrong.
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
 
-            GLint uvAttribute = -1; // Default to not found
-            if (!uvAttributeName.empty()) { // Only try to get it if a name is provided
-                uvAttribute = glGetAttribLocation(program, uvAttributeName.c_str());
-                if (uvAttribute == -1) {
-                    aout << "Warning: Could not find UV attribute: " << uvAttributeName
-                         << ". This may be expected if the shader doesn't use it." << std::endl;
-                    // Don't fail here, just record -1. The Shader object needs to handle it.
-                }
-            }
+    return std::shared_ptr<PendingShader>(new PendingShader(
+            program,
+            vertexShader,
+            fragmentShader,
+            positionAttributeName,
+            uvAttributeName,
+            projectionMatrixUniformName,
+            layerAttributeName,
+            Utility::hasGlExtension("GL_KHR_parallel_shader_compile")));
+}
 
-            GLint projectionMatrixUniform = glGetUniformLocation(program, projectionMatrixUniformName.c_str());
-            if (projectionMatrixUniform == -1) {
-                aout << "Failed to find required uniform: " << projectionMatrixUniformName << std::endl;
-                glDeleteProgram(program);
-                return nullptr; // Projection is likely always required
-            }
-            // Only create a new shader if all the attributes are found.
-            if (positionAttribute != -1
-               // && uvAttribute != -1
-                && projectionMatrixUniform != -1) {
-
-                shader = new Shader(
-                        program,
-                        positionAttribute,
-                        uvAttribute,
-                        projectionMatrixUniform);
-            } else {
-                glDeleteProgram(program);
-                aout << "Failed to find attribute or uniform "  << positionAttribute << " " << uvAttribute << " " << projectionMatrixUniform << std::endl;
-            }
-        }
+void Shader::enableParallelCompile() {
+    if (!Utility::hasGlExtension("GL_KHR_parallel_shader_compile")) {
+        aout << "KHR_parallel_shader_compile not supported, shaders will compile serially"
+             << std::endl;
+        return;
     }
 
-    // The shaders are no longer needed once the program is linked. Release their memory.
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    return shader;
+    auto maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(
+            eglGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    if (maxShaderCompilerThreads) {
+        // 0xFFFFFFFF lets the implementation pick however many threads it likes
+        maxShaderCompilerThreads(0xFFFFFFFF);
+    }
 }
 
-GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
+GLuint Shader::compileShader(GLenum shaderType, const std::string &shaderSource) {
     Utility::assertGlError();
     GLuint shader = glCreateShader(shaderType);
     if (shader) {
@@ -103,29 +93,139 @@ GLuint Shader::loadShader(GLenum shaderType, const std::string &shaderSource) {
         GLint shaderLength = shaderSource.length();
         glShaderSource(shader, 1, &shaderRawString, &shaderLength);
         glCompileShader(shader);
+    }
+    return shader;
+}
+
+bool Shader::checkCompileStatus(GLuint shader) {
+    GLint shaderCompiled = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
+
+    // If the shader doesn't compile, log the result to the terminal for debugging
+    if (!shaderCompiled) {
+        GLint infoLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLength);
+
+        if (infoLength) {
+            auto *infoLog = new GLchar[infoLength];
+            glGetShaderInfoLog(shader, infoLength, nullptr, infoLog);
+            aout << "Failed to compile with:\n" << infoLog << std::endl;
+            delete[] infoLog;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool PendingShader::isReady() const {
+    if (!program_) {
+        return true;
+    }
+
+    if (!hasParallelCompile_) {
+        return true;
+    }
 
-        GLint shaderCompiled = 0;
-        glGetShaderiv(shader, GL_COMPILE_STATUS, &shaderCompiled);
+    GLint completionStatus = GL_FALSE;
+    glGetProgramiv(program_, GL_COMPLETION_STATUS_KHR, &completionStatus);
+    return completionStatus == GL_TRUE;
+}
+
+std::unique_ptr<Shader> PendingShader::take() {
+    if (!program_) {
+        return nullptr;
+    }
+
+    std::unique_ptr<Shader> shader;
 
-        // If the shader doesn't compile, log the result to the terminal for debugging
-        if (!shaderCompiled) {
-            GLint infoLength = 0;
-            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLength);
+    // This is the first point the driver has to be finished with the program
+    GLint linkStatus = GL_FALSE;
+    glGetProgramiv(program_, GL_LINK_STATUS, &linkStatus);
+    if (linkStatus != GL_TRUE) {
+        // A compile failure shows up as a link failure, report whichever stage broke first
+        Shader::checkCompileStatus(vertexShader_);
+        Shader::checkCompileStatus(fragmentShader_);
+
+        GLint logLength = 0;
+        glGetProgramiv(program_, GL_INFO_LOG_LENGTH, &logLength);
+
+        // If we fail to link the shader program, log the result for debugging
+        if (logLength) {
+            GLchar *log = new GLchar[logLength];
+            glGetProgramInfoLog(program_, logLength, nullptr, log);
+            aout << "Failed to link program with:\n" << log << std::endl;
+            delete[] log;
+        }
+    } else {
+        // Get the attribute and uniform locations by name. You may also choose to hardcode
+        // indices with layout= in your shader, but it is not done in this sample
+        GLint positionAttribute = glGetAttribLocation(program_, positionAttributeName_.c_str());
+        if (positionAttribute == -1) {
+            aout << "Failed to find required attribute: " << positionAttributeName_ << std::endl;
+        }
 
-            if (infoLength) {
-                auto *infoLog = new GLchar[infoLength];
-                glGetShaderInfoLog(shader, infoLength, nullptr, infoLog);
-                aout << "Failed to compile with:\n" << infoLog << std::endl;
-                delete[] infoLog;
+        GLint uvAttribute = -1; // Default to not found
+        if (!uvAttributeName_.empty()) { // Only try to get it if a name is provided
+            uvAttribute = glGetAttribLocation(program_, uvAttributeName_.c_str());
+            if (uvAttribute == -1) {
+                aout << "Warning: Could not find UV attribute: " << uvAttributeName_
+                     << ". This may be expected if the shader doesn't use it." << std::endl;
+                // Don't fail here, just record -1. The Shader object needs to handle it.
             }
+        }
+
+        GLint layerAttribute = -1;
+        if (!layerAttributeName_.empty()) {
+            layerAttribute = glGetAttribLocation(program_, layerAttributeName_.c_str());
+            if (layerAttribute == -1) {
+                aout << "Warning: Could not find layer attribute: " << layerAttributeName_
+                     << std::endl;
+            }
+        }
 
-            glDeleteShader(shader);
-            shader = 0;
+        GLint projectionMatrixUniform = glGetUniformLocation(
+                program_,
+                projectionMatrixUniformName_.c_str());
+        if (projectionMatrixUniform == -1) {
+            aout << "Failed to find required uniform: " << projectionMatrixUniformName_
+                 << std::endl;
+        }
+
+        // Only create a new shader if all the required attributes are found. Position and
+        // projection are likely always required.
+        if (positionAttribute != -1 && projectionMatrixUniform != -1) {
+            shader = std::unique_ptr<Shader>(new Shader(
+                    program_,
+                    positionAttribute,
+                    uvAttribute,
+                    layerAttribute,
+                    projectionMatrixUniform));
+
+            // The Shader owns the program now
+            program_ = 0;
         }
     }
+
+    release();
     return shader;
 }
 
+void PendingShader::release() {
+    // The shaders are no longer needed once the program is linked. Release their memory.
+    if (vertexShader_) {
+        glDeleteShader(vertexShader_);
+        vertexShader_ = 0;
+    }
+    if (fragmentShader_) {
+        glDeleteShader(fragmentShader_);
+        fragmentShader_ = 0;
+    }
+    if (program_) {
+        glDeleteProgram(program_);
+        program_ = 0;
+    }
+}
+
 void Shader::activate() const {
     glUseProgram(program_);
 }
@@ -135,6 +235,20 @@ void Shader::deactivate() const {
 }
 
 void Shader::drawModel(const Model &model) const {
+    drawIndexed(
+            model.getVertexData(),
+            model.getIndexData(),
+            model.getIndexCount(),
+            model.getTexturePointer(),
+            model.getSampler());
+}
+
+void Shader::drawIndexed(
+        const Vertex *vertices,
+        const Index *indices,
+        size_t indexCount,
+        const TextureAsset *texture,
+        GLuint sampler) const {
     // The position attribute is 3 floats
     glVertexAttribPointer(
             position_, // attrib
@@ -142,7 +256,7 @@ void Shader::drawModel(const Model &model) const {
             GL_FLOAT, // of type float
             GL_FALSE, // don't normalize
             sizeof(Vertex), // stride is Vertex bytes
-            model.getVertexData() // pull from the start of the vertex data
+            vertices // pull from the start of the vertex data
     );
     glEnableVertexAttribArray(position_);
 
@@ -155,7 +269,7 @@ void Shader::drawModel(const Model &model) const {
                 GL_FLOAT, // of type float
                 GL_FALSE, // don't normalize
                 sizeof(Vertex), // stride is Vertex bytes
-                ((uint8_t *) model.getVertexData()) +
+                ((uint8_t *) vertices) +
                 sizeof(Vector3) // offset Vector3 from the start
         );
         glEnableVertexAttribArray(uv_);
@@ -163,11 +277,32 @@ void Shader::drawModel(const Model &model) const {
 
         // Setup the texture
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, model.getTexture().getTextureID());
+        glBindTexture(texture->getTarget(), texture->getTextureID());
+
+        // Sampling state comes from the sampler object bound to the same unit
+        glBindSampler(0, sampler);
+    }
+
+    // Only setup the array layer if this shader samples a texture array
+    if (layer_ != -1) {
+        // The layer attribute is 1 float
+        glVertexAttribPointer(
+                layer_, // attrib
+                1, // elements
+                GL_FLOAT, // of type float
+                GL_FALSE, // don't normalize
+                sizeof(Vertex), // stride is Vertex bytes
+                ((uint8_t *) vertices) +
+                sizeof(Vector3) + sizeof(Vector2) // offset position and uv from the start
+        );
+        glEnableVertexAttribArray(layer_);
     }
 
     // Draw as indexed triangles
-    glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, model.getIndexData());
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, indices);
+    if (layer_ != -1) {
+        glDisableVertexAttribArray(layer_);
+    }
     if(uv_ != -1) {
         glDisableVertexAttribArray(uv_);
     }
@@ -1,10 +1,18 @@
 #ifndef ANDROIDGLINVESTIGATIONS_SHADER_H
 #define ANDROIDGLINVESTIGATIONS_SHADER_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <GLES3/gl3.h>
 
+#include "GpuDeletionQueue.h"
+
 class Model;
+class PendingShader;
+class TextureAsset;
+struct Vertex;
+typedef uint16_t Index;
 
 /*!
  * A class representing a simple shader program. It consists of vertex and fragment components. The
@@ -25,6 +33,8 @@ public:
      * @param positionAttributeName The name of the position attribute in your vertex program
      * @param uvAttributeName The name of the uv coordinate attribute in your vertex program
      * @param projectionMatrixUniformName The name of your model/view/projection matrix uniform
+     * @param layerAttributeName The name of the texture array layer attribute, if the fragment
+     *     program samples a sampler2DArray
      * @return a valid Shader on success, otherwise null.
      */
     static Shader *loadShader(
@@ -32,13 +42,43 @@ public:
             const std::string &fragmentSource,
             const std::string &positionAttributeName,
             const std::string &uvAttributeName,
-            const std::string &projectionMatrixUniformName);
+            const std::string &projectionMatrixUniformName,
+            const std::string &layerAttributeName = "");
+
+    /*!
+     * Submits the vertex and fragment sources for compilation and linking without waiting on the
+     * driver. No status is queried here, so a driver that compiles in the background (see
+     * KHR_parallel_shader_compile) can keep working while the caller does something else. Resolve
+     * the returned handle with @a PendingShader::take once the shader is actually needed.
+     *
+     * @param vertexSource The full source code for your vertex program
+     * @param fragmentSource The full source code of your fragment program
+     * @param positionAttributeName The name of the position attribute in your vertex program
+     * @param uvAttributeName The name of the uv coordinate attribute in your vertex program
+     * @param projectionMatrixUniformName The name of your model/view/projection matrix uniform
+     * @param layerAttributeName The name of the texture array layer attribute, if the fragment
+     *     program samples a sampler2DArray
+     * @return a handle to the in-flight program, or null if GL could not create the objects.
+     */
+    static std::shared_ptr<PendingShader> loadShaderAsync(
+            const std::string &vertexSource,
+            const std::string &fragmentSource,
+            const std::string &positionAttributeName,
+            const std::string &uvAttributeName,
+            const std::string &projectionMatrixUniformName,
+            const std::string &layerAttributeName = "");
+
+    /*!
+     * Lets the driver use as many background threads as it wants for compiling shaders. Does
+     * nothing if KHR_parallel_shader_compile isn't supported. Call once after the context is made
+     * current.
+     */
+    static void enableParallelCompile();
 
     inline ~Shader() {
-        if (program_) {
-            glDeleteProgram(program_);
-            program_ = 0;
-        }
+        // Draws still in flight may use it
+        GpuDeletionQueue::release(GpuResourceType::Program, program_);
+        program_ = 0;
     }
 
     /*!
@@ -57,6 +97,22 @@ public:
      */
     void drawModel(const Model &model) const;
 
+    /*!
+     * Renders indexed triangles straight from client memory. This is what @a drawModel uses, and
+     * lets a batcher draw vertices merged from several models.
+     * @param vertices the vertices to draw
+     * @param indices the indices into @a vertices, three per triangle
+     * @param indexCount how many indices to draw
+     * @param texture the texture to sample, may be null if this shader doesn't use uvs
+     * @param sampler the sampler object to bind alongside @a texture, 0 for none
+     */
+    void drawIndexed(
+            const Vertex *vertices,
+            const Index *indices,
+            size_t indexCount,
+            const TextureAsset *texture,
+            GLuint sampler) const;
+
     /*!
      * Sets the model/view/projection matrix in the shader.
      * @param projectionMatrix sixteen floats, column major, defining an OpenGL projection matrix.
@@ -64,35 +120,116 @@ public:
     void setProjectionMatrix(float *projectionMatrix) const;
 
 private:
+    friend class PendingShader;
+
     /*!
-     * Helper function to load a shader of a given type
+     * Helper function to submit a shader of a given type for compilation. The compile status is
+     * not checked here, that happens when the owning program is resolved.
      * @param shaderType The OpenGL shader type. Should either be GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
      * @param shaderSource The full source of the shader
      * @return the id of the shader, as returned by glCreateShader, or 0 in the case of an error
      */
-    static GLuint loadShader(GLenum shaderType, const std::string &shaderSource);
+    static GLuint compileShader(GLenum shaderType, const std::string &shaderSource);
+
+    /*!
+     * Logs the info log of a shader if it failed to compile
+     * @param shader the id of the shader to check
+     * @return true if the shader compiled successfully
+     */
+    static bool checkCompileStatus(GLuint shader);
 
     /*!
      * Constructs a new instance of a shader. Use @a loadShader
      * @param program the GL program id of the shader
      * @param position the attribute location of the position
      * @param uv the attribute location of the uv coordinates
+     * @param layer the attribute location of the texture array layer
      * @param projectionMatrix the uniform location of the projection matrix
      */
     constexpr Shader(
             GLuint program,
             GLint position,
             GLint uv,
+            GLint layer,
             GLint projectionMatrix)
             : program_(program),
               position_(position),
               uv_(uv),
+              layer_(layer),
               projectionMatrix_(projectionMatrix) {}
 
     GLuint program_;
     GLint position_;
     GLint uv_;
+    GLint layer_;
     GLint projectionMatrix_;
 };
 
+/*!
+ * A future-like handle to a shader program that has been submitted to the driver but not yet
+ * checked. Querying compile or link status forces the driver to finish the work, so this class
+ * defers those queries until @a take is called. When KHR_parallel_shader_compile is available,
+ * @a isReady can be polled to find out whether @a take would block.
+ */
+class PendingShader {
+public:
+    inline ~PendingShader() {
+        release();
+    }
+
+    // It owns GL objects, a copy would delete them twice
+    PendingShader(const PendingShader &) = delete;
+    PendingShader &operator=(const PendingShader &) = delete;
+
+    /*!
+     * @return true if resolving the shader will not block. Without KHR_parallel_shader_compile
+     *     there is no way to ask, so this always returns true and @a take may block.
+     */
+    bool isReady() const;
+
+    /*!
+     * Waits for the driver to finish compiling and linking, then looks up the attribute and
+     * uniform locations. This can only be done once, later calls return null.
+     *
+     * @return a valid Shader on success, otherwise null. Failures are logged.
+     */
+    std::unique_ptr<Shader> take();
+
+private:
+    friend class Shader;
+
+    PendingShader(
+            GLuint program,
+            GLuint vertexShader,
+            GLuint fragmentShader,
+            std::string positionAttributeName,
+            std::string uvAttributeName,
+            std::string projectionMatrixUniformName,
+            std::string layerAttributeName,
+            bool hasParallelCompile)
+            : program_(program),
+              vertexShader_(vertexShader),
+              fragmentShader_(fragmentShader),
+              positionAttributeName_(std::move(positionAttributeName)),
+              uvAttributeName_(std::move(uvAttributeName)),
+              projectionMatrixUniformName_(std::move(projectionMatrixUniformName)),
+              layerAttributeName_(std::move(layerAttributeName)),
+              hasParallelCompile_(hasParallelCompile) {}
+
+    /*!
+     * Deletes any GL objects still owned by this handle
+     */
+    void release();
+
+    GLuint program_;
+    GLuint vertexShader_;
+    GLuint fragmentShader_;
+    std::string positionAttributeName_;
+    std::string uvAttributeName_;
+    std::string projectionMatrixUniformName_;
+    std::string layerAttributeName_;
+    // whether the context it was submitted on supports KHR_parallel_shader_compile
+    bool hasParallelCompile_;
+};
+
 #endif //ANDROIDGLINVESTIGATIONS_SHADER_H
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include "ShaderWarmup.h"
+
+#include <chrono>
+
+#include "AndroidOut.h"
+#include "Model.h"
+#include "PipelineState.h"
+#include "Shader.h"
+#include "Utility.h"
+
+/*!
+ * The size of the offscreen target. It only has to be big enough to cover a few pixels.
+ */
+static constexpr GLsizei kWarmupTargetSize = 4;
+
+void ShaderWarmup::add(
+        std::string name,
+        const PipelineState *pipeline,
+        std::shared_ptr<TextureAsset> texture,
+        GLuint sampler) {
+    manifest_.push_back({std::move(name), pipeline, std::move(texture), sampler});
+}
+
+void ShaderWarmup::run(PipelineBinder &binder) {
+    timings_.clear();
+    if (manifest_.empty()) {
+        return;
+    }
+
+    // Remember what the renderer had set up so it can be put back afterwards
+    GLint previousFramebuffer = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    GLint previousViewport[4] = {0};
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    // Match the attachment formats of the window surface so the driver builds the same variants
+    GLuint renderbuffers[2];
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, kWarmupTargetSize, kWarmupTargetSize);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(
+            GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, kWarmupTargetSize, kWarmupTargetSize);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glFramebufferRenderbuffer(
+            GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) {
+        glViewport(0, 0, kWarmupTargetSize, kWarmupTargetSize);
+
+        float identityMatrix[16];
+        Utility::buildIdentityMatrix(identityMatrix);
+
+        for (const auto &entry: manifest_) {
+            // A single small triangle is enough to make the driver commit to this combination
+            std::vector<Vertex> vertices = {
+                    Vertex(Vector3{0.f, 0.f, 0.f}, Vector2{0.f, 0.f}),
+                    Vertex(Vector3{0.5f, 0.f, 0.f}, Vector2{1.f, 0.f}),
+                    Vertex(Vector3{0.f, 0.5f, 0.f}, Vector2{0.f, 1.f})
+            };
+            std::vector<Index> indices = {0, 1, 2};
+            Model model(vertices, indices, entry.texture, entry.sampler);
+
+            auto start = std::chrono::steady_clock::now();
+
+            binder.prepareForClear();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            // The projection uniform is overwritten here. The renderer sets the real one before
+            // its first frame anyway.
+            binder.bind(*entry.pipeline);
+            const auto *shader = entry.pipeline->getDescription().shader;
+            shader->setProjectionMatrix(identityMatrix);
+            shader->drawModel(model);
+
+            // Block until the driver is really done, otherwise the cost just moves to later
+            glFinish();
+
+            std::chrono::duration<double, std::milli> elapsed =
+                    std::chrono::steady_clock::now() - start;
+            timings_.push_back({entry.name, elapsed.count()});
+        }
+    } else {
+        aout << "Shader warm-up skipped, offscreen framebuffer is incomplete" << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(2, renderbuffers);
+
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    Utility::assertGlError();
+}
@@ -0,0 +1,68 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SHADERWARMUP_H
+#define ANDROIDGLINVESTIGATIONS_SHADERWARMUP_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <GLES3/gl3.h>
+
+class PipelineBinder;
+class PipelineState;
+class TextureAsset;
+
+/*!
+ * Many drivers only finish compiling a program, or build the variant for a specific vertex format
+ * and blend state, the first time it's used to draw. This class forces that work to happen at load
+ * time by drawing a tiny triangle into an offscreen framebuffer for every pipeline listed in its
+ * manifest. A @a PipelineState already captures the program, vertex layout and blend state.
+ */
+class ShaderWarmup {
+public:
+    /*!
+     * How long one combination took to warm up
+     */
+    struct Timing {
+        std::string name;
+        double milliseconds;
+    };
+
+    /*!
+     * Adds a combination to the manifest
+     * @param name a readable name for the startup report
+     * @param pipeline the pipeline to warm up, must outlive the call to @a run
+     * @param texture the texture to bind, may be null for shaders that don't sample
+     * @param sampler the sampler object to bind with @a texture
+     */
+    void add(
+            std::string name,
+            const PipelineState *pipeline,
+            std::shared_ptr<TextureAsset> texture,
+            GLuint sampler);
+
+    /*!
+     * Issues one offscreen draw per manifest entry and waits for each to finish. The previously
+     * bound framebuffer and viewport are restored afterwards.
+     * @param binder the binder used to apply each pipeline, so it keeps tracking the GL state
+     */
+    void run(PipelineBinder &binder);
+
+    /*!
+     * @return the time each combination took in the last @a run, in manifest order
+     */
+    inline const std::vector<Timing> &getTimings() const {
+        return timings_;
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        const PipelineState *pipeline;
+        std::shared_ptr<TextureAsset> texture;
+        GLuint sampler;
+    };
+
+    std::vector<Entry> manifest_;
+    std::vector<Timing> timings_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SHADERWARMUP_H
@@ -0,0 +1,81 @@
+#include "SpriteBatcher.h"
+
+#include <limits>
+#include <tuple>
+
+#include "Shader.h"
+
+/*!
+ * @return the key models have to share to be drawn together
+ */
+static std::tuple<GLenum, GLuint, GLuint> batchKey(const Model &model) {
+    const auto *texture = model.getTexturePointer();
+    if (!texture) {
+        return {GL_NONE, 0, model.getSampler()};
+    }
+    return {texture->getTarget(), texture->getTextureID(), model.getSampler()};
+}
+
+void SpriteBatcher::draw(const Shader &shader, const std::vector<Model> &models, uint64_t frame) {
+    drawCount_ = 0;
+    vertices_.clear();
+    indices_.clear();
+
+    const Model *batchModel = nullptr;
+    for (const auto &model: models) {
+        // Skip sprites whose texture is still streaming in rather than draw undefined texels
+        // A texture still streaming in counts as drawn, it's wanted on screen
+        const auto *texture = model.getTexturePointer();
+        if (texture) {
+            texture->markDrawn(frame);
+        }
+        if (texture && !texture->isResident()) {
+            continue;
+        }
+
+        // Indices are 16 bit, so a batch can only address so many vertices
+        bool batchFull = vertices_.size() + model.getVertexCount()
+                         > std::numeric_limits<Index>::max() + size_t(1);
+        if (!indices_.empty() && (batchFull || batchKey(model) != batchKey(*batchModel))) {
+            flush(shader, batchModel->getTexturePointer(), batchModel->getSampler());
+        }
+        if (indices_.empty()) {
+            batchModel = &model;
+        }
+
+        auto baseVertex = Index(vertices_.size());
+        vertices_.insert(
+                vertices_.end(),
+                model.getVertexData(),
+                model.getVertexData() + model.getVertexCount());
+
+        // A streamed texture moves to another layer as its resolution changes, so the layer the
+        // model was built with may be stale
+        if (texture && texture->getTarget() == GL_TEXTURE_2D_ARRAY) {
+            for (size_t i = baseVertex; i < vertices_.size(); i++) {
+                vertices_[i].layer = float(texture->getLayer());
+            }
+        }
+        for (size_t i = 0; i < model.getIndexCount(); i++) {
+            indices_.push_back(baseVertex + model.getIndexData()[i]);
+        }
+    }
+
+    if (!indices_.empty()) {
+        flush(shader, batchModel->getTexturePointer(), batchModel->getSampler());
+    }
+}
+
+void SpriteBatcher::flush(const Shader &shader, const TextureAsset *texture, GLuint sampler) {
+    shader.drawIndexed(vertices_.data(), indices_.data(), indices_.size(), texture, sampler);
+    drawCount_++;
+    vertices_.clear();
+    indices_.clear();
+}
+
+size_t SpriteBatcher::releaseScratch() {
+    auto bytes = vertices_.capacity() * sizeof(Vertex) + indices_.capacity() * sizeof(Index);
+    std::vector<Vertex>().swap(vertices_);
+    std::vector<Index>().swap(indices_);
+    return bytes;
+}
@@ -0,0 +1,51 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SPRITEBATCHER_H
+#define ANDROIDGLINVESTIGATIONS_SPRITEBATCHER_H
+
+#include <vector>
+
+#include "Model.h"
+
+class Shader;
+
+/*!
+ * Merges consecutive models that sample the same GL texture with the same sampler into a single
+ * draw call. Models in different layers of one @a TextureArray share a texture id, so they merge
+ * too. Draw order is
+ * preserved, which matters for alpha blending.
+ */
+class SpriteBatcher {
+public:
+    inline SpriteBatcher() : drawCount_(0) {}
+
+    /*!
+     * Draws every model in @a models with @a shader. The shader must already be active.
+     * @param shader the shader to draw with
+     * @param models the models to draw, in order
+     * @param frame the renderer's frame count, recorded on every texture drawn with
+     */
+    void draw(const Shader &shader, const std::vector<Model> &models, uint64_t frame);
+
+    /*!
+     * @return how many draw calls the last @a draw issued
+     */
+    constexpr size_t getDrawCount() const { return drawCount_; }
+
+    /*!
+     * Frees the scratch buffers batches are built in, they grow back on the next @a draw
+     * @return the bytes freed
+     */
+    size_t releaseScratch();
+
+private:
+    /*!
+     * Draws whatever has been accumulated so far and empties the batch
+     */
+    void flush(const Shader &shader, const TextureAsset *texture, GLuint sampler);
+
+    // Kept between frames so the batch doesn't reallocate every time
+    std::vector<Vertex> vertices_;
+    std::vector<Index> indices_;
+    size_t drawCount_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_SPRITEBATCHER_H
@@ -0,0 +1,361 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TASK_H
+#define ANDROIDGLINVESTIGATIONS_TASK_H
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "JobSystem.h"
+
+/*!
+ * Coroutines on top of the JobSystem.
+ *
+ * A function returning @a Task is a coroutine that starts when it's first awaited, and resumes
+ * whoever awaited it when it returns. Where it runs is explicit: @a resumeOn moves the rest of the
+ * coroutine onto a worker, or onto the main thread for GL work, and everything between two of
+ * those stays on one thread. That lets loading code read top to bottom:
+ *
+ *   Task<std::shared_ptr<TextureAsset>> load(...) {
+ *       co_await resumeOn(jobSystem, JobAffinity::Any);
+ *       ... decode ...
+ *       co_await resumeOn(jobSystem, JobAffinity::MainThread);
+ *       ... upload ...
+ *   }
+ *
+ * Top level coroutines are started with @a spawn, or with @a syncWait when the caller has to have
+ * the result before it goes on.
+ */
+
+template<typename T>
+class Task;
+
+/*!
+ * Lets a Task's caller ask it to stop early. Cancelling only sets a flag, coroutines check it with
+ * their @a CancellationToken at the points where stopping is safe, and return from there.
+ */
+class CancellationToken {
+public:
+    /*!
+     * A token that's never cancelled
+     */
+    CancellationToken() = default;
+
+    inline bool isCancelled() const {
+        return spCancelled_ && spCancelled_->load(std::memory_order_acquire);
+    }
+
+private:
+    friend class CancellationSource;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> spCancelled)
+            : spCancelled_(std::move(spCancelled)) {}
+
+    std::shared_ptr<const std::atomic<bool>> spCancelled_;
+};
+
+/*!
+ * Hands out tokens and cancels them all at once
+ */
+class CancellationSource {
+public:
+    inline CancellationSource() : spCancelled_(std::make_shared<std::atomic<bool>>(false)) {}
+
+    inline void cancel() { spCancelled_->store(true, std::memory_order_release); }
+
+    inline bool isCancelled() const { return spCancelled_->load(std::memory_order_acquire); }
+
+    inline CancellationToken getToken() const { return CancellationToken(spCancelled_); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> spCancelled_;
+};
+
+/*!
+ * What every Task's promise has: the coroutine to resume once it's done
+ */
+class TaskPromiseBase {
+public:
+    /*!
+     * Hands straight over to the awaiting coroutine, so long chains of tasks don't grow the stack
+     */
+    struct FinalAwaiter {
+        inline bool await_ready() const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            auto continuation = handle.promise().continuation_;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+
+        inline void await_resume() const noexcept {}
+    };
+
+    // Tasks don't run until they're awaited
+    inline std::suspend_always initial_suspend() const noexcept { return {}; }
+
+    inline FinalAwaiter final_suspend() const noexcept { return {}; }
+
+    // Nothing here throws, so anything that does is a bug
+    inline void unhandled_exception() const noexcept { std::terminate(); }
+
+    inline void setContinuation(std::coroutine_handle<> continuation) {
+        continuation_ = continuation;
+    }
+
+private:
+    std::coroutine_handle<> continuation_;
+};
+
+template<typename T>
+class TaskPromise : public TaskPromiseBase {
+public:
+    Task<T> get_return_object();
+
+    inline void return_value(T value) { value_.emplace(std::move(value)); }
+
+    inline T takeValue() { return std::move(*value_); }
+
+private:
+    std::optional<T> value_;
+};
+
+template<>
+class TaskPromise<void> : public TaskPromiseBase {
+public:
+    Task<void> get_return_object();
+
+    inline void return_void() const {}
+
+    inline void takeValue() const {}
+};
+
+/*!
+ * A coroutine producing a @a T. Awaiting it starts it, and the awaiting coroutine carries on with
+ * the result on whichever thread the task finished on. A task that's never awaited never runs,
+ * and its frame is freed with it.
+ */
+template<typename T = void>
+class Task {
+public:
+    using promise_type = TaskPromise<T>;
+
+    inline explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+    inline Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+
+    Task &operator=(Task &&other) noexcept {
+        if (this != &other) {
+            if (handle_) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    ~Task() {
+        if (handle_) {
+            handle_.destroy();
+        }
+    }
+
+    inline bool await_ready() const noexcept { return handle_.done(); }
+
+    inline std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        handle_.promise().setContinuation(awaiter);
+        return handle_;
+    }
+
+    inline T await_resume() { return handle_.promise().takeValue(); }
+
+private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template<typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+/*!
+ * A coroutine nobody awaits. It starts straight away and frees itself when it returns.
+ */
+struct DetachedTask {
+    struct promise_type {
+        inline DetachedTask get_return_object() const noexcept { return {}; }
+
+        inline std::suspend_never initial_suspend() const noexcept { return {}; }
+
+        inline std::suspend_never final_suspend() const noexcept { return {}; }
+
+        inline void return_void() const noexcept {}
+
+        inline void unhandled_exception() const noexcept { std::terminate(); }
+    };
+};
+
+/*!
+ * Moves the awaiting coroutine onto a thread of a JobSystem. Awaiting the main thread from the
+ * main thread carries straight on.
+ */
+class ResumeOnAwaiter {
+public:
+    inline ResumeOnAwaiter(JobSystem &jobSystem, JobAffinity affinity)
+            : jobSystem_(jobSystem), affinity_(affinity) {}
+
+    inline bool await_ready() const {
+        return affinity_ == JobAffinity::MainThread && jobSystem_.isMainThread();
+    }
+
+    inline void await_suspend(std::coroutine_handle<> handle) const {
+        jobSystem_.run([handle]() { handle.resume(); }, nullptr, affinity_);
+    }
+
+    inline void await_resume() const noexcept {}
+
+private:
+    JobSystem &jobSystem_;
+    JobAffinity affinity_;
+};
+
+/*!
+ * @param jobSystem the system to run on
+ * @param affinity JobAffinity::Any for a worker, JobAffinity::MainThread for the main thread
+ * @return what to co_await to carry on there
+ */
+inline ResumeOnAwaiter resumeOn(JobSystem &jobSystem, JobAffinity affinity) {
+    return ResumeOnAwaiter(jobSystem, affinity);
+}
+
+/*!
+ * Starts a group of tasks together and resumes the awaiting coroutine once the last finishes
+ */
+template<typename T>
+class WhenAllAwaiter {
+public:
+    using Results = std::conditional_t<
+            std::is_void_v<T>, std::nullptr_t, std::vector<std::optional<T>>>;
+
+    /*!
+     * @param tasks the tasks to run, they have to outlive the await
+     * @param results receives each task's result, null for Task<void>
+     */
+    WhenAllAwaiter(std::vector<Task<T>> &tasks, Results *results)
+            : tasks_(tasks), results_(results), remaining_(tasks.size() + 1) {}
+
+    inline bool await_ready() const noexcept { return tasks_.empty(); }
+
+    bool await_suspend(std::coroutine_handle<> awaiter) {
+        awaiter_ = awaiter;
+        for (size_t i = 0; i < tasks_.size(); i++) {
+            run(this, i);
+        }
+        // The extra count is this thread's, whoever takes it to 0 resumes the awaiter
+        return remaining_.fetch_sub(1, std::memory_order_acq_rel) != 1;
+    }
+
+    inline void await_resume() const noexcept {}
+
+private:
+    static DetachedTask run(WhenAllAwaiter *pAwaiter, size_t index) {
+        if constexpr (std::is_void_v<T>) {
+            co_await std::move(pAwaiter->tasks_[index]);
+        } else {
+            (*pAwaiter->results_)[index].emplace(co_await std::move(pAwaiter->tasks_[index]));
+        }
+        if (pAwaiter->remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            pAwaiter->awaiter_.resume();
+        }
+    }
+
+    std::vector<Task<T>> &tasks_;
+    Results *results_;
+    std::atomic<size_t> remaining_;
+    std::coroutine_handle<> awaiter_;
+};
+
+/*!
+ * Runs tasks concurrently. Each starts on the calling thread and runs until it first moves to
+ * another thread, so tasks that begin with @a resumeOn fan straight out.
+ * @return the results in the same order as @a tasks. The awaiting coroutine carries on on the
+ *     thread the last task finished on.
+ */
+template<typename T>
+Task<std::vector<T>> whenAll(std::vector<Task<T>> tasks) {
+    std::vector<std::optional<T>> results(tasks.size());
+    co_await WhenAllAwaiter<T>(tasks, &results);
+    std::vector<T> values;
+    values.reserve(results.size());
+    for (auto &result: results) {
+        values.push_back(std::move(*result));
+    }
+    co_return values;
+}
+
+inline Task<void> whenAll(std::vector<Task<void>> tasks) {
+    co_await WhenAllAwaiter<void>(tasks, nullptr);
+}
+
+/*!
+ * Awaits a task from a DetachedTask and takes it off a counter once it's done
+ */
+inline DetachedTask runSpawned(Task<void> task, JobSystem &jobSystem, JobCounter *counter) {
+    co_await std::move(task);
+    if (counter) {
+        jobSystem.finishWork(*counter);
+    }
+}
+
+/*!
+ * Starts a task without awaiting it. It runs on the calling thread until it first moves to
+ * another one.
+ * @param jobSystem the system the task runs on
+ * @param task the task
+ * @param counter counts the task until it finishes, so JobSystem::wait on it waits for it, may be
+ *     null
+ */
+inline void spawn(JobSystem &jobSystem, Task<void> task, JobCounter *counter = nullptr) {
+    if (counter) {
+        jobSystem.addWork(*counter);
+    }
+    runSpawned(std::move(task), jobSystem, counter);
+}
+
+template<typename T>
+Task<void> storeResult(Task<T> task, std::optional<T> &outResult) {
+    outResult.emplace(co_await std::move(task));
+}
+
+/*!
+ * Runs a task to completion, running other jobs on this thread in the meantime. Called from the
+ * main thread, that includes the task's own main thread steps.
+ * @return the task's result
+ */
+template<typename T>
+T syncWait(JobSystem &jobSystem, Task<T> task) {
+    JobCounter counter;
+    if constexpr (std::is_void_v<T>) {
+        spawn(jobSystem, std::move(task), &counter);
+        jobSystem.wait(counter);
+    } else {
+        std::optional<T> result;
+        spawn(jobSystem, storeResult(std::move(task), result), &counter);
+        jobSystem.wait(counter);
+        return std::move(*result);
+    }
+}
+
+#endif //ANDROIDGLINVESTIGATIONS_TASK_H
@@ -0,0 +1,184 @@
+#include "TextureArray.h"
+
+#include <algorithm>
+
+#include "AndroidOut.h"
+#include "GpuDeletionQueue.h"
+#include "Utility.h"
+
+/*!
+ * How many layers a new array has room for before it first has to grow
+ */
+static constexpr GLsizei kInitialArrayCapacity = 4;
+
+std::shared_ptr<TextureArray>
+TextureArray::create(
+        GLsizei width,
+        GLsizei height,
+        TextureFormat format,
+        GLsizei initialCapacity) {
+    auto textureArray = std::shared_ptr<TextureArray>(new TextureArray(width, height, format));
+    textureArray->levels_ = Utility::mipLevelCount(width, height);
+    textureArray->grow(std::max<GLsizei>(initialCapacity, 1));
+    return textureArray;
+}
+
+TextureArray::~TextureArray() {
+    // return texture resources once the GPU is done with them
+    GpuDeletionQueue::release(GpuResourceType::Texture, textureID_);
+    textureID_ = 0;
+}
+
+GLint TextureArray::allocateLayer() {
+    if (!freeLayers_.empty()) {
+        auto layer = freeLayers_.back();
+        freeLayers_.pop_back();
+        return layer;
+    }
+    if (nextLayer_ >= capacity_) {
+        grow(capacity_ * 2);
+    }
+    return nextLayer_++;
+}
+
+void TextureArray::releaseLayer(GLint layer) {
+    // Queued draws may still sample it. If the array goes first, so does the layer.
+    GpuDeletionQueue::runWhenDone([wpArray = weak_from_this(), layer]() {
+        if (auto spArray = wpArray.lock()) {
+            spArray->freeLayers_.push_back(layer);
+        }
+    });
+}
+
+size_t TextureArray::getLayerMemorySize() const {
+    return getTextureMemorySize(format_, width_, height_, levels_);
+}
+
+void TextureArray::uploadLayer(GLint layer, const uint8_t *pixels) {
+    uploadLayerLevel(layer, 0, pixels);
+    generateMipmaps();
+}
+
+void TextureArray::generateMipmaps() {
+    // This regenerates every layer, which is fine for the handful of sprites this is used for
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID_);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    Utility::assertGlError();
+}
+
+void TextureArray::uploadLayerLevel(GLint layer, GLint level, const uint8_t *pixels) {
+    const auto &formatInfo = getTextureFormatInfo(format_);
+    auto levelWidth = std::max(width_ >> level, 1);
+    auto levelHeight = std::max(height_ >> level, 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID_);
+
+    if (isCompressedTextureFormat(format_)) {
+        glCompressedTexSubImage3D(
+                GL_TEXTURE_2D_ARRAY, // target
+                level, // mip level
+                0, 0, layer, // offset
+                levelWidth, levelHeight, 1, // a single layer
+                formatInfo.internalFormat, // format
+                GLsizei(getTextureMemorySize(format_, levelWidth, levelHeight, 1)), // data size
+                pixels // Data to upload
+        );
+        Utility::assertGlError();
+        return;
+    }
+
+    // rows are tightly packed, which isn't always a multiple of 4 bytes for the smaller formats
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage3D(
+            GL_TEXTURE_2D_ARRAY, // target
+            level, // mip level
+            0, 0, layer, // offset
+            levelWidth, levelHeight, 1, // a single layer
+            formatInfo.format, // format
+            formatInfo.type, // type
+            pixels // Data to upload
+    );
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    Utility::assertGlError();
+}
+
+void TextureArray::grow(GLsizei capacity) {
+    GLuint newTextureID;
+    glGenTextures(1, &newTextureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, newTextureID);
+
+    // Wrap and filter modes aren't set here, they come from the sampler object bound when drawing
+
+    glTexStorage3D(
+            GL_TEXTURE_2D_ARRAY,
+            levels_,
+            getTextureFormatInfo(format_).internalFormat,
+            width_,
+            height_,
+            capacity);
+    applyTextureFormatSwizzle(GL_TEXTURE_2D_ARRAY, format_);
+
+    if (textureID_) {
+        // Copy every level of every used layer across by reading it through a framebuffer. This
+        // keeps everything on the GPU and works on plain GLES 3.0.
+        GLint previousReadFramebuffer = 0;
+        glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousReadFramebuffer);
+
+        GLuint readFramebuffer;
+        glGenFramebuffers(1, &readFramebuffer);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, readFramebuffer);
+        for (GLint layer = 0; layer < nextLayer_; layer++) {
+            for (GLint level = 0; level < levels_; level++) {
+                glFramebufferTextureLayer(
+                        GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureID_, level, layer);
+                glCopyTexSubImage3D(
+                        GL_TEXTURE_2D_ARRAY,
+                        level,
+                        0, 0, layer,
+                        0, 0,
+                        std::max(width_ >> level, 1),
+                        std::max(height_ >> level, 1));
+            }
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, previousReadFramebuffer);
+        glDeleteFramebuffers(1, &readFramebuffer);
+
+        // The copy above still reads from it
+        GpuDeletionQueue::release(GpuResourceType::Texture, textureID_);
+        aout << "Grew " << width_ << "x" << height_ << " "
+             << getTextureFormatInfo(format_).name << " texture array from " << capacity_
+             << " to " << capacity << " layers" << std::endl;
+    }
+
+    textureID_ = newTextureID;
+    capacity_ = capacity;
+    Utility::assertGlError();
+}
+
+std::pair<std::shared_ptr<TextureArray>, GLint>
+TextureArrayPool::allocate(GLsizei width, GLsizei height, TextureFormat format) {
+    if (isCompressedTextureFormat(format)) {
+        // a full compressed array could never grow, so these aren't shared
+        auto textureArray = TextureArray::create(width, height, format, 1);
+        return {textureArray, textureArray->allocateLayer()};
+    }
+
+    auto &textureArray = arrays_[{width, height, format}];
+    if (!textureArray) {
+        textureArray = TextureArray::create(width, height, format, kInitialArrayCapacity);
+    }
+    auto layer = textureArray->allocateLayer();
+    return {textureArray, layer};
+}
+
+size_t TextureArrayPool::trim() {
+    size_t bytes = 0;
+    for (auto it = arrays_.begin(); it != arrays_.end();) {
+        if (it->second->getUsedLayerCount() == 0 && it->second.use_count() == 1) {
+            bytes += it->second->getMemorySize();
+            it = arrays_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return bytes;
+}
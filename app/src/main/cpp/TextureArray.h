@@ -0,0 +1,157 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TEXTUREARRAY_H
+#define ANDROIDGLINVESTIGATIONS_TEXTUREARRAY_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <GLES3/gl3.h>
+#include <tuple>
+
+#include "TextureFormat.h"
+
+/*!
+ * A GL_TEXTURE_2D_ARRAY holding same sized images of one format, one per layer. Sprites that live in the
+ * same array can be drawn together in a single draw call by passing the layer per vertex. Layers
+ * are handed out by @a allocateLayer, and the array grows by reallocating and copying on the GPU
+ * when it runs out of room.
+ *
+ * Layers are handed out and written on the GL thread. A released layer only goes back on the free
+ * list once the GPU has finished the frame it was released in, through the @a GpuDeletionQueue, so
+ * draws still in flight never sample it after it's reused.
+ */
+class TextureArray : public std::enable_shared_from_this<TextureArray> {
+public:
+    /*!
+     * Creates an empty array
+     * @param width the width of every layer
+     * @param height the height of every layer
+     * @param format the storage format of every layer
+     * @param initialCapacity how many layers to allocate storage for up front
+     * @return a shared pointer to the array, GL resources are reclaimed when it's cleaned up
+     */
+    static std::shared_ptr<TextureArray>
+    create(GLsizei width, GLsizei height, TextureFormat format, GLsizei initialCapacity);
+
+    ~TextureArray();
+
+    /*!
+     * Reserves a layer, growing the array if every layer is in use. Call on the GL thread.
+     * @return the index of the reserved layer
+     */
+    GLint allocateLayer();
+
+    /*!
+     * Returns a layer so it can be handed out again once the GPU is done with it. Safe from any
+     * thread.
+     * @param layer a layer previously returned from @a allocateLayer
+     */
+    void releaseLayer(GLint layer);
+
+    /*!
+     * Uploads an image into a layer and regenerates the mip chain
+     * @param layer the layer to fill
+     * @param pixels tightly packed pixels in the array's format, exactly width * height of them
+     */
+    void uploadLayer(GLint layer, const uint8_t *pixels);
+
+    /*!
+     * Uploads one mip level of a layer as is, for images that come with their own mip chain.
+     * Nothing is regenerated, so every level has to be uploaded this way.
+     * @param layer the layer to fill
+     * @param level the mip level to fill
+     * @param pixels tightly packed pixels or blocks in the array's format, sized for the level
+     */
+    void uploadLayerLevel(GLint layer, GLint level, const uint8_t *pixels);
+
+    /*!
+     * Regenerates the mip chain of every layer from its first level
+     */
+    void generateMipmaps();
+
+    constexpr GLsizei getLevelCount() const { return levels_; }
+
+    constexpr GLuint getTextureID() const { return textureID_; }
+
+    constexpr GLsizei getWidth() const { return width_; }
+
+    constexpr GLsizei getHeight() const { return height_; }
+
+    constexpr GLsizei getCapacity() const { return capacity_; }
+
+    constexpr TextureFormat getFormat() const { return format_; }
+
+    /*!
+     * @return how many layers are handed out, or released and still waiting for the GPU. Call on
+     *     the GL thread.
+     */
+    inline GLsizei getUsedLayerCount() const {
+        return nextLayer_ - GLsizei(freeLayers_.size());
+    }
+
+    /*!
+     * @return the bytes one layer takes, including its mip chain
+     */
+    size_t getLayerMemorySize() const;
+
+    /*!
+     * @return the bytes the whole array takes
+     */
+    inline size_t getMemorySize() const { return getLayerMemorySize() * capacity_; }
+
+private:
+    TextureArray(GLsizei width, GLsizei height, TextureFormat format)
+            : textureID_(0),
+              width_(width),
+              height_(height),
+              format_(format),
+              capacity_(0),
+              levels_(1),
+              nextLayer_(0) {}
+
+    /*!
+     * Reallocates storage with room for @a capacity layers, copying over the existing layers
+     * @param capacity the new number of layers
+     */
+    void grow(GLsizei capacity);
+
+    GLuint textureID_;
+    GLsizei width_;
+    GLsizei height_;
+    TextureFormat format_;
+    GLsizei capacity_;
+    GLsizei levels_;
+    GLint nextLayer_;
+    // GL thread only, released layers are put back from the deletion queue
+    std::vector<GLint> freeLayers_;
+};
+
+/*!
+ * Keeps one @a TextureArray per image size and format, so any images that match end up sharing an
+ * array. Block compressed formats can't be copied into a bigger array on GLES 3.0, since they
+ * can't be read through a framebuffer, so each of those images gets an array of its own.
+ */
+class TextureArrayPool {
+public:
+    /*!
+     * Reserves a layer in the array for the given size, creating the array if needed
+     * @param width the width of the image
+     * @param height the height of the image
+     * @param format the storage format of the image
+     * @return the array and the layer that was reserved in it
+     */
+    std::pair<std::shared_ptr<TextureArray>, GLint>
+    allocate(GLsizei width, GLsizei height, TextureFormat format);
+
+    /*!
+     * Frees every array that has no layers in use and isn't referenced outside the pool
+     * @return the bytes of texture memory freed
+     */
+    size_t trim();
+
+private:
+    std::map<std::tuple<GLsizei, GLsizei, TextureFormat>, std::shared_ptr<TextureArray>> arrays_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TEXTUREARRAY_H
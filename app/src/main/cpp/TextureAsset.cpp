@@ -1,80 +1,821 @@
-#include <android/imagedecoder.h>
+#include <algorithm>
+#include <cmath>
 #include "TextureAsset.h"
+#include "AndroidImageDecoder.h"
 #include "AndroidOut.h"
+#include "DecodePool.h"
+#include "Etc2Encoder.h"
+#include "FileSystem.h"
+#include "GpuDeletionQueue.h"
+#include "Hash.h"
+#include "Ktx2File.h"
+#include "PixelConvert.h"
+#include "TextureArray.h"
+#include "TextureContainer.h"
+#include "TextureDiskCache.h"
+#include "TextureUploadQueue.h"
+#include "UastcTranscoder.h"
 #include "Utility.h"
+#include "Zstd.h"
 
-std::shared_ptr<TextureAsset>
-TextureAsset::loadAsset(AAssetManager *assetManager, const std::string &assetPath) {
-    // Get the image from asset manager
-    auto pAndroidRobotPng = AAssetManager_open(
-            assetManager,
-            assetPath.c_str(),
-            AASSET_MODE_BUFFER);
+TextureLoadOptions TextureLoadOptions::defaults() {
+    return TextureLoadOptions{
+            TextureFormatPolicy::defaults(), nullptr, true, 0, 0, nullptr, nullptr};
+}
+
+int32_t TextureLoadOptions::computeMaxDisplaySize(
+        int32_t surfaceWidth,
+        int32_t surfaceHeight,
+        float projectionHalfHeight,
+        float maxWorldSize) {
+    // The projection maps its height onto the height of the surface. Use the longer side so the
+    // answer still holds after the device is rotated.
+    auto longSide = std::max(surfaceWidth, surfaceHeight);
+    float pixelsPerUnit = float(longSide) / (2.f * projectionHalfHeight);
+    return int32_t(std::ceil(pixelsPerUnit * maxWorldSize));
+}
+
+/*!
+ * @return a hash of every option that changes the packed result, for the disk cache key
+ */
+static uint64_t hashFormatOptions(const TextureLoadOptions &options) {
+    auto hash = Hash::combine(0, options.premultiplyAlpha);
+    hash = Hash::combine(hash, options.formatPolicy.lossless);
+    hash = Hash::combine(hash, options.formatPolicy.maxChannelError);
+    return Hash::combine(hash, options.formatPolicy.flatArtColorCount);
+}
 
-    // Make a decoder to turn it into a texture
-    AImageDecoder *pAndroidDecoder = nullptr;
-    auto result = AImageDecoder_createFromAAsset(pAndroidRobotPng, &pAndroidDecoder);
-    assert(result == ANDROID_IMAGE_DECODER_SUCCESS);
+static uint64_t hashOptions(const TextureLoadOptions &options) {
+    auto hash = Hash::combine(hashFormatOptions(options), uint32_t(options.maxDisplayWidth));
+    return Hash::combine(hash, uint32_t(options.maxDisplayHeight));
+}
 
-    // make sure we get 8 bits per channel out. RGBA order.
-    AImageDecoder_setAndroidBitmapFormat(pAndroidDecoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
+bool TextureAsset::decodeAsset(
+        const std::string &assetPath,
+        const uint8_t *data,
+        size_t size,
+        int32_t maxWidth,
+        int32_t maxHeight,
+        int32_t &outWidth,
+        int32_t &outHeight,
+        std::vector<uint8_t> &outPixels) {
+    auto pDecoder = AndroidImageDecoder::create(data, size);
+    if (!pDecoder) {
+        aout << "Couldn't decode " << assetPath << std::endl;
+        return false;
+    }
 
-    // Get the image header, to help set everything up
-    const AImageDecoderHeaderInfo *pAndroidHeader = nullptr;
-    pAndroidHeader = AImageDecoder_getHeaderInfo(pAndroidDecoder);
+    // Anything bigger than it can ever appear on screen is decoded straight at a smaller size.
+    // This saves decode time, upload bandwidth and VRAM all at once.
+    auto sourceWidth = pDecoder->getSourceWidth();
+    auto sourceHeight = pDecoder->getSourceHeight();
+    float scale = 1.f;
+    if (maxWidth > 0 && sourceWidth > maxWidth) {
+        scale = std::min(scale, float(maxWidth) / float(sourceWidth));
+    }
+    if (maxHeight > 0 && sourceHeight > maxHeight) {
+        scale = std::min(scale, float(maxHeight) / float(sourceHeight));
+    }
+    if (scale < 1.f) {
+        auto targetWidth = std::max(int32_t(std::ceil(sourceWidth * scale)), 1);
+        auto targetHeight = std::max(int32_t(std::ceil(sourceHeight * scale)), 1);
+        if (pDecoder->setTargetSize(targetWidth, targetHeight)) {
+            aout << "Decoding " << assetPath << " at " << targetWidth << "x" << targetHeight
+                 << " instead of " << sourceWidth << "x" << sourceHeight << std::endl;
+        }
+    }
 
     // important metrics for sending to GL
-    auto width = AImageDecoderHeaderInfo_getWidth(pAndroidHeader);
-    auto height = AImageDecoderHeaderInfo_getHeight(pAndroidHeader);
-    auto stride = AImageDecoder_getMinimumStride(pAndroidDecoder);
-
-    // Get the bitmap data of the image
-    auto upAndroidImageData = std::make_unique<std::vector<uint8_t>>(height * stride);
-    auto decodeResult = AImageDecoder_decodeImage(
-            pAndroidDecoder,
-            upAndroidImageData->data(),
-            stride,
-            upAndroidImageData->size());
-    assert(decodeResult == ANDROID_IMAGE_DECODER_SUCCESS);
+    outWidth = pDecoder->getWidth();
+    outHeight = pDecoder->getHeight();
+    auto stride = pDecoder->getMinimumStride();
+    outPixels.resize(outHeight * stride);
+    if (!pDecoder->decode(outPixels.data(), stride)) {
+        aout << assetPath << " is corrupt" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+TextureFormat TextureAsset::selectFormat(
+        const std::string &assetPath,
+        uint64_t sourceHash,
+        const uint8_t *pixels,
+        size_t pixelCount,
+        const TextureLoadOptions &options) {
+    auto key = Hash::combine(sourceHash, hashFormatOptions(options));
+    TextureMetadata metadata{};
+    if (options.metadataStore && options.metadataStore->find(assetPath, key, metadata)) {
+        return metadata.format;
+    }
+
+    auto analysis = analyzeImage(pixels, pixelCount);
+    auto format = chooseTextureFormat(analysis, options.formatPolicy);
+    aout << "Chose " << getTextureFormatInfo(format).name << " for " << assetPath
+         << " (opaque " << analysis.opaque
+         << ", binary alpha " << analysis.binaryAlpha
+         << ", grayscale " << analysis.grayscale
+         << ", colors " << analysis.colorCount << ")" << std::endl;
+
+    if (options.metadataStore) {
+        options.metadataStore->record(assetPath, TextureMetadata{key, format});
+    }
+    return format;
+}
+
+std::unique_ptr<File> TextureAsset::openKtx2(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        const TextureLoadOptions &options,
+        Ktx2File &outKtx2,
+        TextureFormat &outFormat) {
+    auto ktx2Path = Ktx2File::pathFor(assetPath);
+    auto pFile = fileSystem.open(ktx2Path);
+    if (!pFile) {
+        return nullptr;
+    }
+
+    // Anything this device can't use falls back to the source image, so one asset set still
+    // works everywhere
+    auto pData = pFile->getBuffer();
+    bool usable = pData && Ktx2File::parse(pData, size_t(pFile->getLength()), outKtx2);
+    uint32_t scheme = usable ? outKtx2.getSupercompressionScheme()
+                             : Ktx2File::kSupercompressionNone;
+    bool uastc = usable && outKtx2.isUastc()
+                 && (scheme == Ktx2File::kSupercompressionNone
+                     || scheme == Ktx2File::kSupercompressionZstd);
+    auto fullChain = size_t(Utility::mipLevelCount(
+            int(outKtx2.getWidth()), int(outKtx2.getHeight())));
+    if (!usable) {
+        aout << ktx2Path << " isn't a 2D KTX2 file" << std::endl;
+    } else if (uastc) {
+        // Transcoded on a worker. ASTC takes the blocks as they are, ETC2 is encoded from the
+        // decoded pixels unless the policy can't lose anything, and a lone level is repacked
+        // like a decoded image so the rest of its chain can be generated. Straight alpha can
+        // still be premultiplied, premultiplied alpha can't be taken back out.
+        if (outKtx2.getLevelCount() != fullChain) {
+            outFormat = TextureFormat::RGBA8;
+        } else if (isTextureFormatSupported(TextureFormat::ASTC_4x4)) {
+            outFormat = TextureFormat::ASTC_4x4;
+        } else if (!options.formatPolicy.lossless) {
+            outFormat = TextureFormat::ETC2_RGBA8;
+        } else {
+            outFormat = TextureFormat::RGBA8;
+        }
+        if (outKtx2.isPremultipliedAlpha() && !options.premultiplyAlpha) {
+            aout << ktx2Path << " doesn't match the requested alpha mode" << std::endl;
+            usable = false;
+        }
+    } else if (outKtx2.isBasisUniversal()) {
+        aout << ktx2Path << " is ETC1S or BasisLZ supercompressed, only UASTC is transcoded"
+             << std::endl;
+        usable = false;
+    } else if (scheme != Ktx2File::kSupercompressionNone) {
+        aout << ktx2Path << " uses an unsupported supercompression scheme" << std::endl;
+        usable = false;
+    } else if (!outKtx2.getTextureFormat(outFormat)) {
+        aout << ktx2Path << " isn't in a format that can be uploaded as is" << std::endl;
+        usable = false;
+    } else if (!isTextureFormatSupported(outFormat)) {
+        aout << "This device can't sample " << getTextureFormatInfo(outFormat).name << ", skipping "
+             << ktx2Path << std::endl;
+        usable = false;
+    } else if (outFormat != TextureFormat::ETC2_RGB8
+               && outKtx2.isPremultipliedAlpha() != options.premultiplyAlpha) {
+        aout << ktx2Path << " doesn't match the requested alpha mode" << std::endl;
+        usable = false;
+    }
+
+    // Block compressed levels can't be generated on the GPU, so those need the whole chain
+    if (usable && outKtx2.getLevelCount() != fullChain
+        && (outKtx2.getLevelCount() != 1 || isCompressedTextureFormat(outFormat))) {
+        aout << ktx2Path << " doesn't hold a full mip chain" << std::endl;
+        usable = false;
+    }
+    for (size_t i = 0; usable && i < outKtx2.getLevelCount(); i++) {
+        const auto &level = outKtx2.getLevel(i);
+        usable = level.uncompressedSize == (uastc
+                ? UastcTranscoder::getLevelSize(level.width, level.height)
+                : getTextureMemorySize(outFormat, int32_t(level.width), int32_t(level.height), 1));
+    }
+    if (!usable) {
+        return nullptr;
+    }
+    return pFile;
+}
+
+void TextureAsset::openPrebuiltFiles(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        const TextureLoadOptions &options,
+        PrebuiltFiles &outFiles) {
+    outFiles.pKtx2File = openKtx2(
+            fileSystem, assetPath, options, outFiles.ktx2File, outFiles.ktx2Format);
+    if (!outFiles.pKtx2File) {
+        outFiles.pMipChainFile = openMipChain(fileSystem, assetPath, options, outFiles.mipChain);
+    }
+}
+
+std::unique_ptr<File> TextureAsset::openMipChain(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        const TextureLoadOptions &options,
+        TextureContainer &outContainer) {
+    auto containerPath = TextureContainer::containerPathFor(assetPath);
+    auto pFile = fileSystem.open(containerPath);
+    if (!pFile) {
+        return nullptr;
+    }
+
+    // Containers are stored uncompressed in the APK, so this maps the file rather than copying it
+    auto pData = pFile->getBuffer();
+    bool usable = pData
+                  && TextureContainer::parse(pData, size_t(pFile->getLength()), outContainer)
+                  && TextureFormat(outContainer.getFormat()) == TextureFormat::RGBA8;
+    bool premultiplied = outContainer.getFlags() & TextureContainer::kFlagPremultipliedAlpha;
+    if (usable && premultiplied != options.premultiplyAlpha) {
+        aout << containerPath << " doesn't match the requested alpha mode" << std::endl;
+        usable = false;
+    }
+    if (usable && outContainer.getLevelCount() != size_t(Utility::mipLevelCount(
+            int(outContainer.getWidth()), int(outContainer.getHeight())))) {
+        aout << containerPath << " doesn't hold a full mip chain" << std::endl;
+        usable = false;
+    }
+    for (size_t i = 0; usable && i < outContainer.getLevelCount(); i++) {
+        const auto &level = outContainer.getLevel(i);
+        usable = level.size == size_t(level.width) * level.height * 4;
+    }
+    if (!usable) {
+        return nullptr;
+    }
+    return pFile;
+}
+
+size_t TextureAsset::findFirstLevel(
+        const TextureContainer &container,
+        int32_t maxWidth,
+        int32_t maxHeight) {
+    // Start at the smallest level that still covers the largest on screen size. Everything
+    // below it is already in the chain, so nothing is lost by dropping the bigger levels.
+    size_t firstLevel = 0;
+    while (firstLevel + 1 < container.getLevelCount()) {
+        const auto &next = container.getLevel(firstLevel + 1);
+        if ((maxWidth <= 0 || int32_t(next.width) < maxWidth)
+            && (maxHeight <= 0 || int32_t(next.height) < maxHeight)) {
+            break;
+        }
+        firstLevel++;
+    }
+    return firstLevel;
+}
+
+void TextureAsset::packMipChain(
+        const std::string &containerPath,
+        uint64_t sourceHash,
+        const TextureContainer &container,
+        const TextureLoadOptions &options,
+        PreparedTexture &outTexture) {
+    auto firstLevel = findFirstLevel(
+            container, options.maxDisplayWidth, options.maxDisplayHeight);
+    const auto &baseLevel = container.getLevel(firstLevel);
+    if (firstLevel > 0) {
+        aout << "Using " << containerPath << " from " << baseLevel.width << "x"
+             << baseLevel.height << " instead of " << container.getWidth() << "x"
+             << container.getHeight() << std::endl;
+    }
+
+    outTexture.width = int32_t(baseLevel.width);
+    outTexture.height = int32_t(baseLevel.height);
+    outTexture.format = selectFormat(
+            containerPath,
+            sourceHash,
+            baseLevel.data,
+            size_t(baseLevel.width) * baseLevel.height,
+            options);
+    for (size_t i = firstLevel; i < container.getLevelCount(); i++) {
+        const auto &level = container.getLevel(i);
+        std::vector<uint8_t> pixels;
+        convertPixels(outTexture.format, level.data, size_t(level.width) * level.height, pixels);
+        outTexture.levels.push_back(sharePixels(std::move(pixels)));
+    }
+}
+
+bool TextureAsset::prepareTexture(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        const TextureLoadOptions &options,
+        PrebuiltFiles &files,
+        std::vector<uint8_t> &scratch,
+        PreparedTexture &outTexture) {
+    // A KTX2 file is already in its GPU format, so the levels upload straight from the asset
+    if (files.pKtx2File && !files.ktx2File.isUastc()) {
+        std::shared_ptr<File> spKtx2File = std::move(files.pKtx2File);
+        const auto &ktx2File = files.ktx2File;
+        outTexture.width = int32_t(ktx2File.getWidth());
+        outTexture.height = int32_t(ktx2File.getHeight());
+        outTexture.format = files.ktx2Format;
+        for (size_t i = 0; i < ktx2File.getLevelCount(); i++) {
+            outTexture.levels.emplace_back(spKtx2File, ktx2File.getLevel(i).data);
+        }
+        aout << "Using " << Ktx2File::pathFor(assetPath) << " as "
+             << getTextureFormatInfo(files.ktx2Format).name << std::endl;
+        return true;
+    }
+
+    // UASTC is packed like any other pixels once it's transcoded. The levels point into the
+    // file, so it stays open until then.
+    if (files.pKtx2File) {
+        auto pKtx2File = std::move(files.pKtx2File);
+        return packUastc(
+                Ktx2File::pathFor(assetPath),
+                Hash::xxh64(pKtx2File->getBuffer(), size_t(pKtx2File->getLength())),
+                files.ktx2File,
+                files.ktx2Format,
+                options,
+                scratch,
+                outTexture);
+    }
+
+    return prepareSourceTexture(fileSystem, assetPath, options, files, scratch, outTexture);
+}
+
+bool TextureAsset::packUastc(
+        const std::string &ktx2Path,
+        uint64_t sourceHash,
+        const Ktx2File &ktx2File,
+        TextureFormat format,
+        const TextureLoadOptions &options,
+        std::vector<uint8_t> &scratch,
+        PreparedTexture &outTexture) {
+    outTexture.width = int32_t(ktx2File.getWidth());
+    outTexture.height = int32_t(ktx2File.getHeight());
+    bool premultiply = options.premultiplyAlpha && !ktx2File.isPremultipliedAlpha();
+
+    // Supercompressed levels are inflated one at a time, as they're needed
+    bool zstd = ktx2File.getSupercompressionScheme() == Ktx2File::kSupercompressionZstd;
+    std::vector<uint8_t> inflated;
+    size_t inflatedLevel = SIZE_MAX;
+    auto getBlocks = [&](size_t i) -> const uint8_t * {
+        const auto &level = ktx2File.getLevel(i);
+        if (!zstd) {
+            return level.data;
+        }
+        if (inflatedLevel != i) {
+            inflated.resize(level.uncompressedSize);
+            if (!Zstd::decompress(level.data, level.size, inflated.data(), inflated.size())) {
+                return nullptr;
+            }
+            inflatedLevel = i;
+        }
+        return inflated.data();
+    };
+
+    // Alpha can only be premultiplied in decoded pixels, so a texture that has any can't keep
+    // its blocks as ASTC. Opaque textures don't need ETC2's alpha blocks.
+    if (format != TextureFormat::RGBA8) {
+        const auto *pBlocks = getBlocks(0);
+        if (!pBlocks) {
+            aout << ktx2Path << " is corrupt" << std::endl;
+            return false;
+        }
+        bool opaque = UastcTranscoder::isOpaque(pBlocks, ktx2File.getLevel(0).uncompressedSize);
+        if (format == TextureFormat::ASTC_4x4 && premultiply && !opaque) {
+            format = options.formatPolicy.lossless ? TextureFormat::RGBA8
+                                                   : TextureFormat::ETC2_RGBA8;
+        }
+        if (format == TextureFormat::ETC2_RGBA8 && opaque) {
+            format = TextureFormat::ETC2_RGB8;
+        }
+    }
+    outTexture.format = format;
+
+    for (size_t i = 0; i < ktx2File.getLevelCount(); i++) {
+        const auto &level = ktx2File.getLevel(i);
+        auto pixelCount = size_t(level.width) * level.height;
+        const auto *pBlocks = getBlocks(i);
+        std::vector<uint8_t> packed;
+        if (format == TextureFormat::ASTC_4x4) {
+            packed.resize(level.uncompressedSize);
+            if (!pBlocks || !UastcTranscoder::transcodeToAstc(
+                    pBlocks, level.uncompressedSize, packed.data())) {
+                aout << ktx2Path << " is corrupt" << std::endl;
+                return false;
+            }
+            outTexture.levels.push_back(sharePixels(std::move(packed)));
+            continue;
+        }
+
+        auto &pixels = scratch;
+        pixels.resize(pixelCount * 4);
+        if (!pBlocks || !UastcTranscoder::transcodeToRgba8(
+                pBlocks, level.uncompressedSize, level.width, level.height, pixels.data())) {
+            aout << ktx2Path << " is corrupt" << std::endl;
+            return false;
+        }
+        if (premultiply) {
+            PixelConvert::premultiplyAlpha(pixels.data(), pixelCount);
+        }
+
+        if (format == TextureFormat::ETC2_RGB8 || format == TextureFormat::ETC2_RGBA8) {
+            packed.resize(getTextureMemorySize(
+                    format, int32_t(level.width), int32_t(level.height), 1));
+            if (format == TextureFormat::ETC2_RGB8) {
+                Etc2Encoder::encodeRgb8(pixels.data(), level.width, level.height, packed.data());
+            } else {
+                Etc2Encoder::encodeRgba8(pixels.data(), level.width, level.height, packed.data());
+            }
+        } else {
+            if (i == 0) {
+                outTexture.format = selectFormat(
+                        ktx2Path, sourceHash, pixels.data(), pixelCount, options);
+            }
+            convertPixels(outTexture.format, pixels.data(), pixelCount, packed);
+        }
+        outTexture.levels.push_back(sharePixels(std::move(packed)));
+    }
+    aout << "Transcoded " << ktx2Path << " to "
+         << getTextureFormatInfo(outTexture.format).name << std::endl;
+    return true;
+}
+
+bool TextureAsset::prepareSourceTexture(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        const TextureLoadOptions &options,
+        PrebuiltFiles &files,
+        std::vector<uint8_t> &scratch,
+        PreparedTexture &outTexture) {
+    // The source is the offline mip chain when there's a usable one, otherwise the image itself
+    const auto &container = files.mipChain;
+    auto pFile = std::move(files.pMipChainFile);
+    auto sourcePath = pFile ? TextureContainer::containerPathFor(assetPath) : assetPath;
+    bool hasMipChain = pFile != nullptr;
+    if (!hasMipChain) {
+        pFile = fileSystem.open(assetPath);
+    }
+    auto pSource = pFile ? pFile->getBuffer() : nullptr;
+    if (!pSource) {
+        aout << "Couldn't read " << assetPath << std::endl;
+        return false;
+    }
+    auto sourceLength = pFile->getLength();
+    // Keys the disk cache entry and the recorded format choice
+    auto sourceHash = Hash::xxh64(pSource, size_t(sourceLength));
+
+    uint64_t cacheKey = 0;
+    if (options.diskCache) {
+        cacheKey = options.diskCache->makeKey(sourceHash, hashOptions(options));
+        if (auto spCached = options.diskCache->find(cacheKey)) {
+            outTexture.width = spCached->width;
+            outTexture.height = spCached->height;
+            outTexture.format = spCached->format;
+            for (auto pLevel: spCached->levels) {
+                outTexture.levels.emplace_back(spCached, pLevel);
+            }
+            return true;
+        }
+    }
+
+    if (hasMipChain) {
+        packMipChain(sourcePath, sourceHash, container, options, outTexture);
+    } else {
+        // The decoded pixels only live until they're packed, so they go in the scratch buffer
+        auto &pixels = scratch;
+        if (!decodeAsset(
+                assetPath,
+                pSource,
+                size_t(sourceLength),
+                options.maxDisplayWidth,
+                options.maxDisplayHeight,
+                outTexture.width,
+                outTexture.height,
+                pixels)) {
+            return false;
+        }
+        auto pixelCount = size_t(outTexture.width) * outTexture.height;
+        if (options.premultiplyAlpha) {
+            PixelConvert::premultiplyAlpha(pixels.data(), pixelCount);
+        }
+
+        // Repack into the cheapest format the policy allows
+        outTexture.format = selectFormat(
+                assetPath, sourceHash, pixels.data(), pixelCount, options);
+        std::vector<uint8_t> packed;
+        convertPixels(outTexture.format, pixels.data(), pixelCount, packed);
+        outTexture.levels.push_back(sharePixels(std::move(packed)));
+    }
+    pFile.reset();
+
+    if (options.diskCache) {
+        std::vector<const uint8_t *> levels;
+        for (const auto &spLevel: outTexture.levels) {
+            levels.push_back(spLevel.get());
+        }
+        options.diskCache->store(
+                cacheKey, outTexture.width, outTexture.height, outTexture.format, levels);
+    }
+    return true;
+}
+
+std::shared_ptr<TextureAsset>
+TextureAsset::loadAsset(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        const TextureLoadOptions &options) {
+    PrebuiltFiles files;
+    openPrebuiltFiles(fileSystem, assetPath, options, files);
+    PreparedTexture texture{};
+    std::vector<uint8_t> scratch;
+    if (!prepareTexture(fileSystem, assetPath, options, files, scratch, texture)) {
+        return nullptr;
+    }
+    const auto &formatInfo = getTextureFormatInfo(texture.format);
 
     // Get an opengl texture
     GLuint textureId;
     glGenTextures(1, &textureId);
     glBindTexture(GL_TEXTURE_2D, textureId);
 
-    // Clamp to the edge, you'll get odd results alpha blending if you don't
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Wrap and filter modes aren't set here, they come from the sampler object bound when drawing
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Allocate the whole mip chain up front, it can't change size or format after this
+    auto levelCount = Utility::mipLevelCount(texture.width, texture.height);
+    glTexStorage2D(
+            GL_TEXTURE_2D,
+            levelCount,
+            formatInfo.internalFormat,
+            texture.width,
+            texture.height);
+    applyTextureFormatSwizzle(GL_TEXTURE_2D, texture.format);
 
-    // Load the texture into VRAM
-    glTexImage2D(
-            GL_TEXTURE_2D, // target
-            0, // mip level
-            GL_RGBA, // internal format, often advisable to use BGR
-            width, // width of the texture
-            height, // height of the texture
-            0, // border (always 0)
-            GL_RGBA, // format
-            GL_UNSIGNED_BYTE, // type
-            upAndroidImageData->data() // Data to upload
-    );
+    auto spTexture = std::shared_ptr<TextureAsset>(new TextureAsset(
+            textureId,
+            texture.format,
+            getTextureMemorySize(texture.format, texture.width, texture.height, levelCount)));
+    if (options.uploadQueue) {
+        streamLevels(spTexture, texture, *options.uploadQueue);
+        return spTexture;
+    }
 
-    // generate mip levels. Not really needed for 2D, but good to do
-    glGenerateMipmap(GL_TEXTURE_2D);
+    // Load the texture into VRAM. Rows are tightly packed, which isn't always a multiple of 4
+    // bytes for the smaller formats.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t level = 0; level < texture.levels.size(); level++) {
+        auto levelWidth = std::max(texture.width >> level, 1);
+        auto levelHeight = std::max(texture.height >> level, 1);
+        if (isCompressedTextureFormat(texture.format)) {
+            glCompressedTexSubImage2D(
+                    GL_TEXTURE_2D, // target
+                    GLint(level), // mip level
+                    0, 0, // offset
+                    levelWidth, levelHeight, // size of the level
+                    formatInfo.internalFormat, // format
+                    GLsizei(getTextureMemorySize(texture.format, levelWidth, levelHeight, 1)),
+                    texture.levels[level].get() // Data to upload
+            );
+            continue;
+        }
+        glTexSubImage2D(
+                GL_TEXTURE_2D, // target
+                GLint(level), // mip level
+                0, 0, // offset
+                levelWidth, // width of the level
+                levelHeight, // height of the level
+                formatInfo.format, // format
+                formatInfo.type, // type
+                texture.levels[level].get() // Data to upload
+        );
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-    // cleanup helpers
-    AImageDecoder_delete(pAndroidDecoder);
-    AAsset_close(pAndroidRobotPng);
+    // generate mip levels when the asset didn't come with its own
+    if (texture.levels.size() == 1) {
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
 
-    // Create a shared pointer so it can be cleaned up easily/automatically
-    return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
+    return spTexture;
+}
+
+std::shared_ptr<TextureAsset>
+TextureAsset::loadAssetIntoArray(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        TextureArrayPool &arrayPool,
+        const TextureLoadOptions &options) {
+    PrebuiltFiles files;
+    openPrebuiltFiles(fileSystem, assetPath, options, files);
+    return loadIntoArray(fileSystem, assetPath, files, arrayPool, options);
+}
+
+std::shared_ptr<TextureAsset> TextureAsset::loadIntoArray(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        PrebuiltFiles &files,
+        TextureArrayPool &arrayPool,
+        const TextureLoadOptions &options) {
+    PreparedTexture texture{};
+    std::vector<uint8_t> scratch;
+    if (!prepareTexture(fileSystem, assetPath, options, files, scratch, texture)) {
+        return nullptr;
+    }
+    return uploadIntoArray(texture, arrayPool, options);
+}
+
+std::vector<std::shared_ptr<TextureAsset>>
+TextureAsset::loadAssetsIntoArrays(
+        FileSystem &fileSystem,
+        const std::vector<TextureLoadRequest> &requests,
+        TextureArrayPool &arrayPool,
+        DecodePool &decodePool) {
+    std::vector<PrebuiltFiles> files(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        openPrebuiltFiles(fileSystem, requests[i].assetPath, requests[i].options, files[i]);
+    }
+    return loadBatchIntoArrays(fileSystem, requests, files, arrayPool, decodePool);
+}
+
+std::vector<std::shared_ptr<TextureAsset>> TextureAsset::loadBatchIntoArrays(
+        FileSystem &fileSystem,
+        const std::vector<TextureLoadRequest> &requests,
+        std::vector<PrebuiltFiles> &files,
+        TextureArrayPool &arrayPool,
+        DecodePool &decodePool) {
+    std::vector<std::shared_ptr<TextureAsset>> textures(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        const auto &request = requests[i];
+
+        // KTX2 files that need no transcoding load right here
+        if (!files[i].needsDecode()) {
+            textures[i] = loadIntoArray(
+                    fileSystem, request.assetPath, files[i], arrayPool, request.options);
+            continue;
+        }
+
+        auto spTexture = std::make_shared<PreparedTexture>();
+        auto spPrepared = std::make_shared<bool>(false);
+        auto &requestFiles = files[i];
+        decodePool.submit(
+                request.priority,
+                [&fileSystem, &request, &requestFiles, spTexture, spPrepared](
+                        std::vector<uint8_t> &scratch) {
+                    *spPrepared = prepareTexture(
+                            fileSystem,
+                            request.assetPath,
+                            request.options,
+                            requestFiles,
+                            scratch,
+                            *spTexture);
+                },
+                [&textures, &arrayPool, &request, i, spTexture, spPrepared]() {
+                    if (*spPrepared) {
+                        textures[i] = uploadIntoArray(*spTexture, arrayPool, request.options);
+                    }
+                });
+    }
+
+    // Uploads go in as the decodes land, so the GL thread works while the workers do
+    decodePool.finish();
+    return textures;
+}
+
+Task<std::shared_ptr<TextureAsset>>
+TextureAsset::loadAssetIntoArrayAsync(
+        FileSystem &fileSystem,
+        std::string assetPath,
+        TextureArrayPool &arrayPool,
+        TextureLoadOptions options,
+        JobSystem &jobSystem,
+        CancellationToken cancellation) {
+    // Checking for a KTX2 file asks GL what the device supports, so the files are opened on the
+    // main thread
+    co_await resumeOn(jobSystem, JobAffinity::MainThread);
+    auto spFiles = std::make_shared<PrebuiltFiles>();
+    openPrebuiltFiles(fileSystem, assetPath, options, *spFiles);
+    co_return co_await loadIntoArrayAsync(
+            fileSystem,
+            std::move(assetPath),
+            std::move(spFiles),
+            arrayPool,
+            options,
+            jobSystem,
+            cancellation);
+}
+
+Task<std::shared_ptr<TextureAsset>>
+TextureAsset::loadIntoArrayAsync(
+        FileSystem &fileSystem,
+        std::string assetPath,
+        std::shared_ptr<PrebuiltFiles> spFiles,
+        TextureArrayPool &arrayPool,
+        TextureLoadOptions options,
+        JobSystem &jobSystem,
+        CancellationToken cancellation) {
+    // KTX2 files that need no transcoding load on the main thread without a trip to a worker
+    if (!spFiles->needsDecode()) {
+        if (cancellation.isCancelled()) {
+            co_return nullptr;
+        }
+        co_return loadIntoArray(fileSystem, assetPath, *spFiles, arrayPool, options);
+    }
+
+    co_await resumeOn(jobSystem, JobAffinity::Any);
+    if (cancellation.isCancelled()) {
+        co_await resumeOn(jobSystem, JobAffinity::MainThread);
+        co_return nullptr;
+    }
+    PreparedTexture texture{};
+    bool prepared;
+    {
+        std::vector<uint8_t> scratch;
+        prepared = prepareTexture(fileSystem, assetPath, options, *spFiles, scratch, texture);
+    }
+
+    co_await resumeOn(jobSystem, JobAffinity::MainThread);
+    if (!prepared || cancellation.isCancelled()) {
+        co_return nullptr;
+    }
+    co_return uploadIntoArray(texture, arrayPool, options);
+}
+
+std::shared_ptr<TextureAsset> TextureAsset::uploadIntoArray(
+        PreparedTexture &texture,
+        TextureArrayPool &arrayPool,
+        const TextureLoadOptions &options) {
+    // Find an array with the same size and format and upload into a free layer of it
+    auto [spArray, layer] = arrayPool.allocate(texture.width, texture.height, texture.format);
+    auto spTexture = std::shared_ptr<TextureAsset>(
+            new TextureAsset(spArray, layer, texture.format));
+    if (options.uploadQueue) {
+        streamLevels(spTexture, texture, *options.uploadQueue);
+    } else if (texture.levels.size() == 1) {
+        spArray->uploadLayer(layer, texture.levels[0].get());
+    } else {
+        for (size_t level = 0; level < texture.levels.size(); level++) {
+            spArray->uploadLayerLevel(layer, GLint(level), texture.levels[level].get());
+        }
+    }
+    return spTexture;
+}
+
+void TextureAsset::streamLevels(
+        const std::shared_ptr<TextureAsset> &spTexture,
+        PreparedTexture &texture,
+        TextureUploadQueue &uploadQueue) {
+    bool generateMipmaps = texture.levels.size() == 1;
+    spTexture->pendingUploads_ = int(texture.levels.size());
+    std::weak_ptr<TextureAsset> wpTexture = spTexture;
+
+    for (size_t level = 0; level < texture.levels.size(); level++) {
+        TextureUpload upload{
+                wpTexture,
+                spTexture->target_,
+                spTexture->textureID_,
+                spTexture->spArray_,
+                spTexture->layer_,
+                GLint(level),
+                std::max(texture.width >> level, 1),
+                std::max(texture.height >> level, 1),
+                texture.format,
+                texture.levels[level],
+                [wpTexture, generateMipmaps]() {
+                    auto spTexture = wpTexture.lock();
+                    if (!spTexture || --spTexture->pendingUploads_ > 0) {
+                        return;
+                    }
+                    if (generateMipmaps && spTexture->spArray_) {
+                        spTexture->spArray_->generateMipmaps();
+                    } else if (generateMipmaps) {
+                        glBindTexture(GL_TEXTURE_2D, spTexture->textureID_);
+                        glGenerateMipmap(GL_TEXTURE_2D);
+                    }
+                }};
+        uploadQueue.enqueue(std::move(upload));
+    }
 }
 
 TextureAsset::~TextureAsset() {
     // return texture resources
-    glDeleteTextures(1, &textureID_);
+    if (spArray_) {
+        spArray_->releaseLayer(layer_);
+    } else {
+        // The last reference can go on any thread, and the GPU may still be drawing with it
+        GpuDeletionQueue::release(GpuResourceType::Texture, textureID_);
+    }
     textureID_ = 0;
+}
+
+void TextureAsset::moveToLayer(std::shared_ptr<TextureArray> spArray, GLint layer) {
+    spArray_->releaseLayer(layer_);
+    spArray_ = std::move(spArray);
+    layer_ = layer;
+}
+
+size_t TextureAsset::getMemorySize() const {
+    return spArray_ ? spArray_->getLayerMemorySize() : memorySize_;
+}
+
+GLuint TextureAsset::getTextureID() const {
+    // An array can be reallocated when it grows, so always ask it for the current id
+    return spArray_ ? spArray_->getTextureID() : textureID_;
 }
\ No newline at end of file
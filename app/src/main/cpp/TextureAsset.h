@@ -2,33 +2,510 @@
 #define ANDROIDGLINVESTIGATIONS_TEXTUREASSET_H
 
 #include <memory>
-#include <android/asset_manager.h>
 #include <GLES3/gl3.h>
 #include <string>
 #include <vector>
 
+#include "Ktx2File.h"
+#include "Task.h"
+#include "TextureContainer.h"
+#include "TextureFormat.h"
+
+class DecodePool;
+class File;
+class FileSystem;
+class TextureArray;
+class TextureArrayPool;
+class TextureDiskCache;
+class TextureUploadQueue;
+
+/*!
+ * Controls how a texture is stored once it's decoded
+ */
+struct TextureLoadOptions {
+    // how much quality may be traded for a smaller storage format
+    TextureFormatPolicy formatPolicy;
+    // remembers the chosen format between loads so the pixels don't have to be analyzed again,
+    // may be null
+    TextureMetadataStore *metadataStore;
+    // multiply color by alpha before upload, draw with glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA)
+    bool premultiplyAlpha;
+    // the largest size in pixels the texture can ever appear on screen. Larger images are decoded
+    // straight to a size that fits, keeping their aspect ratio. 0 means no limit
+    int32_t maxDisplayWidth;
+    int32_t maxDisplayHeight;
+    // streams the pixels in over the next frames instead of uploading them during the load, may
+    // be null. The texture isn't resident until it's done.
+    TextureUploadQueue *uploadQueue;
+    // keeps packed textures between runs so they don't have to be decoded and converted again,
+    // may be null
+    TextureDiskCache *diskCache;
+
+    /*!
+     * @return the default format policy with premultiplied alpha, no metadata store, no size
+     *     limit, uploads done during the load and no disk cache
+     */
+    static TextureLoadOptions defaults();
+
+    /*!
+     * Works out the largest on screen size of something drawn with an orthographic projection
+     * @param surfaceWidth the width of the surface in pixels
+     * @param surfaceHeight the height of the surface in pixels
+     * @param projectionHalfHeight half the height of the projection in world units
+     * @param maxWorldSize the largest size, in world units, the texture is ever drawn at
+     * @return the size in pixels to use for @a maxDisplayWidth and @a maxDisplayHeight
+     */
+    static int32_t computeMaxDisplaySize(
+            int32_t surfaceWidth,
+            int32_t surfaceHeight,
+            float projectionHalfHeight,
+            float maxWorldSize);
+};
+
+/*!
+ * One texture in a batch load
+ */
+struct TextureLoadRequest {
+    // The path to the asset
+    std::string assetPath;
+    // how the texture is stored
+    TextureLoadOptions options;
+    // higher priority textures are decoded and uploaded first
+    int priority;
+};
+
 class TextureAsset {
 public:
     /*!
      * Loads a texture asset from the assets/ directory
-     * @param assetManager Asset manager to use
+     * @param fileSystem where the asset is read from
      * @param assetPath The path to the asset
-     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
+     * @param options how the texture is stored
+     * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned
+     *     up. Null if the asset is missing or can't be decoded.
      */
     static std::shared_ptr<TextureAsset>
-    loadAsset(AAssetManager *assetManager, const std::string &assetPath);
+    loadAsset(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            const TextureLoadOptions &options = TextureLoadOptions::defaults());
+
+    /*!
+     * Loads a texture asset from the assets/ directory into a layer of a texture array. Images of
+     * the same size share an array, so they can be drawn together in one draw call.
+     * @param fileSystem where the asset is read from
+     * @param assetPath The path to the asset
+     * @param arrayPool The pool to allocate the layer from
+     * @param options how the texture is stored, arrays are shared per format as well as size
+     * @return a shared pointer to a texture asset, the layer is released when it's cleaned up.
+     *     Null if the asset is missing or can't be decoded.
+     */
+    static std::shared_ptr<TextureAsset>
+    loadAssetIntoArray(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            TextureArrayPool &arrayPool,
+            const TextureLoadOptions &options = TextureLoadOptions::defaults());
+
+    /*!
+     * Loads a batch of texture assets into texture array layers, like @a loadAssetIntoArray,
+     * decoding them in parallel. Each texture is uploaded as soon as it's decoded, on the calling
+     * thread, which has to be the GL thread.
+     * @param fileSystem where the assets are read from, it's shared with the decode threads
+     * @param requests the textures to load, they stay in use until this returns
+     * @param arrayPool The pool to allocate the layers from
+     * @param decodePool where the images are decoded. It's drained before this returns, running
+     *     the completions of anything else submitted to it too.
+     * @return a texture for each request in the same order, null where the asset is missing or
+     *     can't be decoded
+     */
+    static std::vector<std::shared_ptr<TextureAsset>>
+    loadAssetsIntoArrays(
+            FileSystem &fileSystem,
+            const std::vector<TextureLoadRequest> &requests,
+            TextureArrayPool &arrayPool,
+            DecodePool &decodePool);
+
+    /*!
+     * Loads a texture asset into a texture array layer like @a loadAssetIntoArray, as a coroutine.
+     * The image is read and decoded on a worker, and uploaded on the main thread, so many of these
+     * awaited together with @a whenAll decode in parallel.
+     * @param fileSystem where the asset is read from, it's shared with the workers
+     * @param assetPath The path to the asset
+     * @param arrayPool The pool to allocate the layer from, it has to outlive the task
+     * @param options how the texture is stored, anything it points to has to outlive the task
+     * @param jobSystem runs the decode, its main thread has to be the GL thread
+     * @param cancellation stops the load before the decode or the upload once cancelled
+     * @return a task for the texture, null if the asset is missing, can't be decoded, or the load
+     *     was cancelled. The awaiting coroutine carries on on the main thread.
+     */
+    static Task<std::shared_ptr<TextureAsset>>
+    loadAssetIntoArrayAsync(
+            FileSystem &fileSystem,
+            std::string assetPath,
+            TextureArrayPool &arrayPool,
+            TextureLoadOptions options,
+            JobSystem &jobSystem,
+            CancellationToken cancellation);
 
     ~TextureAsset();
 
     /*!
      * @return the texture id for use with OpenGL
      */
-    constexpr GLuint getTextureID() const { return textureID_; }
+    GLuint getTextureID() const;
+
+    /*!
+     * @return the target to bind the texture id to, GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+     */
+    constexpr GLenum getTarget() const { return target_; }
+
+    /*!
+     * @return the layer of the texture array this texture lives in, 0 for plain 2D textures
+     */
+    constexpr GLint getLayer() const { return layer_; }
+
+    /*!
+     * @return the format the texture is stored in on the GPU
+     */
+    constexpr TextureFormat getFormat() const { return format_; }
+
+    /*!
+     * @return the bytes of texture memory this texture takes, for an array texture its layer
+     */
+    size_t getMemorySize() const;
+
+    /*!
+     * @return true once every level has been uploaded and the texture is safe to draw with
+     */
+    constexpr bool isResident() const { return pendingUploads_ == 0; }
+
+    /*!
+     * Records that the texture was drawn with, so trimming can tell it from idle ones
+     * @param frame the renderer's frame count
+     */
+    inline void markDrawn(uint64_t frame) const { lastDrawnFrame_ = frame; }
+
+    /*!
+     * @return the frame the texture was last drawn in, 0 if it never has been
+     */
+    constexpr uint64_t getLastDrawnFrame() const { return lastDrawnFrame_; }
 
 private:
-    inline TextureAsset(GLuint textureId) : textureID_(textureId) {}
+    // streamed textures move between arrays as their resolution changes
+    friend class TextureStreamer;
+
+    /*!
+     * An image packed into its storage format, ready to upload
+     */
+    struct PreparedTexture {
+        int32_t width;
+        int32_t height;
+        TextureFormat format;
+        // the packed pixels of each mip level, largest first. When there's only one the rest of
+        // the chain still has to be generated. They may point into a mapped cache entry.
+        std::vector<std::shared_ptr<const uint8_t>> levels;
+    };
+
+    /*!
+     * The files built offline next to an asset, opened once at the start of a load so working out
+     * how to load it doesn't open and parse them again
+     */
+    struct PrebuiltFiles {
+        // a KTX2 file this device can upload as is or that's UASTC to transcode, null if there
+        // isn't one
+        std::unique_ptr<File> pKtx2File;
+        Ktx2File ktx2File;
+        // the format the file's levels are uploaded in, or transcoded to for UASTC
+        TextureFormat ktx2Format;
+        // a usable mip chain, only looked for when there's no KTX2 file. Null if there isn't one.
+        std::unique_ptr<File> pMipChainFile;
+        TextureContainer mipChain;
+
+        /*!
+         * @return true if preparing the texture decodes or transcodes it, which is left to a
+         *     worker
+         */
+        inline bool needsDecode() const { return !pKtx2File || ktx2File.isUastc(); }
+    };
+
+    /*!
+     * Opens the KTX2 file next to an asset, or failing that its mip chain. Checking the KTX2 file
+     * asks GL what the device supports, so this runs on the GL thread.
+     * @param fileSystem where the asset is read from
+     * @param assetPath The path to the asset
+     * @param options how the texture is stored
+     * @param outFiles receives whichever was found usable
+     */
+    static void openPrebuiltFiles(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            const TextureLoadOptions &options,
+            PrebuiltFiles &outFiles);
+
+    /*!
+     * Loads an image and packs it for upload. A KTX2 file next to the asset that this device can
+     * sample is used as is, and a UASTC one is transcoded and packed like decoded pixels.
+     * Otherwise the mip chain built offline next to the asset is used when there is one, and
+     * failing that the asset itself is decoded. With a disk cache in the options, a previous run's
+     * result is used instead when the source and options match. It doesn't touch GL, so it can
+     * run on a decode thread.
+     * @param fileSystem where the asset is read from
+     * @param assetPath The path to the asset
+     * @param options how the texture is stored
+     * @param files the asset's files from @a openPrebuiltFiles, they're moved from
+     * @param scratch holds the decoded pixels until they're packed, its contents are replaced
+     * @param outTexture receives the packed image
+     * @return false if the asset is missing or can't be decoded
+     */
+    static bool prepareTexture(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            const TextureLoadOptions &options,
+            PrebuiltFiles &files,
+            std::vector<uint8_t> &scratch,
+            PreparedTexture &outTexture);
+
+    /*!
+     * Everything @a prepareTexture does when there's no KTX2 file
+     * @param fileSystem where the asset is read from
+     * @param assetPath The path to the asset
+     * @param options how the texture is stored
+     * @param files the asset's files from @a openPrebuiltFiles, the mip chain is moved from
+     * @param scratch holds the decoded pixels until they're packed, its contents are replaced
+     * @param outTexture receives the packed image
+     * @return false if the asset is missing or can't be decoded
+     */
+    static bool prepareSourceTexture(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            const TextureLoadOptions &options,
+            PrebuiltFiles &files,
+            std::vector<uint8_t> &scratch,
+            PreparedTexture &outTexture);
+
+    /*!
+     * @a loadAssetIntoArray with the asset's files already opened
+     */
+    static std::shared_ptr<TextureAsset> loadIntoArray(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            PrebuiltFiles &files,
+            TextureArrayPool &arrayPool,
+            const TextureLoadOptions &options);
+
+    /*!
+     * @a loadAssetsIntoArrays with the assets' files already opened
+     * @param files the files of each request, in the same order. They stay in use until this
+     *     returns.
+     */
+    static std::vector<std::shared_ptr<TextureAsset>> loadBatchIntoArrays(
+            FileSystem &fileSystem,
+            const std::vector<TextureLoadRequest> &requests,
+            std::vector<PrebuiltFiles> &files,
+            TextureArrayPool &arrayPool,
+            DecodePool &decodePool);
+
+    /*!
+     * @a loadAssetIntoArrayAsync with the asset's files already opened. It starts on the main
+     * thread.
+     */
+    static Task<std::shared_ptr<TextureAsset>> loadIntoArrayAsync(
+            FileSystem &fileSystem,
+            std::string assetPath,
+            std::shared_ptr<PrebuiltFiles> spFiles,
+            TextureArrayPool &arrayPool,
+            TextureLoadOptions options,
+            JobSystem &jobSystem,
+            CancellationToken cancellation);
+
+    /*!
+     * Opens the KTX2 file next to an asset and checks this device can upload it, either as is or
+     * once its UASTC blocks are transcoded
+     * @param fileSystem where the asset is read from
+     * @param assetPath The path to the source asset, the KTX2 file sits next to it
+     * @param options how the texture is stored
+     * @param outKtx2 receives the parsed file, its levels point into the file's buffer
+     * @param outFormat receives the format the levels are uploaded in. For UASTC it's what they're
+     *     transcoded to: ASTC_4x4 when the device has it, otherwise ETC2_RGBA8, or RGBA8 to be
+     *     repacked like a decoded image when the policy is lossless or there's only one level.
+     *     @a packUastc may still narrow it.
+     * @return the open file, which has to stay open while @a outKtx2 is used, or null if there's
+     *     no usable KTX2 file
+     */
+    static std::unique_ptr<File> openKtx2(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            const TextureLoadOptions &options,
+            Ktx2File &outKtx2,
+            TextureFormat &outFormat);
+
+    /*!
+     * Opens the TextureContainer built for an asset and checks it can be used
+     * @param fileSystem where the asset is read from
+     * @param assetPath The path to the source asset, the container sits next to it
+     * @param options how the texture is stored
+     * @param outContainer receives the container, its levels point into the file's buffer
+     * @return the open file, which has to stay open while the container is used, or null if
+     *     there's no usable container
+     */
+    static std::unique_ptr<File> openMipChain(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            const TextureLoadOptions &options,
+            TextureContainer &outContainer);
+
+    /*!
+     * @param container a full mip chain
+     * @param maxWidth the largest width the texture appears on screen at, 0 for no limit
+     * @param maxHeight the largest height the texture appears on screen at, 0 for no limit
+     * @return the smallest level that still covers the on screen size
+     */
+    static size_t findFirstLevel(
+            const TextureContainer &container,
+            int32_t maxWidth,
+            int32_t maxHeight);
+
+    /*!
+     * Packs the mip chain stored in a TextureContainer, skipping levels bigger than the texture
+     * can appear on screen
+     * @param containerPath The path to the container asset
+     * @param sourceHash the hash of the container asset's bytes
+     * @param container a container checked by @a openMipChain
+     * @param options how the texture is stored
+     * @param outTexture receives the packed image
+     */
+    static void packMipChain(
+            const std::string &containerPath,
+            uint64_t sourceHash,
+            const TextureContainer &container,
+            const TextureLoadOptions &options,
+            PreparedTexture &outTexture);
+
+    /*!
+     * Transcodes the UASTC levels of a KTX2 file, inflating them first when they're Zstandard
+     * supercompressed. ASTC keeps the blocks, rewritten in its own layout. Textures whose alpha
+     * still has to be premultiplied can't, so those go to ETC2 RGBA8 instead. ETC2 drops to RGB8
+     * when the largest level is opaque. RGBA8 is packed like a decoded mip chain, in the format
+     * picked for the largest level.
+     * @param ktx2Path The path to the KTX2 file
+     * @param sourceHash the hash of the KTX2 file's bytes
+     * @param ktx2File a UASTC file checked by @a openKtx2
+     * @param format the format @a openKtx2 picked
+     * @param options how the texture is stored
+     * @param scratch holds each transcoded level until it's packed, its contents are replaced
+     * @param outTexture receives the packed image
+     * @return false if a level is corrupt
+     */
+    static bool packUastc(
+            const std::string &ktx2Path,
+            uint64_t sourceHash,
+            const Ktx2File &ktx2File,
+            TextureFormat format,
+            const TextureLoadOptions &options,
+            std::vector<uint8_t> &scratch,
+            PreparedTexture &outTexture);
+
+    /*!
+     * Decodes an encoded image into RGBA8 pixels with the platform's decoder
+     * @param assetPath The path to the asset, for logging
+     * @param data the encoded image
+     * @param size the size of @a data in bytes
+     * @param maxWidth the largest width to decode at, 0 for the full size
+     * @param maxHeight the largest height to decode at, 0 for the full size
+     * @param outWidth receives the width of the image
+     * @param outHeight receives the height of the image
+     * @param outPixels receives the tightly packed pixels, with straight alpha
+     * @return false if the image can't be decoded
+     */
+    static bool decodeAsset(
+            const std::string &assetPath,
+            const uint8_t *data,
+            size_t size,
+            int32_t maxWidth,
+            int32_t maxHeight,
+            int32_t &outWidth,
+            int32_t &outHeight,
+            std::vector<uint8_t> &outPixels);
+
+    /*!
+     * Picks the storage format for decoded pixels, reusing the recorded choice if neither the
+     * asset nor the options that decide the format have changed since it was made
+     * @param assetPath The path to the asset
+     * @param sourceHash the hash of the encoded asset's bytes
+     * @param pixels the decoded RGBA8 pixels
+     * @param pixelCount how many pixels there are
+     * @param options the policy and metadata store to use
+     * @return the format to store the texture in
+     */
+    static TextureFormat selectFormat(
+            const std::string &assetPath,
+            uint64_t sourceHash,
+            const uint8_t *pixels,
+            size_t pixelCount,
+            const TextureLoadOptions &options);
+
+    /*!
+     * Uploads a packed image into a free layer of a texture array
+     * @param texture the packed image
+     * @param arrayPool The pool to allocate the layer from
+     * @param options how the texture is stored, streamed through the upload queue if it has one
+     * @return the texture
+     */
+    static std::shared_ptr<TextureAsset> uploadIntoArray(
+            PreparedTexture &texture,
+            TextureArrayPool &arrayPool,
+            const TextureLoadOptions &options);
+
+    /*!
+     * Queues every level of @a texture for upload into @a spTexture
+     * @param spTexture the texture to fill, storage must already be allocated
+     * @param texture the packed image, its pixels are shared with the queue
+     * @param uploadQueue the queue to stream through
+     */
+    static void streamLevels(
+            const std::shared_ptr<TextureAsset> &spTexture,
+            PreparedTexture &texture,
+            TextureUploadQueue &uploadQueue);
+
+    /*!
+     * Moves an array texture to a new layer and releases the old one
+     * @param spArray the array holding the new layer
+     * @param layer the new layer, already filled
+     */
+    void moveToLayer(std::shared_ptr<TextureArray> spArray, GLint layer);
+
+    inline TextureAsset(GLuint textureId, TextureFormat format, size_t memorySize)
+            : textureID_(textureId),
+              target_(GL_TEXTURE_2D),
+              layer_(0),
+              format_(format),
+              pendingUploads_(0),
+              memorySize_(memorySize),
+              lastDrawnFrame_(0) {}
+
+    inline TextureAsset(std::shared_ptr<TextureArray> spArray, GLint layer, TextureFormat format)
+            : textureID_(0),
+              target_(GL_TEXTURE_2D_ARRAY),
+              spArray_(std::move(spArray)),
+              layer_(layer),
+              format_(format),
+              pendingUploads_(0),
+              memorySize_(0),
+              lastDrawnFrame_(0) {}
 
     GLuint textureID_;
+    GLenum target_;
+    std::shared_ptr<TextureArray> spArray_;
+    GLint layer_;
+    TextureFormat format_;
+    // levels still waiting in an upload queue
+    int pendingUploads_;
+    // the size of a plain 2D texture, array textures ask their array
+    size_t memorySize_;
+    // bookkeeping for whoever draws it rather than the texture's own state, so it's set through
+    // the const pointers models hold
+    mutable uint64_t lastDrawnFrame_;
 };
 
-#endif //ANDROIDGLINVESTIGATIONS_TEXTUREASSET_H
\ No newline at end of file
+#endif //ANDROIDGLINVESTIGATIONS_TEXTUREASSET_H
@@ -0,0 +1,85 @@
+#include "TextureContainer.h"
+
+#include <cstring>
+
+bool TextureContainer::parse(const uint8_t *data, size_t size, TextureContainer &outContainer) {
+    if (!data || size < sizeof(Header)) {
+        return false;
+    }
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+        return false;
+    }
+    if (header.levelCount == 0 || header.levelCount > 32) {
+        return false;
+    }
+
+    size_t tableEnd = sizeof(Header) + size_t(header.levelCount) * sizeof(LevelEntry);
+    if (size < tableEnd) {
+        return false;
+    }
+
+    std::vector<Level> levels;
+    levels.reserve(header.levelCount);
+    for (uint32_t i = 0; i < header.levelCount; i++) {
+        LevelEntry entry;
+        memcpy(&entry, data + sizeof(Header) + i * sizeof(LevelEntry), sizeof(LevelEntry));
+        if (entry.offset < tableEnd || entry.offset > size || entry.size > size - entry.offset) {
+            return false;
+        }
+        levels.push_back({entry.width, entry.height, data + entry.offset, size_t(entry.size)});
+    }
+
+    outContainer.header_ = header;
+    outContainer.levels_ = std::move(levels);
+    return true;
+}
+
+std::vector<uint8_t> TextureContainer::write(
+        uint32_t width,
+        uint32_t height,
+        uint32_t format,
+        uint32_t flags,
+        const std::vector<std::vector<uint8_t>> &levels) {
+    Header header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.width = width;
+    header.height = height;
+    header.format = format;
+    header.levelCount = uint32_t(levels.size());
+    header.flags = flags;
+
+    auto alignUp = [](size_t value) {
+        return (value + kLevelAlignment - 1) / kLevelAlignment * kLevelAlignment;
+    };
+
+    std::vector<LevelEntry> entries;
+    size_t offset = alignUp(sizeof(Header) + levels.size() * sizeof(LevelEntry));
+    for (size_t i = 0; i < levels.size(); i++) {
+        uint32_t levelWidth = width >> i ? width >> i : 1;
+        uint32_t levelHeight = height >> i ? height >> i : 1;
+        entries.push_back({offset, levels[i].size(), levelWidth, levelHeight});
+        offset = alignUp(offset + levels[i].size());
+    }
+
+    std::vector<uint8_t> file(offset, 0);
+    memcpy(file.data(), &header, sizeof(Header));
+    memcpy(file.data() + sizeof(Header), entries.data(), entries.size() * sizeof(LevelEntry));
+    for (size_t i = 0; i < levels.size(); i++) {
+        memcpy(file.data() + entries[i].offset, levels[i].data(), levels[i].size());
+    }
+    return file;
+}
+
+std::string TextureContainer::containerPathFor(const std::string &assetPath) {
+    auto extension = assetPath.find_last_of('.');
+    auto directory = assetPath.find_last_of('/');
+    if (extension == std::string::npos
+        || (directory != std::string::npos && extension < directory)) {
+        return assetPath + kExtension;
+    }
+    return assetPath.substr(0, extension) + kExtension;
+}
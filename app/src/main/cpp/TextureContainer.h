@@ -0,0 +1,113 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TEXTURECONTAINER_H
+#define ANDROIDGLINVESTIGATIONS_TEXTURECONTAINER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+ * A simple texture file holding a full, pre-generated mip chain. It's produced at build time by
+ * tools/texturetool and read at runtime without any decoding, so every level can be uploaded
+ * directly. All values are little endian.
+ *
+ * Layout:
+ *  - @a TextureContainer::Header
+ *  - levelCount x @a TextureContainer::LevelEntry, largest level first
+ *  - level data, each level starting on a kLevelAlignment boundary
+ */
+class TextureContainer {
+public:
+    static constexpr char kMagic[4] = {'M', 'T', 'E', 'X'};
+    static constexpr uint32_t kVersion = 1;
+    static constexpr size_t kLevelAlignment = 16;
+
+    /*!
+     * The extension the build step gives containers, replacing the source image's extension
+     */
+    static constexpr const char *kExtension = ".mtex";
+
+    enum Flags : uint32_t {
+        // the color channels are already multiplied by alpha
+        kFlagPremultipliedAlpha = 1u << 0,
+    };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        // a TextureFormat value
+        uint32_t format;
+        uint32_t levelCount;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    struct LevelEntry {
+        // from the start of the file
+        uint64_t offset;
+        uint64_t size;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    /*!
+     * One mip level as a view into the container's memory
+     */
+    struct Level {
+        uint32_t width;
+        uint32_t height;
+        const uint8_t *data;
+        size_t size;
+    };
+
+    /*!
+     * Reads a container from memory without copying. @a data must outlive the container.
+     * @param data the contents of the file
+     * @param size the size of the file
+     * @param outContainer receives the parsed container
+     * @return false if the data isn't a valid container
+     */
+    static bool parse(const uint8_t *data, size_t size, TextureContainer &outContainer);
+
+    /*!
+     * Serializes a container
+     * @param width the width of the first level
+     * @param height the height of the first level
+     * @param format the TextureFormat the levels are stored in
+     * @param flags any of @a Flags
+     * @param levels the pixel data of each level, largest first
+     * @return the contents of the file
+     */
+    static std::vector<uint8_t> write(
+            uint32_t width,
+            uint32_t height,
+            uint32_t format,
+            uint32_t flags,
+            const std::vector<std::vector<uint8_t>> &levels);
+
+    /*!
+     * @param assetPath the path of a source image, ex: "android_robot.png"
+     * @return where the build step puts the container for it, ex: "android_robot.mtex"
+     */
+    static std::string containerPathFor(const std::string &assetPath);
+
+    inline uint32_t getWidth() const { return header_.width; }
+
+    inline uint32_t getHeight() const { return header_.height; }
+
+    inline uint32_t getFormat() const { return header_.format; }
+
+    inline uint32_t getFlags() const { return header_.flags; }
+
+    inline size_t getLevelCount() const { return levels_.size(); }
+
+    inline const Level &getLevel(size_t level) const { return levels_[level]; }
+
+private:
+    Header header_;
+    std::vector<Level> levels_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TEXTURECONTAINER_H
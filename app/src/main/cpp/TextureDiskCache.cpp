@@ -0,0 +1,283 @@
+#include "TextureDiskCache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "AndroidOut.h"
+#include "Hash.h"
+
+/*!
+ * Bump this whenever anything about what gets cached changes, so old entries are never read
+ */
+static constexpr uint32_t kCacheVersion = 2;
+
+static constexpr char kMagic[4] = {'G', 'T', 'E', 'X'};
+
+static constexpr const char *kEntryExtension = ".gtex";
+
+/*!
+ * Level data starts on this boundary within the file
+ */
+static constexpr size_t kLevelAlignment = 16;
+
+/*!
+ * The start of every entry. payloadHash covers the rest of the header and everything after it,
+ * the level table and the pixels.
+ */
+struct EntryHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint64_t payloadHash;
+    uint64_t payloadSize;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t levelCount;
+};
+
+// It's hashed as bytes, so there must be no padding to hold garbage
+static_assert(sizeof(EntryHeader) == 48, "EntryHeader has padding");
+
+/*!
+ * @return the hash of an entry: its header with payloadHash zeroed, then its payload
+ */
+static uint64_t hashEntry(const EntryHeader &header, const uint8_t *payload) {
+    auto hashed = header;
+    hashed.payloadHash = 0;
+    return Hash::xxh64(payload, header.payloadSize, Hash::xxh64(&hashed, sizeof(hashed)));
+}
+
+static size_t alignUp(size_t value) {
+    return (value + kLevelAlignment - 1) / kLevelAlignment * kLevelAlignment;
+}
+
+/*!
+ * @return the bytes one level of an entry takes
+ */
+static size_t levelSize(TextureFormat format, int32_t width, int32_t height, size_t level) {
+    return getTextureMemorySize(
+            format, std::max(width >> level, 1), std::max(height >> level, 1), 1);
+}
+
+/*!
+ * Makes a directory and any missing parents
+ */
+static bool makeDirectories(const std::string &path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        auto part = path.substr(0, slash);
+        if (mkdir(part.c_str(), 0700) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (slash == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+MappedTexture::~MappedTexture() {
+    if (pMapping_) {
+        munmap(pMapping_, mappingSize_);
+    }
+}
+
+std::unique_ptr<TextureDiskCache>
+TextureDiskCache::create(const std::string &directory, const std::string &deviceSignature) {
+    if (directory.empty() || !makeDirectories(directory)) {
+        aout << "Can't use " << directory << " for the texture cache" << std::endl;
+        return nullptr;
+    }
+    auto deviceHash = Hash::xxh64(deviceSignature.data(), deviceSignature.size(), kCacheVersion);
+    return std::unique_ptr<TextureDiskCache>(new TextureDiskCache(directory, deviceHash));
+}
+
+uint64_t TextureDiskCache::makeKey(uint64_t contentHash, uint64_t optionsHash) const {
+    return Hash::combine(Hash::combine(deviceHash_, contentHash), optionsHash);
+}
+
+std::string TextureDiskCache::getEntryPath(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016" PRIx64, key);
+    return directory_ + "/" + name + kEntryExtension;
+}
+
+std::shared_ptr<const MappedTexture> TextureDiskCache::find(uint64_t key) {
+    auto path = getEntryPath(key);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        misses_++;
+        return nullptr;
+    }
+
+    struct stat status{};
+    void *pMapping = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && size_t(status.st_size) >= sizeof(EntryHeader)) {
+        pMapping = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+
+    auto spTexture = std::shared_ptr<MappedTexture>(new MappedTexture());
+    if (pMapping != MAP_FAILED) {
+        spTexture->pMapping_ = pMapping;
+        spTexture->mappingSize_ = size_t(status.st_size);
+    }
+
+    // Check everything before trusting a single byte of it
+    auto data = static_cast<const uint8_t *>(spTexture->pMapping_);
+    auto size = spTexture->mappingSize_;
+    bool valid = data != nullptr;
+    EntryHeader header{};
+    if (valid) {
+        memcpy(&header, data, sizeof(header));
+        valid = memcmp(header.magic, kMagic, sizeof(kMagic)) == 0
+                && header.version == kCacheVersion
+                && header.key == key
+                && header.payloadSize == size - sizeof(EntryHeader)
+                && isValidTextureFormat(header.format)
+                && header.width > 0 && header.height > 0
+                && header.levelCount > 0 && header.levelCount <= 32
+                && sizeof(EntryHeader) + header.levelCount * sizeof(uint64_t) <= size;
+    }
+    if (valid) {
+        // Sequential for the hash, and the upload right after reads it in order too
+        madvise(spTexture->pMapping_, size, MADV_SEQUENTIAL);
+        valid = hashEntry(header, data + sizeof(EntryHeader)) == header.payloadHash;
+    }
+    if (valid) {
+        spTexture->width = int32_t(header.width);
+        spTexture->height = int32_t(header.height);
+        spTexture->format = TextureFormat(header.format);
+        for (uint32_t level = 0; valid && level < header.levelCount; level++) {
+            uint64_t offset;
+            memcpy(&offset,
+                   data + sizeof(EntryHeader) + level * sizeof(uint64_t),
+                   sizeof(offset));
+            auto bytes = levelSize(spTexture->format, spTexture->width, spTexture->height, level);
+            valid = offset <= size && bytes <= size - offset;
+            spTexture->levels.push_back(data + offset);
+        }
+    }
+
+    if (!valid) {
+        aout << "Texture cache entry " << path << " is corrupt, rebuilding it" << std::endl;
+        corrupt_++;
+        misses_++;
+        unlink(path.c_str());
+        return nullptr;
+    }
+
+    // Touch the entry so pruning sees it was used
+    utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+    hits_++;
+    return spTexture;
+}
+
+bool TextureDiskCache::store(
+        uint64_t key,
+        int32_t width,
+        int32_t height,
+        TextureFormat format,
+        const std::vector<const uint8_t *> &levels) {
+    // Lay out the level table and the levels after the header
+    std::vector<uint64_t> offsets;
+    size_t offset = alignUp(sizeof(EntryHeader) + levels.size() * sizeof(uint64_t));
+    for (size_t level = 0; level < levels.size(); level++) {
+        offsets.push_back(offset);
+        offset = alignUp(offset + levelSize(format, width, height, level));
+    }
+
+    std::vector<uint8_t> file(offset, 0);
+    memcpy(file.data() + sizeof(EntryHeader), offsets.data(), offsets.size() * sizeof(uint64_t));
+    for (size_t level = 0; level < levels.size(); level++) {
+        memcpy(file.data() + offsets[level],
+               levels[level],
+               levelSize(format, width, height, level));
+    }
+
+    EntryHeader header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kCacheVersion;
+    header.key = key;
+    header.payloadSize = file.size() - sizeof(EntryHeader);
+    header.width = uint32_t(width);
+    header.height = uint32_t(height);
+    header.format = uint32_t(format);
+    header.levelCount = uint32_t(levels.size());
+    header.payloadHash = hashEntry(header, file.data() + sizeof(EntryHeader));
+    memcpy(file.data(), &header, sizeof(header));
+
+    auto path = getEntryPath(key);
+    // one temporary file per thread, so concurrent stores of one key don't write into each other
+    auto temporaryPath = path + "." + std::to_string(gettid()) + ".tmp";
+    auto pFile = fopen(temporaryPath.c_str(), "wb");
+    bool written = pFile && fwrite(file.data(), 1, file.size(), pFile) == file.size();
+    if (pFile) {
+        written = fclose(pFile) == 0 && written;
+    }
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        aout << "Couldn't write texture cache entry " << path << std::endl;
+        unlink(temporaryPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+size_t TextureDiskCache::prune(size_t maxBytes) {
+    struct Entry {
+        std::string path;
+        size_t size;
+        timespec modified;
+    };
+    std::vector<Entry> entries;
+    size_t totalBytes = 0;
+
+    auto pDirectory = opendir(directory_.c_str());
+    if (!pDirectory) {
+        return 0;
+    }
+    while (auto pEntry = readdir(pDirectory)) {
+        std::string name = pEntry->d_name;
+        auto extension = name.rfind('.');
+        if (extension == std::string::npos) {
+            continue;
+        }
+        auto path = directory_ + "/" + name;
+        // leftovers from a write that never finished can always go
+        if (name.compare(extension, std::string::npos, ".tmp") == 0) {
+            unlink(path.c_str());
+            continue;
+        }
+        struct stat status{};
+        if (name.compare(extension, std::string::npos, kEntryExtension) != 0
+            || stat(path.c_str(), &status) != 0) {
+            continue;
+        }
+        entries.push_back({path, size_t(status.st_size), status.st_mtim});
+        totalBytes += size_t(status.st_size);
+    }
+    closedir(pDirectory);
+
+    // Oldest first
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+        return a.modified.tv_sec != b.modified.tv_sec ? a.modified.tv_sec < b.modified.tv_sec
+                                                      : a.modified.tv_nsec < b.modified.tv_nsec;
+    });
+    size_t deletedBytes = 0;
+    for (const auto &entry: entries) {
+        if (totalBytes - deletedBytes <= maxBytes) {
+            break;
+        }
+        if (unlink(entry.path.c_str()) == 0) {
+            deletedBytes += entry.size;
+        }
+    }
+    return deletedBytes;
+}
@@ -0,0 +1,120 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TEXTUREDISKCACHE_H
+#define ANDROIDGLINVESTIGATIONS_TEXTUREDISKCACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TextureFormat.h"
+
+/*!
+ * A texture read back from the disk cache. The levels point straight into a read only mapping of
+ * the cache file, which stays mapped for as long as this object lives.
+ */
+class MappedTexture {
+public:
+    ~MappedTexture();
+
+    int32_t width;
+    int32_t height;
+    TextureFormat format;
+    // the packed pixels of each mip level, largest first
+    std::vector<const uint8_t *> levels;
+
+private:
+    friend class TextureDiskCache;
+
+    MappedTexture() : width(0), height(0), format(TextureFormat::RGBA8), pMapping_(nullptr),
+                      mappingSize_(0) {}
+
+    void *pMapping_;
+    size_t mappingSize_;
+};
+
+/*!
+ * Keeps the final, GPU ready form of textures on disk so later runs can skip decoding and
+ * converting them. Entries are keyed by a hash of the source content, the load options and the
+ * device, so a changed asset, option or driver simply misses. Every entry carries a hash of its
+ * contents and anything that doesn't check out is deleted and rebuilt.
+ *
+ * @a find and @a store can be called from decode threads. Entries are written to a temporary file
+ * and renamed into place, so two threads storing the same key just race to an identical file.
+ */
+class TextureDiskCache {
+public:
+    /*!
+     * @param directory where entries are kept, created if it doesn't exist
+     * @param deviceSignature identifies the GPU and driver, ex: the GL renderer and version
+     *     strings. Entries made for another device are never used.
+     * @return the cache, or null if the directory can't be used
+     */
+    static std::unique_ptr<TextureDiskCache>
+    create(const std::string &directory, const std::string &deviceSignature);
+
+    /*!
+     * @param contentHash a hash of the encoded source image
+     * @param optionsHash a hash of everything that changes what the load produces
+     * @return the key for the entry
+     */
+    uint64_t makeKey(uint64_t contentHash, uint64_t optionsHash) const;
+
+    /*!
+     * Maps an entry. An entry that fails validation is deleted so it gets rebuilt.
+     * @param key the key from @a makeKey
+     * @return the mapped texture, or null on a miss
+     */
+    std::shared_ptr<const MappedTexture> find(uint64_t key);
+
+    /*!
+     * Writes an entry, replacing any old one. The file is written next to its final name and
+     * renamed into place, so a crash never leaves a partial entry behind.
+     * @param key the key from @a makeKey
+     * @param width the width of the first level
+     * @param height the height of the first level
+     * @param format the format every level is packed in
+     * @param levels the packed pixels of each level, largest first
+     * @return false if the entry couldn't be written
+     */
+    bool store(
+            uint64_t key,
+            int32_t width,
+            int32_t height,
+            TextureFormat format,
+            const std::vector<const uint8_t *> &levels);
+
+    /*!
+     * Deletes the least recently used entries until the cache fits in @a maxBytes
+     * @return the bytes deleted
+     */
+    size_t prune(size_t maxBytes);
+
+    inline size_t getHitCount() const { return hits_; }
+
+    inline size_t getMissCount() const { return misses_; }
+
+    inline size_t getCorruptCount() const { return corrupt_; }
+
+private:
+    TextureDiskCache(std::string directory, uint64_t deviceHash)
+            : directory_(std::move(directory)),
+              deviceHash_(deviceHash),
+              hits_(0),
+              misses_(0),
+              corrupt_(0) {}
+
+    /*!
+     * @return the path of the entry for @a key
+     */
+    std::string getEntryPath(uint64_t key) const;
+
+    std::string directory_;
+    uint64_t deviceHash_;
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+    std::atomic<size_t> corrupt_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TEXTUREDISKCACHE_H
@@ -0,0 +1,292 @@
+#include "TextureFormat.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+#include "AndroidOut.h"
+#include "PixelConvert.h"
+
+/*!
+ * GL_COMPRESSED_RGBA_ASTC_4x4_KHR, which gl3.h doesn't declare
+ */
+static constexpr GLenum kGlCompressedRgbaAstc4x4 = 0x93B0;
+
+/*!
+ * Per format GL enums, in the same order as @a TextureFormat
+ */
+static const TextureFormatInfo kTextureFormatInfos[] = {
+        {"RGBA8", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 1, 4},
+        {"RGB565", GL_RGB565, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, 1, 2},
+        {"RGBA4444", GL_RGBA4, GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, 1, 2},
+        {"RGB5_A1", GL_RGB5_A1, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, 1, 2},
+        {"R8", GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 1},
+        {"RG8", GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 1, 2},
+        {"ETC2_RGB8", GL_COMPRESSED_RGB8_ETC2, GL_NONE, GL_NONE, 4, 8},
+        {"ETC2_RGBA8", GL_COMPRESSED_RGBA8_ETC2_EAC, GL_NONE, GL_NONE, 4, 16},
+        {"ASTC_4x4", kGlCompressedRgbaAstc4x4, GL_NONE, GL_NONE, 4, 16},
+};
+
+static constexpr size_t kTextureFormatCount =
+        sizeof(kTextureFormatInfos) / sizeof(kTextureFormatInfos[0]);
+
+/*!
+ * Expands a @a bits bit channel back to 8 bits the way the GPU does when sampling
+ */
+static inline uint8_t expand(uint8_t value, int bits) {
+    int maxValue = (1 << bits) - 1;
+    return uint8_t((value * 255 + maxValue / 2) / maxValue);
+}
+
+/*!
+ * A table of how far each 8 bit value moves when packed into @a bits bits and expanded again
+ */
+static std::array<uint8_t, 256> buildErrorTable(int bits) {
+    std::array<uint8_t, 256> table{};
+    for (int value = 0; value < 256; value++) {
+        int roundTrip = expand(PixelConvert::quantize(uint8_t(value), bits), bits);
+        table[value] = uint8_t(std::abs(roundTrip - value));
+    }
+    return table;
+}
+
+const TextureFormatInfo &getTextureFormatInfo(TextureFormat format) {
+    return kTextureFormatInfos[static_cast<size_t>(format)];
+}
+
+bool isValidTextureFormat(uint32_t value) {
+    return value < kTextureFormatCount;
+}
+
+bool isCompressedTextureFormat(TextureFormat format) {
+    return getTextureFormatInfo(format).blockSize > 1;
+}
+
+bool isTextureFormatSupported(TextureFormat format) {
+    if (format != TextureFormat::ASTC_4x4) {
+        return true;
+    }
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+        auto extension = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+        if (extension && strcmp(extension, "GL_KHR_texture_compression_astc_ldr") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t getTextureRowSize(TextureFormat format, int32_t width) {
+    const auto &formatInfo = getTextureFormatInfo(format);
+    auto blocks = (width + formatInfo.blockSize - 1) / formatInfo.blockSize;
+    return size_t(blocks) * formatInfo.bytesPerBlock;
+}
+
+size_t getTextureMemorySize(
+        TextureFormat format,
+        int32_t width,
+        int32_t height,
+        int32_t levelCount) {
+    // Block compressed levels round up to whole blocks, down to the 1x1 level
+    auto blockSize = getTextureFormatInfo(format).blockSize;
+    size_t bytes = 0;
+    for (int32_t level = 0; level < levelCount; level++) {
+        auto blockRows = (std::max(height >> level, 1) + blockSize - 1) / blockSize;
+        bytes += size_t(blockRows) * getTextureRowSize(format, std::max(width >> level, 1));
+    }
+    return bytes;
+}
+
+std::shared_ptr<const uint8_t> sharePixels(std::vector<uint8_t> pixels) {
+    auto spPixels = std::make_shared<std::vector<uint8_t>>(std::move(pixels));
+    return std::shared_ptr<const uint8_t>(spPixels, spPixels->data());
+}
+
+void applyTextureFormatSwizzle(GLenum target, TextureFormat format) {
+    GLint swizzle[4] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+    if (format == TextureFormat::R8) {
+        swizzle[1] = swizzle[2] = GL_RED;
+        swizzle[3] = GL_ONE;
+    } else if (format == TextureFormat::RG8) {
+        swizzle[1] = swizzle[2] = GL_RED;
+        swizzle[3] = GL_GREEN;
+    }
+    glTexParameteri(target, GL_TEXTURE_SWIZZLE_R, swizzle[0]);
+    glTexParameteri(target, GL_TEXTURE_SWIZZLE_G, swizzle[1]);
+    glTexParameteri(target, GL_TEXTURE_SWIZZLE_B, swizzle[2]);
+    glTexParameteri(target, GL_TEXTURE_SWIZZLE_A, swizzle[3]);
+}
+
+TextureFormatPolicy TextureFormatPolicy::defaults() {
+    // RGB565 rounds to within 4 of the original value, RGBA4444 to within 9
+    return TextureFormatPolicy{false, 4, 16};
+}
+
+TextureFormatPolicy TextureFormatPolicy::keepRGBA8() {
+    return TextureFormatPolicy{true, 0, 0};
+}
+
+ImageAnalysis analyzeImage(const uint8_t *rgba, size_t pixelCount) {
+    static const auto kError4 = buildErrorTable(4);
+    static const auto kError5 = buildErrorTable(5);
+    static const auto kError6 = buildErrorTable(6);
+
+    ImageAnalysis analysis{true, true, true, 0, 0, 0, 0};
+    std::unordered_set<uint32_t> colors;
+
+    for (size_t i = 0; i < pixelCount; i++) {
+        const uint8_t *pixel = rgba + i * 4;
+        uint8_t r = pixel[0];
+        uint8_t g = pixel[1];
+        uint8_t b = pixel[2];
+        uint8_t a = pixel[3];
+
+        analysis.opaque &= a == 255;
+        analysis.binaryAlpha &= a == 0 || a == 255;
+        analysis.grayscale &= r == g && g == b;
+
+        if (colors.size() < ImageAnalysis::kMaxCountedColors) {
+            colors.insert(uint32_t(r) | uint32_t(g) << 8 | uint32_t(b) << 16 | uint32_t(a) << 24);
+        }
+
+        // RGB565 drops alpha entirely, so anything not opaque counts as error
+        uint8_t error565 = std::max({kError5[r], kError6[g], kError5[b], uint8_t(255 - a)});
+        uint8_t error4444 = std::max({kError4[r], kError4[g], kError4[b], kError4[a]});
+        uint8_t error5551 = std::max(
+                {kError5[r], kError5[g], kError5[b], std::min(a, uint8_t(255 - a))});
+
+        analysis.maxErrorRGB565 = std::max(analysis.maxErrorRGB565, error565);
+        analysis.maxErrorRGBA4444 = std::max(analysis.maxErrorRGBA4444, error4444);
+        analysis.maxErrorRGB5A1 = std::max(analysis.maxErrorRGB5A1, error5551);
+    }
+
+    analysis.colorCount = uint32_t(colors.size());
+    return analysis;
+}
+
+TextureFormat chooseTextureFormat(const ImageAnalysis &analysis, const TextureFormatPolicy &policy) {
+    // Grayscale formats are exact, and at least as small as anything else that would fit
+    if (analysis.grayscale) {
+        return analysis.opaque ? TextureFormat::R8 : TextureFormat::RG8;
+    }
+
+    bool flatArt = policy.flatArtColorCount
+                   && analysis.colorCount <= policy.flatArtColorCount;
+    uint8_t allowedError = (policy.lossless || flatArt) ? 0 : policy.maxChannelError;
+
+    // All the 16 bit formats are the same size, so try the ones that keep the most color first
+    if (analysis.maxErrorRGB565 <= allowedError) {
+        return TextureFormat::RGB565;
+    }
+    if (analysis.maxErrorRGB5A1 <= allowedError) {
+        return TextureFormat::RGB5_A1;
+    }
+    if (analysis.maxErrorRGBA4444 <= allowedError) {
+        return TextureFormat::RGBA4444;
+    }
+    return TextureFormat::RGBA8;
+}
+
+void convertPixels(
+        TextureFormat format,
+        const uint8_t *rgba,
+        size_t pixelCount,
+        std::vector<uint8_t> &out) {
+    out.resize(pixelCount * getTextureFormatInfo(format).bytesPerBlock);
+    auto *out16 = reinterpret_cast<uint16_t *>(out.data());
+
+    switch (format) {
+        case TextureFormat::RGBA8:
+            std::copy(rgba, rgba + pixelCount * 4, out.begin());
+            break;
+        case TextureFormat::RGB565:
+            PixelConvert::packRGB565(rgba, out16, pixelCount);
+            break;
+        case TextureFormat::RGBA4444:
+            PixelConvert::packRGBA4444(rgba, out16, pixelCount);
+            break;
+        case TextureFormat::RGB5_A1:
+            PixelConvert::packRGB5A1(rgba, out16, pixelCount);
+            break;
+        case TextureFormat::R8:
+            PixelConvert::extractR8(rgba, out.data(), pixelCount);
+            break;
+        case TextureFormat::RG8:
+            PixelConvert::extractRA8(rgba, out.data(), pixelCount);
+            break;
+        case TextureFormat::ETC2_RGB8:
+        case TextureFormat::ETC2_RGBA8:
+        case TextureFormat::ASTC_4x4:
+            // there's no encoder here, these only come already packed
+            assert(false);
+            out.clear();
+            break;
+    }
+}
+
+void TextureMetadataStore::load(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    dirty_ = false;
+
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        // <key in hex> <format> <asset path>, the path goes last since it may contain spaces
+        std::istringstream lineStream(line);
+        uint64_t key;
+        int format;
+        if (!(lineStream >> std::hex >> key >> std::dec >> format) || format < 0
+            || size_t(format) >= kTextureFormatCount) {
+            continue;
+        }
+        std::string assetPath;
+        std::getline(lineStream >> std::ws, assetPath);
+        if (!assetPath.empty()) {
+            entries_[assetPath] = TextureMetadata{key, TextureFormat(format)};
+        }
+    }
+    aout << "Loaded texture metadata for " << entries_.size() << " assets" << std::endl;
+}
+
+void TextureMetadataStore::save(const std::string &path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!dirty_) {
+        return;
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    for (const auto &[assetPath, metadata]: entries_) {
+        file << std::hex << metadata.key << std::dec << " " << int(metadata.format) << " "
+             << assetPath << "\n";
+    }
+    if (file) {
+        dirty_ = false;
+    } else {
+        aout << "Failed to save texture metadata to " << path << std::endl;
+    }
+}
+
+bool TextureMetadataStore::find(
+        const std::string &assetPath,
+        uint64_t key,
+        TextureMetadata &outMetadata) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(assetPath);
+    if (it == entries_.end() || it->second.key != key) {
+        return false;
+    }
+    outMetadata = it->second;
+    return true;
+}
+
+void TextureMetadataStore::record(const std::string &assetPath, const TextureMetadata &metadata) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[assetPath] = metadata;
+    dirty_ = true;
+}
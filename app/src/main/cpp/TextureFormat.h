@@ -0,0 +1,229 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TEXTUREFORMAT_H
+#define ANDROIDGLINVESTIGATIONS_TEXTUREFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <GLES3/gl3.h>
+
+/*!
+ * The storage formats a texture can be uploaded as. Everything up to the block compressed formats
+ * can be packed from decoded RGBA8 pixels.
+ */
+enum class TextureFormat : uint8_t {
+    RGBA8,
+    RGB565,
+    RGBA4444,
+    RGB5_A1,
+    // grayscale, sampled as (r, r, r, 1) through a texture swizzle
+    R8,
+    // grayscale + alpha, sampled as (r, r, r, g) through a texture swizzle
+    RG8,
+    // block compressed, these only ever come already packed from a KTX2 file. ETC2 is part of
+    // GLES 3.0, ASTC needs GL_KHR_texture_compression_astc_ldr.
+    ETC2_RGB8,
+    ETC2_RGBA8,
+    ASTC_4x4
+};
+
+/*!
+ * How to hand a @a TextureFormat to GL
+ */
+struct TextureFormatInfo {
+    const char *name;
+    GLenum internalFormat;
+    GLenum format;
+    GLenum type;
+    // the width and height of a block in pixels, 1 for formats that aren't block compressed
+    int32_t blockSize;
+    size_t bytesPerBlock;
+};
+
+/*!
+ * @param format the format to look up
+ * @return the GL enums and size of @a format
+ */
+const TextureFormatInfo &getTextureFormatInfo(TextureFormat format);
+
+/*!
+ * @param value a number read back from a file
+ * @return true if @a value is a @a TextureFormat
+ */
+bool isValidTextureFormat(uint32_t value);
+
+/*!
+ * @return true if @a format is stored in blocks of pixels, which can't be packed from RGBA8 here
+ *     and are uploaded with glCompressedTexSubImage
+ */
+bool isCompressedTextureFormat(TextureFormat format);
+
+/*!
+ * Checks the GL extensions for formats that aren't part of core GLES 3.0. Needs a current context.
+ * @return true if the device can sample @a format
+ */
+bool isTextureFormatSupported(TextureFormat format);
+
+/*!
+ * @param format the storage format
+ * @param width the width of the image
+ * @return the bytes in one row of blocks, which is a row of pixels for uncompressed formats
+ */
+size_t getTextureRowSize(TextureFormat format, int32_t width);
+
+/*!
+ * @param format the storage format
+ * @param width the width of the first level
+ * @param height the height of the first level
+ * @param levelCount how many mip levels there are
+ * @return the bytes an image of that size takes on the GPU, ignoring driver padding
+ */
+size_t getTextureMemorySize(
+        TextureFormat format,
+        int32_t width,
+        int32_t height,
+        int32_t levelCount);
+
+/*!
+ * Applies the texture swizzle a format needs to be sampled as RGBA. Call with the texture bound.
+ * @param target the target the texture is bound to
+ * @param format the format of the bound texture
+ */
+void applyTextureFormatSwizzle(GLenum target, TextureFormat format);
+
+/*!
+ * What an image's pixels actually use. The error fields are the largest difference, in 8 bit
+ * units, between a channel and what it would come back as after packing it into that format.
+ */
+struct ImageAnalysis {
+    bool opaque;
+    // every alpha is either 0 or 255
+    bool binaryAlpha;
+    // every pixel has r == g == b
+    bool grayscale;
+    // distinct RGBA colors, stops counting at kMaxCountedColors
+    uint32_t colorCount;
+    uint8_t maxErrorRGB565;
+    uint8_t maxErrorRGBA4444;
+    uint8_t maxErrorRGB5A1;
+
+    static constexpr uint32_t kMaxCountedColors = 4096;
+};
+
+/*!
+ * Decides how much quality an asset may give up for a smaller format
+ */
+struct TextureFormatPolicy {
+    // never pick a format that changes any pixel
+    bool lossless;
+    // the largest per channel error a lossy format may introduce, in 8 bit units
+    uint8_t maxChannelError;
+    // with this many colors or fewer, an image is treated as flat art and only exact formats are
+    // considered, since banding on flat colors is easy to spot. 0 disables the check
+    uint32_t flatArtColorCount;
+
+    /*!
+     * @return a policy that accepts the error of RGB565 but not RGBA4444 on photographic content
+     */
+    static TextureFormatPolicy defaults();
+
+    /*!
+     * @return a policy that always keeps the decoded RGBA8 pixels
+     */
+    static TextureFormatPolicy keepRGBA8();
+};
+
+/*!
+ * Looks at every pixel to see what the image actually needs
+ * @param rgba tightly packed RGBA8 pixels
+ * @param pixelCount how many pixels @a rgba holds
+ * @return the analysis
+ */
+ImageAnalysis analyzeImage(const uint8_t *rgba, size_t pixelCount);
+
+/*!
+ * Picks the smallest format that @a policy accepts for an image
+ * @param analysis the result of @a analyzeImage
+ * @param policy the quality requirements of the asset
+ * @return the chosen format
+ */
+TextureFormat chooseTextureFormat(const ImageAnalysis &analysis, const TextureFormatPolicy &policy);
+
+/*!
+ * Packs RGBA8 pixels into @a format
+ * @param format the format to pack into, not a block compressed one
+ * @param rgba tightly packed RGBA8 pixels
+ * @param pixelCount how many pixels @a rgba holds
+ * @param out receives the packed pixels, resized to fit
+ */
+void convertPixels(
+        TextureFormat format,
+        const uint8_t *rgba,
+        size_t pixelCount,
+        std::vector<uint8_t> &out);
+
+/*!
+ * Hands ownership of packed pixels to a shared pointer, so they can be passed around the same way
+ * as pixels that live in a mapped file
+ * @param pixels the pixels to take
+ * @return a pointer to the first pixel that keeps the pixels alive
+ */
+std::shared_ptr<const uint8_t> sharePixels(std::vector<uint8_t> pixels);
+
+/*!
+ * What was decided for a texture the last time it was loaded
+ */
+struct TextureMetadata {
+    // the hash of the encoded asset and the options that decide the format, so the choice isn't
+    // reused once either changes
+    uint64_t key;
+    TextureFormat format;
+};
+
+/*!
+ * Remembers the format chosen for each asset, so later loads can skip the analysis. It is saved as
+ * a small text file, one asset per line. Lookups and records are safe from decode threads.
+ */
+class TextureMetadataStore {
+public:
+    inline TextureMetadataStore() : dirty_(false) {}
+
+    /*!
+     * Replaces the contents of the store with what's saved at @a path. A missing or unreadable
+     * file leaves the store empty.
+     * @param path the file to read
+     */
+    void load(const std::string &path);
+
+    /*!
+     * Writes the store to @a path if anything changed since it was loaded or saved
+     * @param path the file to write
+     */
+    void save(const std::string &path);
+
+    /*!
+     * @param assetPath the asset to look up
+     * @param key the current key of the asset, see @a TextureMetadata::key
+     * @param outMetadata receives a copy of the recorded metadata
+     * @return false if there is none or it was recorded under a different key
+     */
+    bool find(
+            const std::string &assetPath,
+            uint64_t key,
+            TextureMetadata &outMetadata) const;
+
+    /*!
+     * Records the metadata for an asset
+     */
+    void record(const std::string &assetPath, const TextureMetadata &metadata);
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, TextureMetadata> entries_;
+    bool dirty_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TEXTUREFORMAT_H
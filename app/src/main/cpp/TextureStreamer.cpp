@@ -0,0 +1,331 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+
+#include "AndroidOut.h"
+#include "DecodePool.h"
+#include "TextureArray.h"
+#include "TextureUploadQueue.h"
+
+/*!
+ * The largest level uploaded during the load. It's small enough to cost next to nothing and big
+ * enough to look reasonable while the rest streams in.
+ */
+static constexpr uint32_t kInitialResidentSize = 64;
+
+/*!
+ * Packs every level of @a container from @a firstLevel down into @a format. RGBA8 levels are used
+ * straight from the container, kept alive by @a spOwner, rather than copied.
+ */
+static std::vector<std::shared_ptr<const uint8_t>> packChain(
+        const std::shared_ptr<const void> &spOwner,
+        const TextureContainer &container,
+        size_t firstLevel,
+        TextureFormat format) {
+    std::vector<std::shared_ptr<const uint8_t>> levels;
+    for (size_t i = firstLevel; i < container.getLevelCount(); i++) {
+        const auto &level = container.getLevel(i);
+        if (format == TextureFormat::RGBA8) {
+            levels.emplace_back(spOwner, level.data);
+            continue;
+        }
+        std::vector<uint8_t> pixels;
+        convertPixels(format, level.data, size_t(level.width) * level.height, pixels);
+        levels.push_back(sharePixels(std::move(pixels)));
+    }
+    return levels;
+}
+
+TextureStreamer::PendingLayer::~PendingLayer() {
+    if (committed) {
+        return;
+    }
+    spArray->releaseLayer(layer);
+
+    // Let the texture try again on the next update
+    if (auto spStreamed = wpStreamed.lock()) {
+        spStreamed->pendingLevel = spStreamed->residentLevel;
+    }
+}
+
+TextureStreamer::TextureStreamer(TextureArrayPool &arrayPool, TextureUploadQueue &uploadQueue)
+        : arrayPool_(arrayPool), uploadQueue_(uploadQueue), levelBias_(0) {}
+
+std::shared_ptr<TextureAsset> TextureStreamer::load(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        const TextureLoadOptions &options) {
+    TextureAsset::PrebuiltFiles files;
+    TextureAsset::openPrebuiltFiles(fileSystem, assetPath, options, files);
+    return load(fileSystem, assetPath, files, options);
+}
+
+std::shared_ptr<TextureAsset> TextureStreamer::load(
+        FileSystem &fileSystem,
+        const std::string &assetPath,
+        TextureAsset::PrebuiltFiles &files,
+        const TextureLoadOptions &options) {
+    // A KTX2 file loads whole, openPrebuiltFiles doesn't look for a chain when this device can
+    // use one. Block compressed it's smaller fully resident than most of a streamed chain.
+    if (!canStream(files)) {
+        return TextureAsset::loadIntoArray(fileSystem, assetPath, files, arrayPool_, options);
+    }
+
+    auto spStreamed = std::make_shared<StreamedTexture>();
+    spStreamed->pFile = std::move(files.pMipChainFile);
+    spStreamed->container = files.mipChain;
+
+    const auto &container = spStreamed->container;
+    const auto &topLevel = container.getLevel(0);
+    spStreamed->format = TextureAsset::selectFormat(
+            TextureContainer::containerPathFor(assetPath),
+            spStreamed->pFile->getLength(),
+            topLevel.data,
+            size_t(topLevel.width) * topLevel.height,
+            options);
+    spStreamed->maxDisplayWidth = options.maxDisplayWidth;
+    spStreamed->maxDisplayHeight = options.maxDisplayHeight;
+    spStreamed->droppedLevels = 0;
+
+    // Upload the small levels straight away so the texture can be drawn this frame
+    size_t level = findTargetLevel(*spStreamed);
+    while (level + 1 < container.getLevelCount()
+           && std::max(container.getLevel(level).width, container.getLevel(level).height)
+              > kInitialResidentSize) {
+        level++;
+    }
+    const auto &baseLevel = container.getLevel(level);
+    auto levels = packChain(spStreamed, container, level, spStreamed->format);
+    auto [spArray, layer] = arrayPool_.allocate(
+            GLsizei(baseLevel.width), GLsizei(baseLevel.height), spStreamed->format);
+    for (size_t i = 0; i < levels.size(); i++) {
+        spArray->uploadLayerLevel(layer, GLint(i), levels[i].get());
+    }
+
+    auto spTexture = std::shared_ptr<TextureAsset>(
+            new TextureAsset(spArray, layer, spStreamed->format));
+    spStreamed->wpTexture = spTexture;
+    spStreamed->residentLevel = level;
+    spStreamed->pendingLevel = level;
+    textures_.push_back(spStreamed);
+
+    aout << "Streaming " << assetPath << ", starting at " << baseLevel.width << "x"
+         << baseLevel.height << std::endl;
+    return spTexture;
+}
+
+std::vector<std::shared_ptr<TextureAsset>> TextureStreamer::loadBatch(
+        FileSystem &fileSystem,
+        const std::vector<TextureLoadRequest> &requests,
+        DecodePool &decodePool) {
+    // Streamed textures only pack their small levels up front, so they load right away. Everything
+    // else needs a full decode, and those run together.
+    std::vector<std::shared_ptr<TextureAsset>> textures(requests.size());
+    std::vector<TextureLoadRequest> decodeRequests;
+    std::vector<TextureAsset::PrebuiltFiles> decodeFiles;
+    std::vector<size_t> decodeIndices;
+    for (size_t i = 0; i < requests.size(); i++) {
+        const auto &request = requests[i];
+        TextureAsset::PrebuiltFiles files;
+        TextureAsset::openPrebuiltFiles(fileSystem, request.assetPath, request.options, files);
+        if (canStream(files)) {
+            textures[i] = load(fileSystem, request.assetPath, files, request.options);
+        } else {
+            decodeRequests.push_back(request);
+            decodeFiles.push_back(std::move(files));
+            decodeIndices.push_back(i);
+        }
+    }
+
+    auto decoded = TextureAsset::loadBatchIntoArrays(
+            fileSystem, decodeRequests, decodeFiles, arrayPool_, decodePool);
+    for (size_t i = 0; i < decoded.size(); i++) {
+        textures[decodeIndices[i]] = std::move(decoded[i]);
+    }
+    return textures;
+}
+
+Task<std::shared_ptr<TextureAsset>> TextureStreamer::loadAsync(
+        FileSystem &fileSystem,
+        std::string assetPath,
+        TextureLoadOptions options,
+        JobSystem &jobSystem,
+        CancellationToken cancellation) {
+    // Streaming only packs the small levels, that's quick enough to do on the GL thread
+    co_await resumeOn(jobSystem, JobAffinity::MainThread);
+    if (cancellation.isCancelled()) {
+        co_return nullptr;
+    }
+    auto spFiles = std::make_shared<TextureAsset::PrebuiltFiles>();
+    TextureAsset::openPrebuiltFiles(fileSystem, assetPath, options, *spFiles);
+    if (canStream(*spFiles)) {
+        co_return load(fileSystem, assetPath, *spFiles, options);
+    }
+    co_return co_await TextureAsset::loadIntoArrayAsync(
+            fileSystem,
+            std::move(assetPath),
+            std::move(spFiles),
+            arrayPool_,
+            options,
+            jobSystem,
+            cancellation);
+}
+
+void TextureStreamer::setDisplaySize(
+        const TextureAsset &texture,
+        int32_t maxWidth,
+        int32_t maxHeight) {
+    for (auto &spStreamed: textures_) {
+        if (spStreamed->wpTexture.lock().get() == &texture) {
+            spStreamed->maxDisplayWidth = maxWidth;
+            spStreamed->maxDisplayHeight = maxHeight;
+            return;
+        }
+    }
+}
+
+void TextureStreamer::setLevelBias(int bias) {
+    levelBias_ = std::max(bias, 0);
+}
+
+bool TextureStreamer::isSettled() const {
+    for (const auto &spStreamed: textures_) {
+        if (spStreamed->wpTexture.expired()) {
+            continue;
+        }
+        if (spStreamed->pendingLevel != spStreamed->residentLevel
+            || findTargetLevel(*spStreamed) != spStreamed->residentLevel) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t TextureStreamer::findTargetLevel(const StreamedTexture &texture) const {
+    auto level = TextureAsset::findFirstLevel(
+            texture.container, texture.maxDisplayWidth, texture.maxDisplayHeight);
+    return std::min(
+            level + size_t(levelBias_ + texture.droppedLevels),
+            texture.container.getLevelCount() - 1);
+}
+
+void TextureStreamer::update() {
+    // Forget textures that have been freed, this closes their containers
+    textures_.erase(
+            std::remove_if(
+                    textures_.begin(),
+                    textures_.end(),
+                    [](const std::shared_ptr<StreamedTexture> &spStreamed) {
+                        return spStreamed->wpTexture.expired();
+                    }),
+            textures_.end());
+
+    for (auto &spStreamed: textures_) {
+        if (spStreamed->pendingLevel != spStreamed->residentLevel) {
+            continue;
+        }
+
+        // Grow one level at a time so the texture sharpens progressively, but drop straight to
+        // the target since the smaller chain is cheap to upload
+        auto target = findTargetLevel(*spStreamed);
+        if (target < spStreamed->residentLevel) {
+            startMove(spStreamed, spStreamed->residentLevel - 1);
+        } else if (target > spStreamed->residentLevel) {
+            startMove(spStreamed, target);
+        }
+    }
+}
+
+void TextureStreamer::startMove(
+        const std::shared_ptr<StreamedTexture> &spStreamed,
+        size_t level) {
+    const auto &baseLevel = spStreamed->container.getLevel(level);
+    auto [spArray, layer] = arrayPool_.allocate(
+            GLsizei(baseLevel.width), GLsizei(baseLevel.height), spStreamed->format);
+    std::weak_ptr<StreamedTexture> wpStreamed = spStreamed;
+    auto spPending = std::make_shared<PendingLayer>();
+    spPending->wpStreamed = wpStreamed;
+    spPending->spArray = spArray;
+    spPending->layer = layer;
+    spPending->committed = false;
+    spStreamed->pendingLevel = level;
+
+    auto levels = packChain(spStreamed, spStreamed->container, level, spStreamed->format);
+    for (size_t i = 0; i < levels.size(); i++) {
+        TextureUpload upload{
+                spStreamed->wpTexture,
+                GL_TEXTURE_2D_ARRAY,
+                0,
+                spArray,
+                layer,
+                GLint(i),
+                std::max(GLsizei(baseLevel.width) >> i, 1),
+                std::max(GLsizei(baseLevel.height) >> i, 1),
+                spStreamed->format,
+                std::move(levels[i]),
+                {}};
+
+        // The queue is in order, so once the last level is issued the whole layer is
+        if (i + 1 == levels.size()) {
+            upload.onComplete = [wpStreamed, spPending, level]() {
+                auto spStreamed = wpStreamed.lock();
+                auto spTexture = spStreamed ? spStreamed->wpTexture.lock() : nullptr;
+                if (!spTexture) {
+                    return;
+                }
+                spTexture->moveToLayer(spPending->spArray, spPending->layer);
+                spPending->committed = true;
+                spStreamed->residentLevel = level;
+                spStreamed->pendingLevel = level;
+            };
+        }
+        uploadQueue_.enqueue(std::move(upload));
+    }
+}
+
+size_t TextureStreamer::dropIdleLevels(int levels, uint64_t frame, uint64_t idleFrames) {
+    size_t residentBytes = getResidentBytes();
+
+    size_t targetBytes = 0;
+    for (const auto &spStreamed: textures_) {
+        auto spTexture = spStreamed->wpTexture.lock();
+        if (spTexture && spTexture->getLastDrawnFrame() + idleFrames <= frame) {
+            spStreamed->droppedLevels += levels;
+        }
+        auto level = std::max(spStreamed->residentLevel, findTargetLevel(*spStreamed));
+        targetBytes += getChainMemorySize(*spStreamed, level);
+    }
+    return residentBytes - targetBytes;
+}
+
+bool TextureStreamer::hasDroppedLevels() const {
+    for (const auto &spStreamed: textures_) {
+        if (spStreamed->droppedLevels > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TextureStreamer::restoreDroppedLevels() {
+    for (auto &spStreamed: textures_) {
+        spStreamed->droppedLevels = 0;
+    }
+}
+
+size_t TextureStreamer::getChainMemorySize(const StreamedTexture &texture, size_t level) {
+    const auto &baseLevel = texture.container.getLevel(level);
+    return getTextureMemorySize(
+            texture.format,
+            int32_t(baseLevel.width),
+            int32_t(baseLevel.height),
+            int32_t(texture.container.getLevelCount() - level));
+}
+
+size_t TextureStreamer::getResidentBytes() const {
+    size_t bytes = 0;
+    for (const auto &spStreamed: textures_) {
+        bytes += getChainMemorySize(*spStreamed, spStreamed->residentLevel);
+    }
+    return bytes;
+}
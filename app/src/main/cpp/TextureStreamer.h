@@ -0,0 +1,209 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TEXTURESTREAMER_H
+#define ANDROIDGLINVESTIGATIONS_TEXTURESTREAMER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FileSystem.h"
+#include "TextureAsset.h"
+#include "TextureContainer.h"
+
+class DecodePool;
+class TextureArrayPool;
+class TextureUploadQueue;
+
+/*!
+ * Loads textures a few mip levels at a time so they can be drawn almost straight away.
+ *
+ * A texture starts out with just its small levels, uploaded during the load. Each @a update then
+ * moves it one level closer to the resolution it's displayed at: the next larger chain is streamed
+ * into a layer of a bigger @a TextureArray through the upload queue, and the texture switches over
+ * once it has all landed. Textures move back down to a smaller array when they're displayed
+ * smaller, when @a setLevelBias asks for less memory, or when @a dropIdleLevels trims the ones
+ * that aren't being drawn.
+ *
+ * Only images with a TextureContainer are streamed. The container stays mapped so any level can
+ * be uploaded again later. Anything else is loaded whole with TextureAsset::loadAssetIntoArray.
+ */
+class TextureStreamer {
+public:
+    /*!
+     * @param arrayPool the pool streamed textures are allocated from
+     * @param uploadQueue the queue that larger levels are streamed through
+     */
+    TextureStreamer(TextureArrayPool &arrayPool, TextureUploadQueue &uploadQueue);
+
+    /*!
+     * Loads the small levels of a texture, the rest follow over the next frames
+     * @param fileSystem where the asset is read from
+     * @param assetPath The path to the asset
+     * @param options how the texture is stored, the max display size is where streaming stops
+     * @return a shared pointer to a texture asset, streaming stops when it's cleaned up
+     */
+    std::shared_ptr<TextureAsset> load(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            const TextureLoadOptions &options);
+
+    /*!
+     * Loads a batch of textures. Streamed ones load their small levels like @a load, the rest are
+     * decoded in parallel on @a decodePool and uploaded whole.
+     * @param fileSystem where the asset is read from
+     * @param requests the textures to load
+     * @param decodePool where images without a TextureContainer are decoded, it's drained before
+     *     this returns
+     * @return a texture for each request in the same order, null where one failed to load
+     */
+    std::vector<std::shared_ptr<TextureAsset>> loadBatch(
+            FileSystem &fileSystem,
+            const std::vector<TextureLoadRequest> &requests,
+            DecodePool &decodePool);
+
+    /*!
+     * Loads a texture as a coroutine. Streamed ones load their small levels like @a load, the
+     * rest are decoded on a worker with TextureAsset::loadAssetIntoArrayAsync.
+     * @param fileSystem where the asset is read from
+     * @param assetPath The path to the asset
+     * @param options how the texture is stored
+     * @param jobSystem runs the decode, its main thread has to be the GL thread
+     * @param cancellation stops the load once cancelled
+     * @return a task for the texture, null where it failed to load or was cancelled. The awaiting
+     *     coroutine carries on on the main thread.
+     */
+    Task<std::shared_ptr<TextureAsset>> loadAsync(
+            FileSystem &fileSystem,
+            std::string assetPath,
+            TextureLoadOptions options,
+            JobSystem &jobSystem,
+            CancellationToken cancellation);
+
+    /*!
+     * Changes how large a streamed texture is displayed, which decides how many levels it needs
+     * @param texture a texture returned from @a load
+     * @param maxWidth the largest width it appears on screen at, 0 for no limit
+     * @param maxHeight the largest height it appears on screen at, 0 for no limit
+     */
+    void setDisplaySize(const TextureAsset &texture, int32_t maxWidth, int32_t maxHeight);
+
+    /*!
+     * Drops extra levels from every streamed texture, halving its size each time
+     * @param bias how many levels below the display size to keep textures at, 0 for none
+     */
+    void setLevelBias(int bias);
+
+    constexpr int getLevelBias() const { return levelBias_; }
+
+    /*!
+     * Gives memory back from streamed textures that haven't been drawn lately, so nothing on
+     * screen gets blurrier. The levels are dropped over the next updates and stay dropped until
+     * @a restoreDroppedLevels.
+     * @param levels how many more levels to drop from each idle texture
+     * @param frame the renderer's current frame count
+     * @param idleFrames how many frames a texture has to have gone undrawn to count as idle
+     * @return the bytes that will be freed once every idle texture has dropped its levels
+     */
+    size_t dropIdleLevels(int levels, uint64_t frame, uint64_t idleFrames);
+
+    /*!
+     * @return true if @a dropIdleLevels dropped levels that haven't been restored
+     */
+    bool hasDroppedLevels() const;
+
+    /*!
+     * Lets textures trimmed by @a dropIdleLevels stream back up to their display size
+     */
+    void restoreDroppedLevels();
+
+    /*!
+     * Starts moving textures towards the resolution they need. Call once per frame on the GL
+     * thread, before the upload queue is processed.
+     */
+    void update();
+
+    /*!
+     * @return true if every streamed texture is at the resolution it needs, so @a update has
+     *     nothing to do until a display size or the level bias changes
+     */
+    bool isSettled() const;
+
+    /*!
+     * @return the bytes of texture memory the resident levels of streamed textures use
+     */
+    size_t getResidentBytes() const;
+
+private:
+    struct StreamedTexture {
+        std::weak_ptr<TextureAsset> wpTexture;
+        // kept open so the container's levels stay mapped
+        std::unique_ptr<File> pFile;
+        TextureContainer container;
+        TextureFormat format;
+        int32_t maxDisplayWidth;
+        int32_t maxDisplayHeight;
+        // levels dropped while the texture was idle, on top of the level bias
+        int droppedLevels;
+        // the container level that's the first level of the texture's layer
+        size_t residentLevel;
+        // the level being moved to, the same as residentLevel when nothing is in flight
+        size_t pendingLevel;
+    };
+
+    /*!
+     * A layer being filled for a texture to move into. It goes back to its array unless the move
+     * completes, which covers the texture being freed or the upload queue being cleared mid
+     * stream.
+     */
+    struct PendingLayer {
+        ~PendingLayer();
+
+        std::weak_ptr<StreamedTexture> wpStreamed;
+        std::shared_ptr<TextureArray> spArray;
+        GLint layer;
+        bool committed;
+    };
+
+    /*!
+     * @return true if the asset is streamed, it has a usable TextureContainer and no KTX2 file
+     *     that's preferred over it
+     */
+    static inline bool canStream(const TextureAsset::PrebuiltFiles &files) {
+        return files.pMipChainFile != nullptr;
+    }
+
+    /*!
+     * @a load with the asset's files already opened. Assets that can't be streamed are loaded
+     * whole with TextureAsset::loadIntoArray.
+     * @param files the asset's files from TextureAsset::openPrebuiltFiles, they're moved from
+     */
+    std::shared_ptr<TextureAsset> load(
+            FileSystem &fileSystem,
+            const std::string &assetPath,
+            TextureAsset::PrebuiltFiles &files,
+            const TextureLoadOptions &options);
+
+    /*!
+     * @return the bytes @a texture takes with its chain starting at @a level
+     */
+    static size_t getChainMemorySize(const StreamedTexture &texture, size_t level);
+
+    /*!
+     * @return the container level @a texture should end up at
+     */
+    size_t findTargetLevel(const StreamedTexture &texture) const;
+
+    /*!
+     * Allocates a layer sized for @a level and queues the chain from @a level down into it
+     * @param spStreamed the texture to move
+     * @param level the container level the new layer starts at
+     */
+    void startMove(const std::shared_ptr<StreamedTexture> &spStreamed, size_t level);
+
+    TextureArrayPool &arrayPool_;
+    TextureUploadQueue &uploadQueue_;
+    std::vector<std::shared_ptr<StreamedTexture>> textures_;
+    int levelBias_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TEXTURESTREAMER_H
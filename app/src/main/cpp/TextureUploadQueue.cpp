@@ -0,0 +1,273 @@
+#include "TextureUploadQueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "AndroidOut.h"
+#include "GpuDeletionQueue.h"
+#include "TextureArray.h"
+#include "Utility.h"
+
+/*!
+ * A conservative guess at staging throughput until the first chunk has been measured
+ */
+static constexpr double kInitialBytesPerMillisecond = 256.0 * 1024.0;
+
+/*!
+ * How quickly the throughput estimate follows new measurements
+ */
+static constexpr double kThroughputSmoothing = 0.25;
+
+TextureUploadQueue::TextureUploadQueue(
+        float budgetMilliseconds,
+        size_t stagingBufferSize,
+        size_t stagingBufferCount)
+        : budgetMilliseconds_(budgetMilliseconds),
+          stagingBufferSize_(stagingBufferSize),
+          staging_(std::max<size_t>(stagingBufferCount, 1), StagingBuffer{0, 0, nullptr}),
+          nextStaging_(0),
+          nextRow_(0),
+          bytesPerMillisecond_(kInitialBytesPerMillisecond),
+          bytesLastFrame_(0) {}
+
+void TextureUploadQueue::enqueue(TextureUpload upload) {
+    uploads_.push_back(std::move(upload));
+}
+
+void TextureUploadQueue::clear() {
+    uploads_.clear();
+    nextRow_ = 0;
+}
+
+void TextureUploadQueue::releaseGlObjects() {
+    clear();
+    for (auto &staging: staging_) {
+        if (staging.fence) {
+            glDeleteSync(staging.fence);
+        }
+        // Uploads from it may not have landed yet
+        GpuDeletionQueue::release(GpuResourceType::Buffer, staging.buffer);
+        staging = StagingBuffer{0, 0, nullptr};
+    }
+    nextStaging_ = 0;
+}
+
+size_t TextureUploadQueue::releaseStagingBuffers() {
+    size_t bytes = 0;
+    for (auto &staging: staging_) {
+        if (staging.buffer && isAvailable(staging)) {
+            glDeleteBuffers(1, &staging.buffer);
+            bytes += size_t(staging.size);
+            staging = StagingBuffer{0, 0, nullptr};
+        }
+    }
+    return bytes;
+}
+
+size_t TextureUploadQueue::getPendingBytes() const {
+    size_t bytes = 0;
+    for (const auto &upload: uploads_) {
+        bytes += getTextureMemorySize(upload.format, upload.width, upload.height, 1);
+    }
+    if (!uploads_.empty()) {
+        const auto &front = uploads_.front();
+        bytes -= size_t(nextRow_) * getTextureRowSize(front.format, front.width);
+    }
+    return bytes;
+}
+
+bool TextureUploadQueue::isAvailable(StagingBuffer &staging) {
+    if (!staging.fence) {
+        return true;
+    }
+    auto status = glClientWaitSync(staging.fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return false;
+    }
+    glDeleteSync(staging.fence);
+    staging.fence = nullptr;
+    return true;
+}
+
+void TextureUploadQueue::process() {
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    auto frameStart = std::chrono::steady_clock::now();
+    bytesLastFrame_ = 0;
+
+    while (!uploads_.empty()) {
+        auto &upload = uploads_.front();
+        if (upload.owner.expired()) {
+            uploads_.pop_front();
+            nextRow_ = 0;
+            continue;
+        }
+
+        // Work out how many rows fit in what's left of the budget at the measured throughput. At
+        // least one row always goes out so a tiny budget still makes progress.
+        double remaining = budgetMilliseconds_
+                           - Milliseconds(std::chrono::steady_clock::now() - frameStart).count();
+        if (remaining <= 0.0) {
+            break;
+        }
+        auto rowBytes = getTextureRowSize(upload.format, upload.width);
+        auto budgetRows = GLsizei(remaining * bytesPerMillisecond_ / double(rowBytes));
+        if (budgetRows == 0 && bytesLastFrame_ > 0) {
+            break;
+        }
+
+        // The staging buffers are used in order, so if the next one is still being read by the
+        // GPU the rest are too
+        auto &staging = staging_[nextStaging_];
+        if (!isAvailable(staging)) {
+            break;
+        }
+
+        auto rowCount = getRowCount(upload);
+        auto rows = std::min(rowCount - nextRow_, std::max<GLsizei>(budgetRows, 1));
+        rows = std::min(rows, std::max<GLsizei>(GLsizei(stagingBufferSize_ / rowBytes), 1));
+
+        auto chunkStart = std::chrono::steady_clock::now();
+        if (!issueRows(staging, rows)) {
+            break;
+        }
+        nextStaging_ = (nextStaging_ + 1) % staging_.size();
+
+        auto chunkBytes = size_t(rows) * rowBytes;
+        auto chunkMilliseconds =
+                Milliseconds(std::chrono::steady_clock::now() - chunkStart).count();
+        if (chunkMilliseconds > 0.0) {
+            bytesPerMillisecond_ += kThroughputSmoothing
+                                    * (double(chunkBytes) / chunkMilliseconds
+                                       - bytesPerMillisecond_);
+        }
+        bytesLastFrame_ += chunkBytes;
+
+        nextRow_ += rows;
+        if (nextRow_ == rowCount) {
+            // Take the upload off the queue before the callback runs, it may queue more
+            auto finished = std::move(upload);
+            uploads_.pop_front();
+            nextRow_ = 0;
+            if (finished.onComplete) {
+                finished.onComplete();
+            }
+        }
+    }
+
+    // Leaving a pixel unpack buffer bound would turn every later client side upload pointer into
+    // an offset into it
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    Utility::assertGlError();
+}
+
+GLsizei TextureUploadQueue::getRowCount(const TextureUpload &upload) {
+    auto blockSize = getTextureFormatInfo(upload.format).blockSize;
+    return (upload.height + blockSize - 1) / blockSize;
+}
+
+bool TextureUploadQueue::issueRows(StagingBuffer &staging, GLsizei rows) {
+    auto &upload = uploads_.front();
+    const auto &formatInfo = getTextureFormatInfo(upload.format);
+    auto rowBytes = getTextureRowSize(upload.format, upload.width);
+    auto chunkBytes = GLsizeiptr(rows * rowBytes);
+
+    if (!staging.buffer) {
+        glGenBuffers(1, &staging.buffer);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+    if (staging.size < chunkBytes) {
+        // Only a single row wider than the staging size can get here
+        staging.size = std::max(chunkBytes, GLsizeiptr(stagingBufferSize_));
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, staging.size, nullptr, GL_STREAM_DRAW);
+    }
+
+    // The fence says the GPU is done with the old contents, so there's no need for the driver to
+    // synchronize or keep a copy
+    auto pStaging = glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER,
+            0,
+            chunkBytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (!pStaging) {
+        // Out of memory, or the buffer is gone. The rows are staged again next frame.
+        aout << "Couldn't map a staging buffer, retrying the upload next frame" << std::endl;
+        return false;
+    }
+    memcpy(pStaging, upload.pixels.get() + size_t(nextRow_) * rowBytes, chunkBytes);
+    if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+        // The contents were lost, which can happen on some display changes. The rows are staged
+        // again next frame.
+        aout << "Staging buffer was corrupted, retrying the upload next frame" << std::endl;
+        return false;
+    }
+
+    // Rows of blocks cover blockSize rows of pixels, the last one may hang over the edge
+    auto y = nextRow_ * formatInfo.blockSize;
+    auto height = std::min(rows * formatInfo.blockSize, upload.height - y);
+    if (isCompressedTextureFormat(upload.format)) {
+        issueCompressedRows(upload, y, height, GLsizei(chunkBytes));
+    } else {
+        // rows are tightly packed, which isn't always a multiple of 4 bytes for the smaller
+        // formats
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (upload.target == GL_TEXTURE_2D_ARRAY) {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, upload.spArray->getTextureID());
+            glTexSubImage3D(
+                    GL_TEXTURE_2D_ARRAY,
+                    upload.level,
+                    0, y, upload.layer,
+                    upload.width, height, 1,
+                    formatInfo.format,
+                    formatInfo.type,
+                    nullptr // offset into the staging buffer
+            );
+        } else {
+            glBindTexture(GL_TEXTURE_2D, upload.textureID);
+            glTexSubImage2D(
+                    GL_TEXTURE_2D,
+                    upload.level,
+                    0, y,
+                    upload.width, height,
+                    formatInfo.format,
+                    formatInfo.type,
+                    nullptr // offset into the staging buffer
+            );
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    staging.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    return true;
+}
+
+void TextureUploadQueue::issueCompressedRows(
+        const TextureUpload &upload,
+        GLint y,
+        GLsizei height,
+        GLsizei imageSize) {
+    auto internalFormat = getTextureFormatInfo(upload.format).internalFormat;
+    if (upload.target == GL_TEXTURE_2D_ARRAY) {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, upload.spArray->getTextureID());
+        glCompressedTexSubImage3D(
+                GL_TEXTURE_2D_ARRAY,
+                upload.level,
+                0, y, upload.layer,
+                upload.width, height, 1,
+                internalFormat,
+                imageSize,
+                nullptr // offset into the staging buffer
+        );
+    } else {
+        glBindTexture(GL_TEXTURE_2D, upload.textureID);
+        glCompressedTexSubImage2D(
+                GL_TEXTURE_2D,
+                upload.level,
+                0, y,
+                upload.width, height,
+                internalFormat,
+                imageSize,
+                nullptr // offset into the staging buffer
+        );
+    }
+}
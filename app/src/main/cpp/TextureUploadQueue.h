@@ -0,0 +1,169 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TEXTUREUPLOADQUEUE_H
+#define ANDROIDGLINVESTIGATIONS_TEXTUREUPLOADQUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <GLES3/gl3.h>
+
+#include "TextureFormat.h"
+
+class TextureArray;
+
+/*!
+ * One mip level of pixels waiting to be copied into a texture
+ */
+struct TextureUpload {
+    // the upload is dropped once this expires, so a texture freed before it finished streaming
+    // isn't written to
+    std::weak_ptr<void> owner;
+    // GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY
+    GLenum target;
+    // the texture to fill when target is GL_TEXTURE_2D
+    GLuint textureID;
+    // the array to fill when target is GL_TEXTURE_2D_ARRAY. Its id is read for every chunk as it
+    // changes when the array grows.
+    std::shared_ptr<TextureArray> spArray;
+    GLint layer;
+    GLint level;
+    GLsizei width;
+    GLsizei height;
+    TextureFormat format;
+    // tightly packed pixels in @a format, kept alive until the last row is issued. May point into
+    // a mapped file.
+    std::shared_ptr<const uint8_t> pixels;
+    // called on the GL thread once the last row has been handed to GL, may be empty
+    std::function<void()> onComplete;
+};
+
+/*!
+ * Streams texture data to the GPU a few rows at a time so that loading doesn't stall a frame.
+ *
+ * Pixels are copied into a small ring of GL_PIXEL_UNPACK_BUFFER staging buffers and handed to
+ * glTexSubImage from there, which lets the driver do the transfer asynchronously. Each buffer gets
+ * a fence when it's used, and is only written again once the GPU is done reading it. Call
+ * @a process once per frame; it issues as many row chunks as fit in the budget, sized from the
+ * throughput measured so far, and leaves the rest for later frames.
+ */
+class TextureUploadQueue {
+public:
+    /*!
+     * GL objects are created on the first @a process call, so this can be made before there's a
+     * context
+     * @param budgetMilliseconds how much time @a process may spend each frame
+     * @param stagingBufferSize the size of each staging buffer, the largest chunk in bytes
+     * @param stagingBufferCount how many staging buffers to cycle through
+     */
+    explicit TextureUploadQueue(
+            float budgetMilliseconds = 2.f,
+            size_t stagingBufferSize = 1024 * 1024,
+            size_t stagingBufferCount = 3);
+
+    /*!
+     * Whatever @a releaseGlObjects didn't free goes with the context
+     */
+    ~TextureUploadQueue() = default;
+
+    /*!
+     * Adds an upload to the back of the queue
+     * @param upload the level to upload
+     */
+    void enqueue(TextureUpload upload);
+
+    /*!
+     * Issues queued uploads until this frame's budget runs out. Call on the GL thread.
+     */
+    void process();
+
+    /*!
+     * Frees the staging buffers the GPU is done with, they're made again when needed
+     * @return the bytes freed
+     */
+    size_t releaseStagingBuffers();
+
+    /*!
+     * Forgets every queued upload without issuing it. Completion callbacks aren't called.
+     */
+    void clear();
+
+    /*!
+     * Forgets every queued upload and hands the staging buffers and their fences back to GL. Call
+     * on the GL thread before the context is destroyed, and before the @a GpuDeletionQueue is
+     * flushed so the buffers are deleted with the rest. @a process makes new ones if it's called
+     * again.
+     */
+    void releaseGlObjects();
+
+    inline void setBudget(float budgetMilliseconds) { budgetMilliseconds_ = budgetMilliseconds; }
+
+    inline float getBudget() const { return budgetMilliseconds_; }
+
+    inline size_t getPendingCount() const { return uploads_.size(); }
+
+    /*!
+     * @return the bytes of pixel data still waiting to be issued
+     */
+    size_t getPendingBytes() const;
+
+    /*!
+     * @return the bytes issued by the last @a process call
+     */
+    inline size_t getBytesLastFrame() const { return bytesLastFrame_; }
+
+private:
+    struct StagingBuffer {
+        GLuint buffer;
+        GLsizeiptr size;
+        // signalled once the GPU has finished reading the buffer, null if it isn't in use
+        GLsync fence;
+    };
+
+    /*!
+     * @return true if @a staging can be written, deleting its fence if the GPU is done with it
+     */
+    static bool isAvailable(StagingBuffer &staging);
+
+    /*!
+     * @return how many rows @a upload is issued in, rows of blocks for block compressed formats
+     */
+    static GLsizei getRowCount(const TextureUpload &upload);
+
+    /*!
+     * Copies rows of the front upload into @a staging and issues them
+     * @param staging the buffer to stage through, must be available
+     * @param rows how many rows to issue
+     * @return false if the staging buffer couldn't be mapped or its contents were lost, nothing
+     *     was issued and the same rows should be tried again on a later frame
+     */
+    bool issueRows(StagingBuffer &staging, GLsizei rows);
+
+    /*!
+     * Issues block compressed rows that are already in the bound staging buffer
+     * @param upload the upload the rows belong to
+     * @param y the first row of pixels
+     * @param height how many rows of pixels
+     * @param imageSize the bytes of compressed data
+     */
+    static void issueCompressedRows(
+            const TextureUpload &upload,
+            GLint y,
+            GLsizei height,
+            GLsizei imageSize);
+
+    float budgetMilliseconds_;
+    size_t stagingBufferSize_;
+    std::vector<StagingBuffer> staging_;
+    size_t nextStaging_;
+
+    std::deque<TextureUpload> uploads_;
+    // the first row of the front upload that hasn't been issued, in rows of blocks
+    GLsizei nextRow_;
+
+    // measured time to stage and issue data, used to size chunks to the time that's left
+    double bytesPerMillisecond_;
+    size_t bytesLastFrame_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_TEXTUREUPLOADQUEUE_H
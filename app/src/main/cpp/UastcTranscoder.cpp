@@ -0,0 +1,838 @@
+#include "UastcTranscoder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+/*!
+ * UASTC blocks are 4x4 pixels in 16 bytes, read as one little endian 128 bit number from bit 0:
+ *  - a prefix code selecting one of 19 modes
+ *  - hint bits for transcoding to BC1 and ETC, which decoding skips
+ *  - the partition pattern, for modes with more than one subset
+ *  - the channel on the second weight plane, for dual plane modes
+ *  - the endpoints: the trits or quints packed in base 3 or 5, then the low bits of each value
+ *  - the weights in pixel order, the first weight of each subset and plane a bit short since
+ *    its top bit is always 0
+ * Everything else follows ASTC, so the endpoints, weights and partitions decode as they would
+ * on a GPU.
+ */
+static constexpr uint32_t kBlockDimension = 4;
+static constexpr size_t kBlockSize = 16;
+static constexpr uint32_t kBlockPixels = kBlockDimension * kBlockDimension;
+
+/*!
+ * Mode 8 is a single RGBA8 color, with no endpoints or weights
+ */
+static constexpr int kSolidColorMode = 8;
+
+/*!
+ * The luminance + alpha dual plane mode, which always puts alpha on the second plane
+ */
+static constexpr int kLumaAlphaDualPlaneMode = 17;
+
+/*!
+ * The only mode with 3 subsets
+ */
+static constexpr int kThreeSubsetMode = 3;
+
+/*!
+ * The 2 subset mode whose patterns come from BC7's 3 subset ones
+ */
+static constexpr int kBc7ThreeSubsetMode = 7;
+
+struct UastcMode {
+    // the prefix code, read from bit 0, and its length
+    uint8_t code;
+    uint8_t codeBits;
+    uint8_t hintBits;
+    uint8_t subsets;
+    uint8_t planes;
+    // 2 for luminance + alpha, 3 for RGB, 4 for RGBA
+    uint8_t components;
+    uint8_t weightBits;
+    // each endpoint is a trit (3) or quint (5) over this many low bits, or only the bits (1)
+    uint8_t endpointBits;
+    uint8_t endpointBase;
+};
+
+static constexpr UastcMode kModes[] = {
+        {0x01, 4, 15, 1, 1, 3, 4, 6, 3},
+        {0x35, 6, 15, 1, 1, 3, 2, 8, 1},
+        {0x1D, 5, 15, 2, 1, 3, 3, 4, 1},
+        {0x03, 5, 15, 3, 1, 3, 2, 2, 3},
+        {0x13, 5, 15, 2, 1, 3, 2, 3, 5},
+        {0x0B, 5, 15, 1, 1, 3, 3, 8, 1},
+        {0x1B, 5, 15, 1, 2, 3, 2, 5, 5},
+        {0x07, 5, 15, 2, 1, 3, 2, 3, 5},
+        {0x17, 5, 0, 1, 1, 4, 0, 0, 1},
+        {0x0F, 5, 23, 2, 1, 4, 2, 4, 1},
+        {0x02, 3, 17, 1, 1, 4, 4, 4, 3},
+        {0x00, 2, 17, 1, 2, 4, 2, 4, 3},
+        {0x06, 3, 17, 1, 1, 4, 3, 6, 3},
+        {0x1F, 5, 23, 1, 2, 4, 1, 8, 1},
+        {0x0D, 5, 23, 1, 1, 4, 2, 8, 1},
+        {0x05, 7, 23, 1, 1, 2, 4, 8, 1},
+        {0x15, 6, 23, 2, 1, 2, 2, 8, 1},
+        {0x25, 6, 23, 1, 2, 2, 2, 8, 1},
+        {0x09, 4, 15, 1, 1, 3, 5, 5, 1},
+};
+static constexpr int kModeCount = int(std::size(kModes));
+
+/*!
+ * The low 7 bits cover every mode's prefix code
+ */
+static constexpr int kModeCodeBits = 7;
+
+/*!
+ * ASTC partition seeds of the patterns a block picks from, the subset of ASTC's that BC7 also
+ * has. 2 subset modes other than mode 7 use the first table.
+ */
+static constexpr uint16_t kPartitionSeeds2[] = {
+        28, 20, 16, 29, 91, 9, 107, 72, 149, 204, 50, 114, 496, 17, 78, 39, 252, 828, 43, 156,
+        116, 210, 476, 273, 684, 359, 246, 195, 694, 524};
+static constexpr uint16_t kPartitionSeeds3[] = {
+        260, 74, 32, 156, 183, 15, 745, 0, 335, 902, 254};
+static constexpr uint16_t kBc7ThreeSubsetSeeds[] = {
+        36, 48, 61, 137, 161, 183, 226, 281, 302, 307, 479, 495, 593, 594, 605, 799, 812, 988,
+        993};
+
+/*!
+ * Which subset each pixel of a block is in, and the first pixel of each subset, whose weights
+ * are stored a bit short
+ */
+struct UastcPartition {
+    uint8_t subsets[kBlockPixels];
+    uint8_t anchors[3];
+    // the ASTC partition index it comes from
+    uint16_t seed;
+};
+
+/*!
+ * Everything worked out once rather than per block
+ */
+struct UastcTables {
+    // the mode of each value of the low bits, -1 for the reserved code
+    int8_t modes[1 << kModeCodeBits];
+    UastcPartition single;
+    UastcPartition partitions2[std::size(kPartitionSeeds2)];
+    UastcPartition partitions3[std::size(kPartitionSeeds3)];
+    UastcPartition bc7ThreeSubsetPartitions[std::size(kBc7ThreeSubsetSeeds)];
+    // the smallest ASTC pack of each group of 5 trits or 3 quints, indexed by the group's digits
+    // in base 3 or 5 with the first one lowest
+    uint8_t tritPacks[243];
+    uint8_t quintPacks[125];
+};
+
+/*!
+ * The hash ASTC's partition function is built on
+ */
+static uint32_t hashPartitionSeed(uint32_t seed) {
+    seed ^= seed >> 15;
+    seed -= seed << 17;
+    seed += seed << 7;
+    seed += seed << 4;
+    seed ^= seed >> 5;
+    seed += seed << 16;
+    seed ^= seed >> 7;
+    seed ^= seed >> 3;
+    seed ^= seed << 6;
+    seed ^= seed >> 17;
+    return seed;
+}
+
+/*!
+ * ASTC's partition function for a 2D block of fewer than 31 pixels
+ * @return the subset the pixel at @a x, @a y is in
+ */
+static uint8_t selectPartition(uint32_t seed, uint32_t x, uint32_t y, uint32_t subsetCount) {
+    // Small blocks sample the pattern at twice the spacing
+    x <<= 1;
+    y <<= 1;
+
+    seed += (subsetCount - 1) * 1024;
+    uint32_t random = hashPartitionSeed(seed);
+    uint32_t seeds[8];
+    for (int i = 0; i < 8; i++) {
+        seeds[i] = (random >> (i * 4)) & 0xF;
+        seeds[i] *= seeds[i];
+    }
+
+    uint32_t shift1;
+    uint32_t shift2;
+    if (seed & 1) {
+        shift1 = (seed & 2) ? 4 : 5;
+        shift2 = subsetCount == 3 ? 6 : 5;
+    } else {
+        shift1 = subsetCount == 3 ? 6 : 5;
+        shift2 = (seed & 2) ? 4 : 5;
+    }
+    for (int i = 0; i < 8; i++) {
+        seeds[i] >>= (i & 1) ? shift2 : shift1;
+    }
+
+    // There's no z in 2D, so the seeds that would scale it are left out
+    uint32_t a = (seeds[0] * x + seeds[1] * y + (random >> 14)) & 0x3F;
+    uint32_t b = (seeds[2] * x + seeds[3] * y + (random >> 10)) & 0x3F;
+    uint32_t c = subsetCount < 3 ? 0 : (seeds[4] * x + seeds[5] * y + (random >> 6)) & 0x3F;
+    if (a >= b && a >= c) {
+        return 0;
+    }
+    return b >= c ? 1 : 2;
+}
+
+static UastcPartition makePartition(uint32_t seed, uint32_t subsetCount) {
+    UastcPartition partition{};
+    partition.seed = uint16_t(seed);
+    bool seen[3] = {};
+    for (uint32_t i = 0; i < kBlockPixels; i++) {
+        auto subset = selectPartition(
+                seed, i % kBlockDimension, i / kBlockDimension, subsetCount);
+        partition.subsets[i] = subset;
+        if (!seen[subset]) {
+            seen[subset] = true;
+            partition.anchors[subset] = uint8_t(i);
+        }
+    }
+    return partition;
+}
+
+/*!
+ * ASTC's decoding of an 8 bit pack into 5 trits
+ */
+static void unpackAstcTrits(uint32_t pack, uint32_t trits[5]) {
+    auto bits = [pack](uint32_t high, uint32_t low) {
+        return (pack >> low) & ((1u << (high - low + 1)) - 1);
+    };
+    uint32_t c;
+    if (bits(4, 2) == 7) {
+        c = (bits(7, 5) << 2) | bits(1, 0);
+        trits[4] = 2;
+        trits[3] = 2;
+    } else {
+        c = bits(4, 0);
+        if (bits(6, 5) == 3) {
+            trits[4] = 2;
+            trits[3] = bits(7, 7);
+        } else {
+            trits[4] = bits(7, 7);
+            trits[3] = bits(6, 5);
+        }
+    }
+    auto c0 = c & 1;
+    auto c1 = (c >> 1) & 1;
+    auto c2 = (c >> 2) & 1;
+    auto c3 = (c >> 3) & 1;
+    if ((c & 3) == 3) {
+        trits[2] = 2;
+        trits[1] = c >> 4;
+        trits[0] = (c3 << 1) | (c2 & ~c3 & 1);
+    } else if (((c >> 2) & 3) == 3) {
+        trits[2] = 2;
+        trits[1] = 2;
+        trits[0] = c & 3;
+    } else {
+        trits[2] = c >> 4;
+        trits[1] = (c >> 2) & 3;
+        trits[0] = (c1 << 1) | (c0 & ~c1 & 1);
+    }
+}
+
+/*!
+ * ASTC's decoding of a 7 bit pack into 3 quints
+ */
+static void unpackAstcQuints(uint32_t pack, uint32_t quints[3]) {
+    auto bit = [pack](uint32_t index) { return (pack >> index) & 1; };
+    if (((pack >> 1) & 3) == 3 && ((pack >> 5) & 3) == 0) {
+        quints[2] = (bit(0) << 2) | ((bit(4) & ~bit(0) & 1) << 1) | (bit(3) & ~bit(0) & 1);
+        quints[1] = 4;
+        quints[0] = 4;
+        return;
+    }
+    uint32_t c;
+    if (((pack >> 1) & 3) == 3) {
+        quints[2] = 4;
+        c = (((pack >> 3) & 3) << 3) | ((~pack >> 5 & 3) << 1) | bit(0);
+    } else {
+        quints[2] = (pack >> 5) & 3;
+        c = pack & 0x1F;
+    }
+    if ((c & 7) == 5) {
+        quints[1] = 4;
+        quints[0] = c >> 3;
+    } else {
+        quints[1] = c >> 3;
+        quints[0] = c & 7;
+    }
+}
+
+static const UastcTables &getTables() {
+    static const UastcTables tables = []() {
+        UastcTables tables{};
+        for (int code = 0; code < (1 << kModeCodeBits); code++) {
+            tables.modes[code] = -1;
+            for (int mode = 0; mode < kModeCount; mode++) {
+                auto mask = (1 << kModes[mode].codeBits) - 1;
+                if ((code & mask) == kModes[mode].code) {
+                    tables.modes[code] = int8_t(mode);
+                }
+            }
+        }
+        for (size_t i = 0; i < std::size(kPartitionSeeds2); i++) {
+            tables.partitions2[i] = makePartition(kPartitionSeeds2[i], 2);
+        }
+        for (size_t i = 0; i < std::size(kPartitionSeeds3); i++) {
+            tables.partitions3[i] = makePartition(kPartitionSeeds3[i], 3);
+        }
+        for (size_t i = 0; i < std::size(kBc7ThreeSubsetSeeds); i++) {
+            tables.bc7ThreeSubsetPartitions[i] = makePartition(kBc7ThreeSubsetSeeds[i], 2);
+        }
+        // Every group has a pack in ASTC's encoding, going down keeps the smallest
+        for (uint32_t pack = 256; pack-- > 0;) {
+            uint32_t trits[5];
+            unpackAstcTrits(pack, trits);
+            tables.tritPacks[trits[0] + 3 * (trits[1] + 3 * (trits[2] + 3 * (trits[3]
+                    + 3 * trits[4])))] = uint8_t(pack);
+        }
+        for (uint32_t pack = 128; pack-- > 0;) {
+            uint32_t quints[3];
+            unpackAstcQuints(pack, quints);
+            tables.quintPacks[quints[0] + 5 * (quints[1] + 5 * quints[2])] = uint8_t(pack);
+        }
+        return tables;
+    }();
+    return tables;
+}
+
+/*!
+ * Reads a block from bit 0 up
+ */
+class UastcBitReader {
+public:
+    explicit UastcBitReader(const uint8_t *block) : offset_(0) {
+        memcpy(words_, block, sizeof(words_));
+    }
+
+    /*!
+     * @param bits up to 8
+     */
+    inline uint32_t read(uint32_t bits) {
+        if (bits == 0) {
+            return 0;
+        }
+        uint64_t value;
+        if (offset_ >= 64) {
+            value = words_[1] >> (offset_ - 64);
+        } else {
+            value = words_[0] >> offset_;
+            if (offset_ + bits > 64) {
+                value |= words_[1] << (64 - offset_);
+            }
+        }
+        offset_ += bits;
+        return uint32_t(value) & ((1u << bits) - 1);
+    }
+
+    inline void skip(uint32_t bits) { offset_ += bits; }
+
+private:
+    uint64_t words_[2];
+    uint32_t offset_;
+};
+
+/*!
+ * Expands an endpoint to 8 bits the way ASTC does
+ * @param bits the endpoint's low bits
+ * @param digit its trit or quint, 0 if it has neither
+ */
+static uint8_t unquantizeEndpoint(uint32_t bits, uint32_t digit, const UastcMode &mode) {
+    if (mode.endpointBase == 1) {
+        // Bit replication
+        uint32_t value = 0;
+        for (int shift = 8 - mode.endpointBits; shift > -int(mode.endpointBits);
+             shift -= mode.endpointBits) {
+            value |= shift >= 0 ? bits << shift : bits >> -shift;
+        }
+        return uint8_t(value);
+    }
+
+    // The digit scales the value across the range, the low bits are spread over it and bit 0
+    // mirrors the result
+    uint32_t high = bits >> 1;
+    uint32_t spread;
+    uint32_t scale;
+    if (mode.endpointBase == 3) {
+        switch (mode.endpointBits) {
+            case 2:
+                spread = (high << 8) | (high << 4) | (high << 2) | (high << 1);
+                scale = 93;
+                break;
+            case 4:
+                spread = (high << 6) | high;
+                scale = 22;
+                break;
+            default:
+                spread = (high << 4) | (high >> 4);
+                scale = 5;
+                break;
+        }
+    } else {
+        switch (mode.endpointBits) {
+            case 3:
+                spread = (high << 7) | (high << 1) | (high >> 1);
+                scale = 26;
+                break;
+            default:
+                spread = (high << 5) | (high >> 3);
+                scale = 6;
+                break;
+        }
+    }
+    uint32_t mirror = (bits & 1) ? 0x1FF : 0;
+    uint32_t value = (digit * scale + spread) ^ mirror;
+    return uint8_t((mirror & 0x80) | (value >> 2));
+}
+
+/*!
+ * Expands a weight to ASTC's 0 to 64 range
+ */
+static inline uint8_t unquantizeWeight(uint32_t weight, uint32_t bits) {
+    uint32_t value = 0;
+    for (int shift = 6 - int(bits); shift > -int(bits); shift -= int(bits)) {
+        value |= shift >= 0 ? weight << shift : weight >> -shift;
+    }
+    return uint8_t(value > 32 ? value + 1 : value);
+}
+
+static inline uint8_t interpolate(uint32_t low, uint32_t high, uint32_t weight) {
+    low = (low << 8) | low;
+    high = (high << 8) | high;
+    return uint8_t(((low * (64 - weight) + high * weight + 32) >> 6) >> 8);
+}
+
+/*!
+ * Blue contraction, which ASTC uses to get more precision out of near gray endpoints
+ */
+static inline void contractBlue(uint8_t *color) {
+    color[0] = uint8_t((color[0] + color[2]) >> 1);
+    color[1] = uint8_t((color[1] + color[2]) >> 1);
+}
+
+/*!
+ * Turns a subset's endpoint values into its two RGBA endpoints
+ */
+static void decodeEndpoints(
+        const uint8_t *values,
+        const UastcMode &mode,
+        uint8_t endpoints[2][4]) {
+    if (mode.components == 2) {
+        for (int i = 0; i < 2; i++) {
+            endpoints[i][0] = endpoints[i][1] = endpoints[i][2] = values[i];
+            endpoints[i][3] = values[2 + i];
+        }
+        return;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        for (int channel = 0; channel < 3; channel++) {
+            endpoints[i][channel] = values[channel * 2 + i];
+        }
+        endpoints[i][3] = mode.components == 4 ? values[6 + i] : 255;
+    }
+    uint32_t sum0 = uint32_t(values[0]) + values[2] + values[4];
+    uint32_t sum1 = uint32_t(values[1]) + values[3] + values[5];
+    if (sum1 < sum0) {
+        std::swap(endpoints[0], endpoints[1]);
+        contractBlue(endpoints[0]);
+        contractBlue(endpoints[1]);
+    }
+}
+
+/*!
+ * A block's fields read out of the UASTC layout, still quantized, so they can be decoded to pixels
+ * or written back out as an ASTC block
+ */
+struct UastcBlock {
+    int modeIndex;
+    const UastcPartition *pPartition;
+    // the channel weighted by the second plane, 4 with only one plane
+    uint32_t secondPlaneChannel;
+    // the color of a solid block, which has nothing else
+    uint8_t color[4];
+    // the trit or quint of each endpoint value, and its low bits
+    uint8_t endpointDigits[18];
+    uint8_t endpointBits[18];
+    // in pixel order, interleaved by plane for dual plane modes
+    uint8_t weights[kBlockPixels * 2];
+
+    inline const UastcMode &getMode() const { return kModes[modeIndex]; }
+
+    inline uint32_t getValueCount() const {
+        const auto &mode = getMode();
+        return uint32_t(mode.components) * 2 * mode.subsets;
+    }
+};
+
+/*!
+ * Reads the fields of a block
+ * @return false if the block is corrupt
+ */
+static bool unpackBlock(const uint8_t *block, UastcBlock &out) {
+    const auto &tables = getTables();
+    out.modeIndex = tables.modes[block[0] & ((1 << kModeCodeBits) - 1)];
+    if (out.modeIndex < 0) {
+        return false;
+    }
+    const auto &mode = out.getMode();
+    UastcBitReader reader(block);
+    reader.skip(mode.codeBits);
+
+    if (out.modeIndex == kSolidColorMode) {
+        for (auto &channel: out.color) {
+            channel = uint8_t(reader.read(8));
+        }
+        return true;
+    }
+    reader.skip(mode.hintBits);
+
+    out.pPartition = &tables.single;
+    if (out.modeIndex == kThreeSubsetMode) {
+        auto pattern = reader.read(4);
+        if (pattern >= std::size(tables.partitions3)) {
+            return false;
+        }
+        out.pPartition = &tables.partitions3[pattern];
+    } else if (out.modeIndex == kBc7ThreeSubsetMode) {
+        auto pattern = reader.read(5);
+        if (pattern >= std::size(tables.bc7ThreeSubsetPartitions)) {
+            return false;
+        }
+        out.pPartition = &tables.bc7ThreeSubsetPartitions[pattern];
+    } else if (mode.subsets == 2) {
+        auto pattern = reader.read(5);
+        if (pattern >= std::size(tables.partitions2)) {
+            return false;
+        }
+        out.pPartition = &tables.partitions2[pattern];
+    }
+
+    out.secondPlaneChannel = 4;
+    if (out.modeIndex == kLumaAlphaDualPlaneMode) {
+        out.secondPlaneChannel = 3;
+    } else if (mode.planes == 2) {
+        out.secondPlaneChannel = reader.read(2);
+    }
+
+    // Trits pack 5 to a byte and quints 3 to 7 bits, a partial pack only takes the bits its
+    // values need
+    auto valueCount = out.getValueCount();
+    memset(out.endpointDigits, 0, sizeof(out.endpointDigits));
+    if (mode.endpointBase > 1) {
+        uint32_t packSize = mode.endpointBase == 3 ? 5 : 3;
+        for (uint32_t first = 0; first < valueCount; first += packSize) {
+            auto count = std::min(packSize, valueCount - first);
+            uint32_t maxPack = 1;
+            for (uint32_t i = 0; i < count; i++) {
+                maxPack *= mode.endpointBase;
+            }
+            uint32_t packBits = 0;
+            while ((1u << packBits) < maxPack) {
+                packBits++;
+            }
+            auto pack = reader.read(packBits);
+            for (uint32_t i = 0; i < count; i++) {
+                out.endpointDigits[first + i] = uint8_t(pack % mode.endpointBase);
+                pack /= mode.endpointBase;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < valueCount; i++) {
+        out.endpointBits[i] = uint8_t(reader.read(mode.endpointBits));
+    }
+
+    const auto *pPartition = out.pPartition;
+    for (uint32_t i = 0; i < kBlockPixels; i++) {
+        bool anchor = pPartition->anchors[pPartition->subsets[i]] == i;
+        for (uint32_t plane = 0; plane < mode.planes; plane++) {
+            out.weights[i * mode.planes + plane] =
+                    uint8_t(reader.read(mode.weightBits - (anchor ? 1 : 0)));
+        }
+    }
+    return true;
+}
+
+/*!
+ * Decodes one block into 4x4 RGBA8 pixels
+ * @return false if the block is corrupt
+ */
+static bool decodeBlock(const uint8_t *block, uint8_t *pixels) {
+    UastcBlock unpacked;
+    if (!unpackBlock(block, unpacked)) {
+        return false;
+    }
+    if (unpacked.modeIndex == kSolidColorMode) {
+        for (uint32_t i = 0; i < kBlockPixels; i++) {
+            memcpy(pixels + i * 4, unpacked.color, sizeof(unpacked.color));
+        }
+        return true;
+    }
+
+    const auto &mode = unpacked.getMode();
+    auto valueCount = unpacked.getValueCount();
+    uint8_t values[18];
+    for (uint32_t i = 0; i < valueCount; i++) {
+        values[i] = unquantizeEndpoint(
+                unpacked.endpointBits[i], unpacked.endpointDigits[i], mode);
+    }
+
+    uint8_t endpoints[3][2][4];
+    for (uint32_t subset = 0; subset < mode.subsets; subset++) {
+        decodeEndpoints(values + subset * mode.components * 2, mode, endpoints[subset]);
+    }
+
+    uint8_t weights[kBlockPixels * 2];
+    for (uint32_t i = 0; i < kBlockPixels * mode.planes; i++) {
+        weights[i] = unquantizeWeight(unpacked.weights[i], mode.weightBits);
+    }
+
+    const auto *pPartition = unpacked.pPartition;
+    for (uint32_t i = 0; i < kBlockPixels; i++) {
+        const auto &subsetEndpoints = endpoints[pPartition->subsets[i]];
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            auto plane = channel == unpacked.secondPlaneChannel ? 1 : 0;
+            pixels[i * 4 + channel] = interpolate(
+                    subsetEndpoints[0][channel],
+                    subsetEndpoints[1][channel],
+                    weights[i * mode.planes + plane]);
+        }
+    }
+    return true;
+}
+
+/*!
+ * Writes an ASTC block from bit 0 up, or the weights from bit 127 down
+ */
+class AstcBitWriter {
+public:
+    AstcBitWriter() : words_{} {}
+
+    inline void write(uint32_t offset, uint32_t bits, uint32_t value) {
+        for (uint32_t i = 0; i < bits; i++) {
+            setBit(offset + i, (value >> i) & 1);
+        }
+    }
+
+    /*!
+     * Writes @a value with its bits in reverse order, ending at bit 127 - @a offset
+     */
+    inline void writeReversed(uint32_t offset, uint32_t bits, uint32_t value) {
+        for (uint32_t i = 0; i < bits; i++) {
+            setBit(127 - (offset + i), (value >> i) & 1);
+        }
+    }
+
+    inline void store(uint8_t *block) const { memcpy(block, words_, sizeof(words_)); }
+
+private:
+    inline void setBit(uint32_t bit, uint32_t value) {
+        words_[bit / 64] |= uint64_t(value) << (bit % 64);
+    }
+
+    uint64_t words_[2];
+};
+
+/*!
+ * ASTC's color endpoint modes for the three kinds of UASTC endpoints
+ */
+static constexpr uint32_t kAstcLumaAlphaDirect = 4;
+static constexpr uint32_t kAstcRgbDirect = 8;
+static constexpr uint32_t kAstcRgbaDirect = 12;
+
+/*!
+ * The ASTC weight range of a number of weight bits, as the block mode's R bits and H bit
+ */
+static constexpr uint8_t kAstcWeightRanges[][2] = {{0, 0}, {2, 0}, {4, 0}, {7, 0}, {4, 1}, {7, 1}};
+
+/*!
+ * How many bits of each trit pack and quint pack sit after each value, ASTC's interleaving
+ */
+static constexpr uint8_t kAstcTritPackBits[5] = {2, 2, 1, 2, 1};
+static constexpr uint8_t kAstcQuintPackBits[3] = {3, 2, 2};
+
+/*!
+ * Writes a block's endpoints the way ASTC packs them: values in groups of 5 trits or 3 quints,
+ * with the group's pack spread between the values' low bits
+ * @return the bit after the last one written
+ */
+static uint32_t writeAstcEndpoints(
+        const UastcBlock &block,
+        uint32_t offset,
+        AstcBitWriter &writer) {
+    const auto &tables = getTables();
+    const auto &mode = block.getMode();
+    auto valueCount = block.getValueCount();
+    if (mode.endpointBase == 1) {
+        for (uint32_t i = 0; i < valueCount; i++) {
+            writer.write(offset, mode.endpointBits, block.endpointBits[i]);
+            offset += mode.endpointBits;
+        }
+        return offset;
+    }
+
+    bool trits = mode.endpointBase == 3;
+    uint32_t groupSize = trits ? 5 : 3;
+    const uint8_t *pPackBits = trits ? kAstcTritPackBits : kAstcQuintPackBits;
+    for (uint32_t first = 0; first < valueCount; first += groupSize) {
+        // Missing values in the last group count as 0, and the pack for those has nothing in
+        // the bits that get cut off
+        uint32_t index = 0;
+        for (uint32_t i = groupSize; i-- > 0;) {
+            auto digit = first + i < valueCount ? block.endpointDigits[first + i] : 0;
+            index = index * mode.endpointBase + digit;
+        }
+        uint32_t pack = trits ? tables.tritPacks[index] : tables.quintPacks[index];
+        for (uint32_t i = 0; i < groupSize && first + i < valueCount; i++) {
+            writer.write(offset, mode.endpointBits, block.endpointBits[first + i]);
+            offset += mode.endpointBits;
+            writer.write(offset, pPackBits[i], pack & ((1u << pPackBits[i]) - 1));
+            offset += pPackBits[i];
+            pack >>= pPackBits[i];
+        }
+    }
+    return offset;
+}
+
+/*!
+ * Writes a block as the ASTC block it's a subset of
+ * @return false if the block is corrupt
+ */
+static bool transcodeBlockToAstc(const uint8_t *block, uint8_t *out) {
+    UastcBlock unpacked;
+    if (!unpackBlock(block, unpacked)) {
+        return false;
+    }
+    AstcBitWriter writer;
+
+    if (unpacked.modeIndex == kSolidColorMode) {
+        // A void extent block covering the whole texture, with 16 bit UNORM channels
+        writer.write(0, 12, 0xDFC);
+        writer.write(12, 32, 0xFFFFFFFF);
+        writer.write(44, 20, 0xFFFFF);
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            writer.write(64 + channel * 16, 16, unpacked.color[channel] * 257u);
+        }
+        writer.store(out);
+        return true;
+    }
+
+    // The block mode for a 4x4 weight grid: the weight range's R bits split around the grid's
+    // A and B fields, then H and the dual plane bit
+    const auto &mode = unpacked.getMode();
+    auto rangeBits = kAstcWeightRanges[mode.weightBits][0];
+    auto highPrecision = kAstcWeightRanges[mode.weightBits][1];
+    uint32_t blockMode = ((rangeBits >> 1) & 3) | ((rangeBits & 1) << 4) | (2 << 5)
+                         | (highPrecision << 9) | ((mode.planes - 1) << 10);
+    writer.write(0, 11, blockMode);
+    writer.write(11, 2, mode.subsets - 1);
+
+    uint32_t colorMode = mode.components == 2 ? kAstcLumaAlphaDirect
+                         : mode.components == 3 ? kAstcRgbDirect : kAstcRgbaDirect;
+    uint32_t offset;
+    if (mode.subsets == 1) {
+        writer.write(13, 4, colorMode);
+        offset = 17;
+    } else {
+        // Every subset shares the color endpoint mode
+        writer.write(13, 10, unpacked.pPartition->seed);
+        writer.write(23, 2, 0);
+        writer.write(25, 4, colorMode);
+        offset = 29;
+    }
+    writeAstcEndpoints(unpacked, offset, writer);
+
+    // Weights go from the top of the block down, full width since ASTC has no anchors
+    uint32_t weightCount = kBlockPixels * mode.planes;
+    for (uint32_t i = 0; i < weightCount; i++) {
+        writer.writeReversed(i * mode.weightBits, mode.weightBits, unpacked.weights[i]);
+    }
+    if (mode.planes == 2) {
+        // The second plane's channel sits right under the weights
+        writer.write(128 - weightCount * mode.weightBits - 2, 2, unpacked.secondPlaneChannel);
+    }
+    writer.store(out);
+    return true;
+}
+
+size_t UastcTranscoder::getLevelSize(uint32_t width, uint32_t height) {
+    auto blocksX = size_t((width + kBlockDimension - 1) / kBlockDimension);
+    auto blocksY = size_t((height + kBlockDimension - 1) / kBlockDimension);
+    return blocksX * blocksY * kBlockSize;
+}
+
+bool UastcTranscoder::transcodeToRgba8(
+        const uint8_t *data,
+        size_t size,
+        uint32_t width,
+        uint32_t height,
+        uint8_t *out) {
+    if (!data || size != getLevelSize(width, height)) {
+        return false;
+    }
+
+    uint32_t blocksX = (width + kBlockDimension - 1) / kBlockDimension;
+    uint32_t blocksY = (height + kBlockDimension - 1) / kBlockDimension;
+    size_t stride = size_t(width) * 4;
+    uint8_t pixels[kBlockPixels * 4];
+    for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+        for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+            if (!decodeBlock(data + (size_t(blockY) * blocksX + blockX) * kBlockSize, pixels)) {
+                return false;
+            }
+
+            // Blocks on the right and bottom edges hang over the level
+            auto x = blockX * kBlockDimension;
+            auto y = blockY * kBlockDimension;
+            auto rowPixels = std::min(kBlockDimension, width - x);
+            auto rows = std::min(kBlockDimension, height - y);
+            for (uint32_t row = 0; row < rows; row++) {
+                memcpy(out + (y + row) * stride + size_t(x) * 4,
+                       pixels + row * kBlockDimension * 4,
+                       rowPixels * 4);
+            }
+        }
+    }
+    return true;
+}
+
+bool UastcTranscoder::transcodeToAstc(const uint8_t *data, size_t size, uint8_t *out) {
+    if (!data || size % kBlockSize != 0) {
+        return false;
+    }
+    for (size_t offset = 0; offset < size; offset += kBlockSize) {
+        if (!transcodeBlockToAstc(data + offset, out + offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UastcTranscoder::isOpaque(const uint8_t *data, size_t size) {
+    uint8_t pixels[kBlockPixels * 4];
+    for (size_t offset = 0; offset + kBlockSize <= size; offset += kBlockSize) {
+        // RGB modes can't hold alpha, the rest have to be decoded to see
+        const auto *pBlock = data + offset;
+        auto modeIndex = getTables().modes[pBlock[0] & ((1 << kModeCodeBits) - 1)];
+        if (modeIndex < 0 || kModes[modeIndex].components == 3) {
+            continue;
+        }
+        if (!decodeBlock(pBlock, pixels)) {
+            continue;
+        }
+        for (uint32_t i = 0; i < kBlockPixels; i++) {
+            if (pixels[i * 4 + 3] != 255) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
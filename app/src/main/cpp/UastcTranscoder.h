@@ -0,0 +1,60 @@
+#ifndef ANDROIDGLINVESTIGATIONS_UASTCTRANSCODER_H
+#define ANDROIDGLINVESTIGATIONS_UASTCTRANSCODER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * Transcodes UASTC, the Basis Universal block format that's a subset of ASTC 4x4. This is what
+ * lets one KTX2 file load on any GPU: devices with ASTC get the blocks rewritten in ASTC's layout,
+ * which loses nothing and costs no more than a copy, and the rest get RGBA8 pixels to encode as
+ * ETC2 or repack like a decoded image. Nothing here touches GL, so it runs on the loaders' worker
+ * threads.
+ *
+ * Levels supercompressed with Zstandard are decompressed before they get here. ETC1S, the other
+ * Basis Universal format, isn't handled.
+ */
+class UastcTranscoder {
+public:
+    /*!
+     * @return the size of a level of UASTC blocks, 16 bytes per 4x4 block
+     */
+    static size_t getLevelSize(uint32_t width, uint32_t height);
+
+    /*!
+     * Decodes a level. Corrupt blocks, with a reserved mode or a partition pattern outside the
+     * format's table, fail the whole level so the load can fall back to the source image.
+     * @param data the level's blocks, in rows from the top left
+     * @param size the size of the level
+     * @param width the width of the level in pixels
+     * @param height the height of the level in pixels
+     * @param out receives width x height tightly packed RGBA8 pixels
+     * @return false if @a size doesn't match the level or a block is corrupt
+     */
+    static bool transcodeToRgba8(
+            const uint8_t *data,
+            size_t size,
+            uint32_t width,
+            uint32_t height,
+            uint8_t *out);
+
+    /*!
+     * Rewrites a level as ASTC 4x4 blocks, which decode to exactly the pixels
+     * @a transcodeToRgba8 gives
+     * @param data the level's blocks
+     * @param size the size of the level, a whole number of blocks
+     * @param out receives @a size bytes of ASTC blocks, in the same order
+     * @return false if a block is corrupt
+     */
+    static bool transcodeToAstc(const uint8_t *data, size_t size, uint8_t *out);
+
+    /*!
+     * Checks the alpha of a level without decoding blocks in modes that have no alpha
+     * @param data the level's blocks
+     * @param size the size of the level
+     * @return true if every pixel has an alpha of 255. Corrupt blocks are skipped.
+     */
+    static bool isOpaque(const uint8_t *data, size_t size);
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_UASTCTRANSCODER_H
@@ -2,6 +2,7 @@
 #include "AndroidOut.h"
 
 #include <GLES3/gl3.h>
+#include <cstring>
 
 #define CHECK_ERROR(e) case e: aout << "GL Error: "#e << std::endl; break;
 
@@ -26,6 +27,28 @@ bool Utility::checkAndLogGlError(bool alwaysLog) {
     }
 }
 
+bool Utility::hasGlExtension(const char *extension) {
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+        auto name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+        if (name && strcmp(name, extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int Utility::mipLevelCount(int width, int height) {
+    int levels = 1;
+    auto size = width > height ? width : height;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
 float *
 Utility::buildOrthographicMatrix(float *outMatrix, float halfHeight, float aspect, float near,
                                  float far) {
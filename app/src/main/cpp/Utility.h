@@ -9,6 +9,21 @@ public:
 
     static inline void assertGlError() { assert(checkAndLogGlError()); }
 
+    /**
+     * Checks whether the current GL context exposes an extension
+     *
+     * @param extension the full extension name, ex: "GL_KHR_parallel_shader_compile"
+     * @return true if the extension is in the context's extension list
+     */
+    static bool hasGlExtension(const char *extension);
+
+    /**
+     * @param width the width of the first level
+     * @param height the height of the first level
+     * @return the number of levels in a full mip chain, down to 1x1
+     */
+    static int mipLevelCount(int width, int height);
+
     /**
      * Generates an orthographic projection matrix given the half height, aspect ratio, near, and far
      * planes
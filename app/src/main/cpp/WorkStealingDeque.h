@@ -0,0 +1,122 @@
+#ifndef ANDROIDGLINVESTIGATIONS_WORKSTEALINGDEQUE_H
+#define ANDROIDGLINVESTIGATIONS_WORKSTEALINGDEQUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*!
+ * A fixed capacity Chase-Lev deque of pointers, using the C11 memory orderings from Lê et al.,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models".
+ *
+ * One owner thread pushes and pops at the bottom, last in first out, which keeps what it works on
+ * warm in its cache. Any other thread steals from the top, taking the oldest and usually largest
+ * piece of work. Neither end takes a lock, the only contention is a compare and swap when the
+ * owner and a thief go for the last item.
+ *
+ * @tparam T the pointee type, the deque never owns what it holds
+ */
+template<typename T>
+class WorkStealingDeque {
+public:
+    /*!
+     * @param capacity how many items fit, rounded up to a power of 2
+     */
+    explicit WorkStealingDeque(size_t capacity)
+            : top_(0),
+              bottom_(0),
+              mask_(roundUpToPowerOf2(capacity) - 1),
+              items_(new std::atomic<T *>[mask_ + 1]) {}
+
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    /*!
+     * Adds an item at the bottom. Owner only.
+     * @return false if the deque is full, the item isn't added
+     */
+    bool push(T *item) {
+        auto bottom = bottom_.load(std::memory_order_relaxed);
+        auto top = top_.load(std::memory_order_acquire);
+        if (bottom - top > int64_t(mask_)) {
+            return false;
+        }
+        items_[bottom & mask_].store(item, std::memory_order_relaxed);
+        // publishes the item, and everything written before it, to thieves
+        bottom_.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    /*!
+     * Takes the item at the bottom, the one pushed last. Owner only.
+     * @return the item, or null if the deque is empty or a thief took the last one
+     */
+    T *pop() {
+        auto bottom = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto top = top_.load(std::memory_order_relaxed);
+        if (top > bottom) {
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        auto item = items_[bottom & mask_].load(std::memory_order_relaxed);
+        if (top == bottom) {
+            // The last item, thieves may be after it too
+            if (!top_.compare_exchange_strong(
+                    top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                item = nullptr;
+            }
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return item;
+    }
+
+    /*!
+     * Takes the item at the top, the one pushed first. Any thread.
+     * @return the item, or null if the deque is empty or another thread got there first
+     */
+    T *steal() {
+        auto top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return nullptr;
+        }
+        auto item = items_[top & mask_].load(std::memory_order_relaxed);
+        if (!top_.compare_exchange_strong(
+                top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return item;
+    }
+
+    /*!
+     * @return roughly how many items there are, exact only when called by the owner with no
+     *     thief active
+     */
+    inline size_t size() const {
+        auto bottom = bottom_.load(std::memory_order_relaxed);
+        auto top = top_.load(std::memory_order_relaxed);
+        return bottom > top ? size_t(bottom - top) : 0;
+    }
+
+private:
+    static size_t roundUpToPowerOf2(size_t value) {
+        size_t power = 1;
+        while (power < value) {
+            power *= 2;
+        }
+        return power;
+    }
+
+    // Thieves hammer top_ while the owner works on bottom_, so they get a cache line each
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    size_t mask_;
+    std::unique_ptr<std::atomic<T *>[]> items_;
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_WORKSTEALINGDEQUE_H
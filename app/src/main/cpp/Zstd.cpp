@@ -0,0 +1,1046 @@
+#include "Zstd.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "Hash.h"
+
+static constexpr uint32_t kFrameMagic = 0xFD2FB528;
+
+/*!
+ * Skippable frames use any of the 16 magic numbers from this one, and are ignored
+ */
+static constexpr uint32_t kSkippableFrameMagic = 0x184D2A50;
+static constexpr uint32_t kSkippableFrameMagicMask = 0xFFFFFFF0;
+
+/*!
+ * The most a compressed block can decompress to, and so the most literals it can hold
+ */
+static constexpr size_t kMaxBlockSize = 128 * 1024;
+
+enum BlockType : uint32_t {
+    kBlockRaw = 0,
+    kBlockRle = 1,
+    kBlockCompressed = 2,
+};
+
+enum LiteralsType : uint32_t {
+    kLiteralsRaw = 0,
+    kLiteralsRle = 1,
+    kLiteralsCompressed = 2,
+    // Huffman coded with the previous block's table
+    kLiteralsTreeless = 3,
+};
+
+/*!
+ * How each of the sequences' code tables is given
+ */
+enum TableMode : uint32_t {
+    kTablePredefined = 0,
+    kTableRle = 1,
+    kTableCompressed = 2,
+    kTableRepeat = 3,
+};
+
+/*!
+ * Huffman codes for literals are at most 11 bits, their weights are FSE coded with at most 6
+ */
+static constexpr uint32_t kMaxHuffmanBits = 11;
+static constexpr uint32_t kMaxHuffmanWeightLog = 6;
+static constexpr uint32_t kMaxLiteralSymbols = 256;
+
+/*!
+ * The largest accuracy log of each FSE table, and how many codes it has
+ */
+static constexpr uint32_t kMaxFseLog = 9;
+static constexpr uint32_t kMaxLiteralLengthLog = 9;
+static constexpr uint32_t kMaxMatchLengthLog = 9;
+static constexpr uint32_t kMaxOffsetLog = 8;
+static constexpr uint32_t kLiteralLengthCodes = 36;
+static constexpr uint32_t kMatchLengthCodes = 53;
+static constexpr uint32_t kOffsetCodes = 32;
+static constexpr uint32_t kMaxFseSymbols = kMatchLengthCodes;
+
+/*!
+ * What a literal length or match length code stands for: a base value, plus this many bits read
+ * from the stream
+ */
+struct LengthCode {
+    uint32_t base;
+    uint8_t bits;
+};
+
+static constexpr LengthCode kLiteralLengths[kLiteralLengthCodes] = {
+        {0, 0}, {1, 0}, {2, 0}, {3, 0}, {4, 0}, {5, 0}, {6, 0}, {7, 0}, {8, 0}, {9, 0}, {10, 0},
+        {11, 0}, {12, 0}, {13, 0}, {14, 0}, {15, 0}, {16, 1}, {18, 1}, {20, 1}, {22, 1}, {24, 2},
+        {28, 2}, {32, 3}, {40, 3}, {48, 4}, {64, 6}, {128, 7}, {256, 8}, {512, 9}, {1024, 10},
+        {2048, 11}, {4096, 12}, {8192, 13}, {16384, 14}, {32768, 15}, {65536, 16}};
+
+static constexpr LengthCode kMatchLengths[kMatchLengthCodes] = {
+        {3, 0}, {4, 0}, {5, 0}, {6, 0}, {7, 0}, {8, 0}, {9, 0}, {10, 0}, {11, 0}, {12, 0},
+        {13, 0}, {14, 0}, {15, 0}, {16, 0}, {17, 0}, {18, 0}, {19, 0}, {20, 0}, {21, 0}, {22, 0},
+        {23, 0}, {24, 0}, {25, 0}, {26, 0}, {27, 0}, {28, 0}, {29, 0}, {30, 0}, {31, 0}, {32, 0},
+        {33, 0}, {34, 0}, {35, 1}, {37, 1}, {39, 1}, {41, 1}, {43, 2}, {47, 2}, {51, 3}, {59, 3},
+        {67, 4}, {83, 4}, {99, 5}, {131, 7}, {259, 8}, {515, 9}, {1027, 10}, {2051, 11},
+        {4099, 12}, {8195, 13}, {16387, 14}, {32771, 15}, {65539, 16}};
+
+/*!
+ * The distributions used by predefined tables, -1 being a probability below 1
+ */
+static constexpr uint32_t kPredefinedLiteralLengthLog = 6;
+static constexpr int16_t kPredefinedLiteralLengths[kLiteralLengthCodes] = {
+        4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1,
+        1, 1, -1, -1, -1, -1};
+
+static constexpr uint32_t kPredefinedMatchLengthLog = 6;
+static constexpr int16_t kPredefinedMatchLengths[kMatchLengthCodes] = {
+        1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1, -1, -1};
+
+static constexpr uint32_t kPredefinedOffsetLog = 5;
+static constexpr int16_t kPredefinedOffsets[29] = {
+        1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1,
+        -1};
+
+/*!
+ * The offsets repeat codes refer to at the start of a frame
+ */
+static constexpr uint32_t kInitialRepeatOffsets[3] = {1, 4, 8};
+
+static inline uint64_t readLittleEndian(const uint8_t *data, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= uint64_t(data[i]) << (i * 8);
+    }
+    return value;
+}
+
+static inline uint32_t highestBit(uint32_t value) {
+    uint32_t bit = 0;
+    while (value >>= 1) {
+        bit++;
+    }
+    return bit;
+}
+
+/*!
+ * Reads a bit stream from its first byte up, lowest bit first, as FSE table descriptions are
+ * written. Reading past the end gives zeros and is caught by @a isOverflowed.
+ */
+class ForwardBitReader {
+public:
+    ForwardBitReader(const uint8_t *data, size_t size) : data_(data), size_(size), offset_(0) {}
+
+    inline uint32_t peek(uint32_t bits) const {
+        uint64_t window = 0;
+        auto byte = offset_ / 8;
+        if (byte < size_) {
+            window = readLittleEndian(data_ + byte, std::min(size_ - byte, size_t(8)));
+        }
+        return uint32_t(window >> (offset_ % 8)) & ((1u << bits) - 1);
+    }
+
+    inline void skip(uint32_t bits) { offset_ += bits; }
+
+    inline uint32_t read(uint32_t bits) {
+        auto value = peek(bits);
+        skip(bits);
+        return value;
+    }
+
+    inline size_t getBytesRead() const { return (offset_ + 7) / 8; }
+
+    inline bool isOverflowed() const { return offset_ > size_ * 8; }
+
+private:
+    const uint8_t *data_;
+    size_t size_;
+    size_t offset_;
+};
+
+/*!
+ * Reads a bit stream from its last byte down, highest bit first, as FSE and Huffman coded data is
+ * written. The stream ends in a 1 bit marking where the data starts. Reading past the start gives
+ * zeros and is caught by @a isOverflowed.
+ */
+class BackwardBitReader {
+public:
+    BackwardBitReader() : data_(nullptr), size_(0), position_(0) {}
+
+    /*!
+     * @return false if the stream is empty or doesn't end in the marker
+     */
+    bool init(const uint8_t *data, size_t size) {
+        if (size == 0 || data[size - 1] == 0) {
+            return false;
+        }
+        data_ = data;
+        size_ = size;
+        position_ = int64_t(size - 1) * 8 + highestBit(data[size - 1]);
+        return true;
+    }
+
+    /*!
+     * @param bits up to 32
+     */
+    inline uint32_t peek(uint32_t bits) const {
+        if (bits == 0) {
+            return 0;
+        }
+        auto low = position_ - int64_t(bits);
+        uint64_t window;
+        if (low >= 0) {
+            window = load(size_t(low / 8)) >> (low % 8);
+        } else if (low > -64) {
+            window = load(0) << -low;
+        } else {
+            window = 0;
+        }
+        return uint32_t(window & ((uint64_t(1) << bits) - 1));
+    }
+
+    inline void skip(uint32_t bits) { position_ -= bits; }
+
+    inline uint32_t read(uint32_t bits) {
+        auto value = peek(bits);
+        skip(bits);
+        return value;
+    }
+
+    /*!
+     * @return true if every bit was read, and no more
+     */
+    inline bool isFinished() const { return position_ == 0; }
+
+    inline bool isOverflowed() const { return position_ < 0; }
+
+private:
+    inline uint64_t load(size_t byte) const {
+        if (byte + 8 <= size_) {
+            uint64_t value;
+            memcpy(&value, data_ + byte, sizeof(value));
+            return value;
+        }
+        return byte < size_ ? readLittleEndian(data_ + byte, size_ - byte) : 0;
+    }
+
+    const uint8_t *data_;
+    size_t size_;
+    // the bits still to read
+    int64_t position_;
+};
+
+struct FseEntry {
+    // added to the bits read to get the next state
+    uint16_t base;
+    uint8_t symbol;
+    uint8_t bits;
+};
+
+struct FseTable {
+    uint32_t accuracyLog;
+    FseEntry entries[1 << kMaxFseLog];
+};
+
+/*!
+ * Spreads a distribution over a decoding table the way the reference encoder does
+ * @param counts each symbol's share of the table, -1 for a probability below 1
+ * @return false if the distribution doesn't fill the table exactly
+ */
+static bool buildFseTable(
+        const int16_t *counts,
+        uint32_t symbolCount,
+        uint32_t accuracyLog,
+        FseTable &out) {
+    uint32_t tableSize = 1u << accuracyLog;
+    uint32_t highThreshold = tableSize - 1;
+    uint16_t nextStates[kMaxFseSymbols];
+    out.accuracyLog = accuracyLog;
+
+    // Symbols below 1 take a state each from the end of the table
+    for (uint32_t symbol = 0; symbol < symbolCount; symbol++) {
+        if (counts[symbol] == -1) {
+            out.entries[highThreshold--].symbol = uint8_t(symbol);
+            nextStates[symbol] = 1;
+        } else {
+            nextStates[symbol] = uint16_t(counts[symbol]);
+        }
+    }
+
+    uint32_t step = (tableSize >> 1) + (tableSize >> 3) + 3;
+    uint32_t mask = tableSize - 1;
+    uint32_t position = 0;
+    for (uint32_t symbol = 0; symbol < symbolCount; symbol++) {
+        for (int i = 0; i < counts[symbol]; i++) {
+            out.entries[position].symbol = uint8_t(symbol);
+            do {
+                position = (position + step) & mask;
+            } while (position > highThreshold);
+        }
+    }
+    if (position != 0) {
+        return false;
+    }
+
+    for (uint32_t state = 0; state < tableSize; state++) {
+        auto &entry = out.entries[state];
+        uint32_t nextState = nextStates[entry.symbol]++;
+        entry.bits = uint8_t(accuracyLog - highestBit(nextState));
+        entry.base = uint16_t((nextState << entry.bits) - tableSize);
+    }
+    return true;
+}
+
+/*!
+ * Makes the table of a single symbol, which reads no bits
+ */
+static void buildRleTable(uint8_t symbol, FseTable &out) {
+    out.accuracyLog = 0;
+    out.entries[0] = {0, symbol, 0};
+}
+
+/*!
+ * Reads an FSE table description and builds its decoding table
+ * @param outSize receives the size of the description
+ * @return false if the description is corrupt or goes past the limits
+ */
+static bool readFseTable(
+        const uint8_t *data,
+        size_t size,
+        uint32_t maxAccuracyLog,
+        uint32_t maxSymbols,
+        FseTable &out,
+        size_t &outSize) {
+    ForwardBitReader reader(data, size);
+    auto accuracyLog = reader.read(4) + 5;
+    if (accuracyLog > maxAccuracyLog) {
+        return false;
+    }
+
+    // Each count takes just enough bits for what's left of the table to share out
+    int16_t counts[kMaxFseSymbols] = {};
+    int32_t remaining = (1 << accuracyLog) + 1;
+    uint32_t threshold = 1u << accuracyLog;
+    uint32_t bits = accuracyLog + 1;
+    uint32_t symbol = 0;
+    while (remaining > 1 && symbol < maxSymbols) {
+        auto max = int32_t(2 * threshold - 1) - remaining;
+        int32_t count;
+        auto value = reader.peek(bits);
+        if (int32_t(value & (threshold - 1)) < max) {
+            count = int32_t(value & (threshold - 1));
+            reader.skip(bits - 1);
+        } else {
+            count = int32_t(value & (2 * threshold - 1));
+            if (count >= int32_t(threshold)) {
+                count -= max;
+            }
+            reader.skip(bits);
+        }
+        count--;
+        remaining -= count < 0 ? -count : count;
+        counts[symbol++] = int16_t(count);
+
+        // A zero is followed by how many more zeros come after it, 2 bits at a time
+        if (count == 0) {
+            uint32_t repeat;
+            do {
+                repeat = reader.read(2);
+                symbol += repeat;
+            } while (repeat == 3 && symbol <= maxSymbols && !reader.isOverflowed());
+            if (symbol > maxSymbols) {
+                return false;
+            }
+        }
+        while (remaining < int32_t(threshold)) {
+            bits--;
+            threshold >>= 1;
+        }
+    }
+    if (remaining != 1 || reader.isOverflowed()) {
+        return false;
+    }
+    outSize = reader.getBytesRead();
+    return buildFseTable(counts, symbol, accuracyLog, out);
+}
+
+struct HuffmanEntry {
+    uint8_t symbol;
+    uint8_t bits;
+};
+
+struct HuffmanTable {
+    uint32_t maxBits;
+    HuffmanEntry entries[1 << kMaxHuffmanBits];
+};
+
+/*!
+ * Reads the literals' Huffman table, given as weights for every symbol but the last
+ * @param outSize receives the size of the description
+ * @return false if the description is corrupt
+ */
+static bool readHuffmanTable(
+        const uint8_t *data,
+        size_t size,
+        HuffmanTable &out,
+        size_t &outSize) {
+    if (size == 0) {
+        return false;
+    }
+    uint8_t weights[kMaxLiteralSymbols];
+    uint32_t weightCount = 0;
+    auto header = data[0];
+    if (header < 128) {
+        // FSE coded, with two states taking turns
+        size_t compressedSize = header;
+        if (compressedSize == 0 || compressedSize + 1 > size) {
+            return false;
+        }
+        FseTable table;
+        size_t tableSize;
+        if (!readFseTable(data + 1, compressedSize, kMaxHuffmanWeightLog, kMaxHuffmanBits + 1,
+                          table, tableSize) || tableSize >= compressedSize) {
+            return false;
+        }
+        BackwardBitReader reader;
+        if (!reader.init(data + 1 + tableSize, compressedSize - tableSize)) {
+            return false;
+        }
+        uint32_t states[2];
+        states[0] = reader.read(table.accuracyLog);
+        states[1] = reader.read(table.accuracyLog);
+        for (uint32_t turn = 0;; turn ^= 1) {
+            if (weightCount + 2 > kMaxLiteralSymbols) {
+                return false;
+            }
+            const auto &entry = table.entries[states[turn]];
+            weights[weightCount++] = entry.symbol;
+            states[turn] = entry.base + reader.read(entry.bits);
+            // Once the stream runs out, the other state holds the last weight
+            if (reader.isOverflowed()) {
+                weights[weightCount++] = table.entries[states[turn ^ 1]].symbol;
+                break;
+            }
+        }
+        outSize = 1 + compressedSize;
+    } else {
+        // 4 bits each
+        weightCount = header - 127u;
+        size_t bytes = (weightCount + 1) / 2;
+        if (1 + bytes > size || weightCount >= kMaxLiteralSymbols) {
+            return false;
+        }
+        for (uint32_t i = 0; i < weightCount; i++) {
+            auto byte = data[1 + i / 2];
+            weights[i] = i % 2 == 0 ? byte >> 4 : byte & 0xF;
+        }
+        outSize = 1 + bytes;
+    }
+
+    // The last weight is whatever brings the total up to the next power of 2
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < weightCount; i++) {
+        if (weights[i] > kMaxHuffmanBits) {
+            return false;
+        }
+        total += weights[i] ? 1u << (weights[i] - 1) : 0;
+    }
+    if (total == 0) {
+        return false;
+    }
+    auto maxBits = highestBit(total) + 1;
+    auto rest = (1u << maxBits) - total;
+    if (maxBits > kMaxHuffmanBits || rest != 1u << highestBit(rest)) {
+        return false;
+    }
+    weights[weightCount++] = uint8_t(highestBit(rest) + 1);
+
+    // Codes are handed out from the lightest weights, the longest codes, up
+    uint32_t rankStarts[kMaxHuffmanBits + 2] = {};
+    for (uint32_t i = 0; i < weightCount; i++) {
+        rankStarts[weights[i]] += weights[i] ? 1u << (weights[i] - 1) : 0;
+    }
+    uint32_t next = 0;
+    for (uint32_t weight = 1; weight <= maxBits; weight++) {
+        auto share = rankStarts[weight];
+        rankStarts[weight] = next;
+        next += share;
+    }
+    out.maxBits = maxBits;
+    for (uint32_t symbol = 0; symbol < weightCount; symbol++) {
+        auto weight = weights[symbol];
+        if (weight == 0) {
+            continue;
+        }
+        HuffmanEntry entry{uint8_t(symbol), uint8_t(maxBits + 1 - weight)};
+        auto start = rankStarts[weight];
+        auto length = 1u << (weight - 1);
+        for (uint32_t i = 0; i < length; i++) {
+            out.entries[start + i] = entry;
+        }
+        rankStarts[weight] += length;
+    }
+    return true;
+}
+
+/*!
+ * Decodes one Huffman coded stream of literals
+ * @return false unless the stream holds exactly @a count literals
+ */
+static bool decodeHuffmanStream(
+        const HuffmanTable &table,
+        const uint8_t *data,
+        size_t size,
+        uint8_t *out,
+        size_t count) {
+    BackwardBitReader reader;
+    if (!reader.init(data, size)) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        const auto &entry = table.entries[reader.peek(table.maxBits)];
+        out[i] = entry.symbol;
+        reader.skip(entry.bits);
+    }
+    return reader.isFinished();
+}
+
+/*!
+ * The state carried from block to block within a frame
+ */
+class ZstdFrameDecoder {
+public:
+    ZstdFrameDecoder() : literals_(kMaxBlockSize) {}
+
+    /*!
+     * Decompresses the frame at @a data, which starts after its magic number
+     * @param outPosition where the frame's output starts, moved past it
+     * @return false if the frame is corrupt, needs a dictionary or doesn't fit
+     */
+    bool decompressFrame(
+            const uint8_t *&data,
+            const uint8_t *end,
+            uint8_t *&outPosition,
+            uint8_t *outEnd);
+
+private:
+    bool decompressBlock(const uint8_t *data, size_t size);
+
+    /*!
+     * @param outSize receives the size of the literals section
+     */
+    bool decodeLiterals(const uint8_t *data, size_t size, size_t &outSize);
+
+    bool decodeSequences(const uint8_t *data, size_t size);
+
+    /*!
+     * Sets up one of the sequences' tables for a block
+     * @param outSize receives how many bytes of @a data the table took
+     */
+    bool readSequenceTable(
+            TableMode mode,
+            const uint8_t *data,
+            size_t size,
+            uint32_t maxAccuracyLog,
+            uint32_t symbolCount,
+            const FseTable &predefined,
+            FseTable &table,
+            bool &hasTable,
+            size_t &outSize);
+
+    /*!
+     * Copies literals and then a match to the output
+     */
+    bool executeSequence(uint32_t literalLength, uint32_t offset, uint32_t matchLength);
+
+    // this frame's output
+    uint8_t *frameStart_;
+    uint8_t *outPosition_;
+    uint8_t *outEnd_;
+
+    // the current block's literals, either in the input or in the buffer
+    std::vector<uint8_t> literals_;
+    const uint8_t *pLiterals_;
+    size_t literalCount_;
+
+    // the tables a later block can repeat
+    HuffmanTable huffman_;
+    bool hasHuffman_;
+    FseTable literalLengths_;
+    FseTable offsets_;
+    FseTable matchLengths_;
+    bool hasLiteralLengths_;
+    bool hasOffsets_;
+    bool hasMatchLengths_;
+    uint32_t repeatOffsets_[3];
+};
+
+/*!
+ * The tables for predefined mode, built once
+ */
+struct PredefinedTables {
+    FseTable literalLengths;
+    FseTable matchLengths;
+    FseTable offsets;
+};
+
+static const PredefinedTables &getPredefinedTables() {
+    static const auto *pTables = []() {
+        auto *pTables = new PredefinedTables();
+        buildFseTable(kPredefinedLiteralLengths, kLiteralLengthCodes,
+                      kPredefinedLiteralLengthLog, pTables->literalLengths);
+        buildFseTable(kPredefinedMatchLengths, kMatchLengthCodes,
+                      kPredefinedMatchLengthLog, pTables->matchLengths);
+        buildFseTable(kPredefinedOffsets, uint32_t(std::size(kPredefinedOffsets)),
+                      kPredefinedOffsetLog, pTables->offsets);
+        return pTables;
+    }();
+    return *pTables;
+}
+
+bool ZstdFrameDecoder::decompressFrame(
+        const uint8_t *&data,
+        const uint8_t *end,
+        uint8_t *&outPosition,
+        uint8_t *outEnd) {
+    // The header: a descriptor byte, then the window size, dictionary ID and content size,
+    // each only when the descriptor says it's there
+    if (data == end) {
+        return false;
+    }
+    auto descriptor = *data++;
+    auto contentSizeFlag = descriptor >> 6;
+    bool singleSegment = (descriptor >> 5) & 1;
+    bool hasChecksum = (descriptor >> 2) & 1;
+    auto dictionaryIdFlag = descriptor & 3;
+    if (descriptor & 0x08) {
+        return false;
+    }
+    static constexpr size_t kDictionaryIdSizes[4] = {0, 1, 2, 4};
+    size_t contentSizeBytes = contentSizeFlag == 0 ? (singleSegment ? 1 : 0)
+                                                   : size_t(1) << contentSizeFlag;
+    size_t headerRest = (singleSegment ? 0 : 1) + kDictionaryIdSizes[dictionaryIdFlag]
+                        + contentSizeBytes;
+    if (size_t(end - data) < headerRest) {
+        return false;
+    }
+    data += singleSegment ? 0 : 1;
+    auto dictionaryId = readLittleEndian(data, kDictionaryIdSizes[dictionaryIdFlag]);
+    data += kDictionaryIdSizes[dictionaryIdFlag];
+    if (dictionaryId != 0) {
+        return false;
+    }
+    bool hasContentSize = contentSizeBytes > 0;
+    auto contentSize = readLittleEndian(data, contentSizeBytes) + (contentSizeBytes == 2 ? 256 : 0);
+    data += contentSizeBytes;
+
+    frameStart_ = outPosition;
+    outPosition_ = outPosition;
+    outEnd_ = outEnd;
+    hasHuffman_ = false;
+    hasLiteralLengths_ = false;
+    hasOffsets_ = false;
+    hasMatchLengths_ = false;
+    memcpy(repeatOffsets_, kInitialRepeatOffsets, sizeof(repeatOffsets_));
+
+    bool lastBlock = false;
+    while (!lastBlock) {
+        if (end - data < 3) {
+            return false;
+        }
+        auto blockHeader = uint32_t(readLittleEndian(data, 3));
+        data += 3;
+        lastBlock = blockHeader & 1;
+        auto type = (blockHeader >> 1) & 3;
+        size_t blockSize = blockHeader >> 3;
+        switch (type) {
+            case kBlockRaw:
+                if (size_t(end - data) < blockSize || size_t(outEnd_ - outPosition_) < blockSize) {
+                    return false;
+                }
+                memcpy(outPosition_, data, blockSize);
+                outPosition_ += blockSize;
+                data += blockSize;
+                break;
+            case kBlockRle:
+                if (data == end || size_t(outEnd_ - outPosition_) < blockSize) {
+                    return false;
+                }
+                memset(outPosition_, *data, blockSize);
+                outPosition_ += blockSize;
+                data++;
+                break;
+            case kBlockCompressed:
+                if (blockSize > kMaxBlockSize || size_t(end - data) < blockSize
+                    || !decompressBlock(data, blockSize)) {
+                    return false;
+                }
+                data += blockSize;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    auto frameSize = size_t(outPosition_ - frameStart_);
+    if (hasContentSize && frameSize != contentSize) {
+        return false;
+    }
+    if (hasChecksum) {
+        // The low 32 bits of the content's XXH64
+        if (end - data < 4) {
+            return false;
+        }
+        auto checksum = uint32_t(readLittleEndian(data, 4));
+        data += 4;
+        if (checksum != uint32_t(Hash::xxh64(frameStart_, frameSize))) {
+            return false;
+        }
+    }
+    outPosition = outPosition_;
+    return true;
+}
+
+bool ZstdFrameDecoder::decompressBlock(const uint8_t *data, size_t size) {
+    size_t literalsSize;
+    if (!decodeLiterals(data, size, literalsSize)) {
+        return false;
+    }
+    return decodeSequences(data + literalsSize, size - literalsSize);
+}
+
+bool ZstdFrameDecoder::decodeLiterals(const uint8_t *data, size_t size, size_t &outSize) {
+    if (size == 0) {
+        return false;
+    }
+    auto type = data[0] & 3;
+    auto sizeFormat = (data[0] >> 2) & 3;
+
+    if (type == kLiteralsRaw || type == kLiteralsRle) {
+        // 5, 12 or 20 bits of size
+        size_t headerSize = (sizeFormat & 1) == 0 ? 1 : sizeFormat == 1 ? 2 : 3;
+        if (size < headerSize) {
+            return false;
+        }
+        auto header = readLittleEndian(data, headerSize);
+        size_t count = headerSize == 1 ? size_t(header >> 3) : size_t(header >> 4);
+        if (count > kMaxBlockSize) {
+            return false;
+        }
+        if (type == kLiteralsRaw) {
+            if (size - headerSize < count) {
+                return false;
+            }
+            pLiterals_ = data + headerSize;
+            outSize = headerSize + count;
+        } else {
+            if (size - headerSize < 1) {
+                return false;
+            }
+            memset(literals_.data(), data[headerSize], count);
+            pLiterals_ = literals_.data();
+            outSize = headerSize + 1;
+        }
+        literalCount_ = count;
+        return true;
+    }
+
+    // Huffman coded: the regenerated and compressed sizes share 10, 14 or 18 bits each, and
+    // everything but the smallest size is split into 4 streams
+    static constexpr size_t kHeaderSizes[4] = {3, 3, 4, 5};
+    static constexpr uint32_t kSizeBits[4] = {10, 10, 14, 18};
+    auto headerSize = kHeaderSizes[sizeFormat];
+    auto sizeBits = kSizeBits[sizeFormat];
+    bool fourStreams = sizeFormat != 0;
+    if (size < headerSize) {
+        return false;
+    }
+    auto header = readLittleEndian(data, headerSize);
+    auto sizeMask = (uint64_t(1) << sizeBits) - 1;
+    auto count = size_t((header >> 4) & sizeMask);
+    auto compressedSize = size_t((header >> (4 + sizeBits)) & sizeMask);
+    if (count > kMaxBlockSize || compressedSize > size - headerSize) {
+        return false;
+    }
+
+    const auto *pStreams = data + headerSize;
+    auto streamsSize = compressedSize;
+    if (type == kLiteralsCompressed) {
+        size_t tableSize;
+        if (!readHuffmanTable(pStreams, streamsSize, huffman_, tableSize)
+            || tableSize > streamsSize) {
+            return false;
+        }
+        hasHuffman_ = true;
+        pStreams += tableSize;
+        streamsSize -= tableSize;
+    } else if (!hasHuffman_) {
+        return false;
+    }
+
+    auto *pOut = literals_.data();
+    if (!fourStreams) {
+        if (!decodeHuffmanStream(huffman_, pStreams, streamsSize, pOut, count)) {
+            return false;
+        }
+    } else {
+        // A jump table gives the sizes of the first 3, each holds a quarter rounded up
+        if (streamsSize < 6) {
+            return false;
+        }
+        size_t streamSizes[4];
+        size_t total = 6;
+        for (int i = 0; i < 3; i++) {
+            streamSizes[i] = size_t(readLittleEndian(pStreams + i * 2, 2));
+            total += streamSizes[i];
+        }
+        auto quarter = (count + 3) / 4;
+        if (total > streamsSize || quarter * 3 > count) {
+            return false;
+        }
+        streamSizes[3] = streamsSize - total;
+        const auto *pStream = pStreams + 6;
+        for (int i = 0; i < 4; i++) {
+            auto streamCount = i < 3 ? quarter : count - quarter * 3;
+            if (!decodeHuffmanStream(huffman_, pStream, streamSizes[i], pOut, streamCount)) {
+                return false;
+            }
+            pStream += streamSizes[i];
+            pOut += streamCount;
+        }
+    }
+    pLiterals_ = literals_.data();
+    literalCount_ = count;
+    outSize = headerSize + compressedSize;
+    return true;
+}
+
+bool ZstdFrameDecoder::readSequenceTable(
+        TableMode mode,
+        const uint8_t *data,
+        size_t size,
+        uint32_t maxAccuracyLog,
+        uint32_t symbolCount,
+        const FseTable &predefined,
+        FseTable &table,
+        bool &hasTable,
+        size_t &outSize) {
+    outSize = 0;
+    switch (mode) {
+        case kTablePredefined:
+            table = predefined;
+            break;
+        case kTableRle:
+            if (size < 1 || data[0] >= symbolCount) {
+                return false;
+            }
+            buildRleTable(data[0], table);
+            outSize = 1;
+            break;
+        case kTableCompressed:
+            if (!readFseTable(data, size, maxAccuracyLog, symbolCount, table, outSize)) {
+                return false;
+            }
+            break;
+        case kTableRepeat:
+            if (!hasTable) {
+                return false;
+            }
+            break;
+    }
+    hasTable = true;
+    return true;
+}
+
+bool ZstdFrameDecoder::decodeSequences(const uint8_t *data, size_t size) {
+    // The number of sequences takes 1 to 3 bytes
+    if (size < 1) {
+        return false;
+    }
+    uint32_t sequenceCount = data[0];
+    size_t offset = 1;
+    if (sequenceCount >= 128) {
+        if (sequenceCount == 255) {
+            if (size < 3) {
+                return false;
+            }
+            sequenceCount = data[1] + (uint32_t(data[2]) << 8) + 0x7F00;
+            offset = 3;
+        } else {
+            if (size < 2) {
+                return false;
+            }
+            sequenceCount = ((sequenceCount - 128) << 8) + data[1];
+            offset = 2;
+        }
+    }
+
+    // A block of only literals
+    if (sequenceCount == 0) {
+        return offset == size && executeSequence(uint32_t(literalCount_), 0, 0);
+    }
+
+    if (offset == size) {
+        return false;
+    }
+    auto modes = data[offset++];
+    if (modes & 3) {
+        return false;
+    }
+    const auto &predefined = getPredefinedTables();
+    size_t tableSize;
+    if (!readSequenceTable(TableMode(modes >> 6), data + offset, size - offset,
+                           kMaxLiteralLengthLog, kLiteralLengthCodes, predefined.literalLengths,
+                           literalLengths_, hasLiteralLengths_, tableSize)) {
+        return false;
+    }
+    offset += tableSize;
+    if (!readSequenceTable(TableMode((modes >> 4) & 3), data + offset, size - offset,
+                           kMaxOffsetLog, kOffsetCodes, predefined.offsets,
+                           offsets_, hasOffsets_, tableSize)) {
+        return false;
+    }
+    offset += tableSize;
+    if (!readSequenceTable(TableMode((modes >> 2) & 3), data + offset, size - offset,
+                           kMaxMatchLengthLog, kMatchLengthCodes, predefined.matchLengths,
+                           matchLengths_, hasMatchLengths_, tableSize)) {
+        return false;
+    }
+    offset += tableSize;
+
+    BackwardBitReader reader;
+    if (!reader.init(data + offset, size - offset)) {
+        return false;
+    }
+    auto literalLengthState = reader.read(literalLengths_.accuracyLog);
+    auto offsetState = reader.read(offsets_.accuracyLog);
+    auto matchLengthState = reader.read(matchLengths_.accuracyLog);
+
+    size_t literalsUsed = 0;
+    for (uint32_t i = 0; i < sequenceCount; i++) {
+        const auto &literalLengthEntry = literalLengths_.entries[literalLengthState];
+        const auto &offsetEntry = offsets_.entries[offsetState];
+        const auto &matchLengthEntry = matchLengths_.entries[matchLengthState];
+
+        // The extra bits come offset first, then match length, then literal length
+        auto offsetCode = offsetEntry.symbol;
+        if (offsetCode >= kOffsetCodes) {
+            return false;
+        }
+        auto offsetValue = (uint32_t(1) << offsetCode) + reader.read(offsetCode);
+        const auto &matchLengthCode = kMatchLengths[matchLengthEntry.symbol];
+        auto matchLength = matchLengthCode.base + reader.read(matchLengthCode.bits);
+        const auto &literalLengthCode = kLiteralLengths[literalLengthEntry.symbol];
+        auto literalLength = literalLengthCode.base + reader.read(literalLengthCode.bits);
+
+        // Values up to 3 pick one of the last 3 offsets, shifted by one after no literals
+        uint32_t matchOffset;
+        if (offsetValue > 3) {
+            matchOffset = offsetValue - 3;
+            repeatOffsets_[2] = repeatOffsets_[1];
+            repeatOffsets_[1] = repeatOffsets_[0];
+        } else {
+            auto repeat = offsetValue - 1 + (literalLength == 0 ? 1 : 0);
+            if (repeat == 0) {
+                matchOffset = repeatOffsets_[0];
+            } else {
+                matchOffset = repeat == 3 ? repeatOffsets_[0] - 1 : repeatOffsets_[repeat];
+                if (repeat != 1) {
+                    repeatOffsets_[2] = repeatOffsets_[1];
+                }
+                repeatOffsets_[1] = repeatOffsets_[0];
+            }
+        }
+        repeatOffsets_[0] = matchOffset;
+
+        if (literalLength > literalCount_ - literalsUsed
+            || !executeSequence(literalLength, matchOffset, matchLength)) {
+            return false;
+        }
+        pLiterals_ += literalLength;
+        literalsUsed += literalLength;
+
+        if (i + 1 < sequenceCount) {
+            literalLengthState = literalLengthEntry.base + reader.read(literalLengthEntry.bits);
+            matchLengthState = matchLengthEntry.base + reader.read(matchLengthEntry.bits);
+            offsetState = offsetEntry.base + reader.read(offsetEntry.bits);
+        }
+    }
+    if (!reader.isFinished()) {
+        return false;
+    }
+
+    // Whatever literals are left come after the last match
+    return executeSequence(uint32_t(literalCount_ - literalsUsed), 0, 0);
+}
+
+bool ZstdFrameDecoder::executeSequence(
+        uint32_t literalLength,
+        uint32_t offset,
+        uint32_t matchLength) {
+    if (size_t(outEnd_ - outPosition_) < size_t(literalLength) + matchLength) {
+        return false;
+    }
+    memcpy(outPosition_, pLiterals_, literalLength);
+    outPosition_ += literalLength;
+    if (matchLength == 0) {
+        return true;
+    }
+
+    // Matches can't reach back past the start of the frame, and may overlap their own output
+    if (offset == 0 || offset > size_t(outPosition_ - frameStart_)) {
+        return false;
+    }
+    const auto *pMatch = outPosition_ - offset;
+    if (offset >= matchLength) {
+        memcpy(outPosition_, pMatch, matchLength);
+    } else {
+        for (uint32_t i = 0; i < matchLength; i++) {
+            outPosition_[i] = pMatch[i];
+        }
+    }
+    outPosition_ += matchLength;
+    return true;
+}
+
+bool Zstd::decompress(const uint8_t *data, size_t size, uint8_t *out, size_t outSize) {
+    if (!data || !out) {
+        return false;
+    }
+    const auto *end = data + size;
+    auto *outPosition = out;
+    auto *outEnd = out + outSize;
+    std::unique_ptr<ZstdFrameDecoder> pDecoder;
+    while (data != end || !pDecoder) {
+        if (end - data < 4) {
+            return false;
+        }
+        auto magic = uint32_t(readLittleEndian(data, 4));
+        data += 4;
+        if ((magic & kSkippableFrameMagicMask) == kSkippableFrameMagic) {
+            if (end - data < 4) {
+                return false;
+            }
+            auto frameSize = size_t(readLittleEndian(data, 4));
+            data += 4;
+            if (size_t(end - data) < frameSize) {
+                return false;
+            }
+            data += frameSize;
+            continue;
+        }
+        if (magic != kFrameMagic) {
+            return false;
+        }
+        if (!pDecoder) {
+            pDecoder = std::make_unique<ZstdFrameDecoder>();
+        }
+        if (!pDecoder->decompressFrame(data, end, outPosition, outEnd)) {
+            return false;
+        }
+    }
+    return outPosition == outEnd;
+}
@@ -0,0 +1,27 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ZSTD_H
+#define ANDROIDGLINVESTIGATIONS_ZSTD_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * Zstandard decompression (RFC 8878), for the KTX2 levels that toktx supercompresses with --zcmp.
+ * Any frame the reference encoder writes at any level decompresses, except ones that need a
+ * dictionary. Every length, offset and table is checked against the buffers, so corrupt data
+ * can't read or write out of bounds.
+ */
+class Zstd {
+public:
+    /*!
+     * Decompresses one or more frames, checking each frame's checksum when it has one
+     * @param data the compressed frames
+     * @param size the size of the compressed frames
+     * @param out receives the decompressed bytes
+     * @param outSize the exact size of the decompressed frames
+     * @return false if the data is corrupt, needs a dictionary or doesn't decompress to exactly
+     *     @a outSize bytes
+     */
+    static bool decompress(const uint8_t *data, size_t size, uint8_t *out, size_t outSize);
+};
+
+#endif //ANDROIDGLINVESTIGATIONS_ZSTD_H
@@ -2,6 +2,7 @@
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 
 #include "AndroidOut.h"
+#include "MemoryPressure.h"
 #include "Renderer.h"
 
 extern "C" {
@@ -32,11 +33,35 @@ void handle_cmd(android_app *pApp, int32_t cmd) {
                 delete pRenderer;
             }
             break;
+        case APP_CMD_WINDOW_RESIZED:
+        case APP_CMD_WINDOW_REDRAW_NEEDED:
+        case APP_CMD_CONTENT_RECT_CHANGED:
+        case APP_CMD_CONFIG_CHANGED:
+            // The loop only draws when something changed, and these change what's on screen
+            if (pApp->userData) {
+                reinterpret_cast<Renderer *>(pApp->userData)->requestRedraw();
+            }
+            break;
+        case APP_CMD_LOW_MEMORY:
+            // The system is about to start killing processes, give back everything possible. The
+            // trim itself runs on the next frame.
+            MemoryPressure::post(TrimTier::Pools);
+            break;
         default:
             break;
     }
 }
 
+/*!
+ * Called from MainActivity.onTrimMemory on the UI thread
+ * @param level one of the android.content.ComponentCallbacks2 TRIM_MEMORY_ levels
+ */
+JNIEXPORT void JNICALL
+Java_com_omsi_nativeguitest_MainActivity_nativeOnTrimMemory(JNIEnv *, jobject, jint level) {
+    aout << "onTrimMemory " << level << std::endl;
+    MemoryPressure::postTrimLevel(level);
+}
+
 /*!
  * Enable the motion events you want to handle; not handled events are
  * passed back to OS for further processing. For this example case,
@@ -62,6 +87,11 @@ void android_main(struct android_app *pApp) {
     // Register an event handler for Android events
     pApp->onAppCmd = handle_cmd;
 
+#ifndef NDEBUG
+    // Lets memory pressure be simulated with "adb shell kill -USR1 <pid>"
+    MemoryPressure::installSimulationSignal();
+#endif
+
     // Set input event filters (set it to NULL if the app wants to process all inputs).
     // Note that for key inputs, this example uses the default default_key_filter()
     // implemented in android_native_app_glue.c.
@@ -69,17 +99,29 @@ void android_main(struct android_app *pApp) {
 
     // This sets up a typical game/event loop. It will run until the app is destroyed.
     do {
+        // Sleep until there's something to do: an app command, input, work handed back to the
+        // renderer or one of its timers. Without a window there's nothing to draw at all.
+        auto *pIdleRenderer = reinterpret_cast<Renderer *>(pApp->userData);
+        int timeout = pIdleRenderer ? pIdleRenderer->getPollTimeout() : -1;
+
         // Process all pending events before running game logic.
         bool done = false;
         while (!done) {
-            // 0 is non-blocking.
-            int timeout = 0;
             int events;
             android_poll_source *pSource;
             int result = ALooper_pollOnce(timeout, nullptr, &events,
                                           reinterpret_cast<void**>(&pSource));
+            // Only the first poll waits, the rest just drain what's already there. 0 is
+            // non-blocking.
+            timeout = 0;
             switch (result) {
                 case ALOOPER_POLL_TIMEOUT:
+                    // The timeout is the next timer on the completion queue. Timers don't write to
+                    // its fd, so the looper callback doesn't run them. The renderer is looked up
+                    // again, an app command may have destroyed it since.
+                    if (pApp->userData) {
+                        reinterpret_cast<Renderer *>(pApp->userData)->runCompletions();
+                    }
                     [[clang::fallthrough]];
                 case ALOOPER_POLL_WAKE:
                     // No events occurred before the timeout or explicit wake. Stop checking for events.
@@ -106,8 +148,10 @@ void android_main(struct android_app *pApp) {
             // Process game input
             pRenderer->handleInput();
 
-            // Render a frame
-            pRenderer->render();
+            // Render a frame, unless nothing has changed since the last one
+            if (pRenderer->needsFrame()) {
+                pRenderer->render();
+            }
         }
     } while (!pApp->destroyRequested);
 }
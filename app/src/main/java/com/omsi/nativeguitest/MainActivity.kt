@@ -10,6 +10,16 @@ class MainActivity : GameActivity() {
         }
     }
 
+    override fun onTrimMemory(level: Int) {
+        super.onTrimMemory(level)
+        nativeOnTrimMemory(level)
+    }
+
+    /**
+     * Hands the trim level to the native memory pressure handling, implemented in main.cpp
+     */
+    private external fun nativeOnTrimMemory(level: Int)
+
     override fun onWindowFocusChanged(hasFocus: Boolean) {
         super.onWindowFocusChanged(hasFocus)
         if (hasFocus) {
@@ -0,0 +1,171 @@
+/*!
+ * How an AssetRegistry holds up with many threads asking for overlapping sets of assets.
+ *
+ *   asset_registry_benchmark [max threads]
+ *
+ * Each thread walks a skewed random sequence over a shared set of names, so a few assets are
+ * asked for constantly and many only now and then, the way sprites are across a scene. The first
+ * request for a name loads it, which takes a while, and everyone else asking meanwhile waits for
+ * that one load. Runs with 1 shard, a single lock, and with the default, from 1 thread up.
+ *
+ * Every asset is checked to have been loaded exactly once and handed to every request.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AssetRegistry.h"
+
+static constexpr int kAssetCount = 4096;
+static constexpr int kRequestsPerThread = 200000;
+
+/*!
+ * How long a load takes, in iterations of busy work
+ */
+static constexpr int kLoadWork = 20000;
+
+struct Asset {
+    int id;
+};
+
+/*!
+ * Busy work that can't be optimized out
+ */
+static void spin(int iterations) {
+    volatile float value = 1.f;
+    for (int i = 0; i < iterations; i++) {
+        value = value * 1.0001f + 0.0001f;
+    }
+}
+
+/*!
+ * Blocks a thread until a waiter it handed to the registry is called
+ */
+class Wait {
+public:
+    Wait() : done_(false) {}
+
+    void set(const std::shared_ptr<Asset> &spAsset) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        spAsset_ = spAsset;
+        done_ = true;
+        condition_.notify_one();
+    }
+
+    std::shared_ptr<Asset> get() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.wait(lock, [this]() { return done_; });
+        return spAsset_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool done_;
+    std::shared_ptr<Asset> spAsset_;
+};
+
+struct Result {
+    double seconds;
+    long loads;
+    long waits;
+    bool correct;
+};
+
+static Result run(int threadCount, size_t shardCount, const std::vector<std::string> &names) {
+    AssetRegistry<Asset> registry(shardCount);
+    std::vector<std::atomic<int>> loadCounts(names.size());
+    std::atomic<long> waits(0);
+    std::atomic<bool> correct(true);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; t++) {
+        threads.emplace_back([&, t]() {
+            // Skewed towards low ids, every thread shares the hot ones
+            std::mt19937 random(uint32_t(t + 1));
+            std::exponential_distribution<double> distribution(8.0 / kAssetCount);
+            for (int i = 0; i < kRequestsPerThread; i++) {
+                auto id = std::min(int(distribution(random)), kAssetCount - 1);
+                const auto &name = names[size_t(id)];
+
+                auto spWait = std::make_shared<Wait>();
+                std::shared_ptr<Asset> spAsset;
+                auto acquired = registry.acquire(
+                        name,
+                        [spWait](const std::shared_ptr<Asset> &spLoaded) { spWait->set(spLoaded); },
+                        spAsset);
+                if (acquired == AssetRegistry<Asset>::AcquireResult::Load) {
+                    loadCounts[size_t(id)]++;
+                    spin(kLoadWork);
+                    spAsset = registry.resolve(name, std::make_shared<Asset>(Asset{id}));
+                } else if (acquired == AssetRegistry<Asset>::AcquireResult::Waiting) {
+                    waits++;
+                    spAsset = spWait->get();
+                }
+                if (!spAsset || spAsset->id != id) {
+                    correct = false;
+                }
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    long loads = 0;
+    for (auto &count: loadCounts) {
+        if (count > 1) {
+            correct = false;
+        }
+        loads += count;
+    }
+    return Result{elapsed.count(), loads, waits.load(), correct.load()};
+}
+
+int main(int argc, char **argv) {
+    int maxThreads = std::max(int(std::thread::hardware_concurrency()), 1);
+    if (argc > 1) {
+        maxThreads = std::max(atoi(argv[1]), 1);
+    }
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::vector<std::string> names;
+    for (int i = 0; i < kAssetCount; i++) {
+        names.push_back("sprites/sprite_" + std::to_string(i) + ".png");
+    }
+
+    bool correct = true;
+    printf("%-8s %-8s %16s %10s %10s\n", "threads", "shards", "M lookups/s", "loads", "waits");
+    for (size_t shards: {size_t(1), size_t(16)}) {
+        for (auto threads: threadCounts) {
+            auto result = run(threads, shards, names);
+            printf("%-8d %-8zu %16.2f %10ld %10ld\n",
+                   threads,
+                   shards,
+                   double(threads) * kRequestsPerThread / result.seconds / 1e6,
+                   result.loads,
+                   result.waits);
+            correct &= result.correct;
+        }
+    }
+    if (!correct) {
+        printf("FAILED: an asset was loaded twice or a request got the wrong one\n");
+        return 1;
+    }
+    return 0;
+}
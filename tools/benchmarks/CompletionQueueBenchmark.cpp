@@ -0,0 +1,169 @@
+/*!
+ * Drives a CompletionQueue from a plain epoll loop, the way the app's ALooper does, and checks it
+ * wakes the loop only when there's work.
+ *
+ *   completion_queue_benchmark [producer threads]
+ *
+ * Three workloads:
+ *  - wake latency: one post at a time while the loop sleeps, timed from post to completion
+ *  - throughput: producers post as fast as they can, counting how often the loop had to wake
+ *  - timers: completions posted for later, timed against when they were due
+ *
+ * Every completion posted is checked to have run exactly once, on the loop's thread.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/epoll.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "CompletionQueue.h"
+
+using Clock = CompletionQueue::Clock;
+
+static constexpr int kLatencySamples = 200;
+static constexpr int kPostsPerProducer = 200000;
+static constexpr int kTimerCount = 50;
+static constexpr auto kTimerSpread = std::chrono::milliseconds(200);
+
+/*!
+ * An epoll loop on the calling thread around a CompletionQueue
+ */
+class EpollLoop {
+public:
+    explicit EpollLoop(CompletionQueue &queue)
+            : queue_(queue), epollFd_(epoll_create1(EPOLL_CLOEXEC)), wakeups_(0) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = queue_.getFd();
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, queue_.getFd(), &event);
+    }
+
+    ~EpollLoop() { close(epollFd_); }
+
+    /*!
+     * Sleeps until the queue has work, the way the app's main loop does when it's idle, and
+     * runs it
+     * @return how many completions ran
+     */
+    size_t runOnce() {
+        epoll_event event{};
+        if (epoll_wait(epollFd_, &event, 1, queue_.getTimeoutMillis()) > 0) {
+            wakeups_++;
+        }
+        return queue_.runPending();
+    }
+
+    inline size_t getWakeups() const { return wakeups_; }
+
+private:
+    CompletionQueue &queue_;
+    int epollFd_;
+    size_t wakeups_;
+};
+
+static double percentile(std::vector<double> samples, double fraction) {
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(size_t(fraction * double(samples.size())), samples.size() - 1)];
+}
+
+int main(int argc, char **argv) {
+    int producers = std::max(int(std::thread::hardware_concurrency()) - 1, 1);
+    if (argc > 1) {
+        producers = std::max(atoi(argv[1]), 1);
+    }
+
+    CompletionQueue queue;
+    if (queue.getFd() < 0) {
+        fprintf(stderr, "Couldn't create the eventfd\n");
+        return 1;
+    }
+    EpollLoop loop(queue);
+    auto loopThread = std::this_thread::get_id();
+    bool failed = false;
+
+    // Wake latency: a worker posts while the loop sleeps
+    std::vector<double> latencies;
+    for (int i = 0; i < kLatencySamples; i++) {
+        Clock::time_point posted;
+        Clock::time_point ran;
+        std::thread worker([&]() {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            posted = Clock::now();
+            queue.post([&]() { ran = Clock::now(); });
+        });
+        size_t ranCount = 0;
+        while (ranCount == 0) {
+            ranCount = loop.runOnce();
+        }
+        worker.join();
+        latencies.push_back(std::chrono::duration<double, std::micro>(ran - posted).count());
+    }
+    printf("wake latency: median %.1f us, p99 %.1f us\n",
+           percentile(latencies, 0.5), percentile(latencies, 0.99));
+
+    // Throughput: many producers, one loop
+    std::atomic<int> finishedProducers(0);
+    std::vector<int> runCounts(size_t(producers), 0);
+    auto wakeupsBefore = loop.getWakeups();
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&, p]() {
+            for (int i = 0; i < kPostsPerProducer; i++) {
+                queue.post([&, p]() {
+                    failed |= std::this_thread::get_id() != loopThread;
+                    runCounts[size_t(p)]++;
+                });
+            }
+            finishedProducers++;
+        });
+    }
+    size_t totalRan = 0;
+    size_t expected = size_t(producers) * kPostsPerProducer;
+    while (totalRan < expected) {
+        totalRan += loop.runOnce();
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    for (auto count: runCounts) {
+        failed |= count != kPostsPerProducer;
+    }
+    printf("throughput: %d producers, %.2f M completions/s, %zu wakeups for %zu posts\n",
+           producers, double(totalRan) / elapsed.count() / 1e6,
+           loop.getWakeups() - wakeupsBefore, expected);
+
+    // Timers: the loop sleeps until each is due
+    std::vector<double> lateness;
+    auto timerStart = Clock::now();
+    for (int i = 0; i < kTimerCount; i++) {
+        auto due = timerStart + kTimerSpread * (kTimerCount - i) / kTimerCount;
+        queue.postAt(due, [&lateness, due]() {
+            lateness.push_back(std::chrono::duration<double, std::milli>(
+                    Clock::now() - due).count());
+        });
+    }
+    auto timerWakeupsBefore = loop.getWakeups();
+    while (lateness.size() < size_t(kTimerCount)) {
+        loop.runOnce();
+    }
+    failed |= std::any_of(lateness.begin(), lateness.end(), [](double ms) { return ms < 0; });
+    printf("timers: median %.2f ms late, max %.2f ms, %zu wakeups for %d timers\n",
+           percentile(lateness, 0.5), percentile(lateness, 1.0),
+           loop.getWakeups() - timerWakeupsBefore, kTimerCount);
+
+    // Nothing left, so the loop would sleep forever
+    failed |= queue.getTimeoutMillis() != -1;
+
+    if (failed) {
+        printf("FAILED: a completion ran twice, was lost, ran early or ran off the loop thread\n");
+        return 1;
+    }
+    return 0;
+}
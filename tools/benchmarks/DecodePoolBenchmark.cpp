@@ -0,0 +1,157 @@
+/*!
+ * How batch image decoding on a DecodePool scales with its thread count.
+ *
+ *   decode_pool_benchmark [file.png ...]
+ *
+ * With no arguments a batch of synthetic photo-like 1024x1024 images is generated. The batch is
+ * decoded with 1 thread, then doubling up to the core count, and the big core count the app
+ * would pick is marked. Each job decodes into the scratch buffer the pool lends it and its
+ * completion checks a pixel, standing in for the upload on the GL thread.
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <png.h>
+
+#include "DecodePool.h"
+#include "PngImageDecoder.h"
+
+/*!
+ * How many times each batch runs. The fastest run is reported.
+ */
+static constexpr int kIterations = 3;
+
+/*!
+ * The synthetic batch
+ */
+static constexpr int kBatchSize = 24;
+static constexpr int kImageSize = 1024;
+
+static std::vector<uint8_t> encodePng(int size, const std::vector<uint8_t> &rgba) {
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    image.width = png_uint_32(size);
+    image.height = png_uint_32(size);
+    image.format = PNG_FORMAT_RGBA;
+
+    png_alloc_size_t pngSize = 0;
+    png_image_write_get_memory_size(image, pngSize, 0, rgba.data(), 0, nullptr);
+    std::vector<uint8_t> png(pngSize);
+    if (!png_image_write_to_memory(&image, png.data(), &pngSize, 0, rgba.data(), 0, nullptr)) {
+        return {};
+    }
+    png.resize(pngSize);
+    return png;
+}
+
+static std::vector<std::vector<uint8_t>> makeBatch() {
+    std::vector<std::vector<uint8_t>> batch;
+    std::mt19937 random(1234);
+    std::vector<uint8_t> photo(size_t(kImageSize) * kImageSize * 4);
+    for (int image = 0; image < kBatchSize; image++) {
+        for (int y = 0; y < kImageSize; y++) {
+            for (int x = 0; x < kImageSize; x++) {
+                auto *pixel = &photo[(size_t(y) * kImageSize + x) * 4];
+                int noise = int(random() % 16);
+                pixel[0] = uint8_t(x * 255 / kImageSize + noise / 2 + image);
+                pixel[1] = uint8_t(y * 255 / kImageSize + noise / 4);
+                pixel[2] = uint8_t((x + y) * 127 / kImageSize + noise);
+                pixel[3] = 255;
+            }
+        }
+        batch.push_back(encodePng(kImageSize, photo));
+    }
+    return batch;
+}
+
+/*!
+ * Decodes the whole batch on a pool of @a threadCount threads
+ * @return the best time in seconds, or a negative value if a decode failed
+ */
+static double decodeBatch(const std::vector<std::vector<uint8_t>> &batch, int threadCount) {
+    DecodePool pool(threadCount);
+    double bestSeconds = 1e9;
+    for (int i = 0; i < kIterations; i++) {
+        std::atomic<int> failures(0);
+        size_t checked = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t image = 0; image < batch.size(); image++) {
+            const auto &png = batch[image];
+            pool.submit(
+                    int(batch.size() - image),
+                    [&png, &failures](std::vector<uint8_t> &scratch) {
+                        auto pDecoder = PngImageDecoder::create(png.data(), png.size());
+                        if (!pDecoder) {
+                            failures++;
+                            return;
+                        }
+                        auto stride = pDecoder->getMinimumStride();
+                        scratch.resize(stride * pDecoder->getHeight());
+                        if (!pDecoder->decode(scratch.data(), stride)) {
+                            failures++;
+                        }
+                    },
+                    [&checked]() { checked++; });
+        }
+        pool.finish();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (failures > 0 || checked != batch.size()) {
+            return -1.0;
+        }
+        bestSeconds = std::min(bestSeconds, elapsed.count());
+    }
+    return bestSeconds;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::vector<uint8_t>> batch;
+    for (int i = 1; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        batch.emplace_back(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    if (batch.empty()) {
+        batch = makeBatch();
+    }
+
+    int coreCount = std::max(int(std::thread::hardware_concurrency()), 1);
+    int bigCoreCount = DecodePool::getBigCoreCount();
+    printf("%zu images, %d cores, %d big\n", batch.size(), coreCount, bigCoreCount);
+
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < coreCount; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(coreCount);
+    if (std::find(threadCounts.begin(), threadCounts.end(), bigCoreCount) == threadCounts.end()) {
+        threadCounts.push_back(bigCoreCount);
+        std::sort(threadCounts.begin(), threadCounts.end());
+    }
+
+    double serialSeconds = 0;
+    for (auto threads: threadCounts) {
+        auto seconds = decodeBatch(batch, threads);
+        if (seconds < 0) {
+            printf("  %2d threads failed\n", threads);
+            return 1;
+        }
+        if (threads == 1) {
+            serialSeconds = seconds;
+        }
+        printf("  %2d threads %9.2f ms %6.2fx%s\n",
+               threads,
+               seconds * 1000.0,
+               serialSeconds / seconds,
+               threads == bigCoreCount ? "  <- big cores" : "");
+    }
+    return 0;
+}
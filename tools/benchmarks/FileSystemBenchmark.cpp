@@ -0,0 +1,335 @@
+/*!
+ * Reads a set of files through the FileSystem the app's loaders use, with each host backend.
+ *
+ *   file_system_benchmark [directory]
+ *
+ * Every regular file under the directory is read, or a generated set of asset sized files when
+ * no directory is given. Three ways in:
+ *  - mapped: a DirectoryFileSource buffer, mmap with nothing copied
+ *  - streamed: a DirectoryFileSource read front to back in 64 KiB pieces
+ *  - memory: a MemoryFileSource holding every file
+ *  - pack: an AssetPack of every file, mapped once, entries used in place
+ *  - pack lz4: the same with every entry LZ4 compressed where that pays, decompressed per open
+ *
+ * The files are read once first, so each way is measured against a warm page cache. The slowest
+ * files from the file system's own I/O stats are listed after each run.
+ *
+ * Every way has to hash every file the same, a memory mount has to cover the directory under it,
+ * and missing files have to fail to open.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include "AssetPack.h"
+#include "DirectoryFileSource.h"
+#include "FileSystem.h"
+#include "Hash.h"
+#include "MemoryFileSource.h"
+
+static constexpr size_t kStreamChunkSize = 64 * 1024;
+static constexpr int kRepeats = 5;
+static constexpr size_t kLoggedFiles = 3;
+
+/*!
+ * Sizes of the generated files, roughly a sprite sheet's worth of assets
+ */
+static constexpr size_t kGeneratedSizes[] = {
+        4 * 1024, 16 * 1024, 64 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+static constexpr int kGeneratedFilesPerSize = 8;
+
+/*!
+ * Generated bytes are mostly repeats of what came this far before, so they compress about as
+ * well as typical asset data rather than not at all
+ */
+static constexpr size_t kGeneratedRepeatDistance = 64;
+
+static constexpr uint32_t kPackAlignment = 4096;
+
+/*!
+ * Adds the path of every regular file under @a directory, relative to @a root
+ */
+static void listFiles(
+        const std::string &root,
+        const std::string &directory,
+        std::vector<std::string> &outPaths) {
+    auto pDirectory = opendir((root + "/" + directory).c_str());
+    if (!pDirectory) {
+        return;
+    }
+    while (auto pEntry = readdir(pDirectory)) {
+        std::string name = pEntry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        auto path = directory.empty() ? name : directory + "/" + name;
+        struct stat status{};
+        if (stat((root + "/" + path).c_str(), &status) != 0) {
+            continue;
+        }
+        if (S_ISDIR(status.st_mode)) {
+            listFiles(root, path, outPaths);
+        } else if (S_ISREG(status.st_mode)) {
+            outPaths.push_back(path);
+        }
+    }
+    closedir(pDirectory);
+}
+
+/*!
+ * Writes random files of the sizes in @a kGeneratedSizes into a new temporary directory
+ * @return the directory, empty if it couldn't be made
+ */
+static std::string generateFiles(std::vector<std::string> &outPaths) {
+    char directory[] = "/tmp/file_system_benchmark_XXXXXX";
+    if (!mkdtemp(directory)) {
+        return "";
+    }
+    std::mt19937 random(1);
+    for (auto size: kGeneratedSizes) {
+        for (int i = 0; i < kGeneratedFilesPerSize; i++) {
+            auto path = "asset_" + std::to_string(size) + "_" + std::to_string(i) + ".bin";
+            std::vector<uint8_t> data(size);
+            for (size_t j = 0; j < size; j++) {
+                data[j] = j < kGeneratedRepeatDistance || random() % 4 == 0
+                          ? uint8_t(random())
+                          : data[j - kGeneratedRepeatDistance];
+            }
+            auto pFile = fopen((std::string(directory) + "/" + path).c_str(), "wb");
+            if (!pFile) {
+                return "";
+            }
+            fwrite(data.data(), 1, data.size(), pFile);
+            fclose(pFile);
+            outPaths.push_back(path);
+        }
+    }
+    return directory;
+}
+
+/*!
+ * Hashes a whole file from its buffer
+ * @return false if it can't be opened or read
+ */
+static bool hashMapped(FileSystem &fileSystem, const std::string &path, uint64_t &outHash) {
+    auto pFile = fileSystem.open(path, FileAccess::Buffer);
+    auto pData = pFile ? pFile->getBuffer() : nullptr;
+    if (!pData) {
+        return false;
+    }
+    outHash = Hash::xxh64(pData, size_t(pFile->getLength()));
+    return true;
+}
+
+/*!
+ * Hashes a whole file read in pieces. The pieces are hashed as a chain of their own hashes, so
+ * this is compared against @a hashChunks over the mapped buffer rather than a plain hash.
+ * @return false if it can't be opened or read
+ */
+static bool hashStreamed(
+        FileSystem &fileSystem,
+        const std::string &path,
+        std::vector<uint8_t> &chunk,
+        uint64_t &outHash) {
+    auto pFile = fileSystem.open(path, FileAccess::Streaming);
+    if (!pFile) {
+        return false;
+    }
+    chunk.resize(kStreamChunkSize);
+    uint64_t hash = 0;
+    int64_t total = 0;
+    while (true) {
+        auto bytesRead = pFile->read(chunk.data(), chunk.size());
+        if (bytesRead < 0) {
+            return false;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        hash = Hash::xxh64(chunk.data(), size_t(bytesRead), hash);
+        total += bytesRead;
+    }
+    outHash = hash;
+    return total == pFile->getLength();
+}
+
+/*!
+ * @return the hash @a hashStreamed gives for @a data
+ */
+static uint64_t hashChunks(const uint8_t *data, size_t size) {
+    uint64_t hash = 0;
+    for (size_t offset = 0; offset < size; offset += kStreamChunkSize) {
+        hash = Hash::xxh64(data + offset, std::min(kStreamChunkSize, size - offset), hash);
+    }
+    return hash;
+}
+
+/*!
+ * Writes a pack of @a inputs into @a directory and mounts it
+ * @return false if it couldn't be written or opened
+ */
+static bool mountPack(
+        FileSystem &fileSystem,
+        const std::string &directory,
+        const std::string &name,
+        const std::vector<AssetPack::Input> &inputs) {
+    auto pack = AssetPack::write(inputs, kPackAlignment);
+    auto pFile = fopen((directory + "/" + name).c_str(), "wb");
+    if (pack.empty() || !pFile) {
+        return false;
+    }
+    bool written = fwrite(pack.data(), 1, pack.size(), pFile) == pack.size();
+    written = fclose(pFile) == 0 && written;
+
+    auto spDirectory = std::make_shared<DirectoryFileSource>(directory);
+    auto spPack = AssetPack::create(spDirectory->open(name, FileAccess::Buffer));
+    if (!written || !spPack) {
+        return false;
+    }
+    fileSystem.mount("", spPack);
+    return true;
+}
+
+struct Run {
+    const char *name;
+    FileSystem *pFileSystem;
+    bool streamed;
+};
+
+int main(int argc, char **argv) {
+    std::vector<std::string> paths;
+    std::string directory;
+    bool generated = argc <= 1;
+    if (generated) {
+        directory = generateFiles(paths);
+    } else {
+        directory = argv[1];
+        listFiles(directory, "", paths);
+    }
+    if (directory.empty() || paths.empty()) {
+        printf("No files to read\n");
+        return 1;
+    }
+
+    FileSystem directoryFileSystem;
+    directoryFileSystem.mount("", std::make_shared<DirectoryFileSource>(directory));
+
+    // The reference hashes, and the memory pack, from a first pass that also warms the cache
+    bool correct = true;
+    uint64_t totalBytes = 0;
+    std::vector<uint64_t> hashes(paths.size());
+    std::vector<uint64_t> chunkHashes(paths.size());
+    auto spMemory = std::make_shared<MemoryFileSource>();
+    std::vector<AssetPack::Input> packInputs;
+    for (size_t i = 0; i < paths.size(); i++) {
+        auto pFile = directoryFileSystem.open(paths[i]);
+        auto pData = pFile ? pFile->getBuffer() : nullptr;
+        if (!pData) {
+            printf("FAILED: couldn't read %s\n", paths[i].c_str());
+            return 1;
+        }
+        auto size = size_t(pFile->getLength());
+        hashes[i] = Hash::xxh64(pData, size);
+        chunkHashes[i] = hashChunks(pData, size);
+        spMemory->add(paths[i], std::vector<uint8_t>(pData, pData + size));
+        packInputs.push_back({paths[i], std::vector<uint8_t>(pData, pData + size), false});
+        totalBytes += size;
+    }
+
+    FileSystem memoryFileSystem;
+    memoryFileSystem.mount("", spMemory);
+
+    char packDirectory[] = "/tmp/file_system_benchmark_pack_XXXXXX";
+    FileSystem packFileSystem;
+    FileSystem compressedPackFileSystem;
+    bool packed = mkdtemp(packDirectory)
+                  && mountPack(packFileSystem, packDirectory, "stored.mpak", packInputs);
+    for (auto &input: packInputs) {
+        input.compress = true;
+    }
+    packed = packed
+             && mountPack(compressedPackFileSystem, packDirectory, "compressed.mpak", packInputs);
+    packInputs.clear();
+    if (!packed) {
+        printf("FAILED: couldn't write the packs\n");
+        return 1;
+    }
+
+    printf("%zu files, %.1f MiB, from %s\n",
+           paths.size(), double(totalBytes) / (1024 * 1024), directory.c_str());
+    printf("%-10s %12s %12s\n", "way in", "ms", "MiB/s");
+    std::vector<uint8_t> chunk;
+    for (const auto &run: {Run{"mapped", &directoryFileSystem, false},
+                           Run{"streamed", &directoryFileSystem, true},
+                           Run{"memory", &memoryFileSystem, false},
+                           Run{"pack", &packFileSystem, false},
+                           Run{"pack lz4", &compressedPackFileSystem, false}}) {
+        run.pFileSystem->resetIoStats();
+        auto start = std::chrono::steady_clock::now();
+        for (int repeat = 0; repeat < kRepeats; repeat++) {
+            for (size_t i = 0; i < paths.size(); i++) {
+                uint64_t hash = 0;
+                bool read = run.streamed
+                            ? hashStreamed(*run.pFileSystem, paths[i], chunk, hash)
+                            : hashMapped(*run.pFileSystem, paths[i], hash);
+                if (!read || hash != (run.streamed ? chunkHashes[i] : hashes[i])) {
+                    correct = false;
+                }
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printf("%-10s %12.2f %12.1f\n",
+               run.name,
+               elapsed.count() * 1000.0 / kRepeats,
+               double(totalBytes) * kRepeats / (1024 * 1024) / elapsed.count());
+
+        auto stats = run.pFileSystem->getIoStats();
+        for (size_t i = 0; i < std::min(kLoggedFiles, stats.size()); i++) {
+            const auto &[path, fileStats] = stats[i];
+            printf("    %s: %u opens in %.3f ms, %llu bytes in %.3f ms\n",
+                   path.c_str(),
+                   fileStats.openCount,
+                   fileStats.openMilliseconds,
+                   (unsigned long long) fileStats.bytesRead,
+                   fileStats.readMilliseconds);
+        }
+    }
+
+    // A memory mount covers the directory under it, and only for the files it has
+    FileSystem overlay;
+    overlay.mount("", std::make_shared<DirectoryFileSource>(directory));
+    auto spPatch = std::make_shared<MemoryFileSource>();
+    spPatch->add(paths[0], {1, 2, 3});
+    overlay.mount("", spPatch);
+    auto pPatched = overlay.open(paths[0]);
+    correct &= pPatched && pPatched->getLength() == 3;
+    if (paths.size() > 1) {
+        uint64_t hash = 0;
+        correct &= hashMapped(overlay, paths[1], hash) && hash == hashes[1];
+    }
+    correct &= !overlay.open("missing/file.png");
+
+    for (auto name: {"stored.mpak", "compressed.mpak"}) {
+        unlink((std::string(packDirectory) + "/" + name).c_str());
+    }
+    rmdir(packDirectory);
+    if (generated) {
+        for (const auto &path: paths) {
+            unlink((directory + "/" + path).c_str());
+        }
+        rmdir(directory.c_str());
+    }
+    if (!correct) {
+        printf("FAILED: a file read differently between ways in, or a mount resolved wrong\n");
+        return 1;
+    }
+    return 0;
+}
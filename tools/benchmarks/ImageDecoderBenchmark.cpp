@@ -0,0 +1,154 @@
+/*!
+ * Decode throughput of the host ImageDecoder across a range of PNG sizes.
+ *
+ *   image_decoder_benchmark [file.png ...]
+ *
+ * With no arguments a synthetic corpus is generated: a photo-like image with gradients and noise,
+ * and flat art with a few solid colors, at each size. Throughput is counted in bytes of decoded
+ * RGBA8 output.
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <png.h>
+
+#include "PngImageDecoder.h"
+
+/*!
+ * How many times each decode runs. The fastest run is reported.
+ */
+static constexpr int kIterations = 5;
+
+/*!
+ * How many rows each call decodes when streaming
+ */
+static constexpr int32_t kStreamRows = 32;
+
+struct CorpusImage {
+    std::string name;
+    std::vector<uint8_t> png;
+};
+
+static std::vector<uint8_t> encodePng(int size, const std::vector<uint8_t> &rgba) {
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    image.width = png_uint_32(size);
+    image.height = png_uint_32(size);
+    image.format = PNG_FORMAT_RGBA;
+
+    png_alloc_size_t pngSize = 0;
+    png_image_write_get_memory_size(image, pngSize, 0, rgba.data(), 0, nullptr);
+    std::vector<uint8_t> png(pngSize);
+    if (!png_image_write_to_memory(&image, png.data(), &pngSize, 0, rgba.data(), 0, nullptr)) {
+        return {};
+    }
+    png.resize(pngSize);
+    return png;
+}
+
+static std::vector<CorpusImage> makeCorpus() {
+    std::vector<CorpusImage> corpus;
+    std::mt19937 random(1234);
+    for (int size: {64, 256, 1024, 2048, 4096}) {
+        std::vector<uint8_t> photo(size_t(size) * size * 4);
+        std::vector<uint8_t> flat(photo.size());
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++) {
+                auto *pixel = &photo[(size_t(y) * size + x) * 4];
+                int noise = int(random() % 16);
+                pixel[0] = uint8_t(x * 255 / size + noise / 2);
+                pixel[1] = uint8_t(y * 255 / size + noise / 4);
+                pixel[2] = uint8_t((x + y) * 127 / size + noise);
+                pixel[3] = 255;
+
+                auto *art = &flat[(size_t(y) * size + x) * 4];
+                bool inside = (x / (size / 8 + 1) + y / (size / 8 + 1)) % 2 == 0;
+                art[0] = inside ? 220 : 30;
+                art[1] = inside ? 60 : 30;
+                art[2] = inside ? 40 : 30;
+                art[3] = inside ? 255 : 0;
+            }
+        }
+        auto label = std::to_string(size) + "x" + std::to_string(size);
+        corpus.push_back({label + " photo", encodePng(size, photo)});
+        corpus.push_back({label + " flat", encodePng(size, flat)});
+    }
+    return corpus;
+}
+
+/*!
+ * Runs @a decode a few times and prints the best throughput
+ */
+static void benchmark(const char *name, size_t outputBytes, const std::function<bool()> &decode) {
+    double bestSeconds = 1e9;
+    for (int i = 0; i < kIterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        if (!decode()) {
+            printf("  %-16s failed\n", name);
+            return;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        bestSeconds = std::min(bestSeconds, elapsed.count());
+    }
+    double megabytes = double(outputBytes) / (1024.0 * 1024.0);
+    printf("  %-16s %8.3f ms %10.1f MB/s\n", name, bestSeconds * 1000.0, megabytes / bestSeconds);
+}
+
+int main(int argc, char **argv) {
+    std::vector<CorpusImage> corpus;
+    for (int i = 1; i < argc; i++) {
+        std::ifstream file(argv[i], std::ios::binary);
+        corpus.push_back({argv[i], std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {})});
+    }
+    if (corpus.empty()) {
+        corpus = makeCorpus();
+    }
+
+    for (const auto &image: corpus) {
+        auto probe = PngImageDecoder::create(image.png.data(), image.png.size());
+        if (!probe) {
+            printf("%s: not a PNG\n", image.name.c_str());
+            continue;
+        }
+        auto width = probe->getWidth();
+        auto height = probe->getHeight();
+        auto stride = probe->getMinimumStride();
+        std::vector<uint8_t> pixels(stride * height);
+        printf("%s, %dx%d (%.1f KB encoded)\n",
+               image.name.c_str(), width, height, double(image.png.size()) / 1024.0);
+
+        benchmark("whole image", pixels.size(), [&] {
+            auto pDecoder = PngImageDecoder::create(image.png.data(), image.png.size());
+            return pDecoder && pDecoder->decode(pixels.data(), stride);
+        });
+        benchmark("streamed rows", pixels.size(), [&] {
+            auto pDecoder = PngImageDecoder::create(image.png.data(), image.png.size());
+            while (pDecoder && pDecoder->getDecodedRowCount() < height) {
+                auto rows = std::min(kStreamRows, height - pDecoder->getDecodedRowCount());
+                if (!pDecoder->decodeRows(pixels.data(), stride, rows)) {
+                    return false;
+                }
+            }
+            return pDecoder != nullptr;
+        });
+
+        // Counted in source bytes, so the cost of filtering down shows against a plain decode
+        auto halfWidth = std::max(width / 2, 1);
+        auto halfHeight = std::max(height / 2, 1);
+        benchmark("half size", pixels.size(), [&] {
+            auto pDecoder = PngImageDecoder::create(image.png.data(), image.png.size());
+            return pDecoder && pDecoder->setTargetSize(halfWidth, halfHeight)
+                   && pDecoder->decode(pixels.data(), pDecoder->getMinimumStride());
+        });
+    }
+    return 0;
+}
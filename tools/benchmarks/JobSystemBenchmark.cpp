@@ -0,0 +1,138 @@
+/*!
+ * How the JobSystem scales from 1 thread up to every core.
+ *
+ *   job_system_benchmark [max threads]
+ *
+ * Three workloads, each run on the main thread plus 0, 1, 3, ... workers:
+ *  - parallel for: transforms a large array of sprite vertices, the kind of loop batch building
+ *    and animation run every frame
+ *  - tiny jobs: many jobs that do next to nothing, which measures the scheduling overhead
+ *  - dependencies: stages of jobs where each stage starts once the one before has finished
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+
+/*!
+ * How many times each workload runs. The fastest run is reported.
+ */
+static constexpr int kIterations = 5;
+
+static constexpr size_t kVertexCount = 4 * 1024 * 1024;
+static constexpr int kTinyJobCount = 100000;
+static constexpr int kStageCount = 64;
+static constexpr int kJobsPerStage = 64;
+
+struct Vertex {
+    float x;
+    float y;
+    float u;
+    float v;
+};
+
+/*!
+ * Runs @a workload a few times
+ * @return the fastest run in seconds
+ */
+static double measure(const std::function<void()> &workload) {
+    double bestSeconds = 1e9;
+    for (int i = 0; i < kIterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        workload();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        bestSeconds = std::min(bestSeconds, elapsed.count());
+    }
+    return bestSeconds;
+}
+
+/*!
+ * Some math per element, enough that the loop isn't bound by memory bandwidth alone
+ */
+static void transformVertices(Vertex *vertices, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        auto &vertex = vertices[i];
+        float angle = float(i % 360) * 0.0174533f;
+        float c = std::cos(angle);
+        float s = std::sin(angle);
+        float x = vertex.x * c - vertex.y * s;
+        float y = vertex.x * s + vertex.y * c;
+        vertex.x = x * 0.5f + 0.25f;
+        vertex.y = y * 0.5f + 0.25f;
+    }
+}
+
+/*!
+ * Busy work that can't be optimized out
+ */
+static void spin(int iterations) {
+    volatile float value = 1.f;
+    for (int i = 0; i < iterations; i++) {
+        value = value * 1.0001f + 0.0001f;
+    }
+}
+
+int main(int argc, char **argv) {
+    int maxThreads = std::max(int(std::thread::hardware_concurrency()), 1);
+    if (argc > 1) {
+        maxThreads = std::max(atoi(argv[1]), 1);
+    }
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    std::vector<Vertex> vertices(kVertexCount, Vertex{1.f, 0.5f, 0.f, 1.f});
+    double serial[3] = {0, 0, 0};
+    printf("%-8s %20s %20s %20s\n", "threads", "parallel for", "tiny jobs", "dependencies");
+    for (auto threads: threadCounts) {
+        JobSystem jobSystem(threads - 1);
+
+        double seconds[3];
+        seconds[0] = measure([&]() {
+            jobSystem.parallelFor(0, vertices.size(), 0, [&](size_t begin, size_t end) {
+                transformVertices(vertices.data(), begin, end);
+            });
+        });
+        seconds[1] = measure([&]() {
+            JobCounter counter;
+            for (int i = 0; i < kTinyJobCount; i++) {
+                jobSystem.run([]() { spin(16); }, &counter);
+            }
+            jobSystem.wait(counter);
+        });
+        seconds[2] = measure([&]() {
+            std::vector<JobCounter> stages(kStageCount);
+            for (int stage = 0; stage < kStageCount; stage++) {
+                for (int job = 0; job < kJobsPerStage; job++) {
+                    if (stage == 0) {
+                        jobSystem.run([]() { spin(2000); }, &stages[stage]);
+                    } else {
+                        jobSystem.runAfter(
+                                stages[stage - 1], []() { spin(2000); }, &stages[stage]);
+                    }
+                }
+            }
+            for (auto &stage: stages) {
+                jobSystem.wait(stage);
+            }
+        });
+
+        printf("%-8d", threads);
+        for (int i = 0; i < 3; i++) {
+            if (threads == 1) {
+                serial[i] = seconds[i];
+            }
+            printf(" %10.2f ms %6.2fx", seconds[i] * 1000.0, serial[i] / seconds[i]);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,239 @@
+/*!
+ * Simulates memory pressure on a desktop build and checks MemoryPressure trims the right tiers.
+ *
+ *   memory_pressure_benchmark
+ *
+ * Every tier gets trimmers that hold a known amount of memory, the way the renderer's scratch
+ * buffers, streamed levels, texture cache and pools do. Then:
+ *  - tiers: each tier is posted in turn, with cheaper ones posted alongside to be folded in. Every
+ *    trimmer at or below the tier has to run once, cheapest first, nothing above it may, the
+ *    eventfd has to wake and the bytes reported have to match what was freed.
+ *  - trim levels: the onTrimMemory levels map to the tiers the header documents
+ *  - signal: SIGUSR1, as "kill -USR1 <pid>" sends it, posts a full trim
+ *  - post cost: threads posting as fast as they can, since posts come from JNI callbacks and
+ *    signal handlers and have to stay cheap
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "MemoryPressure.h"
+
+static constexpr TrimTier kTiers[] = {
+        TrimTier::ScratchBuffers,
+        TrimTier::MipLevels,
+        TrimTier::UnusedTextures,
+        TrimTier::Pools,
+};
+
+static constexpr size_t kBytesPerTrimmer = 1024 * 1024;
+static constexpr int kTrimmersPerTier = 2;
+static constexpr int kPostThreads = 4;
+static constexpr int kPostsPerThread = 1000000;
+
+/*!
+ * Memory one trimmer gives back, refilled before each trim
+ */
+struct FakeCache {
+    TrimTier tier;
+    std::string name;
+    std::vector<uint8_t> data;
+    int trimCount;
+};
+
+/*!
+ * @return true if the eventfd was written to since it was last read, and resets it
+ */
+static bool consumeWake(int fd) {
+    uint64_t count = 0;
+    return read(fd, &count, sizeof(count)) == sizeof(count) && count > 0;
+}
+
+/*!
+ * Checks a trim at @a tier ran exactly the trimmers it should, in order, and reported what they
+ * freed
+ */
+static bool checkTrim(
+        TrimTier tier,
+        const std::vector<TrimResult> &results,
+        const std::vector<FakeCache> &caches) {
+    size_t expectedCount = 0;
+    size_t expectedBytes = 0;
+    for (const auto &cache: caches) {
+        bool shouldRun = cache.tier <= tier;
+        if (cache.trimCount != (shouldRun ? 1 : 0) || (shouldRun && !cache.data.empty())) {
+            printf("  %s ran %d times at %s\n",
+                   cache.name.c_str(), cache.trimCount, MemoryPressure::getTierName(tier));
+            return false;
+        }
+        if (shouldRun) {
+            expectedCount++;
+            expectedBytes += kBytesPerTrimmer;
+        }
+    }
+
+    size_t reportedBytes = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        reportedBytes += results[i].bytesReclaimed;
+        if (results[i].tier > tier || (i > 0 && results[i].tier < results[i - 1].tier)) {
+            printf("  %s ran out of order at %s\n",
+                   results[i].name.c_str(), MemoryPressure::getTierName(tier));
+            return false;
+        }
+    }
+    if (results.size() != expectedCount || reportedBytes != expectedBytes) {
+        printf("  %zu trimmers reported %zu bytes at %s, expected %zu reporting %zu\n",
+               results.size(), reportedBytes, MemoryPressure::getTierName(tier), expectedCount,
+               expectedBytes);
+        return false;
+    }
+    return true;
+}
+
+static void refill(std::vector<FakeCache> &caches) {
+    for (auto &cache: caches) {
+        cache.data.assign(kBytesPerTrimmer, 1);
+        cache.trimCount = 0;
+    }
+}
+
+int main() {
+    int wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd < 0) {
+        fprintf(stderr, "Couldn't create the eventfd\n");
+        return 1;
+    }
+    MemoryPressure::setWakeFd(wakeFd);
+
+    // Added most expensive first, the trims still have to run cheapest first
+    std::vector<FakeCache> caches;
+    for (auto it = std::rbegin(kTiers); it != std::rend(kTiers); ++it) {
+        for (int i = 0; i < kTrimmersPerTier; i++) {
+            caches.push_back({*it, std::string(MemoryPressure::getTierName(*it)) + " "
+                                   + std::to_string(i), {}, 0});
+        }
+    }
+    MemoryPressure memoryPressure;
+    for (auto &cache: caches) {
+        memoryPressure.addTrimmer(cache.tier, cache.name, [&cache]() {
+            cache.trimCount++;
+            auto bytes = cache.data.size();
+            cache.data = {};
+            return bytes;
+        });
+    }
+
+    bool passed = true;
+    printf("tiers:\n");
+    for (auto tier: kTiers) {
+        refill(caches);
+        consumeWake(wakeFd);
+        MemoryPressure::post(tier);
+        MemoryPressure::post(TrimTier::ScratchBuffers);
+        bool woke = consumeWake(wakeFd);
+        bool pending = MemoryPressure::hasPending();
+
+        auto start = std::chrono::steady_clock::now();
+        auto results = memoryPressure.handlePending();
+        std::chrono::duration<double, std::micro> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+        size_t bytes = 0;
+        for (const auto &result: results) {
+            bytes += result.bytesReclaimed;
+        }
+        printf("  %-16s %zu trimmers, %6.1f MiB in %8.1f us\n",
+               MemoryPressure::getTierName(tier), results.size(),
+               double(bytes) / (1024.0 * 1024.0), elapsed.count());
+        if (!woke || !pending || MemoryPressure::hasPending()
+            || !checkTrim(tier, results, caches)) {
+            passed = false;
+        }
+    }
+
+    // Nothing posted means nothing runs
+    refill(caches);
+    if (!memoryPressure.handlePending().empty()) {
+        printf("  a trim ran with nothing posted\n");
+        passed = false;
+    }
+
+    printf("trim levels:\n");
+    struct {
+        int trimLevel;
+        bool trims;
+        TrimTier tier;
+    } levels[] = {
+            {0, false, TrimTier::ScratchBuffers},
+            {5, true, TrimTier::ScratchBuffers},
+            {10, true, TrimTier::MipLevels},
+            {15, true, TrimTier::UnusedTextures},
+            {20, true, TrimTier::MipLevels},
+            {40, true, TrimTier::UnusedTextures},
+            {60, true, TrimTier::Pools},
+            {80, true, TrimTier::Pools},
+    };
+    for (const auto &level: levels) {
+        TrimTier tier = TrimTier::ScratchBuffers;
+        bool trims = MemoryPressure::tierForTrimLevel(level.trimLevel, tier);
+        printf("  %2d -> %s\n",
+               level.trimLevel, trims ? MemoryPressure::getTierName(tier) : "none");
+        if (trims != level.trims || (trims && tier != level.tier)) {
+            passed = false;
+        }
+    }
+
+    printf("signal:\n");
+    refill(caches);
+    if (!MemoryPressure::installSimulationSignal(SIGUSR1)) {
+        printf("  couldn't install the handler\n");
+        passed = false;
+    } else {
+        raise(SIGUSR1);
+        auto results = memoryPressure.handlePending();
+        printf("  SIGUSR1 ran %zu trimmers\n", results.size());
+        passed = checkTrim(TrimTier::Pools, results, caches) && passed;
+        signal(SIGUSR1, SIG_DFL);
+    }
+
+    // The fd only adds a syscall, which is what posting costs in the app
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kPostThreads; i++) {
+        threads.emplace_back([&go, i]() {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (int j = 0; j < kPostsPerThread; j++) {
+                MemoryPressure::post(kTiers[(i + j) % std::size(kTiers)]);
+            }
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    refill(caches);
+    auto results = memoryPressure.handlePending();
+    printf("post cost: %d threads posting at once, %.1f ns per post on each\n",
+           kPostThreads, elapsed.count() / double(kPostsPerThread));
+    passed = checkTrim(TrimTier::Pools, results, caches) && passed;
+
+    MemoryPressure::setWakeFd(-1);
+    close(wakeFd);
+    if (!passed) {
+        printf("FAILED: a tier didn't run what it should, or reported the wrong bytes\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "PixelConvert.h"
+
+/*!
+ * How many times each kernel runs per image size. The fastest run is reported.
+ */
+static constexpr int kIterations = 10;
+
+/*!
+ * Runs @a kernel a few times and prints the best throughput, counted in bytes of RGBA8 input
+ */
+static void benchmark(const char *name, size_t pixelCount, const std::function<void()> &kernel) {
+    double bestSeconds = 1e9;
+    for (int i = 0; i < kIterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        kernel();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        bestSeconds = std::min(bestSeconds, elapsed.count());
+    }
+    double megabytes = double(pixelCount * 4) / (1024.0 * 1024.0);
+    printf("  %-16s %8.3f ms %10.1f MB/s\n", name, bestSeconds * 1000.0, megabytes / bestSeconds);
+}
+
+int main() {
+    printf("PixelConvert kernels: %s\n", PixelConvert::getImplementationName());
+
+    const int sizes[] = {256, 1024, 2048, 4096};
+    std::mt19937 random(1234);
+
+    for (int size: sizes) {
+        size_t pixelCount = size_t(size) * size;
+        std::vector<uint8_t> source(pixelCount * 4);
+        for (auto &byte: source) {
+            byte = uint8_t(random());
+        }
+        std::vector<uint8_t> work(source);
+        std::vector<uint8_t> out(pixelCount * 4);
+        auto *out16 = reinterpret_cast<uint16_t *>(out.data());
+        const uint8_t bgraToRgba[4] = {2, 1, 0, 3};
+
+        printf("%dx%d (%.1f MB RGBA8)\n", size, size, double(pixelCount * 4) / (1024.0 * 1024.0));
+
+        // memcpy is the memory bandwidth ceiling the kernels are compared against
+        benchmark("memcpy", pixelCount, [&] {
+            memcpy(out.data(), source.data(), pixelCount * 4);
+        });
+        benchmark("premultiply", pixelCount, [&] {
+            memcpy(work.data(), source.data(), pixelCount * 4);
+            PixelConvert::premultiplyAlpha(work.data(), pixelCount);
+        });
+        benchmark("pack RGB565", pixelCount, [&] {
+            PixelConvert::packRGB565(source.data(), out16, pixelCount);
+        });
+        benchmark("pack RGBA4444", pixelCount, [&] {
+            PixelConvert::packRGBA4444(source.data(), out16, pixelCount);
+        });
+        benchmark("pack RGB5_A1", pixelCount, [&] {
+            PixelConvert::packRGB5A1(source.data(), out16, pixelCount);
+        });
+        benchmark("swizzle BGRA", pixelCount, [&] {
+            PixelConvert::swizzle4(source.data(), out.data(), pixelCount, bgraToRgba);
+        });
+        benchmark("extract R8", pixelCount, [&] {
+            PixelConvert::extractR8(source.data(), out.data(), pixelCount);
+        });
+        benchmark("extract RA8", pixelCount, [&] {
+            PixelConvert::extractRA8(source.data(), out.data(), pixelCount);
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "PngImageDecoder.h"
+
+#include <cstdint>
+#include <csetjmp>
+#include <cstring>
+
+/*!
+ * Reads a big endian value out of the PNG header
+ */
+static uint32_t readBigEndian(const uint8_t *data) {
+    return uint32_t(data[0]) << 24 | uint32_t(data[1]) << 16 | uint32_t(data[2]) << 8 | data[3];
+}
+
+std::unique_ptr<ImageDecoder> PngImageDecoder::create(const uint8_t *data, size_t size) {
+    // The signature is followed by the IHDR chunk, which starts with the size
+    constexpr size_t kWidthOffset = 16;
+    if (size < kWidthOffset + 8 || png_sig_cmp(data, 0, 8) != 0
+        || memcmp(data + 12, "IHDR", 4) != 0) {
+        return nullptr;
+    }
+    auto width = readBigEndian(data + kWidthOffset);
+    auto height = readBigEndian(data + kWidthOffset + 4);
+    if (width == 0 || height == 0 || width > INT32_MAX / 4 || height > INT32_MAX) {
+        return nullptr;
+    }
+
+    auto pDecoder = std::unique_ptr<PngImageDecoder>(
+            new PngImageDecoder(int32_t(width), int32_t(height), data, size));
+    if (!pDecoder->readHeader()) {
+        return nullptr;
+    }
+    return pDecoder;
+}
+
+bool PngImageDecoder::readHeader() {
+    pPng_ = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, handleError, handleWarning);
+    pInfo_ = pPng_ ? png_create_info_struct(pPng_) : nullptr;
+    if (!pInfo_) {
+        return false;
+    }
+    png_set_read_fn(pPng_, this, readData);
+    if (setjmp(png_jmpbuf(pPng_))) {
+        return false;
+    }
+    png_read_info(pPng_, pInfo_);
+
+    // Whatever is stored, ask for 8 bit RGBA
+    auto colorType = png_get_color_type(pPng_, pInfo_);
+    png_set_expand(pPng_);
+    png_set_strip_16(pPng_);
+    if (colorType == PNG_COLOR_TYPE_GRAY || colorType == PNG_COLOR_TYPE_GRAY_ALPHA) {
+        png_set_gray_to_rgb(pPng_);
+    }
+    if (!(colorType & PNG_COLOR_MASK_ALPHA) && !png_get_valid(pPng_, pInfo_, PNG_INFO_tRNS)) {
+        png_set_add_alpha(pPng_, 0xFF, PNG_FILLER_AFTER);
+    }
+    interlaced_ = png_set_interlace_handling(pPng_) > 1;
+    png_read_update_info(pPng_, pInfo_);
+    return png_get_rowbytes(pPng_, pInfo_) == size_t(getSourceWidth()) * 4;
+}
+
+PngImageDecoder::~PngImageDecoder() {
+    if (pPng_) {
+        png_destroy_read_struct(&pPng_, pInfo_ ? &pInfo_ : nullptr, nullptr);
+    }
+}
+
+void PngImageDecoder::readData(png_structp pPng, png_bytep out, png_size_t length) {
+    auto pDecoder = static_cast<PngImageDecoder *>(png_get_io_ptr(pPng));
+    if (length > pDecoder->size_ - pDecoder->offset_) {
+        png_error(pPng, "truncated");
+    }
+    memcpy(out, pDecoder->data_ + pDecoder->offset_, length);
+    pDecoder->offset_ += length;
+}
+
+void PngImageDecoder::handleError(png_structp pPng, png_const_charp /* message */) {
+    longjmp(png_jmpbuf(pPng), 1);
+}
+
+bool PngImageDecoder::readRows(uint8_t *pixels, size_t stride, int32_t rowCount) {
+    auto rowBytes = size_t(getSourceWidth()) * 4;
+    if (interlaced_ && buffered_.empty()) {
+        buffered_.resize(rowBytes * getSourceHeight());
+        std::vector<png_bytep> rows(getSourceHeight());
+        for (size_t row = 0; row < rows.size(); row++) {
+            rows[row] = buffered_.data() + row * rowBytes;
+        }
+        if (setjmp(png_jmpbuf(pPng_))) {
+            return false;
+        }
+        png_read_image(pPng_, rows.data());
+    }
+    if (interlaced_) {
+        for (int32_t row = 0; row < rowCount; row++, nextBufferedRow_++) {
+            memcpy(pixels + size_t(row) * stride,
+                   buffered_.data() + size_t(nextBufferedRow_) * rowBytes,
+                   rowBytes);
+        }
+        return true;
+    }
+
+    if (setjmp(png_jmpbuf(pPng_))) {
+        return false;
+    }
+    for (int32_t row = 0; row < rowCount; row++) {
+        png_read_row(pPng_, pixels + size_t(row) * stride, nullptr);
+    }
+    return true;
+}
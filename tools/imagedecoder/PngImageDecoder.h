@@ -0,0 +1,65 @@
+#ifndef NATIVEGUITEST_TOOLS_PNGIMAGEDECODER_H
+#define NATIVEGUITEST_TOOLS_PNGIMAGEDECODER_H
+
+#include <memory>
+#include <vector>
+
+#include <png.h>
+
+#include "ImageDecoder.h"
+
+/*!
+ * An @a ImageDecoder for PNG on top of libpng, so decoding can run and be measured off device.
+ * Rows are decoded as they're asked for, except for interlaced images, which libpng can only
+ * produce once every pass has been read; those are decoded whole on the first call.
+ */
+class PngImageDecoder : public ImageDecoder {
+public:
+    /*!
+     * @param data the encoded image, which must outlive the decoder
+     * @param size the size of @a data in bytes
+     * @return the decoder, or null if the data isn't a PNG
+     */
+    static std::unique_ptr<ImageDecoder> create(const uint8_t *data, size_t size);
+
+    ~PngImageDecoder() override;
+
+protected:
+    bool readRows(uint8_t *pixels, size_t stride, int32_t rowCount) override;
+
+private:
+    PngImageDecoder(int32_t width, int32_t height, const uint8_t *data, size_t size)
+            : ImageDecoder(width, height),
+              pPng_(nullptr),
+              pInfo_(nullptr),
+              data_(data),
+              size_(size),
+              offset_(0),
+              interlaced_(false),
+              nextBufferedRow_(0) {}
+
+    /*!
+     * Sets libpng up to produce 8 bit RGBA rows
+     * @return false if the header is corrupt
+     */
+    bool readHeader();
+
+    static void readData(png_structp pPng, png_bytep out, png_size_t length);
+
+    static void handleError(png_structp pPng, png_const_charp message);
+
+    static void handleWarning(png_structp /* pPng */, png_const_charp /* message */) {}
+
+    png_structp pPng_;
+    png_infop pInfo_;
+    const uint8_t *data_;
+    size_t size_;
+    // how much of @a data_ libpng has read
+    size_t offset_;
+    bool interlaced_;
+    // the whole image of an interlaced PNG
+    std::vector<uint8_t> buffered_;
+    int32_t nextBufferedRow_;
+};
+
+#endif //NATIVEGUITEST_TOOLS_PNGIMAGEDECODER_H
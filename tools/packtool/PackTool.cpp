@@ -0,0 +1,275 @@
+/*!
+ * Build time step that packs asset directories into one AssetPack the app mounts over its loose
+ * assets.
+ *
+ * Every regular file under each input directory goes in under its path relative to that
+ * directory. A path in a later directory replaces the same path in an earlier one, the way a
+ * generated asset directory covers the source one. Entries are laid out in path order so the same
+ * inputs always give the same pack. Stored entries start on --align boundaries so they can be
+ * used in place once the pack is mapped. Files with an extension given to --compress are LZ4
+ * compressed when that saves enough, for data that's loaded rarely enough that the decompression
+ * doesn't matter.
+ *
+ * --order takes the access order the app saves, files/asset_access_order.txt, one
+ * "milliseconds<TAB>path" line per asset in the order a recorded run first asked for them. Those
+ * assets are laid out first, in that order, and marked in the pack as read at startup, so the app
+ * reads them ahead as one sequential read rather than faulting them in one at a time. Paths that
+ * aren't in the pack are skipped. --prefetch-list writes where those entries ended up, one
+ * "offset<TAB>size<TAB>path" line each, to check the layout by.
+ *
+ * The pack is read back and every entry checked against its file before it replaces the output.
+ *
+ *   pack_tool [--align 4096|16384] [--compress .ext]... [--order order.txt]
+ *       [--prefetch-list prefetch.txt] output.mpak input_directory...
+ */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include "AssetPack.h"
+#include "MemoryFileSource.h"
+
+static constexpr uint32_t kDefaultAlignment = 4096;
+
+static void printUsage() {
+    fprintf(stderr,
+            "usage: pack_tool [--align 4096|16384] [--compress .ext]... [--order order.txt] "
+            "[--prefetch-list prefetch.txt] output.mpak input_directory...\n");
+}
+
+/*!
+ * Adds every regular file under @a directory, relative to @a root, by path
+ */
+static void listFiles(
+        const std::string &root,
+        const std::string &directory,
+        std::map<std::string, std::string> &outFiles) {
+    auto pDirectory = opendir((root + "/" + directory).c_str());
+    if (!pDirectory) {
+        return;
+    }
+    while (auto pEntry = readdir(pDirectory)) {
+        std::string name = pEntry->d_name;
+        if (name == "." || name == "..") {
+            continue;
+        }
+        auto path = directory.empty() ? name : directory + "/" + name;
+        auto fullPath = root + "/" + path;
+        struct stat status{};
+        if (stat(fullPath.c_str(), &status) != 0) {
+            continue;
+        }
+        if (S_ISDIR(status.st_mode)) {
+            listFiles(root, path, outFiles);
+        } else if (S_ISREG(status.st_mode)) {
+            outFiles[path] = fullPath;
+        }
+    }
+    closedir(pDirectory);
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> &out) {
+    auto pFile = fopen(path.c_str(), "rb");
+    if (!pFile) {
+        fprintf(stderr, "Couldn't open %s\n", path.c_str());
+        return false;
+    }
+    fseek(pFile, 0, SEEK_END);
+    auto size = ftell(pFile);
+    fseek(pFile, 0, SEEK_SET);
+    out.resize(size_t(size));
+    bool read = size >= 0 && fread(out.data(), 1, out.size(), pFile) == out.size();
+    fclose(pFile);
+    if (!read) {
+        fprintf(stderr, "Couldn't read %s\n", path.c_str());
+    }
+    return read;
+}
+
+static bool hasExtension(const std::string &path, const std::vector<std::string> &extensions) {
+    for (const auto &extension: extensions) {
+        if (path.size() >= extension.size()
+            && path.compare(path.size() - extension.size(), extension.size(), extension) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * Reads an access order, the paths in the order they were first asked for. Each line is a path,
+ * after a tab if there's one.
+ */
+static bool readAccessOrder(const std::string &path, std::vector<std::string> &outPaths) {
+    std::ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Couldn't open %s\n", path.c_str());
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        auto tab = line.find('\t');
+        auto assetPath = tab == std::string::npos ? line : line.substr(tab + 1);
+        if (!assetPath.empty()) {
+            outPaths.push_back(std::move(assetPath));
+        }
+    }
+    return true;
+}
+
+/*!
+ * Writes where each entry read at startup is in the pack
+ */
+static bool writePrefetchList(const std::string &path, const std::vector<uint8_t> &pack) {
+    auto spSource = std::make_shared<MemoryFileSource>();
+    spSource->add("pack", pack);
+    auto spPack = AssetPack::create(spSource->open("pack", FileAccess::Buffer));
+    std::ofstream file(path, std::ios::trunc);
+    for (size_t i = 0; spPack && i < spPack->getPrefetchCount(); i++) {
+        const auto &entry = spPack->getEntry(i);
+        file << entry.offset << '\t' << entry.storedSize << '\t' << spPack->getPath(i) << '\n';
+    }
+    if (!spPack || !file) {
+        fprintf(stderr, "Couldn't write %s\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * Reads every entry back out of @a pack and compares it against its input
+ */
+static bool verifyPack(std::vector<uint8_t> pack, const std::vector<AssetPack::Input> &inputs) {
+    auto spSource = std::make_shared<MemoryFileSource>();
+    spSource->add("pack", std::move(pack));
+    auto spPack = AssetPack::create(spSource->open("pack", FileAccess::Buffer));
+    if (!spPack || spPack->getEntryCount() != inputs.size()) {
+        fprintf(stderr, "The pack doesn't open\n");
+        return false;
+    }
+    for (const auto &input: inputs) {
+        auto pFile = spPack->open(input.path, FileAccess::Buffer);
+        auto pData = pFile ? pFile->getBuffer() : nullptr;
+        if (!pData || size_t(pFile->getLength()) != input.data.size()
+            || memcmp(pData, input.data.data(), input.data.size()) != 0) {
+            fprintf(stderr, "%s doesn't read back from the pack\n", input.path.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint32_t alignment = kDefaultAlignment;
+    std::vector<std::string> compressExtensions;
+    std::string orderPath;
+    std::string prefetchListPath;
+    int argument = 1;
+    for (; argument < argc && strncmp(argv[argument], "--", 2) == 0; argument++) {
+        if (argument + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        if (strcmp(argv[argument], "--align") == 0) {
+            alignment = uint32_t(strtoul(argv[++argument], nullptr, 10));
+        } else if (strcmp(argv[argument], "--compress") == 0) {
+            compressExtensions.emplace_back(argv[++argument]);
+        } else if (strcmp(argv[argument], "--order") == 0) {
+            orderPath = argv[++argument];
+        } else if (strcmp(argv[argument], "--prefetch-list") == 0) {
+            prefetchListPath = argv[++argument];
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (argc - argument < 2) {
+        printUsage();
+        return 1;
+    }
+    std::string outputPath = argv[argument++];
+
+    std::map<std::string, std::string> files;
+    for (; argument < argc; argument++) {
+        listFiles(argv[argument], "", files);
+    }
+
+    // A previous pack in the inputs mustn't end up inside the new one
+    for (auto it = files.begin(); it != files.end();) {
+        it = hasExtension(it->first, {AssetPack::kExtension}) ? files.erase(it) : std::next(it);
+    }
+
+    // What startup reads goes first, in the order it's read, then everything else by path
+    std::vector<std::string> layout;
+    std::set<std::string> laidOut;
+    if (!orderPath.empty()) {
+        std::vector<std::string> accessOrder;
+        if (!readAccessOrder(orderPath, accessOrder)) {
+            return 1;
+        }
+        for (const auto &path: accessOrder) {
+            if (files.count(path) && laidOut.insert(path).second) {
+                layout.push_back(path);
+            }
+        }
+    }
+    auto prefetchCount = uint32_t(layout.size());
+    for (const auto &[path, fullPath]: files) {
+        if (!laidOut.count(path)) {
+            layout.push_back(path);
+        }
+    }
+
+    std::vector<AssetPack::Input> inputs;
+    for (const auto &path: layout) {
+        AssetPack::Input input{path, {}, hasExtension(path, compressExtensions)};
+        if (!readFile(files[path], input.data)) {
+            return 1;
+        }
+        inputs.push_back(std::move(input));
+    }
+
+    auto pack = AssetPack::write(inputs, alignment, prefetchCount);
+    if (pack.empty()) {
+        fprintf(stderr, "Couldn't pack, --align has to be a power of two of at least %zu\n",
+                AssetPack::kCompressedAlignment);
+        return 1;
+    }
+    if (!verifyPack(pack, inputs)) {
+        return 1;
+    }
+    if (!prefetchListPath.empty() && !writePrefetchList(prefetchListPath, pack)) {
+        return 1;
+    }
+
+    auto temporaryPath = outputPath + ".tmp";
+    auto pFile = fopen(temporaryPath.c_str(), "wb");
+    if (!pFile) {
+        fprintf(stderr, "Couldn't create %s\n", temporaryPath.c_str());
+        return 1;
+    }
+    bool written = fwrite(pack.data(), 1, pack.size(), pFile) == pack.size();
+    written = fclose(pFile) == 0 && written;
+    if (!written || rename(temporaryPath.c_str(), outputPath.c_str()) != 0) {
+        fprintf(stderr, "Couldn't write %s\n", outputPath.c_str());
+        remove(temporaryPath.c_str());
+        return 1;
+    }
+
+    size_t inputBytes = 0;
+    for (const auto &input: inputs) {
+        inputBytes += input.data.size();
+    }
+    printf("Packed %zu files, %zu bytes, into %s, %zu bytes with %u byte alignment, %u read at "
+           "startup\n",
+           inputs.size(), inputBytes, outputPath.c_str(), pack.size(), alignment, prefetchCount);
+    return 0;
+}
@@ -0,0 +1,520 @@
+/*!
+ * Checks the UASTC transcoder, and the Zstandard decoder and ETC2 encoder that KTX2 textures load
+ * through, against golden output.
+ *
+ *   uastc_transcoder_test
+ *
+ *  - one reference block in each of the 19 UASTC modes, decoded to RGBA8 and rewritten as ASTC.
+ *    The goldens were checked against Mesa's ASTC decoder, so they pin the bit layout as well as
+ *    the pixels
+ *  - a level of reference and solid blocks supercompressed by the zstd command line tool at -19,
+ *    then transcoded, and a short text frame whose literals are Huffman coded
+ *  - corrupt blocks and frames, which have to fail rather than decode to something
+ *  - a gradient encoded as ETC2, whose golden Mesa decodes to within 4 of the source alpha and 12
+ *    of the color
+ */
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+#include <vector>
+
+#include "Etc2Encoder.h"
+#include "UastcTranscoder.h"
+#include "Zstd.h"
+
+struct ReferenceBlock {
+    uint8_t uastc[16];
+    uint8_t astc[16];
+    uint8_t rgba[64];
+};
+
+/*!
+ * One block in each mode, in mode order, with the ASTC block it becomes and the pixels both
+ * decode to, in rows from the top left
+ */
+static constexpr ReferenceBlock kReferenceBlocks[] = {
+        {       // mode 0
+                {0x81, 0xE8, 0xE1, 0x0A, 0xD8, 0x48, 0xFF, 0x4E,
+                 0x17, 0x35, 0x37, 0xC3, 0xFA, 0x04, 0x24, 0xD5},
+                {0x42, 0x02, 0x01, 0x37, 0xC8, 0x3E, 0xF7, 0x34,
+                 0xAB, 0x24, 0x20, 0x5F, 0xC3, 0xEC, 0xAC, 0xC8},
+                {39, 82, 151, 255, 14, 76, 148, 255, 68, 90, 155, 255, 39, 82, 151, 255,
+                 93, 96, 159, 255, 39, 82, 151, 255, 39, 82, 151, 255, 165, 114, 169, 255,
+                 137, 107, 165, 255, 203, 124, 174, 255, 55, 86, 154, 255, 2, 73, 146, 255,
+                 55, 86, 154, 255, 27, 79, 150, 255, 68, 90, 155, 255, 178, 118, 171, 255}},
+        {       // mode 1
+                {0xF5, 0x3D, 0xDC, 0xC2, 0x6C, 0x71, 0x17, 0xE6,
+                 0xCD, 0x06, 0xF7, 0xAC, 0x98, 0x9A, 0x9B, 0xC9},
+                {0x42, 0x00, 0x2D, 0xCC, 0x16, 0x77, 0x61, 0xDE,
+                 0x00, 0x00, 0x00, 0x00, 0x51, 0xF3, 0x0E, 0x36},
+                {22, 139, 48, 255, 102, 187, 111, 255, 76, 171, 90, 255, 48, 155, 68, 255,
+                 22, 139, 48, 255, 22, 139, 48, 255, 102, 187, 111, 255, 48, 155, 68, 255,
+                 102, 187, 111, 255, 102, 187, 111, 255, 22, 139, 48, 255, 102, 187, 111, 255,
+                 76, 171, 90, 255, 76, 171, 90, 255, 22, 139, 48, 255, 76, 171, 90, 255}},
+        {       // mode 2
+                {0xFD, 0x3D, 0xB9, 0x18, 0x6C, 0x26, 0x89, 0xD5,
+                 0x14, 0xAA, 0xA5, 0xDD, 0xDC, 0x08, 0xC6, 0xC9},
+                {0x53, 0x48, 0x0E, 0x90, 0xC1, 0x66, 0x92, 0x58,
+                 0x4D, 0x01, 0x31, 0x08, 0x3B, 0xBB, 0xA5, 0x95},
+                {104, 68, 24, 255, 114, 137, 122, 255, 117, 153, 146, 255, 107, 84, 48, 255,
+                 107, 84, 48, 255, 109, 101, 72, 255, 119, 170, 170, 255, 117, 153, 146, 255,
+                 112, 120, 98, 255, 109, 101, 72, 255, 109, 101, 72, 255, 76, 102, 153, 255,
+                 104, 68, 24, 255, 76, 102, 153, 255, 97, 91, 110, 255, 105, 87, 94, 255}},
+        {       // mode 3
+                {0xA3, 0x61, 0x26, 0xCC, 0x4C, 0x36, 0xC4, 0x7C,
+                 0x1D, 0x42, 0xA3, 0xD1, 0xBB, 0x5F, 0xFD, 0x38},
+                {0x42, 0x10, 0x04, 0x50, 0xD2, 0x7F, 0xB7, 0x23,
+                 0x02, 0xA4, 0xA1, 0x1A, 0x2F, 0xFD, 0xAE, 0x0B},
+                {69, 0, 0, 255, 69, 0, 0, 255, 103, 49, 84, 255, 173, 150, 255, 255,
+                 115, 115, 124, 255, 115, 115, 124, 255, 209, 163, 92, 255, 115, 115, 124, 255,
+                 209, 163, 92, 255, 209, 163, 92, 255, 209, 163, 92, 255, 163, 140, 107, 255,
+                 151, 104, 186, 255, 151, 150, 201, 255, 150, 243, 232, 255, 150, 243, 232, 255}},
+        {       // mode 4
+                {0x53, 0x82, 0xCD, 0x08, 0x0E, 0xDB, 0x9A, 0xCD,
+                 0x77, 0x7B, 0x67, 0xD4, 0x79, 0xDF, 0xC4, 0x5C},
+                {0x42, 0x08, 0x3E, 0x90, 0x2C, 0xE1, 0x9C, 0xC7,
+                 0x34, 0xF3, 0x66, 0x11, 0x91, 0x7D, 0xCF, 0x2A},
+                {123, 210, 71, 255, 114, 189, 123, 255, 114, 189, 123, 255, 166, 174, 175, 255,
+                 97, 145, 229, 255, 174, 145, 158, 255, 150, 232, 210, 255, 150, 232, 210, 255,
+                 158, 204, 193, 255, 150, 232, 210, 255, 150, 232, 210, 255, 158, 204, 193, 255,
+                 166, 174, 175, 255, 158, 204, 193, 255, 174, 145, 158, 255, 158, 204, 193, 255}},
+        {       // mode 5
+                {0xAB, 0xAB, 0xDA, 0x43, 0x65, 0x0A, 0x9B, 0xFD,
+                 0x5F, 0xDB, 0x35, 0xF9, 0x4D, 0xEC, 0xBA, 0x99},
+                {0x53, 0x00, 0x7B, 0xA8, 0x4C, 0x61, 0xB3, 0xFF,
+                 0x01, 0x00, 0xBA, 0x91, 0xFD, 0x64, 0xDD, 0x96},
+                {64, 168, 223, 255, 77, 173, 245, 255, 77, 173, 245, 255, 77, 173, 245, 255,
+                 70, 170, 233, 255, 77, 173, 245, 255, 64, 168, 223, 255, 64, 168, 223, 255,
+                 84, 176, 255, 255, 84, 176, 255, 255, 81, 175, 250, 255, 74, 172, 239, 255,
+                 61, 166, 217, 255, 70, 170, 233, 255, 84, 176, 255, 255, 67, 169, 228, 255}},
+        {       // mode 6
+                {0x7B, 0x21, 0x61, 0x35, 0x20, 0x3C, 0x3B, 0xF7,
+                 0x66, 0xD0, 0x20, 0x6B, 0x58, 0x6B, 0x9C, 0xDE},
+                {0x42, 0x04, 0x05, 0xBC, 0xEC, 0x93, 0xCB, 0x85,
+                 0x7B, 0x39, 0xD6, 0x1A, 0xD6, 0x04, 0x0B, 0x86},
+                {45, 110, 167, 255, 85, 172, 167, 255, 8, 52, 167, 255, 45, 110, 167, 255,
+                 8, 52, 167, 255, 85, 172, 167, 255, 123, 230, 167, 255, 85, 172, 167, 255,
+                 8, 52, 167, 255, 45, 110, 167, 255, 123, 230, 167, 255, 85, 172, 167, 255,
+                 8, 52, 167, 255, 45, 110, 167, 255, 85, 172, 167, 255, 45, 110, 167, 255}},
+        {       // mode 7
+                {0x47, 0xED, 0x9D, 0xB4, 0x3B, 0x77, 0x5C, 0x09,
+                 0xAE, 0xDA, 0xED, 0x37, 0xA2, 0x8B, 0xF9, 0x42},
+                {0x42, 0x68, 0x26, 0x50, 0xC8, 0x19, 0x7C, 0xB2,
+                 0xB6, 0xBE, 0xAF, 0x17, 0xCF, 0xE8, 0x22, 0xA6},
+                {124, 87, 80, 255, 141, 151, 147, 255, 163, 150, 162, 255, 141, 151, 147, 255,
+                 140, 35, 45, 255, 141, 151, 147, 255, 121, 151, 132, 255, 141, 151, 147, 255,
+                 91, 193, 151, 255, 124, 87, 80, 255, 124, 87, 80, 255, 140, 35, 45, 255,
+                 91, 193, 151, 255, 140, 35, 45, 255, 91, 193, 151, 255, 91, 193, 151, 255}},
+        {       // mode 8
+                {0x97, 0x87, 0xAB, 0x97, 0x11, 0x00, 0x00, 0x00,
+                 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+                {0xFC, 0xFD, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                 0x3C, 0x3C, 0x5C, 0x5C, 0xBD, 0xBD, 0x8C, 0x8C},
+                {60, 92, 189, 140, 60, 92, 189, 140, 60, 92, 189, 140, 60, 92, 189, 140,
+                 60, 92, 189, 140, 60, 92, 189, 140, 60, 92, 189, 140, 60, 92, 189, 140,
+                 60, 92, 189, 140, 60, 92, 189, 140, 60, 92, 189, 140, 60, 92, 189, 140,
+                 60, 92, 189, 140, 60, 92, 189, 140, 60, 92, 189, 140, 60, 92, 189, 140}},
+        {       // mode 9
+                {0x8F, 0x8C, 0x4B, 0xDB, 0x39, 0x5B, 0x48, 0xBE,
+                 0x0A, 0x10, 0x3F, 0x18, 0x87, 0xF1, 0x1E, 0xBC},
+                {0x42, 0x88, 0x41, 0x98, 0xB3, 0x85, 0xE4, 0xAB,
+                 0x00, 0xF1, 0x83, 0x11, 0x1E, 0xBC, 0xC7, 0xA0},
+                {61, 115, 95, 158, 107, 70, 45, 141, 93, 34, 34, 85, 8, 76, 17, 136,
+                 136, 144, 68, 255, 93, 34, 34, 85, 117, 156, 177, 182, 170, 195, 255, 204,
+                 107, 70, 45, 141, 170, 195, 255, 204, 170, 195, 255, 204, 93, 34, 34, 85,
+                 8, 76, 17, 136, 117, 156, 177, 182, 136, 144, 68, 255, 107, 70, 45, 141}},
+        {       // mode 10
+                {0xFA, 0x8F, 0xE4, 0xAE, 0xA6, 0x3B, 0x74, 0xCA,
+                 0x1F, 0xB2, 0x44, 0x23, 0x89, 0xC7, 0xA0, 0xD5},
+                {0x42, 0x82, 0xE7, 0xBE, 0x47, 0x7A, 0x2A, 0x3C,
+                 0xAB, 0x05, 0xE3, 0x91, 0xC4, 0x22, 0x4D, 0xE8},
+                {197, 191, 156, 176, 229, 153, 101, 217, 224, 159, 110, 210, 174, 219, 197, 147,
+                 213, 173, 130, 196, 213, 173, 130, 196, 219, 165, 119, 204, 224, 159, 110, 210,
+                 184, 206, 179, 160, 189, 200, 170, 166, 197, 191, 156, 176, 168, 226, 208, 139,
+                 234, 147, 92, 223, 179, 213, 188, 153, 207, 179, 139, 189, 162, 232, 217, 132}},
+        {       // mode 11
+                {0x40, 0x28, 0x1C, 0x10, 0x50, 0xC2, 0xE4, 0x2C,
+                 0x18, 0x9A, 0x23, 0x3F, 0xB7, 0xDC, 0xAC, 0x87},
+                {0x42, 0x84, 0xE9, 0x14, 0x4C, 0x79, 0x58, 0xC0,
+                 0xE1, 0x35, 0x3B, 0xED, 0xFC, 0xC4, 0x59, 0x28},
+                {43, 11, 185, 117, 91, 84, 203, 174, 142, 161, 222, 57, 91, 84, 203, 57,
+                 190, 234, 239, 174, 142, 161, 222, 174, 190, 234, 239, 0, 190, 234, 239, 174,
+                 190, 234, 239, 117, 190, 234, 239, 57, 43, 11, 185, 0, 91, 84, 203, 0,
+                 43, 11, 185, 0, 142, 161, 222, 57, 190, 234, 239, 117, 43, 11, 185, 57}},
+        {       // mode 12
+                {0x66, 0x02, 0x57, 0x28, 0x16, 0x6C, 0xD9, 0xF5,
+                 0xBC, 0x9B, 0xD1, 0x06, 0x51, 0x23, 0xE8, 0x0C},
+                {0x53, 0x80, 0x97, 0xB0, 0x17, 0x7B, 0xFA, 0xDC,
+                 0x8E, 0x19, 0x30, 0x17, 0xC4, 0x8A, 0x60, 0x0B},
+                {95, 139, 141, 155, 117, 149, 134, 168, 129, 154, 131, 174, 129, 154, 131, 174,
+                 95, 139, 141, 155, 117, 149, 134, 168, 141, 160, 127, 181, 117, 149, 134, 168,
+                 129, 154, 131, 174, 141, 160, 127, 181, 95, 139, 141, 155, 141, 160, 127, 181,
+                 164, 170, 120, 193, 106, 144, 138, 161, 129, 154, 131, 174, 95, 139, 141, 155}},
+        {       // mode 13
+                {0xDF, 0xE6, 0xB3, 0x40, 0x25, 0xBF, 0xEA, 0xB6,
+                 0x08, 0x5B, 0xA8, 0xA6, 0xC3, 0x9E, 0xE2, 0xCF},
+                {0x41, 0x84, 0x2B, 0xF9, 0x55, 0xB7, 0x45, 0xD8,
+                 0x42, 0x35, 0x01, 0x00, 0x7F, 0x94, 0x37, 0x1C},
+                {149, 170, 34, 161, 252, 170, 34, 161, 252, 219, 108, 154, 149, 170, 34, 161,
+                 149, 170, 34, 161, 252, 219, 108, 154, 252, 170, 34, 161, 252, 219, 108, 154,
+                 149, 219, 108, 154, 252, 170, 34, 161, 252, 170, 34, 161, 149, 170, 34, 161,
+                 252, 170, 34, 161, 252, 219, 108, 154, 252, 219, 108, 154, 252, 219, 108, 154}},
+        {       // mode 14
+                {0x2D, 0x1D, 0x4F, 0xEE, 0xFF, 0x26, 0xC5, 0xD0,
+                 0xA3, 0x9E, 0x29, 0x7A, 0xF8, 0x6F, 0xFC, 0xAC},
+                {0x42, 0x80, 0xFD, 0xDF, 0xA4, 0x18, 0x7A, 0xD4,
+                 0x33, 0x45, 0x01, 0x00, 0xF9, 0xB1, 0xFF, 0xB0},
+                {167, 106, 177, 159, 157, 71, 61, 153, 172, 123, 234, 162, 172, 123, 234, 162,
+                 157, 71, 61, 153, 157, 71, 61, 153, 157, 71, 61, 153, 157, 71, 61, 153,
+                 167, 106, 177, 159, 157, 71, 61, 153, 172, 123, 234, 162, 162, 88, 118, 156,
+                 157, 71, 61, 153, 157, 71, 61, 153, 167, 106, 177, 159, 162, 88, 118, 156}},
+        {       // mode 15
+                {0x85, 0xC5, 0x95, 0x68, 0x3A, 0x57, 0xB7, 0xF7,
+                 0x78, 0x24, 0x0C, 0x55, 0x82, 0xA2, 0xC3, 0xA4},
+                {0x42, 0x82, 0xD2, 0xB9, 0xBA, 0xBD, 0x01, 0x00,
+                 0x64, 0xB8, 0x28, 0x48, 0x15, 0x86, 0xC4, 0xC3},
+                {207, 207, 207, 222, 118, 118, 118, 222, 207, 207, 207, 222, 216, 216, 216, 221,
+                 225, 225, 225, 221, 178, 178, 178, 222, 156, 156, 156, 222, 138, 138, 138, 222,
+                 216, 216, 216, 221, 225, 225, 225, 221, 196, 196, 196, 222, 225, 225, 225, 221,
+                 110, 110, 110, 222, 225, 225, 225, 221, 178, 178, 178, 222, 216, 216, 216, 221}},
+        {       // mode 16
+                {0x95, 0x9E, 0x94, 0x3A, 0xBB, 0xA7, 0xCE, 0x7A,
+                 0x09, 0x43, 0x98, 0xB1, 0xE8, 0x16, 0x6A, 0xB8},
+                {0x42, 0xE8, 0x2C, 0xC8, 0x3D, 0x75, 0xD6, 0x4B,
+                 0x18, 0xC2, 0x8C, 0x05, 0x1D, 0x56, 0x68, 0x27},
+                {238, 238, 238, 179, 136, 136, 136, 83, 74, 74, 74, 63, 169, 169, 169, 94,
+                 192, 192, 192, 122, 136, 136, 136, 83, 136, 136, 136, 83, 238, 238, 238, 179,
+                 192, 192, 192, 122, 74, 74, 74, 63, 74, 74, 74, 63, 216, 216, 216, 151,
+                 238, 238, 238, 179, 74, 74, 74, 63, 16, 16, 16, 44, 192, 192, 192, 122}},
+        {       // mode 17
+                {0xA5, 0xA0, 0xCC, 0x1E, 0x11, 0x1D, 0x91, 0x9D,
+                 0x2A, 0xA7, 0xB4, 0x75, 0x5B, 0xB6, 0x55, 0x88},
+                {0x42, 0x84, 0x10, 0xD1, 0x11, 0xD9, 0x01, 0xC0,
+                 0x50, 0x6D, 0xD3, 0x76, 0x6D, 0x29, 0xA7, 0x0A},
+                {136, 136, 136, 136, 168, 168, 168, 169, 168, 168, 168, 169, 201, 201, 201, 236,
+                 136, 136, 136, 169, 168, 168, 168, 203, 201, 201, 201, 169, 232, 232, 232, 203,
+                 201, 201, 201, 236, 201, 201, 201, 169, 232, 232, 232, 203, 136, 136, 136, 236,
+                 201, 201, 201, 169, 232, 232, 232, 203, 201, 201, 201, 203, 136, 136, 136, 136}},
+        {       // mode 18
+                {0x69, 0xE6, 0x12, 0xD7, 0x9A, 0x9A, 0xC9, 0x8C,
+                 0xC3, 0xD6, 0xAA, 0x43, 0xD8, 0x29, 0x91, 0x46},
+                {0x53, 0x02, 0xC5, 0xB5, 0xA6, 0x66, 0x62, 0x89,
+                 0x94, 0x1B, 0xC2, 0x55, 0x6B, 0xC3, 0x31, 0x23},
+                {37, 165, 177, 255, 48, 156, 179, 255, 32, 169, 176, 255, 54, 152, 180, 255,
+                 81, 132, 186, 255, 75, 136, 185, 255, 75, 136, 185, 255, 135, 90, 196, 255,
+                 32, 169, 176, 255, 26, 173, 175, 255, 140, 86, 197, 255, 124, 98, 194, 255,
+                 119, 103, 193, 255, 59, 148, 181, 255, 162, 69, 201, 255, 59, 148, 181, 255}}
+};
+
+/*!
+ * A 64x64 level where every 8th block is a reference block and the rest are solid colors,
+ * compressed with zstd -19 --check
+ */
+static constexpr uint8_t kLevelFrame[] = {
+        0x28, 0xB5, 0x2F, 0xFD, 0x64, 0x00, 0x0F, 0x75, 0x21, 0x00, 0x94, 0x3C,
+        0x81, 0xE8, 0xE1, 0x0A, 0xD8, 0x48, 0xFF, 0x4E, 0x17, 0x35, 0x37, 0xC3,
+        0xFA, 0x04, 0x24, 0xD5, 0x77, 0xA0, 0xA0, 0xFF, 0x1F, 0x00, 0xD7, 0x40,
+        0x61, 0x37, 0xE1, 0x21, 0x97, 0x81, 0xE2, 0xFE, 0xF7, 0x21, 0xA3, 0x57,
+        0xC2, 0x63, 0xB7, 0x62, 0x24, 0xF5, 0x3D, 0xDC, 0xC2, 0x6C, 0x71, 0x17,
+        0xE6, 0xCD, 0x06, 0xF7, 0xAC, 0x98, 0x9A, 0x9B, 0xC9, 0x77, 0xA3, 0xA5,
+        0xFD, 0x43, 0x66, 0xFD, 0xE4, 0x26, 0xFD, 0x84, 0xE7, 0xFC, 0x24, 0xA8,
+        0xFC, 0xC5, 0x68, 0xFC, 0x65, 0x29, 0xFD, 0x3D, 0xB9, 0x18, 0x6C, 0x26,
+        0x89, 0xD5, 0x14, 0xAA, 0xA5, 0xDD, 0xDC, 0x08, 0xC6, 0xC9, 0x77, 0xA6,
+        0xAA, 0xFB, 0x46, 0x6B, 0xFB, 0xE7, 0x2B, 0xFB, 0x87, 0xEC, 0xFA, 0x27,
+        0xAD, 0xFA, 0xC8, 0x6D, 0xFA, 0x68, 0x2E, 0xA3, 0x61, 0x26, 0xCC, 0x4C,
+        0x36, 0xC4, 0x7C, 0x1D, 0x42, 0xA3, 0xD1, 0xBB, 0x5F, 0xFD, 0x38, 0x77,
+        0xA9, 0xAF, 0xF9, 0x49, 0x70, 0xF9, 0xEA, 0x30, 0xF9, 0x8A, 0xF1, 0xF8,
+        0x2A, 0xB2, 0xF8, 0xCB, 0x72, 0xF8, 0x6B, 0x33, 0x53, 0x82, 0xCD, 0x08,
+        0x0E, 0xDB, 0x9A, 0xCD, 0x77, 0x7B, 0x67, 0xD4, 0x79, 0xDF, 0xC4, 0x5C,
+        0x77, 0xAC, 0xB4, 0xF7, 0x4C, 0x75, 0xF7, 0xED, 0x35, 0xF7, 0x8D, 0xF6,
+        0xF6, 0x2D, 0xB7, 0xF6, 0xCE, 0x77, 0xF6, 0x6E, 0x38, 0xAB, 0xAB, 0xDA,
+        0x43, 0x65, 0x0A, 0x9B, 0xFD, 0x5F, 0xDB, 0x35, 0xF9, 0x4D, 0xEC, 0xBA,
+        0x99, 0x77, 0xAF, 0xB9, 0xF5, 0x4F, 0x7A, 0xF5, 0xF0, 0x3A, 0xF5, 0x90,
+        0xFB, 0xF4, 0x30, 0xBC, 0xF4, 0xD1, 0x7C, 0xF4, 0x71, 0x3D, 0x7B, 0x21,
+        0x61, 0x35, 0x20, 0x3C, 0x3B, 0xF7, 0x66, 0xD0, 0x20, 0x6B, 0x58, 0x6B,
+        0x9C, 0xDE, 0x77, 0xB2, 0xBE, 0xF3, 0x52, 0x7F, 0xF3, 0xF3, 0x3F, 0xF3,
+        0x93, 0xE0, 0xF2, 0x33, 0xA1, 0xF2, 0xD4, 0x61, 0xF2, 0x74, 0x22, 0x47,
+        0xED, 0x9D, 0xB4, 0x3B, 0x77, 0x5C, 0x09, 0xAE, 0xDA, 0xED, 0x37, 0xA2,
+        0x8B, 0xF9, 0x42, 0x77, 0xB5, 0xA3, 0xF1, 0x55, 0x64, 0xF1, 0xF6, 0x24,
+        0xF1, 0x96, 0xE5, 0xF0, 0x36, 0xA6, 0xF0, 0xD7, 0x66, 0xF0, 0x77, 0x27,
+        0x97, 0x87, 0xAB, 0x97, 0x11, 0x77, 0xB8, 0xA8, 0xEF, 0x58, 0x69, 0xEF,
+        0xF9, 0x29, 0xEF, 0x99, 0xEA, 0xEE, 0x39, 0xAB, 0xEE, 0xDA, 0x6B, 0xEE,
+        0x7A, 0x2C, 0x8F, 0x8C, 0x4B, 0xDB, 0x39, 0x5B, 0x48, 0xBE, 0x0A, 0x10,
+        0x3F, 0x18, 0x87, 0xF1, 0x1E, 0xBC, 0x77, 0xBB, 0xAD, 0xED, 0x5B, 0x6E,
+        0xED, 0xFC, 0x2E, 0xED, 0x9C, 0xEF, 0xEC, 0x3C, 0xB0, 0xEC, 0xDD, 0x70,
+        0xEC, 0x7D, 0x31, 0xFA, 0x8F, 0xE4, 0xAE, 0xA6, 0x3B, 0x74, 0xCA, 0x1F,
+        0xB2, 0x44, 0x23, 0x89, 0xC7, 0xA0, 0xD5, 0x77, 0xBE, 0xB2, 0xEB, 0x5E,
+        0x73, 0xEB, 0xFF, 0x33, 0xEB, 0x9F, 0xF4, 0xEA, 0x3F, 0xB5, 0xEA, 0xC0,
+        0x75, 0xEA, 0x60, 0x36, 0x40, 0x28, 0x1C, 0x10, 0x50, 0xC2, 0xE4, 0x2C,
+        0x18, 0x9A, 0x23, 0x3F, 0xB7, 0xDC, 0xAC, 0x87, 0x77, 0xA1, 0xB7, 0xE9,
+        0x41, 0x78, 0xE9, 0xE2, 0x38, 0xE9, 0x82, 0xF9, 0xE8, 0x22, 0xBA, 0xE8,
+        0xC3, 0x7A, 0xE8, 0x63, 0x3B, 0x66, 0x02, 0x57, 0x28, 0x16, 0x6C, 0xD9,
+        0xF5, 0xBC, 0x9B, 0xD1, 0x06, 0x51, 0x23, 0xE8, 0x0C, 0x77, 0xA4, 0xBC,
+        0xE7, 0x44, 0x7D, 0xE7, 0xE5, 0x3D, 0xE7, 0x85, 0xFE, 0xE6, 0x25, 0xBF,
+        0xE6, 0xC6, 0x7F, 0xE6, 0x66, 0x20, 0xDF, 0xE6, 0xB3, 0x40, 0x25, 0xBF,
+        0xEA, 0xB6, 0x08, 0x5B, 0xA8, 0xA6, 0xC3, 0x9E, 0xE2, 0xCF, 0x77, 0xA7,
+        0xA1, 0xE5, 0x47, 0x62, 0xE5, 0xE8, 0x22, 0xE5, 0x88, 0xE3, 0xE4, 0x28,
+        0xA4, 0xE4, 0xC9, 0x64, 0xE4, 0x69, 0x25, 0x2D, 0x1D, 0x4F, 0xEE, 0xFF,
+        0x26, 0xC5, 0xD0, 0xA3, 0x9E, 0x29, 0x7A, 0xF8, 0x6F, 0xFC, 0xAC, 0x77,
+        0xAA, 0xA6, 0xE3, 0x4A, 0x67, 0xE3, 0xEB, 0x27, 0xE3, 0x8B, 0xE8, 0xE2,
+        0x2B, 0xA9, 0xE2, 0xCC, 0x69, 0xE2, 0x6C, 0x2A, 0x85, 0xC5, 0x95, 0x68,
+        0x3A, 0x57, 0xB7, 0xF7, 0x78, 0x24, 0x0C, 0x55, 0x82, 0xA2, 0xC3, 0xA4,
+        0x77, 0xAD, 0xAB, 0xE1, 0x4D, 0x6C, 0xE1, 0xEE, 0x2C, 0xE1, 0x8E, 0xED,
+        0xE0, 0x2E, 0xAE, 0xE0, 0xCF, 0x6E, 0xE0, 0x6F, 0x2F, 0x95, 0x9E, 0x94,
+        0x3A, 0xBB, 0xA7, 0xCE, 0x7A, 0x09, 0x43, 0x98, 0xB1, 0xE8, 0x16, 0x6A,
+        0xB8, 0x77, 0xB0, 0xB0, 0xFF, 0x50, 0x71, 0xFF, 0xF1, 0x31, 0xFF, 0x91,
+        0xF2, 0xFE, 0x31, 0xB3, 0xFE, 0xD2, 0x73, 0xFE, 0x72, 0x34, 0xA5, 0xA0,
+        0xCC, 0x1E, 0x11, 0x1D, 0x91, 0x9D, 0x2A, 0xA7, 0xB4, 0x75, 0x5B, 0xB6,
+        0x55, 0x88, 0x77, 0xB3, 0xB5, 0xFD, 0x53, 0x76, 0xFD, 0xF4, 0x36, 0xFD,
+        0x94, 0xF7, 0xFC, 0x34, 0xB8, 0xFC, 0xD5, 0x78, 0xFC, 0x75, 0x39, 0x69,
+        0xE6, 0x12, 0xD7, 0x9A, 0x9A, 0xC9, 0x8C, 0xC3, 0xD6, 0xAA, 0x43, 0xD8,
+        0x29, 0x91, 0x46, 0x77, 0xB6, 0xBA, 0xFB, 0x56, 0x7B, 0xFB, 0xF7, 0x3B,
+        0xFB, 0x97, 0xFC, 0xFA, 0x37, 0xBD, 0xFA, 0xD8, 0x7D, 0xFA, 0x78, 0x3E,
+        0xB9, 0xBF, 0xF9, 0x59, 0x60, 0xF9, 0xFA, 0x20, 0xF9, 0x9A, 0xE1, 0xF8,
+        0x3A, 0xA2, 0xF8, 0xDB, 0x62, 0xF8, 0x7B, 0x23, 0xF8, 0xBC, 0xA4, 0xF7,
+        0x5C, 0x65, 0xF7, 0xFD, 0x25, 0xF7, 0x9D, 0xE6, 0xF6, 0x3D, 0xA7, 0xF6,
+        0xDE, 0x67, 0xF6, 0x7E, 0x28, 0xF6, 0xBF, 0xA9, 0xF5, 0x5F, 0x6A, 0xF5,
+        0xE0, 0x2A, 0xF5, 0x80, 0xEB, 0xF4, 0x20, 0xAC, 0xF4, 0xC1, 0x6C, 0xF4,
+        0x61, 0x2D, 0xF4, 0xA2, 0xAE, 0xF3, 0x42, 0x6F, 0xF3, 0xE3, 0x2F, 0xF3,
+        0x83, 0xF0, 0xF2, 0x23, 0xB1, 0xF2, 0xC4, 0x71, 0xF2, 0x64, 0x32, 0xF2,
+        0xA5, 0xB3, 0xF1, 0x45, 0x74, 0xF1, 0xE6, 0x34, 0xF1, 0x86, 0xF5, 0xF0,
+        0x26, 0xB6, 0xF0, 0xC7, 0x76, 0xF0, 0x67, 0x37, 0xF0, 0xA8, 0xB8, 0xEF,
+        0x48, 0x79, 0xEF, 0xE9, 0x39, 0xEF, 0x89, 0xFA, 0xEE, 0x29, 0xBB, 0xEE,
+        0xCA, 0x7B, 0xEE, 0x6A, 0x3C, 0xEE, 0xAB, 0xBD, 0xED, 0x4B, 0x7E, 0xED,
+        0xEC, 0x3E, 0xED, 0x8C, 0xFF, 0xEC, 0x2C, 0xA0, 0xEC, 0xCD, 0x60, 0xEC,
+        0x6D, 0x21, 0xEC, 0xAE, 0xA2, 0xEB, 0x4E, 0x63, 0xEB, 0xEF, 0x23, 0xEB,
+        0x8F, 0xE4, 0xEA, 0x2F, 0xA5, 0xEA, 0xD0, 0x65, 0xEA, 0x70, 0x26, 0xEA,
+        0xB1, 0xA7, 0xE9, 0x51, 0x68, 0xE9, 0xF2, 0x28, 0xE9, 0x92, 0xE9, 0xE8,
+        0x32, 0xAA, 0xE8, 0xD3, 0x6A, 0xE8, 0x73, 0x2B, 0xE8, 0xB4, 0xAC, 0xE7,
+        0x54, 0x6D, 0xE7, 0xF5, 0x2D, 0xE7, 0x95, 0xEE, 0xE6, 0x35, 0xAF, 0xE6,
+        0xD6, 0x6F, 0xE6, 0x76, 0x30, 0xE6, 0xB7, 0xB1, 0xE5, 0x57, 0x72, 0xE5,
+        0xF8, 0x32, 0xE5, 0x98, 0xF3, 0xE4, 0x38, 0xB4, 0xE4, 0xD9, 0x74, 0xE4,
+        0x79, 0x35, 0xE4, 0xBA, 0xB6, 0xE3, 0x5A, 0x77, 0xE3, 0xFB, 0x37, 0xE3,
+        0x9B, 0xF8, 0xE2, 0x3B, 0xB9, 0xE2, 0xDC, 0x79, 0xE2, 0x7C, 0x3A, 0xE2,
+        0xBD, 0xBB, 0xE1, 0x5D, 0x7C, 0xE1, 0xFE, 0x3C, 0xE1, 0x9E, 0xFD, 0xE0,
+        0x3E, 0xBE, 0xE0, 0xDF, 0x7E, 0xE0, 0x7F, 0x3F, 0xE0, 0x80, 0xE2, 0xA8,
+        0x21, 0x04, 0x18, 0xB7, 0x94, 0x5F, 0x0F, 0x90, 0xAD, 0x2C, 0x73, 0x11,
+        0x3C, 0x82, 0x20, 0xEC, 0xA9, 0xFE, 0x0E, 0x0F, 0x77, 0xD1, 0xA7, 0x37,
+        0x7E, 0xE3, 0xA7, 0x37, 0xFE, 0xE2, 0x4F, 0x77, 0xFC, 0xE2, 0x4F, 0x6F,
+        0x80, 0x39, 0x83, 0x09, 0xD4, 0x9E, 0x13, 0xB0, 0x80, 0x8A, 0x31, 0xFC,
+        0xEE, 0xE3, 0x4F, 0x7B, 0xF0, 0x76, 0x86, 0xDF, 0x7F, 0xFC, 0x55, 0x0F,
+        0xBE, 0xCD, 0xE1, 0xF7, 0x1F, 0x7F, 0xDA, 0x0B, 0x09, 0xC5, 0xD0, 0x85,
+        0x53, 0x68, 0x83, 0x37, 0x33, 0xFC, 0xF6, 0xE3, 0xCF, 0x7A, 0xF0, 0x6E,
+        0x86, 0xBF, 0x3F, 0x67, 0x20, 0x9D, 0x60, 0x4E, 0x37, 0x03, 0x98, 0x2A,
+        0xEF, 0xEE, 0x48, 0x7F
+};
+static constexpr uint32_t kLevelWidth = 64;
+static constexpr int kLevelBlocks = 256;
+
+static constexpr std::string_view kText =
+        "Textures are transcoded from UASTC to ASTC when the device samples ASTC, to ETC2 when it "
+        "does not, and to RGBA8 when neither fits. Levels that toktx supercompressed with "
+        "Zstandard are inflated first, and every level is checked against the size the KTX2 "
+        "index records for it before it is uploaded.";
+
+/*!
+ * kText compressed with zstd -19 --check
+ */
+static constexpr uint8_t kTextFrame[] = {
+        0x28, 0xB5, 0x2F, 0xFD, 0x64, 0x28, 0x00, 0x45, 0x06, 0x00, 0x52, 0x4F,
+        0x2A, 0x1C, 0x60, 0x6F, 0x3A, 0x1F, 0xB1, 0x49, 0x62, 0xDA, 0x6E, 0x7F,
+        0xD0, 0x8E, 0x96, 0xB4, 0xC7, 0x08, 0x03, 0xB0, 0xF5, 0xF0, 0x4C, 0xB0,
+        0xC0, 0x32, 0x43, 0x10, 0x98, 0x07, 0x81, 0xFB, 0xA5, 0xE6, 0x40, 0x91,
+        0x15, 0xBD, 0xE8, 0x1F, 0xE2, 0x45, 0x67, 0x6B, 0xAC, 0x97, 0x4D, 0x3D,
+        0x5D, 0xF9, 0x31, 0xB4, 0xC0, 0xC1, 0x24, 0x7E, 0x41, 0x5D, 0x65, 0x98,
+        0x22, 0xC9, 0x77, 0x89, 0xFA, 0x52, 0x56, 0xB4, 0x63, 0x4B, 0x7E, 0x72,
+        0x4D, 0x6C, 0x7C, 0xDF, 0xE4, 0x34, 0x0C, 0x2F, 0xD3, 0xB1, 0xB4, 0xFA,
+        0xF0, 0x5A, 0xA4, 0xF8, 0xAE, 0xFA, 0x84, 0x9E, 0xA6, 0xF2, 0x50, 0xA4,
+        0xAE, 0xAC, 0xA4, 0xAD, 0x37, 0xAD, 0xB5, 0x3A, 0x9F, 0x5C, 0xE1, 0x80,
+        0x2E, 0x36, 0xCE, 0xAF, 0xC5, 0xB3, 0x01, 0xA1, 0x80, 0x58, 0xB8, 0xAD,
+        0x8F, 0x25, 0x03, 0xB6, 0x31, 0xEB, 0xDB, 0x79, 0x51, 0x60, 0x60, 0x0E,
+        0x6E, 0x6B, 0x80, 0xDE, 0x81, 0x9E, 0xA4, 0xBE, 0xC2, 0xC9, 0xCF, 0x5F,
+        0x6B, 0xF6, 0x45, 0x71, 0x5B, 0x1B, 0x18, 0x06, 0xA1, 0xE1, 0xA7, 0x65,
+        0xE3, 0xFB, 0x35, 0xA5, 0x2C, 0xE5, 0xFA, 0x99, 0xAC, 0xCF, 0x68, 0x2B,
+        0x67, 0x02, 0x0A, 0x00, 0x00, 0x70, 0xAC, 0x23, 0x7D, 0xD6, 0x41, 0x8A,
+        0xB5, 0xA1, 0xE1, 0xBE, 0xBB, 0x8C, 0x80, 0x09, 0x35, 0x46, 0x52, 0x23,
+        0x03, 0x75, 0xC2, 0xDB, 0x4B, 0x06, 0xC9, 0x76, 0x8E, 0x8D
+};
+
+/*!
+ * The ETC2 RGBA8 blocks of the 8x8 gradient makeGradient draws
+ */
+static constexpr uint8_t kGradientBlocks[] = {
+        0xE3, 0x3A, 0xFA, 0x8D, 0x41, 0xA0, 0xA0, 0x53, 0x48, 0xB6, 0x60, 0x03,
+        0x03, 0xFF, 0xC0, 0x2B, 0xBB, 0x3A, 0xFA, 0x8D, 0x41, 0xA0, 0xA0, 0x53,
+        0x68, 0xB6, 0x69, 0x03, 0x02, 0xFF, 0x00, 0x0F, 0xBB, 0x3A, 0xFA, 0x8D,
+        0x41, 0xA0, 0xA0, 0x53, 0x48, 0x9E, 0x69, 0x03, 0x00, 0xFF, 0x40, 0x0F,
+        0x93, 0x3A, 0xFA, 0x8D, 0x41, 0xA0, 0xA0, 0x53, 0x66, 0x98, 0x77, 0x01,
+        0x00, 0x3F, 0xFC, 0x00};
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what) {
+    printf("  %-48s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok) {
+        failures++;
+    }
+}
+
+/*!
+ * The color of a solid block in the level
+ */
+static void getSolidColor(int block, uint8_t *rgba) {
+    rgba[0] = uint8_t(block * 3);
+    rgba[1] = uint8_t(block * 5);
+    rgba[2] = uint8_t(255 - block * 2);
+    rgba[3] = 255;
+}
+
+/*!
+ * Fills in the level kLevelFrame decompresses to
+ */
+static std::vector<uint8_t> makeLevel() {
+    std::vector<uint8_t> level(kLevelBlocks * 16);
+    for (int i = 0; i < kLevelBlocks; i++) {
+        auto pBlock = level.data() + i * 16;
+        if (i % 8 == 0) {
+            memcpy(pBlock, kReferenceBlocks[(i / 8) % std::size(kReferenceBlocks)].uastc, 16);
+            continue;
+        }
+        // mode 8, a solid color, is its 5 bit code then the color
+        uint8_t rgba[4];
+        getSolidColor(i, rgba);
+        uint64_t bits = 0x17 | uint64_t(rgba[0]) << 5 | uint64_t(rgba[1]) << 13
+                | uint64_t(rgba[2]) << 21 | uint64_t(rgba[3]) << 29;
+        for (int j = 0; j < 8; j++) {
+            pBlock[j] = uint8_t(bits >> (j * 8));
+        }
+    }
+    return level;
+}
+
+static void checkReferenceBlocks() {
+    printf("reference blocks:\n");
+    for (int mode = 0; mode < int(std::size(kReferenceBlocks)); mode++) {
+        auto &reference = kReferenceBlocks[mode];
+        uint8_t rgba[64];
+        uint8_t astc[16];
+        bool opaque = true;
+        for (int i = 3; i < 64; i += 4) {
+            opaque = opaque && reference.rgba[i] == 255;
+        }
+        bool ok = UastcTranscoder::transcodeToRgba8(reference.uastc, 16, 4, 4, rgba)
+                && memcmp(rgba, reference.rgba, sizeof(rgba)) == 0
+                && UastcTranscoder::transcodeToAstc(reference.uastc, 16, astc)
+                && memcmp(astc, reference.astc, sizeof(astc)) == 0
+                && UastcTranscoder::isOpaque(reference.uastc, 16) == opaque;
+        char what[32];
+        snprintf(what, sizeof(what), "mode %d", mode);
+        expect(ok, what);
+    }
+
+    // 0x45 is the one reserved mode code
+    uint8_t corrupt[16];
+    memcpy(corrupt, kReferenceBlocks[0].uastc, sizeof(corrupt));
+    corrupt[0] = (corrupt[0] & 0x80) | 0x45;
+    uint8_t rgba[64];
+    uint8_t astc[16];
+    expect(!UastcTranscoder::transcodeToRgba8(corrupt, 16, 4, 4, rgba)
+                   && !UastcTranscoder::transcodeToAstc(corrupt, 16, astc),
+           "reserved mode fails");
+}
+
+static void checkZstd() {
+    printf("zstd:\n");
+    auto expected = makeLevel();
+    std::vector<uint8_t> level(expected.size());
+    expect(Zstd::decompress(kLevelFrame, sizeof(kLevelFrame), level.data(), level.size())
+                   && level == expected,
+           "level decompresses");
+
+    // the level transcodes to the reference blocks and solid colors, and solid blocks become
+    // ASTC void extent blocks
+    std::vector<uint8_t> rgba(kLevelWidth * kLevelWidth * 4);
+    std::vector<uint8_t> astc(level.size());
+    bool rgbaOk = UastcTranscoder::transcodeToRgba8(
+            level.data(), level.size(), kLevelWidth, kLevelWidth, rgba.data());
+    bool astcOk = UastcTranscoder::transcodeToAstc(level.data(), level.size(), astc.data());
+    static constexpr uint8_t kVoidExtent[] = {0xFC, 0xFD, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    for (int i = 0; i < kLevelBlocks; i++) {
+        auto &reference = kReferenceBlocks[(i / 8) % std::size(kReferenceBlocks)];
+        uint8_t solid[4];
+        getSolidColor(i, solid);
+        uint8_t expectedAstc[16];
+        memcpy(expectedAstc, kVoidExtent, sizeof(kVoidExtent));
+        for (int c = 0; c < 4; c++) {
+            expectedAstc[8 + c * 2] = solid[c];
+            expectedAstc[9 + c * 2] = solid[c];
+        }
+        astcOk = astcOk && memcmp(astc.data() + i * 16,
+                                  i % 8 == 0 ? reference.astc : expectedAstc, 16) == 0;
+        for (int pixel = 0; pixel < 16; pixel++) {
+            uint32_t x = i % (kLevelWidth / 4) * 4 + pixel % 4;
+            uint32_t y = i / (kLevelWidth / 4) * 4 + pixel / 4;
+            auto pExpected = i % 8 == 0 ? reference.rgba + pixel * 4 : solid;
+            rgbaOk = rgbaOk && memcmp(&rgba[(y * kLevelWidth + x) * 4], pExpected, 4) == 0;
+        }
+    }
+    expect(rgbaOk, "level transcodes to RGBA8");
+    expect(astcOk, "level transcodes to ASTC");
+
+    std::vector<uint8_t> text(kText.size());
+    expect(Zstd::decompress(kTextFrame, sizeof(kTextFrame), text.data(), text.size())
+                   && std::string_view((const char *) text.data(), text.size()) == kText,
+           "Huffman coded literals decompress");
+
+    std::vector<uint8_t> frame(std::begin(kLevelFrame), std::end(kLevelFrame));
+    frame.back() ^= 1;
+    expect(!Zstd::decompress(frame.data(), frame.size(), level.data(), level.size()),
+           "wrong checksum fails");
+    expect(!Zstd::decompress(kLevelFrame, sizeof(kLevelFrame) - 1, level.data(), level.size()),
+           "truncated frame fails");
+    expect(!Zstd::decompress(kLevelFrame, sizeof(kLevelFrame), level.data(), level.size() - 1),
+           "wrong size fails");
+}
+
+/*!
+ * An 8x8 gradient, changing in every channel across and down
+ */
+static std::vector<uint8_t> makeGradient() {
+    std::vector<uint8_t> pixels(8 * 8 * 4);
+    for (int y = 0; y < 8; y++) {
+        for (int x = 0; x < 8; x++) {
+            auto pPixel = &pixels[(y * 8 + x) * 4];
+            pPixel[0] = uint8_t(60 + x * 8);
+            pPixel[1] = uint8_t(180 - y * 6);
+            pPixel[2] = uint8_t(90 + x * 3 + y * 3);
+            pPixel[3] = uint8_t(255 - x * 10 - y * 10);
+        }
+    }
+    return pixels;
+}
+
+static void checkEtc2() {
+    printf("etc2:\n");
+    auto pixels = makeGradient();
+    uint8_t rgba[sizeof(kGradientBlocks)];
+    Etc2Encoder::encodeRgba8(pixels.data(), 8, 8, rgba);
+    expect(memcmp(rgba, kGradientBlocks, sizeof(rgba)) == 0, "RGBA8 gradient");
+
+    // the color blocks don't depend on alpha
+    uint8_t rgb[sizeof(kGradientBlocks) / 2];
+    Etc2Encoder::encodeRgb8(pixels.data(), 8, 8, rgb);
+    bool ok = true;
+    for (int i = 0; i < 4; i++) {
+        ok = ok && memcmp(rgb + i * 8, rgba + i * 16 + 8, 8) == 0;
+    }
+    expect(ok, "RGB8 matches the RGBA8 color blocks");
+}
+
+int main() {
+    checkReferenceBlocks();
+    checkZstd();
+    checkEtc2();
+    if (failures) {
+        printf("FAILED: %d checks\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*!
+ * Build time step that turns a PNG into a TextureContainer holding its full mip chain, so the app
+ * never has to generate mips on the GPU.
+ *
+ * Each level is filtered from the one above it in linear light with premultiplied alpha, which
+ * keeps edges from darkening and thin bright details from fading out. The 2x downsample uses a
+ * Catmull-Rom kernel rather than a box, so smaller levels stay a little sharper than what
+ * glGenerateMipmap gives and look the same on every GPU.
+ *
+ *   texture_tool [--straight-alpha] input.png output.mtex
+ */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <png.h>
+
+#include "PixelConvert.h"
+#include "TextureContainer.h"
+
+/*!
+ * TextureFormat::RGBA8, every level is written as 8 bits per channel and repacked at load time
+ */
+static constexpr uint32_t kFormatRGBA8 = 0;
+
+/*!
+ * Catmull-Rom weights for the four source texels around each destination texel when halving. The
+ * outer taps are negative, which is what keeps the result sharper than a box filter.
+ */
+static constexpr float kDownsampleWeights[4] = {-1.f / 16.f, 9.f / 16.f, 9.f / 16.f, -1.f / 16.f};
+
+/*!
+ * A level being filtered, as linear premultiplied RGBA
+ */
+struct FloatImage {
+    int width;
+    int height;
+    std::vector<float> pixels;
+
+    inline float *at(int x, int y) { return &pixels[(size_t(y) * width + x) * 4]; }
+
+    inline const float *at(int x, int y) const { return &pixels[(size_t(y) * width + x) * 4]; }
+};
+
+static float srgbToLinear(float value) {
+    return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.f / 2.4f) - 0.055f;
+}
+
+static bool readPng(const char *path, int &outWidth, int &outHeight, std::vector<uint8_t> &out) {
+    png_image image;
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_file(&image, path)) {
+        fprintf(stderr, "Couldn't read %s: %s\n", path, image.message);
+        return false;
+    }
+
+    image.format = PNG_FORMAT_RGBA;
+    out.resize(PNG_IMAGE_SIZE(image));
+    if (!png_image_finish_read(&image, nullptr, out.data(), 0, nullptr)) {
+        fprintf(stderr, "Couldn't decode %s: %s\n", path, image.message);
+        png_image_free(&image);
+        return false;
+    }
+    outWidth = int(image.width);
+    outHeight = int(image.height);
+    return true;
+}
+
+static FloatImage toLinearPremultiplied(int width, int height, const std::vector<uint8_t> &rgba) {
+    float srgbTable[256];
+    for (int i = 0; i < 256; i++) {
+        srgbTable[i] = srgbToLinear(float(i) / 255.f);
+    }
+
+    FloatImage image{width, height, std::vector<float>(size_t(width) * height * 4)};
+    for (size_t i = 0; i < size_t(width) * height; i++) {
+        float alpha = float(rgba[i * 4 + 3]) / 255.f;
+        for (int channel = 0; channel < 3; channel++) {
+            image.pixels[i * 4 + channel] = srgbTable[rgba[i * 4 + channel]] * alpha;
+        }
+        image.pixels[i * 4 + 3] = alpha;
+    }
+    return image;
+}
+
+/*!
+ * Halves one axis of @a source. An axis that's already 1 texel is copied through.
+ */
+static FloatImage downsampleAxis(const FloatImage &source, bool horizontal) {
+    int sourceLength = horizontal ? source.width : source.height;
+    if (sourceLength == 1) {
+        return source;
+    }
+
+    int length = std::max(sourceLength / 2, 1);
+    FloatImage result{
+            horizontal ? length : source.width,
+            horizontal ? source.height : length,
+            {}};
+    result.pixels.resize(size_t(result.width) * result.height * 4);
+
+    for (int y = 0; y < result.height; y++) {
+        for (int x = 0; x < result.width; x++) {
+            float sum[4] = {0.f, 0.f, 0.f, 0.f};
+            int center = horizontal ? x * 2 : y * 2;
+            for (int tap = 0; tap < 4; tap++) {
+                int position = std::clamp(center - 1 + tap, 0, sourceLength - 1);
+                const float *texel = horizontal ? source.at(position, y) : source.at(x, position);
+                for (int channel = 0; channel < 4; channel++) {
+                    sum[channel] += texel[channel] * kDownsampleWeights[tap];
+                }
+            }
+
+            // The negative lobes can overshoot. Premultiplied color can never exceed alpha.
+            float *out = result.at(x, y);
+            out[3] = std::clamp(sum[3], 0.f, 1.f);
+            for (int channel = 0; channel < 3; channel++) {
+                out[channel] = std::clamp(sum[channel], 0.f, out[3]);
+            }
+        }
+    }
+    return result;
+}
+
+/*!
+ * Encodes a level back to sRGB RGBA8 with straight alpha, the same thing a decoder returns
+ */
+static std::vector<uint8_t> toRgba8(const FloatImage &image) {
+    std::vector<uint8_t> rgba(size_t(image.width) * image.height * 4);
+    for (size_t i = 0; i < size_t(image.width) * image.height; i++) {
+        const float *texel = &image.pixels[i * 4];
+        float alpha = texel[3];
+        for (int channel = 0; channel < 3; channel++) {
+            float linear = alpha > 0.f ? std::min(texel[channel] / alpha, 1.f) : 0.f;
+            rgba[i * 4 + channel] = uint8_t(std::lround(linearToSrgb(linear) * 255.f));
+        }
+        rgba[i * 4 + 3] = uint8_t(std::lround(alpha * 255.f));
+    }
+    return rgba;
+}
+
+int main(int argc, char **argv) {
+    bool premultiply = true;
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--straight-alpha") == 0) {
+            premultiply = false;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.size() != 2) {
+        fprintf(stderr, "usage: %s [--straight-alpha] input.png output.mtex\n", argv[0]);
+        return 1;
+    }
+
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> rgba;
+    if (!readPng(paths[0], width, height, rgba)) {
+        return 1;
+    }
+
+    // The first level is the source as is, the rest are each filtered from the one above
+    std::vector<std::vector<uint8_t>> levels;
+    levels.push_back(rgba);
+    auto image = toLinearPremultiplied(width, height, rgba);
+    while (image.width > 1 || image.height > 1) {
+        image = downsampleAxis(downsampleAxis(image, true), false);
+        levels.push_back(toRgba8(image));
+    }
+
+    // Premultiply the encoded values, exactly like the runtime does for decoded images
+    uint32_t flags = 0;
+    if (premultiply) {
+        for (auto &level: levels) {
+            PixelConvert::premultiplyAlpha(level.data(), level.size() / 4);
+        }
+        flags |= TextureContainer::kFlagPremultipliedAlpha;
+    }
+
+    auto file = TextureContainer::write(
+            uint32_t(width), uint32_t(height), kFormatRGBA8, flags, levels);
+    auto pFile = fopen(paths[1], "wb");
+    if (!pFile || fwrite(file.data(), 1, file.size(), pFile) != file.size()) {
+        fprintf(stderr, "Couldn't write %s\n", paths[1]);
+        if (pFile) {
+            fclose(pFile);
+        }
+        return 1;
+    }
+    fclose(pFile);
+
+    printf("%s: %dx%d, %zu levels, %zu bytes\n",
+           paths[1], width, height, levels.size(), file.size());
+    return 0;
+}